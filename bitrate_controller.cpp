@@ -0,0 +1,231 @@
+#include "bitrate_controller.h"
+
+#include <cmath>
+
+namespace esphome {
+namespace intercom {
+
+// Loss-based control
+static constexpr float LOSS_HIGH = 0.10f;     // Above: cut by half the loss
+static constexpr float LOSS_LOW = 0.02f;      // Below: free to grow
+static constexpr float INCREASE_PER_S = 1.08f;
+static constexpr float MAX_INCREASE_S = 2.0f;  // Growth credited per report, however late it is
+// Near the rate of the last overuse, probe additively instead
+static constexpr float NEAR_CONGESTION = 0.9f;
+static constexpr float ADDITIVE_BPS_PER_S = 1000.0f;
+
+// Delay gradient
+static constexpr float GRADIENT_OVERUSE = 4.0f;  // ms of RTT per second
+static constexpr float GRADIENT_NORMAL = 1.0f;
+static constexpr float QUEUE_MIN_MS = 20.0f;        // Ignore slopes within this of the base RTT
+static constexpr float QUEUE_STANDING_MS = 200.0f;  // Overuse even if the slope is flat
+static constexpr float OVERUSE_BACKOFF = 0.85f;
+
+// FEC: enter at the first level, leave below the second for FEC_EXIT_REPORTS reports
+static constexpr float FEC1_ENTER = 0.03f;
+static constexpr float FEC1_EXIT = 0.01f;
+static constexpr float FEC2_ENTER = 0.10f;
+static constexpr float FEC2_EXIT = 0.05f;
+static constexpr uint8_t FEC_EXIT_REPORTS = 3;
+
+// Longer packets below these rates; shorter again only 25% above them
+static constexpr uint32_t PTIME_40_BELOW_BPS = 48000;
+static constexpr uint32_t PTIME_60_BELOW_BPS = 24000;
+static constexpr float PTIME_EXIT_MARGIN = 1.25f;
+
+static uint8_t ptime_for(float rate_bps) {
+  if (rate_bps < PTIME_60_BELOW_BPS) {
+    return 60;
+  }
+  return rate_bps < PTIME_40_BELOW_BPS ? 40 : 20;
+}
+
+void BitrateController::begin(uint32_t min_bps, uint32_t max_bps, uint32_t weak_max_bps, uint32_t now_ms) {
+  min_bps_ = min_bps;
+  max_bps_ = max_bps < min_bps ? min_bps : max_bps;
+  weak_max_bps_ = weak_max_bps < min_bps_ ? min_bps_ : weak_max_bps;
+  // Start at the top: an RSSI sample or the first report pulls it down
+  // within seconds, while probing up from the bottom would take a minute
+  rate_bps_ = (float) max_bps_;
+  last_report_ms_ = now_ms;
+  last_decrease_ms_ = now_ms;
+  decreased_ = false;
+  rtt_count_ = 0;
+  rtt_next_ = 0;
+  base_rtt_ms_ = 0.0f;
+  gradient_ = 0.0f;
+  congested_bps_ = 0.0f;
+  fec_low_reports_ = 0;
+  decision_ = BitrateDecision{};
+  decision_.ptime_ms = 20;
+  decision_.state = CongestionState::HOLD;
+  finish_(decision_);
+}
+
+bool BitrateController::on_report(uint8_t fraction_lost, bool rtt_valid, float rtt_ms, uint32_t now_ms) {
+  BitrateDecision before = decision_;
+  float loss = fraction_lost / 256.0f;
+  float dt_s = (now_ms - last_report_ms_) / 1000.0f;
+  if (dt_s > MAX_INCREASE_S) {
+    dt_s = MAX_INCREASE_S;
+  }
+  last_report_ms_ = now_ms;
+
+  if (rtt_valid) {
+    update_gradient_(rtt_ms, now_ms);
+  }
+
+  if (decision_.overuse) {
+    // A filling queue makes any loss congestion loss: what got through is
+    // the bottleneck rate, and the cut goes below it
+    congested_bps_ = rate_bps_ * (1.0f - loss);
+    rate_bps_ = OVERUSE_BACKOFF * congested_bps_;
+    decision_.state = CongestionState::DECREASE;
+  } else if (loss > LOSS_HIGH) {
+    rate_bps_ *= 1.0f - 0.5f * loss;
+    decision_.state = CongestionState::DECREASE;
+  } else if (loss < LOSS_LOW && gradient_ < GRADIENT_OVERUSE &&
+             (!decreased_ || now_ms - last_decrease_ms_ >= HOLD_AFTER_DECREASE_MS)) {
+    float near = NEAR_CONGESTION * congested_bps_;
+    if (congested_bps_ > 0.0f && rate_bps_ >= near) {
+      rate_bps_ += ADDITIVE_BPS_PER_S * dt_s;
+    } else {
+      rate_bps_ *= powf(INCREASE_PER_S, dt_s);
+      if (congested_bps_ > 0.0f && rate_bps_ > near) {
+        rate_bps_ = near;
+      }
+    }
+    decision_.state = CongestionState::INCREASE;
+  } else {
+    decision_.state = CongestionState::HOLD;
+  }
+  if (congested_bps_ > 0.0f && rate_bps_ > congested_bps_ / NEAR_CONGESTION) {
+    congested_bps_ = 0.0f;  // Well past the old bottleneck: it has moved
+  }
+  if (decision_.state == CongestionState::DECREASE) {
+    last_decrease_ms_ = now_ms;
+    decreased_ = true;
+  }
+
+  update_fec_(loss);
+  return finish_(before);
+}
+
+bool BitrateController::on_rssi(int8_t rssi_dbm, uint32_t now_ms) {
+  BitrateDecision before = decision_;
+  if (!decision_.weak_signal && rssi_dbm < WEAK_RSSI_DBM) {
+    decision_.weak_signal = true;
+    decision_.state = CongestionState::DECREASE;
+    last_decrease_ms_ = now_ms;
+    decreased_ = true;
+  } else if (decision_.weak_signal && rssi_dbm > RECOVERED_RSSI_DBM) {
+    decision_.weak_signal = false;
+  }
+  return finish_(before);
+}
+
+void BitrateController::update_gradient_(float rtt_ms, uint32_t now_ms) {
+  if (rtt_count_ == 0 || rtt_ms < base_rtt_ms_) {
+    base_rtt_ms_ = rtt_ms;
+  }
+  rtt_ms_[rtt_next_] = rtt_ms;
+  rtt_at_ms_[rtt_next_] = now_ms;
+  rtt_next_ = (rtt_next_ + 1) % TREND_WINDOW;
+  if (rtt_count_ < TREND_WINDOW) {
+    rtt_count_++;
+  }
+  if (rtt_count_ < 3) {
+    return;
+  }
+
+  // Least squares slope of RTT over time, relative to the oldest sample
+  size_t oldest = (rtt_next_ + TREND_WINDOW - rtt_count_) % TREND_WINDOW;
+  float sum_t = 0.0f, sum_d = 0.0f, sum_tt = 0.0f, sum_td = 0.0f;
+  for (size_t i = 0; i < rtt_count_; i++) {
+    size_t k = (oldest + i) % TREND_WINDOW;
+    float t = (rtt_at_ms_[k] - rtt_at_ms_[oldest]) / 1000.0f;
+    float d = rtt_ms_[k];
+    sum_t += t;
+    sum_d += d;
+    sum_tt += t * t;
+    sum_td += t * d;
+  }
+  float n = (float) rtt_count_;
+  float denom = n * sum_tt - sum_t * sum_t;
+  gradient_ = denom > 0.0f ? (n * sum_td - sum_t * sum_d) / denom : 0.0f;
+
+  float queue_ms = rtt_ms - base_rtt_ms_;
+  if (!decision_.overuse) {
+    decision_.overuse = (gradient_ > GRADIENT_OVERUSE && queue_ms > QUEUE_MIN_MS) || queue_ms > QUEUE_STANDING_MS;
+  } else {
+    // The window still holds the spike after the queue has drained
+    decision_.overuse = queue_ms > QUEUE_MIN_MS && (gradient_ >= GRADIENT_NORMAL || queue_ms > QUEUE_STANDING_MS);
+  }
+}
+
+void BitrateController::update_fec_(float loss) {
+  uint8_t wanted = loss >= FEC2_ENTER ? 2 : loss >= FEC1_ENTER ? 1 : 0;
+  if (wanted >= decision_.fec_depth) {
+    decision_.fec_depth = wanted;
+    fec_low_reports_ = 0;
+    return;
+  }
+  float exit = decision_.fec_depth == 2 ? FEC2_EXIT : FEC1_EXIT;
+  if (loss >= exit) {
+    fec_low_reports_ = 0;
+  } else if (++fec_low_reports_ >= FEC_EXIT_REPORTS) {
+    decision_.fec_depth--;
+    fec_low_reports_ = 0;
+  }
+}
+
+bool BitrateController::finish_(const BitrateDecision &before) {
+  float cap = (float) (decision_.weak_signal ? weak_max_bps_ : max_bps_);
+  if (rate_bps_ > cap) {
+    rate_bps_ = cap;
+  }
+  if (rate_bps_ < (float) min_bps_) {
+    rate_bps_ = (float) min_bps_;
+  }
+
+  // A weak link retries every frame at the MAC layer: fewer, longer packets
+  // and one redundant frame ride out the losses that still get through
+  if (decision_.weak_signal && decision_.fec_depth == 0) {
+    decision_.fec_depth = 1;
+  }
+  uint8_t ptime = ptime_for(rate_bps_);
+  if (ptime < decision_.ptime_ms) {
+    ptime = ptime_for(rate_bps_ / PTIME_EXIT_MARGIN);
+    if (ptime > decision_.ptime_ms) {
+      ptime = decision_.ptime_ms;
+    }
+  }
+  if (decision_.weak_signal && ptime < 40) {
+    ptime = 40;
+  }
+  decision_.ptime_ms = ptime;
+
+  decision_.bitrate_bps = (uint32_t) rate_bps_;
+  if (decision_.state == CongestionState::INCREASE && decision_.bitrate_bps == before.bitrate_bps) {
+    decision_.state = CongestionState::HOLD;  // Already at the cap
+  }
+  decision_.encoder_bps = decision_.bitrate_bps / (1 + decision_.fec_depth);
+
+  return decision_.bitrate_bps != before.bitrate_bps || decision_.ptime_ms != before.ptime_ms ||
+         decision_.fec_depth != before.fec_depth || decision_.state != before.state ||
+         decision_.overuse != before.overuse || decision_.weak_signal != before.weak_signal;
+}
+
+const char *BitrateController::state_name(CongestionState state) {
+  switch (state) {
+    case CongestionState::INCREASE:
+      return "increase";
+    case CongestionState::DECREASE:
+      return "decrease";
+    default:
+      return "hold";
+  }
+}
+
+}  // namespace intercom
+}  // namespace esphome
@@ -0,0 +1,101 @@
+/*
+ * Bitrate Controller
+ * Congestion control for the raw RTP audio path. Consumes the RTCP feedback
+ * from rtp_session.h (loss and round-trip time) and the Wi-Fi RSSI, and
+ * decides the encoder bitrate, the packet time and the FEC depth.
+ *
+ * Loss-based control with delay-gradient detection, after the loss and
+ * delay halves of Google Congestion Control:
+ *
+ *   - loss above 10% cuts the rate by half the loss fraction; below 2% the
+ *     rate may grow by 8% per second; in between it holds
+ *   - a rising RTT trend (least squares slope over the last reports) with a
+ *     queue above the call's base RTT means the bottleneck is filling
+ *     before it drops anything: the rate is cut to 85% of what got through,
+ *     and growth near that rate afterwards is additive
+ *   - after any cut the rate holds for HOLD_AFTER_DECREASE_MS before it may
+ *     grow again, and the weak signal, packet time and FEC thresholds each
+ *     have a separate exit level, so the decisions do not flap
+ *
+ * Plain C++ with no platform calls: the caller passes in the time, so the
+ * same code runs on the host.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace intercom {
+
+enum class CongestionState : uint8_t {
+  HOLD = 0,
+  INCREASE,
+  DECREASE,
+};
+
+struct BitrateDecision {
+  uint32_t bitrate_bps;   // Total send rate budget, redundancy included
+  uint32_t encoder_bps;   // What the encoder gets once FEC is paid for
+  uint8_t ptime_ms;       // Audio per packet: 20, 40 or 60
+  uint8_t fec_depth;      // Redundant copies of earlier frames per packet (0-2)
+  CongestionState state;  // What the last update did
+  bool overuse;           // Delay gradient says the queue is growing
+  bool weak_signal;       // RSSI below the weak threshold
+};
+
+class BitrateController {
+ public:
+  static constexpr int8_t WEAK_RSSI_DBM = -75;
+  static constexpr int8_t RECOVERED_RSSI_DBM = -70;
+  static constexpr uint32_t HOLD_AFTER_DECREASE_MS = 10000;
+  static constexpr size_t TREND_WINDOW = 6;
+
+  // weak_max_bps caps the rate while the RSSI is below WEAK_RSSI_DBM
+  void begin(uint32_t min_bps, uint32_t max_bps, uint32_t weak_max_bps, uint32_t now_ms);
+
+  // Feed one RTCP report about our stream: fraction_lost in 1/256 as in the
+  // report block, rtt_ms only when rtt_valid. Returns true if the decision
+  // changed.
+  bool on_report(uint8_t fraction_lost, bool rtt_valid, float rtt_ms, uint32_t now_ms);
+  // Feed a Wi-Fi RSSI sample. Returns true if the decision changed.
+  bool on_rssi(int8_t rssi_dbm, uint32_t now_ms);
+
+  const BitrateDecision &decision() const { return decision_; }
+  // RTT trend over the window in ms per second (positive: queue growing)
+  float delay_gradient() const { return gradient_; }
+
+  static const char *state_name(CongestionState state);
+
+ protected:
+  void update_gradient_(float rtt_ms, uint32_t now_ms);
+  void update_fec_(float loss);
+  // Recompute the derived fields; returns true if any of them changed
+  bool finish_(const BitrateDecision &before);
+
+  uint32_t min_bps_{0};
+  uint32_t max_bps_{0};
+  uint32_t weak_max_bps_{0};
+  float rate_bps_{0.0f};
+
+  uint32_t last_report_ms_{0};
+  uint32_t last_decrease_ms_{0};
+  bool decreased_{false};
+
+  // Delay gradient
+  float rtt_ms_[TREND_WINDOW]{};
+  uint32_t rtt_at_ms_[TREND_WINDOW]{};
+  size_t rtt_count_{0};
+  size_t rtt_next_{0};
+  float base_rtt_ms_{0.0f};
+  float gradient_{0.0f};
+  float congested_bps_{0.0f};  // Rate at the last overuse; 0 when unknown
+
+  uint8_t fec_low_reports_{0};  // Consecutive reports below the FEC exit level
+
+  BitrateDecision decision_{0, 0, 20, 0, CongestionState::HOLD, false, false};
+};
+
+}  // namespace intercom
+}  // namespace esphome
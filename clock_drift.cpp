@@ -0,0 +1,154 @@
+#include "clock_drift.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace esphome {
+namespace intercom {
+
+static float clamp_ppm(float ppm) {
+  if (ppm > DriftEstimator::MAX_PPM) {
+    return DriftEstimator::MAX_PPM;
+  }
+  return ppm < -DriftEstimator::MAX_PPM ? -DriftEstimator::MAX_PPM : ppm;
+}
+
+void DriftEstimator::begin(uint32_t sample_rate, uint32_t target_fill) {
+  sample_rate_ = sample_rate;
+  target_fill_ = target_fill;
+  // The queue integrates the clock difference: d(fill)/dt = rate * ppm * 1e-6.
+  // Gains that place both poles of the closed loop at LOOP_RAD_S.
+  float plant = sample_rate * 1e-6f;
+  kp_ = 2.0f * LOOP_DAMPING * LOOP_RAD_S / plant;
+  ki_ = LOOP_RAD_S * LOOP_RAD_S / plant;
+  started_ = false;
+  integral_ = 0;
+  drift_avg_ = 0;
+  stats_ = DriftStats{};
+}
+
+void DriftEstimator::on_output(size_t samples, uint64_t now_us) {
+  if (!started_) {
+    started_ = true;
+    anchor_us_ = now_us;
+    last_us_ = now_us;
+    written_ = target_fill_;
+    fill_avg_ = (float) target_fill_;
+  } else {
+    int64_t played = (int64_t) ((now_us - anchor_us_) * sample_rate_ / 1000000);
+    int64_t fill = written_ - played;
+    float dt = (now_us - last_us_) * 1e-6f;
+    last_us_ = now_us;
+    if (fill < 0) {
+      // Whatever was queued has played out; start over from the target
+      // rather than steer against a gap the network made
+      stats_.underruns++;
+      anchor_us_ = now_us;
+      written_ = target_fill_;
+      fill_avg_ = (float) target_fill_;
+    } else if (dt > 0) {
+      fill_avg_ += (fill - fill_avg_) * dt / (FILL_TAU_S + dt);
+      float error = fill_avg_ - (float) target_fill_;
+      integral_ = clamp_ppm(integral_ + ki_ * error * dt);
+      stats_.correction_ppm = clamp_ppm(kp_ * error + integral_);
+      drift_avg_ += (integral_ - drift_avg_) * dt / (DRIFT_TAU_S + dt);
+      stats_.drift_ppm = drift_avg_;
+    }
+  }
+  written_ += samples;
+  stats_.fill = (int32_t) fill_avg_;
+}
+
+// Zeroth order modified Bessel function, for the Kaiser window
+static double bessel_i0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 32; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if (term < sum * 1e-12) {
+      break;
+    }
+  }
+  return sum;
+}
+
+void DriftResampler::begin() {
+  // Cut off a little below the input Nyquist frequency: the ratio stays
+  // within a percent of 1, so there is next to nothing to alias
+  static constexpr double CUTOFF = 0.92;
+  static constexpr double BETA = 7.0;  // About 70 dB of stopband
+  const double half = TAPS / 2.0;
+  const double norm = bessel_i0(BETA);
+  for (size_t p = 0; p <= PHASES; p++) {
+    double frac = (double) p / PHASES;
+    double sum = 0;
+    double h[TAPS];
+    for (size_t k = 0; k < TAPS; k++) {
+      // Distance from this tap to the output instant, which lies frac past
+      // tap TAPS / 2 - 1
+      double d = (double) k - (half - 1.0) - frac;
+      double x = M_PI * CUTOFF * d;
+      double sinc = d == 0 ? 1.0 : sin(x) / x;
+      double r = d / half;
+      double window = r * r < 1.0 ? bessel_i0(BETA * sqrt(1.0 - r * r)) / norm : 0.0;
+      h[k] = sinc * window;
+      sum += h[k];
+    }
+    // Unity gain at DC for every phase, so a changing ratio cannot
+    // modulate the level
+    for (size_t k = 0; k < TAPS; k++) {
+      table_[p][k] = (float) (h[k] / sum);
+    }
+  }
+  memset(work_, 0, sizeof(work_));
+  pos_ = 0;
+  step_ = 1ULL << 32;
+}
+
+void DriftResampler::set_ratio(double ratio) {
+  if (ratio > 1.0 + MAX_RATIO_OFFSET) {
+    ratio = 1.0 + MAX_RATIO_OFFSET;
+  } else if (ratio < 1.0 - MAX_RATIO_OFFSET) {
+    ratio = 1.0 - MAX_RATIO_OFFSET;
+  }
+  step_ = (uint64_t) llround(ratio * 4294967296.0);
+}
+
+size_t DriftResampler::process(const int16_t *in, size_t len, int16_t *out) {
+  size_t produced = 0;
+  while (len > 0) {
+    size_t chunk = len < MAX_INPUT ? len : MAX_INPUT;
+    memcpy(work_ + HISTORY, in, chunk * sizeof(int16_t));
+    // The kernel may start at any of the first `chunk` samples; past that
+    // it would need input not here yet
+    uint64_t end = (uint64_t) chunk << 32;
+    while (pos_ < end) {
+      size_t start = (size_t) (pos_ >> 32);
+      uint32_t frac = (uint32_t) pos_;
+      uint32_t phase = frac >> (32 - PHASE_BITS);
+      float weight = (float) (frac << PHASE_BITS) * (1.0f / 4294967296.0f);
+      const int16_t *x = work_ + start;
+      const float *a = table_[phase];
+      const float *b = table_[phase + 1];
+      float acc_a = 0;
+      float acc_b = 0;
+      for (size_t k = 0; k < TAPS; k++) {
+        acc_a += x[k] * a[k];
+        acc_b += x[k] * b[k];
+      }
+      float y = acc_a + (acc_b - acc_a) * weight;
+      long v = lrintf(y);
+      out[produced++] = (int16_t) (v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v));
+      pos_ += step_;
+    }
+    pos_ -= end;
+    memmove(work_, work_ + chunk, HISTORY * sizeof(int16_t));
+    in += chunk;
+    len -= chunk;
+  }
+  return produced;
+}
+
+}  // namespace intercom
+}  // namespace esphome
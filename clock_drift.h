@@ -0,0 +1,107 @@
+/*
+ * Clock Drift Compensation
+ * The remote captures on its own crystal and our speaker plays on ours;
+ * a few hundred ppm apart, the queue in between gains or loses a frame
+ * every minute or so. DriftEstimator watches how full the playout queue
+ * is and steers a resampling ratio that holds it level; DriftResampler
+ * applies that ratio, so the difference is taken up a fraction of a
+ * sample at a time instead of by dropping or repeating whole frames.
+ *
+ * The estimator models the queue (for the raw RTP path, the speaker's DMA
+ * ring) as what was handed to the output minus what the local sample
+ * clock has played since. The first write is assumed to find target_fill
+ * samples queued; only changes in fill matter to the loop, so an unknown
+ * constant latency does not. The fill is smoothed over FILL_TAU_S to ride
+ * out network jitter, then a PI loop with a bandwidth of LOOP_RAD_S turns
+ * it into a correction of at most MAX_PPM. The integral settles on the
+ * drift itself; stats() reports it averaged over DRIFT_TAU_S. If the model
+ * says the queue ran dry it is re-anchored at target_fill, keeping the
+ * drift learned so far.
+ *
+ * The resampler is a 24-tap Kaiser-windowed sinc with 32 phases, linearly
+ * interpolated between them, and a position kept in 32.32 fixed point. The
+ * ratio can change between any two samples without a step in the output.
+ *
+ * Plain C++ with the time passed in and no heap, so the same code runs on
+ * the host.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace intercom {
+
+struct DriftStats {
+  float drift_ppm{0};       // Remote clock against ours, + when it runs fast
+  float correction_ppm{0};  // Applied now; drift plus what levels the queue
+  int32_t fill{0};          // Smoothed playout fill (samples)
+  uint32_t underruns{0};    // Times the queue ran dry and was re-anchored
+};
+
+class DriftEstimator {
+ public:
+  static constexpr float MAX_PPM = 500.0f;
+  static constexpr float FILL_TAU_S = 2.0f;
+  static constexpr float LOOP_RAD_S = 0.1f;  // A period of about a minute
+  static constexpr float LOOP_DAMPING = 1.0f;
+  static constexpr float DRIFT_TAU_S = 60.0f;  // Averaging of the reported drift
+
+  // Forgets the queue and the drift learned so far
+  void begin(uint32_t sample_rate, uint32_t target_fill);
+  // samples were handed to the output at now_us, which drains them at
+  // sample_rate. Call before each write, with what the write took.
+  void on_output(size_t samples, uint64_t now_us);
+
+  // Input samples to consume per output sample
+  double ratio() const { return 1.0 + stats_.correction_ppm * 1e-6; }
+  const DriftStats &stats() const { return stats_; }
+
+ protected:
+  uint32_t sample_rate_{16000};
+  int64_t target_fill_{0};
+  float kp_{0};  // ppm per sample of fill error
+  float ki_{0};  // ppm per sample-second
+  bool started_{false};
+  uint64_t anchor_us_{0};
+  uint64_t last_us_{0};
+  int64_t written_{0};  // Samples handed over since anchor_us_
+  float fill_avg_{0};
+  float integral_{0};
+  float drift_avg_{0};
+  DriftStats stats_;
+};
+
+class DriftResampler {
+ public:
+  static constexpr size_t TAPS = 24;
+  static constexpr size_t PHASES = 32;
+  static constexpr size_t MAX_INPUT = 1024;  // Longer blocks are taken in pieces
+  static constexpr double MAX_RATIO_OFFSET = 0.01;
+
+  // Builds the filter and clears the history (silence), ratio 1
+  void begin();
+  // Input samples per output sample, within 1 +- MAX_RATIO_OFFSET. Takes
+  // effect from the next output sample.
+  void set_ratio(double ratio);
+  // Resamples len samples into out, which must hold max_output(len), and
+  // returns how many were written. The output lags by TAPS / 2 samples.
+  size_t process(const int16_t *in, size_t len, int16_t *out);
+  static constexpr size_t max_output(size_t len) { return len + len / 64 + 2; }
+
+ protected:
+  static constexpr uint32_t PHASE_BITS = 5;  // log2(PHASES)
+  static constexpr size_t HISTORY = TAPS - 1;
+
+  // One more phase than PHASES so the last interpolates towards a whole
+  // sample step
+  float table_[PHASES + 1][TAPS];
+  int16_t work_[HISTORY + MAX_INPUT];
+  uint64_t pos_{0};   // Kernel start in work_, 32.32
+  uint64_t step_{1ULL << 32};
+};
+
+}  // namespace intercom
+}  // namespace esphome
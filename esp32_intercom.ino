@@ -21,6 +21,42 @@
 #include <WebSocketsClient.h>
 #include <ArduinoJson.h>
 #include <driver/i2s.h>
+#include <esp_timer.h>
+#include <esp_random.h>
+#include <esp_wifi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "clock_drift.h"
+#include "ice_lite.h"
+#include "rtp_red.h"
+#include "rtp_session.h"
+#include "sdp.h"
+#include "srtp.h"
+#include "tx_pacer.h"
+#include "udp_socket.h"
+
+using esphome::intercom::DriftEstimator;
+using esphome::intercom::DriftResampler;
+using esphome::intercom::DriftStats;
+using esphome::intercom::IceLite;
+using esphome::intercom::IceState;
+using esphome::intercom::RedBlock;
+using esphome::intercom::RtpHeader;
+using esphome::intercom::RtpSession;
+using esphome::intercom::RtcpStats;
+using esphome::intercom::SdpCandidate;
+using esphome::intercom::SdpCodecCap;
+using esphome::intercom::SdpDescription;
+using esphome::intercom::SdpLocal;
+using esphome::intercom::SdpNegotiation;
+using esphome::intercom::SrtpContext;
+using esphome::intercom::PacerStats;
+using esphome::intercom::SrtpSuite;
+using esphome::intercom::TxPacer;
+using esphome::intercom::UdpDatagram;
+using esphome::intercom::UdpSocket;
+using esphome::intercom::set_socket_dscp;
 
 // ============================================================================
 // CONFIGURATION - Modify these for your setup
@@ -53,8 +89,14 @@ const char* signalingPath = "/endpoint/webrtc";
 // GLOBAL VARIABLES
 // ============================================================================
 
-// WebSocket client
-WebSocketsClient webSocket;
+// WebSocket client. The subclass reaches the TCP socket underneath, to
+// mark signaling for the Wi-Fi queues (udp_socket.h).
+class SignalingClient : public WebSocketsClient {
+ public:
+  int fd() { return _client.tcp != nullptr ? _client.tcp->fd() : -1; }
+};
+SignalingClient webSocket;
+#define SIGNALING_DSCP 34  // AF41; 0 leaves signaling best effort
 
 // Device identification
 String clientId;
@@ -69,10 +111,91 @@ bool isReady = false;
 bool muted = false;
 
 // Audio streaming
-WiFiUDP udp;
-IPAddress remoteAudioIP;
-int remoteAudioPort = 0;
+UdpSocket audioSocket;
+uint32_t remoteAudioIP = 0;  // Host order
+uint16_t remoteAudioPort = 0;
 int localAudioPort = 5004;
+#define PACKET_SAMPLES (SAMPLE_RATE / 50)  // 20 ms, the ptime in our SDP
+#define AUDIO_DSCP 46  // EF; CS6 (48) where the driver needs it for the voice queue
+
+// The radio stays awake (WIFI_PS_NONE) while a call streams, so packets
+// for us are not held at the access point until the next DTIM beacon.
+// Set to 0 to keep the power save mode through calls.
+#define POWER_SAVE_OFF_IN_CALL 1
+bool powerSaveHeld = false;
+wifi_ps_type_t savedPowerSave = WIFI_PS_MIN_MODEM;
+volatile uint32_t sendLatencyUs = 0;  // Time per packet in the send call, smoothed
+
+// Audio runs in two tasks so loop() only does signaling: captureTask is
+// paced by the mic and sends, renderTask waits on the socket and plays.
+// Their waits are bounded so they notice a stop promptly. While they
+// stream, what they share with loop() is only touched holding stateLock.
+#define AUDIO_TASK_STACK 4096
+#define AUDIO_TASK_PRIORITY 5
+#define AUDIO_RECEIVE_TIMEOUT_MS 20
+#define AUDIO_IO_TIMEOUT_MS 40
+#define AUDIO_STOP_TIMEOUT_MS 250
+TaskHandle_t captureTaskHandle = NULL;
+TaskHandle_t renderTaskHandle = NULL;
+SemaphoreHandle_t stateLock = NULL;
+volatile bool streaming = false;
+volatile bool captureBusy = false;
+volatile bool renderBusy = false;
+
+// Packets leave on an esp_timer one packet time apart (tx_pacer.h), not
+// whenever capture finishes one
+#define PACER_HOLD_US 10000
+#define PACER_BACKLOG 4
+#define PACER_IDLE_US 5000
+TxPacer pacer;
+esp_timer_handle_t paceTimer = NULL;
+volatile bool paceBusy = false;
+
+// RTP/RTCP (rtp_session.h), multiplexed on the audio port. 16-bit PCM
+// (L16, network byte order) under a dynamic payload type, same as the
+// ESPHome legacy component; an answer takes the offerer's number.
+#define RTP_PAYLOAD_TYPE 96
+// RFC 2198 redundancy the component adds on lossy links. This sketch
+// declines it in its SDP, and plays the primary block should a peer send
+// it anyway.
+#define RTP_RED_PAYLOAD_TYPE 97
+RtpSession rtp;
+uint8_t rtcpPacket[esphome::intercom::RTCP_MAX_PACKET_SIZE + esphome::intercom::SRTCP_TRAILER];
+uint8_t payloadType = RTP_PAYLOAD_TYPE;
+bool rtcpMux = true;  // RTCP shares the RTP port; otherwise it goes to port + 1
+
+// Session descriptions (sdp.h)
+#define MAX_SDP 512
+const SdpCodecCap audioCodecs[] = {
+  {"L16", SAMPLE_RATE, 1, 256, RTP_PAYLOAD_TYPE},
+};
+bool offerPending = false;  // startCall() offers once the room is ready
+
+// ICE-lite (ice_lite.h) on the audio port. The remote address is the pair
+// it selects from the signaled candidates, never just whoever sent last.
+IceLite ice;
+uint32_t iceGeneration = 0;
+uint8_t stunPacket[IceLite::MAX_MESSAGE];    // Consent checks from loop()
+uint8_t stunResponse[IceLite::MAX_MESSAGE];  // Answers from renderTask
+
+// SRTP (srtp.h), keyed over SDP: audio goes out under our key and comes in
+// under the remote's. Set to 0 to still talk to peers that only do plain RTP.
+#define SRTP_REQUIRED 1
+SrtpContext srtpTx;
+SrtpContext srtpRx;
+uint8_t srtpLocalKey[esphome::intercom::SRTP_MASTER_SIZE];
+char srtpLocalKeyBase64[esphome::intercom::SRTP_MASTER_BASE64];
+SrtpSuite srtpSuite = SrtpSuite::AES_CM_128_HMAC_SHA1_80;
+uint8_t srtpTag = 1;
+
+// Playout follows the remote's sample clock (clock_drift.h): each packet is
+// resampled by the ratio that keeps the speaker's queue 40 ms deep, so a
+// long call neither overflows nor starves it
+#define PLAYOUT_TARGET_SAMPLES (SAMPLE_RATE / 25)
+DriftEstimator drift;
+DriftResampler resampler;
+int16_t playoutIn[BUFFER_SIZE];  // Aligned copy; RED can leave the audio at an odd offset
+int16_t playoutOut[DriftResampler::max_output(BUFFER_SIZE)];
 
 // ============================================================================
 // FUNCTION PROTOTYPES
@@ -88,10 +211,24 @@ void startAudio();
 void stopAudio();
 void sendAudioPacket();
 void receiveAudioPacket();
+void startRtpSession();
+void sendRtcp();
 void startCall(String deviceId);
 void endCall();
-void acceptCall();
+void acceptCall(const char *offer);
+void sendOffer();
+bool applyRemoteSdp(const char *sdp, SdpNegotiation *negotiation);
+size_t writeLocalSdp(const SdpNegotiation *answer, char *buf, size_t cap);
+void restartIce();
+void restartSrtp();
+void pollIce();
+void updateIcePath();
 void toggleMute();
+void startStreaming();
+void stopStreaming();
+void captureTask(void *arg);
+void paceTimerCallback(void *arg);
+void renderTask(void *arg);
 
 // ============================================================================
 // SETUP
@@ -140,11 +277,25 @@ void setup() {
   webSocket.setReconnectInterval(5000);
   
   // Setup UDP for audio
-  udp.begin(localAudioPort);
+  if (!audioSocket.open(localAudioPort, AUDIO_RECEIVE_TIMEOUT_MS)) {
+    Serial.printf("Could not bind UDP port %d\n", localAudioPort);
+    return;
+  }
   Serial.printf("UDP audio port: %d\n", localAudioPort);
+  if (AUDIO_DSCP != 0 && !audioSocket.set_dscp(AUDIO_DSCP)) {
+    Serial.println("Could not mark audio with DSCP");
+  }
   
-  // Initialize I2S for audio
+  // Initialize I2S and the tasks for audio
   startAudio();
+  stateLock = xSemaphoreCreateMutex();
+  xTaskCreate(captureTask, "audio_capture", AUDIO_TASK_STACK, NULL, AUDIO_TASK_PRIORITY, &captureTaskHandle);
+  xTaskCreate(renderTask, "audio_render", AUDIO_TASK_STACK, NULL, AUDIO_TASK_PRIORITY, &renderTaskHandle);
+  esp_timer_create_args_t paceTimerArgs = {};
+  paceTimerArgs.callback = paceTimerCallback;
+  paceTimerArgs.dispatch_method = ESP_TIMER_TASK;
+  paceTimerArgs.name = "audio_pace";
+  esp_timer_create(&paceTimerArgs, &paceTimer);
   
   Serial.println("\nESP32 Intercom Ready!");
   Serial.println("Waiting for connection to signaling server...\n");
@@ -157,15 +308,14 @@ void setup() {
 void loop() {
   webSocket.loop();
   
-  if (isInCall && !muted) {
-    sendAudioPacket();
-  }
-  
+  // Audio itself streams in captureTask and renderTask
   if (isInCall) {
-    receiveAudioPacket();
+    pollIce();
+    sendRtcp();
   }
   
-  delay(10);
+  // Let lower-priority tasks in without holding up signaling
+  delay(1);
 }
 
 // ============================================================================
@@ -211,12 +361,16 @@ void handleWebSocketEvent(WStype_t type, uint8_t * payload, size_t length) {
     case WStype_DISCONNECTED:
       Serial.println("[WebSocket] Disconnected");
       isConnected = false;
+      stopStreaming();
       isInCall = false;
       break;
       
     case WStype_CONNECTED:
       Serial.println("[WebSocket] Connected to signaling server");
       isConnected = true;
+      if (SIGNALING_DSCP != 0 && !set_socket_dscp(webSocket.fd(), SIGNALING_DSCP)) {
+        Serial.println("[WebSocket] Could not mark signaling with DSCP");
+      }
       // Join room with our client ID (for always-on mode)
       generateSessionId();
       roomId = clientId;
@@ -271,10 +425,11 @@ void sendLeaveMessage() {
 }
 
 void handleSignalingMessage(String message) {
-  Serial.printf("[Signaling] Received: %s\n", message.c_str());
+  Serial.printf("[Signaling] Received %u bytes\n", message.length());
   
+  // Parsed in place, so the SDP is not copied into the document
   StaticJsonDocument<512> doc;
-  DeserializationError error = deserializeJson(doc, message);
+  DeserializationError error = deserializeJson(doc, message.begin());
   
   if (error) {
     Serial.printf("[Signaling] JSON parse error: %s\n", error.c_str());
@@ -292,24 +447,44 @@ void handleSignalingMessage(String message) {
   } else if (type == "ready") {
     isReady = true;
     Serial.println("[Signaling] Room is ready");
+    if (offerPending) {
+      offerPending = false;
+      sendOffer();
+    }
     
   } else if (type == "offer") {
     // Incoming call - we need to handle this
-    String sdp = doc["sdp"] | "";
+    const char *sdp = doc["sdp"] | "";
     Serial.println("[Signaling] Received offer - accepting call");
-    acceptCall();
+    acceptCall(sdp);
     
   } else if (type == "answer") {
     // Call answered
-    String sdp = doc["sdp"] | "";
+    const char *sdp = doc["sdp"] | "";
+    SdpNegotiation negotiation;
+    stopStreaming();
+    if (!applyRemoteSdp(sdp, &negotiation)) {
+      sendLeaveMessage();
+      return;
+    }
     Serial.println("[Signaling] Received answer - call established");
+    startRtpSession();
     isInCall = true;
+    startStreaming();
     
   } else if (type == "candidate") {
-    // ICE candidate - for simplified version, we might skip this
-    // or use it to exchange IP/port information
-    String candidate = doc["candidate"] | "";
-    Serial.printf("[Signaling] Received ICE candidate: %s\n", candidate.c_str());
+    // Trickled ICE candidate
+    const char *candidate = doc["candidate"] | "";
+    SdpCandidate parsed;
+    bool added = false;
+    if (esphome::intercom::sdp_parse_candidate(candidate, strlen(candidate), &parsed)) {
+      xSemaphoreTake(stateLock, portMAX_DELAY);
+      added = ice.add_remote_candidate(parsed);
+      xSemaphoreGive(stateLock);
+    }
+    if (added) {
+      Serial.printf("[Signaling] Added ICE candidate: %s\n", candidate);
+    }
     
   } else if (type == "leave") {
     Serial.println("[Signaling] Remote left - ending call");
@@ -340,7 +515,9 @@ void startCall(String deviceId) {
   roomId = deviceId;
   generateSessionId();
   
-  // Send join message for the target room
+  // Send join message for the target room; the offer follows once the
+  // room is ready
+  offerPending = true;
   sendJoinMessage();
   
   Serial.printf("[Call] Initiating call to %s\n", deviceId.c_str());
@@ -351,28 +528,185 @@ void endCall() {
     return;
   }
   
+  stopStreaming();
   sendLeaveMessage();
   isInCall = false;
+  offerPending = false;
   targetDeviceId = "";
   remoteAudioPort = 0;
+  srtpTx.end();
+  srtpRx.end();
   
   Serial.println("[Call] Call ended");
 }
 
-void acceptCall() {
-  // Send answer (simplified - in real implementation, generate proper SDP)
-  StaticJsonDocument<512> doc;
+void acceptCall(const char *offer) {
+  stopStreaming();
+  restartIce();
+  restartSrtp();
+  SdpNegotiation negotiation;
+  if (!applyRemoteSdp(offer, &negotiation)) {
+    sendLeaveMessage();
+    return;
+  }
+  negotiation.red_payload_type = 0;
+  
+  char sdp[MAX_SDP];
+  if (writeLocalSdp(&negotiation, sdp, sizeof(sdp)) == 0) {
+    Serial.println("[Call] Answer does not fit");
+    sendLeaveMessage();
+    return;
+  }
+  
+  // The SDP is referenced, not copied, so it does not eat into the document
+  StaticJsonDocument<128> doc;
   doc["type"] = "answer";
-  doc["sdp"] = "v=0\r\no=- " + String(millis()) + " 2 IN IP4 " + WiFi.localIP().toString() + "\r\ns=-\r\nt=0 0\r\n";
+  doc["sdp"] = (const char *) sdp;
   
   String message;
   serializeJson(doc, message);
   webSocket.sendTXT(message);
   
+  startRtpSession();
   isInCall = true;
+  startStreaming();
   Serial.println("[Call] Call accepted");
 }
 
+void sendOffer() {
+  restartIce();
+  restartSrtp();
+  char sdp[MAX_SDP];
+  if (writeLocalSdp(nullptr, sdp, sizeof(sdp)) == 0) {
+    Serial.println("[Call] Offer does not fit");
+    return;
+  }
+  
+  StaticJsonDocument<128> doc;
+  doc["type"] = "offer";
+  doc["sdp"] = (const char *) sdp;
+  
+  String message;
+  serializeJson(doc, message);
+  webSocket.sendTXT(message);
+  Serial.println("[Signaling] Sent offer");
+}
+
+bool applyRemoteSdp(const char *sdp, SdpNegotiation *negotiation) {
+  SdpDescription remote;
+  if (!esphome::intercom::sdp_parse(sdp, strlen(sdp), &remote) ||
+      !esphome::intercom::sdp_negotiate(remote, audioCodecs, sizeof(audioCodecs) / sizeof(audioCodecs[0]),
+                                        negotiation)) {
+    Serial.println("[Call] No common codec or address in remote SDP");
+    return false;
+  }
+  
+  uint8_t remoteKey[esphome::intercom::SRTP_MASTER_SIZE];
+  if (esphome::intercom::srtp_select_crypto(remote, &srtpSuite, &srtpTag, remoteKey)) {
+    srtpTx.begin(srtpSuite, srtpLocalKey);
+    srtpRx.begin(srtpSuite, remoteKey);
+    memset(remoteKey, 0, sizeof(remoteKey));
+  } else if (SRTP_REQUIRED) {
+    Serial.println("[Call] No usable SRTP key in remote SDP");
+    return false;
+  } else {
+    Serial.println("[Call] Remote does not do SRTP - audio is not encrypted");
+    srtpTx.end();
+    srtpRx.end();
+  }
+  
+  uint32_t ip = 0;
+  esphome::intercom::ice_parse_ipv4(negotiation->remote_address, strlen(negotiation->remote_address), &ip);
+  ice.set_remote(remote, ip, negotiation->remote_port, millis());
+  updateIcePath();
+  payloadType = negotiation->payload_type;
+  rtcpMux = negotiation->rtcp_mux;
+  Serial.printf("[Call] Audio: %s/%u as %u, %s, ICE %s\n", negotiation->codec->name,
+                (unsigned) negotiation->codec->clock_rate, payloadType,
+                srtpTx.active() ? esphome::intercom::srtp_suite_name(srtpSuite) : "unencrypted",
+                IceLite::state_name(ice.state()));
+  return ice.state() != IceState::FAILED;
+}
+
+void restartIce() {
+  uint8_t random[IceLite::RANDOM_BYTES];
+  esp_fill_random(random, sizeof(random));
+  ice.begin(random);
+  updateIcePath();
+}
+
+void restartSrtp() {
+  esp_fill_random(srtpLocalKey, sizeof(srtpLocalKey));
+  esphome::intercom::srtp_key_to_base64(srtpLocalKey, srtpLocalKeyBase64, sizeof(srtpLocalKeyBase64));
+  srtpSuite = SrtpSuite::AES_CM_128_HMAC_SHA1_80;
+  srtpTag = 1;
+  srtpTx.end();
+  srtpRx.end();
+}
+
+void pollIce() {
+  uint8_t transactionId[12];
+  esp_fill_random(transactionId, sizeof(transactionId));
+  uint32_t ip;
+  uint16_t port;
+  xSemaphoreTake(stateLock, portMAX_DELAY);
+  size_t len = ice.poll(millis(), transactionId, stunPacket, sizeof(stunPacket), &ip, &port);
+  xSemaphoreGive(stateLock);
+  if (len > 0) {
+    audioSocket.send(ip, port, stunPacket, len);
+  }
+  updateIcePath();
+}
+
+// Point the audio at the pair ICE selected; stop sending when it has none.
+// renderTask answers the checks, the path they lead to is picked up here.
+void updateIcePath() {
+  xSemaphoreTake(stateLock, portMAX_DELAY);
+  if (ice.generation() == iceGeneration) {
+    xSemaphoreGive(stateLock);
+    return;
+  }
+  iceGeneration = ice.generation();
+  uint32_t ip;
+  uint16_t port;
+  bool connected = ice.selected(&ip, &port);
+  remoteAudioIP = connected ? ip : 0;
+  remoteAudioPort = connected ? port : 0;
+  bool failed = ice.state() == IceState::FAILED;
+  xSemaphoreGive(stateLock);
+  
+  if (connected) {
+    Serial.printf("[ICE] Connected to %u.%u.%u.%u:%u\n", (unsigned) (ip >> 24), (unsigned) ((ip >> 16) & 0xFF),
+                  (unsigned) ((ip >> 8) & 0xFF), (unsigned) (ip & 0xFF), (unsigned) port);
+    return;
+  }
+  if (failed && isInCall) {
+    Serial.println("[ICE] Failed - ending call");
+    endCall();
+  }
+}
+
+size_t writeLocalSdp(const SdpNegotiation *answer, char *buf, size_t cap) {
+  String address = WiFi.localIP().toString();
+  SdpLocal local{};
+  local.session_id = millis();
+  local.version = 2;
+  local.address = address.c_str();
+  local.port = localAudioPort;
+  local.caps = audioCodecs;
+  local.cap_count = sizeof(audioCodecs) / sizeof(audioCodecs[0]);
+  local.answer = answer;
+  local.ptime = 20;
+  local.ice_ufrag = ice.local_ufrag();
+  local.ice_pwd = ice.local_pwd();
+  if (answer == nullptr || srtpTx.active()) {
+    local.crypto_suite = esphome::intercom::srtp_suite_name(srtpSuite);
+    local.crypto_key = srtpLocalKeyBase64;
+    local.crypto_tag = srtpTag;
+  }
+  return esphome::intercom::sdp_write(local, buf, cap);
+}
+
 void toggleMute() {
   muted = !muted;
   Serial.printf("[Call] Mute: %s\n", muted ? "ON" : "OFF");
@@ -394,7 +728,7 @@ void startAudio() {
     .communication_format = I2S_COMM_FORMAT_STAND_I2S,
     .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
     .dma_buf_count = 8,
-    .dma_buf_len = BUFFER_SIZE,
+    .dma_buf_len = PACKET_SAMPLES,  // Capture hands over packets evenly
     .use_apll = false,
     .tx_desc_auto_clear = false,
     .fixed_mclk = 0
@@ -445,40 +779,213 @@ void stopAudio() {
   Serial.println("[Audio] I2S stopped");
 }
 
+void startStreaming() {
+  if (POWER_SAVE_OFF_IN_CALL && !powerSaveHeld && esp_wifi_get_ps(&savedPowerSave) == ESP_OK &&
+      esp_wifi_set_ps(WIFI_PS_NONE) == ESP_OK) {
+    powerSaveHeld = true;
+  }
+  pacer.begin(PACER_HOLD_US, PACER_BACKLOG);
+  sendLatencyUs = 0;
+  streaming = true;
+  xTaskNotifyGive(captureTaskHandle);
+  xTaskNotifyGive(renderTaskHandle);
+  esp_timer_start_once(paceTimer, PACER_IDLE_US);
+}
+
+void stopStreaming() {
+  streaming = false;
+  esp_timer_stop(paceTimer);
+  // Each task sees the flag within one bounded wait
+  uint32_t start = millis();
+  while ((captureBusy || renderBusy || paceBusy) && millis() - start < AUDIO_STOP_TIMEOUT_MS) {
+    delay(1);
+  }
+  if (powerSaveHeld) {
+    powerSaveHeld = false;
+    esp_wifi_set_ps(savedPowerSave);
+  }
+}
+
+void captureTask(void *arg) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    captureBusy = true;
+    while (streaming) {
+      sendAudioPacket();
+    }
+    captureBusy = false;
+  }
+}
+
+void renderTask(void *arg) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    renderBusy = true;
+    while (streaming) {
+      receiveAudioPacket();
+    }
+    renderBusy = false;
+  }
+}
+
+void paceTimerCallback(void *arg) {
+  paceBusy = true;
+  if (streaming) {
+    uint64_t now = esp_timer_get_time();
+    UdpDatagram batch[TxPacer::SLOTS];
+    size_t count = pacer.due(now, batch, TxPacer::SLOTS);
+    if (count > 0) {
+      uint64_t sendStart = esp_timer_get_time();
+      audioSocket.send_batch(batch, count);
+      int32_t latency = (int32_t) ((esp_timer_get_time() - sendStart) / count);
+      pacer.release(count);
+      sendLatencyUs = sendLatencyUs + (latency - (int32_t) sendLatencyUs) / 16;
+    }
+    uint64_t next = pacer.next_due_us();
+    esp_timer_start_once(paceTimer, next == 0 ? PACER_IDLE_US : (next > now ? next - now : 0));
+  }
+  paceBusy = false;
+}
+
 void sendAudioPacket() {
-  if (remoteAudioPort == 0) {
+  // Read audio from microphone, even while muted or without a path, so the
+  // task keeps pace and no stale audio waits in the DMA buffers
+  static int16_t audioBuffer[PACKET_SAMPLES];
+  size_t bytesRead = 0;
+  
+  i2s_read(I2S_NUM_0, audioBuffer, sizeof(audioBuffer), &bytesRead, pdMS_TO_TICKS(AUDIO_IO_TIMEOUT_MS));
+  if (bytesRead == 0 || muted) {
     return;
   }
   
-  // Read audio from microphone
-  int16_t audioBuffer[BUFFER_SIZE];
-  size_t bytesRead;
-  
-  i2s_read(I2S_NUM_0, audioBuffer, sizeof(audioBuffer), &bytesRead, portMAX_DELAY);
+  esphome::intercom::rtp_l16_swap((uint8_t *) audioBuffer, bytesRead);
+  static uint8_t header[esphome::intercom::RTP_HEADER_SIZE];
+  static uint8_t tag[esphome::intercom::SRTP_MAX_TAG];
+  size_t tagLen = 0;
+  xSemaphoreTake(stateLock, portMAX_DELAY);
+  uint32_t ip = remoteAudioIP;
+  uint16_t port = remoteAudioPort;
+  if (port != 0) {
+    rtp.write_header(header, bytesRead / sizeof(int16_t), bytesRead, esp_timer_get_time());
+    if (srtpTx.active()) {
+      srtpTx.protect(header, sizeof(header), (uint8_t *) audioBuffer, bytesRead, tag);
+      tagLen = srtpTx.tag_size();
+    }
+  }
+  xSemaphoreGive(stateLock);
   
-  if (bytesRead > 0) {
-    // Send RTP packet (simplified - no full RTP header)
-    udp.beginPacket(remoteAudioIP, remoteAudioPort);
-    udp.write((uint8_t*)audioBuffer, bytesRead);
-    udp.endPacket();
+  if (port != 0) {
+    uint32_t durationUs = bytesRead / sizeof(int16_t) * 1000000ULL / SAMPLE_RATE;
+    pacer.push(ip, port, durationUs, esp_timer_get_time(), header, sizeof(header), (uint8_t *) audioBuffer, bytesRead,
+               tag, tagLen);
   }
 }
 
 void receiveAudioPacket() {
-  int packetSize = udp.parsePacket();
-  if (packetSize > 0) {
-    int16_t audioBuffer[BUFFER_SIZE];
-    int len = udp.read((char*)audioBuffer, sizeof(audioBuffer));
-    
-    if (len > 0) {
-      // Store remote IP/port for sending
-      remoteAudioIP = udp.remoteIP();
-      remoteAudioPort = udp.remotePort();
-      
-      // Play audio to speaker
-      size_t bytesWritten;
-      i2s_write(I2S_NUM_1, audioBuffer, len, &bytesWritten, portMAX_DELAY);
+  static uint8_t packet[esphome::intercom::RTP_MAX_HEADER_SIZE + BUFFER_SIZE * sizeof(int16_t) +
+                        esphome::intercom::SRTP_MAX_TAG];
+  uint32_t fromIp;
+  uint16_t fromPort;
+  int len = audioSocket.receive(packet, sizeof(packet), &fromIp, &fromPort);
+  if (len <= 0) {
+    return;
+  }
+  uint64_t now = esp_timer_get_time();
+  
+  xSemaphoreTake(stateLock, portMAX_DELAY);
+  if (esphome::intercom::stun_is_message(packet, len)) {
+    size_t response = ice.on_stun(packet, len, fromIp, fromPort, millis(), stunResponse, sizeof(stunResponse));
+    if (response > 0) {
+      audioSocket.send(fromIp, fromPort, stunResponse, response);
     }
+    xSemaphoreGive(stateLock);
+    return;
+  }
+  
+  if (esphome::intercom::rtp_is_rtcp(packet, len)) {
+    if (srtpRx.active()) {
+      len = srtpRx.unprotect_rtcp(packet, len);
+    }
+    bool report = len > 0 && rtp.on_rtcp(packet, len, now);
+    RtcpStats stats = rtp.stats();
+    xSemaphoreGive(stateLock);
+    if (report) {
+      Serial.printf("[RTCP] Remote lost %.1f%%, jitter %.1fms, RTT %.0fms\n",
+                    stats.remote_fraction_lost * 100.0f / 256.0f, stats.remote_jitter_ms,
+                    stats.rtt_valid ? stats.rtt_ms : -1.0f);
+    }
+    return;
+  }
+  
+  // Drop anything that fails authentication or is replayed
+  size_t offset, payloadLen;
+  RtpHeader header;
+  bool ok = (!srtpRx.active() || (len = srtpRx.unprotect(packet, len)) > 0) &&
+            rtp.on_rtp(packet, len, now, &offset, &payloadLen, &header);
+  xSemaphoreGive(stateLock);
+  if (!ok) {
+    return;
+  }
+  
+  uint8_t *audio = packet + offset;
+  if (header.payload_type == RTP_RED_PAYLOAD_TYPE) {
+    RedBlock blocks[esphome::intercom::RED_MAX_DEPTH + 1];
+    size_t count = esphome::intercom::rtp_red_parse(audio, payloadLen, header.timestamp, blocks,
+                                                    esphome::intercom::RED_MAX_DEPTH + 1);
+    if (count == 0) {
+      return;
+    }
+    audio = packet + (blocks[count - 1].data - packet);
+    payloadLen = blocks[count - 1].len;
+  }
+  
+  // Play audio to speaker at its own clock, waiting no longer than two
+  // packets' worth
+  esphome::intercom::rtp_l16_swap(audio, payloadLen);
+  size_t samples = payloadLen / sizeof(int16_t);
+  if (samples > BUFFER_SIZE) {
+    samples = BUFFER_SIZE;
+  }
+  memcpy(playoutIn, audio, samples * sizeof(int16_t));
+  resampler.set_ratio(drift.ratio());
+  size_t playout = resampler.process(playoutIn, samples, playoutOut);
+  size_t bytesWritten = 0;
+  uint32_t packetMs = samples * 1000 / SAMPLE_RATE;
+  uint64_t writeStart = esp_timer_get_time();
+  i2s_write(I2S_NUM_1, playoutOut, playout * sizeof(int16_t), &bytesWritten, pdMS_TO_TICKS(2 * packetMs + 1));
+  drift.on_output(bytesWritten / sizeof(int16_t), writeStart);
+}
+
+void startRtpSession() {
+  rtp.begin(esp_random(), payloadType, SAMPLE_RATE, clientId.c_str(), esp_timer_get_time());
+  drift.begin(SAMPLE_RATE, PLAYOUT_TARGET_SAMPLES);
+  resampler.begin();
+}
+
+void sendRtcp() {
+  xSemaphoreTake(stateLock, portMAX_DELAY);
+  uint64_t now = esp_timer_get_time();
+  size_t len = 0;
+  if (remoteAudioPort != 0 && rtp.rtcp_due(now)) {
+    len = rtp.build_rtcp(rtcpPacket, esphome::intercom::RTCP_MAX_PACKET_SIZE, now);
+  }
+  if (len > 0 && srtpTx.active()) {
+    len = srtpTx.protect_rtcp(rtcpPacket, len, sizeof(rtcpPacket));
+  }
+  uint32_t ip = remoteAudioIP;
+  uint16_t port = rtcpMux ? remoteAudioPort : remoteAudioPort + 1;
+  xSemaphoreGive(stateLock);
+  if (len > 0) {
+    audioSocket.send(ip, port, rtcpPacket, len);
+    const PacerStats &pacing = pacer.stats();
+    Serial.printf("[Pacer] Jitter %uus (capture %uus), max %uus; %u underruns, %u dropped, %u oversized\n",
+                  (unsigned) pacing.jitter_us, (unsigned) pacing.capture_jitter_us, (unsigned) pacing.max_jitter_us,
+                  (unsigned) pacing.underruns, (unsigned) pacing.dropped, (unsigned) pacing.oversized);
+    const DriftStats &clock = drift.stats();
+    Serial.printf("[Clock] Drift %+.0f ppm, correcting %+.0f ppm; playout %d samples, %u underruns\n",
+                  clock.drift_ppm, clock.correction_ppm, (int) clock.fill, (unsigned) clock.underruns);
+    Serial.printf("[Pacer] Send latency %uus per packet, Wi-Fi power save %s\n", (unsigned) sendLatencyUs,
+                  powerSaveHeld ? "off for the call" : "unchanged");
   }
 }
 
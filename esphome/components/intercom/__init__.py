@@ -1,7 +1,8 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome.components import sensor, text_sensor, switch
-from esphome.const import CONF_ID
+from esphome.const import CONF_ID, CONF_PASSWORD, CONF_URL, CONF_USERNAME
+from esphome.core import CORE
 from esphome.components.esp32 import add_idf_sdkconfig_option
 
 CODEOWNERS = ["@michaelshaffer"]
@@ -24,6 +25,38 @@ CONF_END_CALL = "end_call"
 CONF_ACCEPT_CALL = "accept_call"
 CONF_MUTE = "mute"
 CONF_TARGET_DEVICE = "target_device"
+CONF_PREWARM_PEER = "prewarm_peer"
+CONF_CALL_SETUP_TIME = "call_setup_time"
+CONF_DTLS_CERT_ROTATION = "dtls_cert_rotation"
+CONF_ICE_SERVERS = "ice_servers"
+CONF_ICE_HOST_GRACE = "ice_host_grace"
+CONF_ICE_GATHERING_TIME = "ice_gathering_time"
+CONF_ICE_CONNECT_TIME = "ice_connect_time"
+CONF_ICE_CANDIDATE_TYPE = "ice_candidate_type"
+CONF_MAX_PEERS = "max_peers"
+CONF_POWER_SAVE_OFF_IN_CALL = "power_save_off_in_call"
+CONF_ALLOC_TRACE = "alloc_trace"
+CONF_ALLOC_SUMMARY = "alloc_summary"
+CONF_CONNECTED_ALLOCATIONS = "connected_allocations"
+
+
+def validate_ice_server(value):
+    url = value[CONF_URL]
+    if not url.startswith(("stun:", "turn:", "turns:")):
+        raise cv.Invalid("ICE server URL must start with stun:, turn: or turns:")
+    if url.startswith("turn") and (CONF_USERNAME not in value or CONF_PASSWORD not in value):
+        raise cv.Invalid("TURN servers require username and password")
+    return value
+
+
+ICE_SERVER_SCHEMA = cv.All(
+    cv.Schema({
+        cv.Required(CONF_URL): cv.string,
+        cv.Optional(CONF_USERNAME): cv.string,
+        cv.Optional(CONF_PASSWORD): cv.string,
+    }),
+    validate_ice_server,
+)
 
 CONFIG_SCHEMA = cv.Schema({
     cv.GenerateID(): cv.declare_id(IntercomComponent),
@@ -33,12 +66,37 @@ CONFIG_SCHEMA = cv.Schema({
     cv.Optional(CONF_CLIENT_ID_PREFIX, default="esphome-"): cv.string,
     cv.Optional(CONF_AUTO_ACCEPT, default=True): cv.boolean,
     cv.Optional(CONF_AUTO_CONNECT, default=True): cv.boolean,
+    cv.Optional(CONF_PREWARM_PEER, default=True): cv.boolean,
+    cv.Optional(CONF_DTLS_CERT_ROTATION, default="30d"): cv.positive_time_period_seconds,
+    cv.Optional(CONF_ICE_SERVERS, default=[]): cv.ensure_list(ICE_SERVER_SCHEMA),
+    cv.Optional(CONF_ICE_HOST_GRACE, default="200ms"): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_MAX_PEERS, default=1): cv.int_range(min=1, max=3),
+    cv.Optional(CONF_POWER_SAVE_OFF_IN_CALL, default=True): cv.boolean,
+    cv.Optional(CONF_ALLOC_TRACE, default=False): cv.boolean,
     cv.Optional(CONF_TARGET_DEVICE): text_sensor.text_sensor_schema(),
     cv.Optional(CONF_CALL_STATE): sensor.sensor_schema(
         unit_of_measurement="",
         accuracy_decimals=1,
     ),
     cv.Optional(CONF_CALL_STATUS): text_sensor.text_sensor_schema(),
+    cv.Optional(CONF_CALL_SETUP_TIME): sensor.sensor_schema(
+        unit_of_measurement="ms",
+        accuracy_decimals=0,
+    ),
+    cv.Optional(CONF_ICE_GATHERING_TIME): sensor.sensor_schema(
+        unit_of_measurement="ms",
+        accuracy_decimals=0,
+    ),
+    cv.Optional(CONF_ICE_CONNECT_TIME): sensor.sensor_schema(
+        unit_of_measurement="ms",
+        accuracy_decimals=0,
+    ),
+    cv.Optional(CONF_ICE_CANDIDATE_TYPE): text_sensor.text_sensor_schema(),
+    cv.Optional(CONF_ALLOC_SUMMARY): text_sensor.text_sensor_schema(),
+    cv.Optional(CONF_CONNECTED_ALLOCATIONS): sensor.sensor_schema(
+        unit_of_measurement="",
+        accuracy_decimals=0,
+    ),
     cv.Optional(CONF_START_CALL): switch.switch_schema(),
     cv.Optional(CONF_END_CALL): switch.switch_schema(),
     cv.Optional(CONF_ACCEPT_CALL): switch.switch_schema(),
@@ -55,6 +113,26 @@ async def to_code(config):
     cg.add(var.set_client_id_prefix(config[CONF_CLIENT_ID_PREFIX]))
     cg.add(var.set_auto_accept(config.get(CONF_AUTO_ACCEPT, True)))
     cg.add(var.set_auto_connect(config.get(CONF_AUTO_CONNECT, True)))
+    cg.add(var.set_prewarm_peer(config[CONF_PREWARM_PEER]))
+    cg.add(var.set_dtls_cert_rotation(config[CONF_DTLS_CERT_ROTATION].total_seconds))
+    cg.add(var.set_ice_host_grace(config[CONF_ICE_HOST_GRACE].total_milliseconds))
+    cg.add(var.set_max_peers(config[CONF_MAX_PEERS]))
+    cg.add(var.set_power_save_off_in_call(config[CONF_POWER_SAVE_OFF_IN_CALL]))
+    for server in config[CONF_ICE_SERVERS]:
+        cg.add(var.add_ice_server(
+            server[CONF_URL],
+            server.get(CONF_USERNAME, ""),
+            server.get(CONF_PASSWORD, ""),
+        ))
+    
+    if config[CONF_PREWARM_PEER] and CORE.using_esp_idf:
+        # Keep the standby peers' DTLS/mbedTLS contexts in PSRAM, not internal RAM
+        add_idf_sdkconfig_option("CONFIG_MBEDTLS_EXTERNAL_MEM_ALLOC", True)
+    
+    if config[CONF_ALLOC_TRACE] and CORE.using_esp_idf:
+        # Heap hooks cost a few hundred cycles per malloc/free; debug builds only
+        add_idf_sdkconfig_option("CONFIG_HEAP_USE_HOOKS", True)
+        cg.add_define("USE_INTERCOM_ALLOC_TRACE")
     
     if CONF_TARGET_DEVICE in config:
         text_sens = await text_sensor.new_text_sensor(config[CONF_TARGET_DEVICE])
@@ -68,6 +146,30 @@ async def to_code(config):
         text_sens = await text_sensor.new_text_sensor(config[CONF_CALL_STATUS])
         cg.add(var.set_call_status_text_sensor(text_sens))
     
+    if CONF_CALL_SETUP_TIME in config:
+        sens = await sensor.new_sensor(config[CONF_CALL_SETUP_TIME])
+        cg.add(var.set_call_setup_time_sensor(sens))
+    
+    if CONF_ICE_GATHERING_TIME in config:
+        sens = await sensor.new_sensor(config[CONF_ICE_GATHERING_TIME])
+        cg.add(var.set_ice_gathering_time_sensor(sens))
+    
+    if CONF_ICE_CONNECT_TIME in config:
+        sens = await sensor.new_sensor(config[CONF_ICE_CONNECT_TIME])
+        cg.add(var.set_ice_connect_time_sensor(sens))
+    
+    if CONF_ICE_CANDIDATE_TYPE in config:
+        text_sens = await text_sensor.new_text_sensor(config[CONF_ICE_CANDIDATE_TYPE])
+        cg.add(var.set_ice_candidate_type_text_sensor(text_sens))
+    
+    if CONF_ALLOC_SUMMARY in config:
+        text_sens = await text_sensor.new_text_sensor(config[CONF_ALLOC_SUMMARY])
+        cg.add(var.set_alloc_summary_text_sensor(text_sens))
+    
+    if CONF_CONNECTED_ALLOCATIONS in config:
+        sens = await sensor.new_sensor(config[CONF_CONNECTED_ALLOCATIONS])
+        cg.add(var.set_connected_allocations_sensor(sens))
+    
     if CONF_START_CALL in config:
         sw = await switch.new_switch(config[CONF_START_CALL])
         cg.add(var.set_start_call_switch(sw))
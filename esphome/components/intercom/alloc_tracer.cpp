@@ -0,0 +1,229 @@
+#include "alloc_tracer.h"
+
+#ifdef USE_ESP_IDF
+
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+namespace esphome {
+namespace intercom {
+
+namespace {
+
+// The free hook runs after the block has gone back to the heap, so its size
+// can no longer be asked for. Blocks allocated outside IDLE are remembered
+// with their size in an open-addressed table, emptied on every return to
+// IDLE so long-lived boot allocations never crowd it.
+constexpr size_t LIVE_SLOTS = 256;  // Power of two
+constexpr size_t LIVE_MASK = LIVE_SLOTS - 1;
+
+struct LiveBlock {
+  void *ptr;  // nullptr when free
+  uint32_t size;
+};
+
+struct TracerState {
+  portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+  PhaseAllocStats phases[AllocTracer::PHASE_COUNT];
+  CallPhase phase = CallPhase::IDLE;
+  int64_t net_bytes = 0;  // Since the current phase started
+  TaskHandle_t watched[AllocTracer::MAX_WATCHED_TASKS] = {};
+  LiveBlock live[LIVE_SLOTS] = {};
+};
+
+TracerState DRAM_ATTR state;
+
+bool IRAM_ATTR is_watched_task() {
+  if (xPortInIsrContext()) {
+    return false;
+  }
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  for (TaskHandle_t task : state.watched) {
+    if (task == self) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline size_t IRAM_ATTR live_home(const void *ptr) {
+  // Heap blocks are at least 4-byte aligned; Fibonacci hashing spreads the rest
+  return (size_t) (((uint32_t) (uintptr_t) ptr >> 2) * 2654435761u >> 24) & LIVE_MASK;
+}
+
+// Callers hold state.lock
+bool IRAM_ATTR live_insert(void *ptr, size_t size) {
+  size_t i = live_home(ptr);
+  for (size_t n = 0; n < LIVE_SLOTS; n++, i = (i + 1) & LIVE_MASK) {
+    if (state.live[i].ptr == nullptr) {
+      state.live[i] = LiveBlock{ptr, (uint32_t) size};
+      return true;
+    }
+  }
+  return false;
+}
+
+// Size of a remembered block, forgetting it; 0 if it was never recorded
+size_t IRAM_ATTR live_remove(const void *ptr) {
+  size_t i = live_home(ptr);
+  size_t n = 0;
+  while (state.live[i].ptr != ptr) {
+    if (state.live[i].ptr == nullptr || ++n == LIVE_SLOTS) {
+      return 0;
+    }
+    i = (i + 1) & LIVE_MASK;
+  }
+  size_t size = state.live[i].size;
+  // Backward-shift deletion: pull later entries of the probe run into the
+  // hole unless that would move them before their home slot. The hole is
+  // always empty, so the scan stops even in a full table.
+  state.live[i].ptr = nullptr;
+  for (size_t j = (i + 1) & LIVE_MASK; state.live[j].ptr != nullptr; j = (j + 1) & LIVE_MASK) {
+    size_t home = live_home(state.live[j].ptr);
+    if (((j - home) & LIVE_MASK) >= ((j - i) & LIVE_MASK)) {
+      state.live[i] = state.live[j];
+      state.live[j].ptr = nullptr;
+      i = j;
+    }
+  }
+  return size;
+}
+
+}  // namespace
+
+#ifdef USE_INTERCOM_ALLOC_TRACE
+bool AllocTracer::enabled() { return true; }
+#else
+bool AllocTracer::enabled() { return false; }
+#endif
+
+void AllocTracer::set_phase(CallPhase phase) {
+  portENTER_CRITICAL(&state.lock);
+  state.phase = phase;
+  state.net_bytes = 0;
+  if (phase == CallPhase::IDLE) {
+    memset(state.live, 0, sizeof(state.live));
+  }
+  portEXIT_CRITICAL(&state.lock);
+}
+
+CallPhase AllocTracer::phase() { return state.phase; }
+
+void AllocTracer::watch_current_task() {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  for (TaskHandle_t task : state.watched) {
+    if (task == self) {
+      return;
+    }
+  }
+  portENTER_CRITICAL(&state.lock);
+  for (TaskHandle_t &task : state.watched) {
+    if (task == nullptr || task == self) {
+      task = self;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&state.lock);
+}
+
+void AllocTracer::take(PhaseAllocStats stats[PHASE_COUNT]) {
+  portENTER_CRITICAL(&state.lock);
+  for (size_t i = 0; i < PHASE_COUNT; i++) {
+    stats[i] = state.phases[i];
+    state.phases[i] = PhaseAllocStats();
+  }
+  state.net_bytes = 0;
+  portEXIT_CRITICAL(&state.lock);
+}
+
+const char *AllocTracer::phase_name(CallPhase phase) {
+  switch (phase) {
+    case CallPhase::IDLE:
+      return "idle";
+    case CallPhase::SETUP:
+      return "setup";
+    case CallPhase::CONNECTED:
+      return "connected";
+    case CallPhase::TEARDOWN:
+      return "teardown";
+    default:
+      return "?";
+  }
+}
+
+std::string AllocTracer::summary(const PhaseAllocStats stats[PHASE_COUNT]) {
+  std::string out;
+  out.reserve(160);
+  char part[64];
+  for (size_t i = 0; i < PHASE_COUNT; i++) {
+    const PhaseAllocStats &s = stats[i];
+    int n = snprintf(part, sizeof(part), "%s%s %" PRIu32 "/%.1fk", i ? ", " : "",
+                     phase_name(static_cast<CallPhase>(i)), s.allocs, s.bytes / 1024.0f);
+    if (s.peak_bytes > 0 && n > 0 && (size_t) n < sizeof(part)) {
+      snprintf(part + n, sizeof(part) - n, " peak %.1fk", s.peak_bytes / 1024.0f);
+    }
+    out += part;
+  }
+  const PhaseAllocStats &connected = stats[static_cast<size_t>(CallPhase::CONNECTED)];
+  uint32_t untracked = 0;
+  for (size_t i = 0; i < PHASE_COUNT; i++) {
+    untracked += stats[i].untracked;
+  }
+  snprintf(part, sizeof(part), "; audio %" PRIu32 ", untracked %" PRIu32, connected.audio_allocs, untracked);
+  out += part;
+  return out;
+}
+
+}  // namespace intercom
+}  // namespace esphome
+
+#ifdef USE_INTERCOM_ALLOC_TRACE
+// ESP-IDF calls these around every heap operation when CONFIG_HEAP_USE_HOOKS
+// is set. They run on the allocating task, possibly with the flash cache
+// disabled, so they stay in IRAM and only touch DRAM state.
+using esphome::intercom::state;
+
+extern "C" void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps) {
+  if (ptr == nullptr) {
+    return;
+  }
+  bool audio = esphome::intercom::is_watched_task();
+  portENTER_CRITICAL_SAFE(&state.lock);
+  auto &s = state.phases[static_cast<size_t>(state.phase)];
+  s.allocs++;
+  s.bytes += size;
+  if (audio) {
+    s.audio_allocs++;
+  }
+  if (state.phase != esphome::intercom::CallPhase::IDLE) {
+    if (esphome::intercom::live_insert(ptr, size)) {
+      state.net_bytes += size;
+      if (state.net_bytes > (int64_t) s.peak_bytes) {
+        s.peak_bytes = (uint32_t) state.net_bytes;
+      }
+    } else {
+      s.untracked++;
+    }
+  }
+  portEXIT_CRITICAL_SAFE(&state.lock);
+}
+
+extern "C" void IRAM_ATTR esp_heap_trace_free_hook(void *ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  // Runs after the block went back to the heap, so its size comes from the
+  // table rather than the heap
+  portENTER_CRITICAL_SAFE(&state.lock);
+  state.phases[static_cast<size_t>(state.phase)].frees++;
+  state.net_bytes -= (int64_t) esphome::intercom::live_remove(ptr);
+  portEXIT_CRITICAL_SAFE(&state.lock);
+}
+#endif  // USE_INTERCOM_ALLOC_TRACE
+
+#endif  // USE_ESP_IDF
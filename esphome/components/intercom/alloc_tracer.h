@@ -0,0 +1,60 @@
+/*
+ * Heap Allocation Tracer
+ * Attributes heap allocations to the phase of the call lifecycle they
+ * happen in, via the ESP-IDF heap hooks (CONFIG_HEAP_USE_HOOKS)
+ */
+
+#pragma once
+
+#ifdef USE_ESP_IDF
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace esphome {
+namespace intercom {
+
+enum class CallPhase : uint8_t {
+  IDLE = 0,
+  SETUP,      // Joining, negotiating, ICE/DTLS
+  CONNECTED,  // Media flowing
+  TEARDOWN,   // Ending the call and releasing peers
+  COUNT,
+};
+
+struct PhaseAllocStats {
+  uint32_t allocs = 0;
+  uint32_t frees = 0;
+  uint64_t bytes = 0;        // Total bytes allocated
+  uint32_t peak_bytes = 0;   // Highest net growth (allocated - freed) within the phase; 0 for idle
+  uint32_t audio_allocs = 0; // Allocations made by watched audio tasks
+  uint32_t untracked = 0;    // Left out of peak_bytes: the size table was full
+};
+
+class AllocTracer {
+ public:
+  static constexpr size_t PHASE_COUNT = static_cast<size_t>(CallPhase::COUNT);
+  static constexpr size_t MAX_WATCHED_TASKS = 4;
+
+  // False unless built with the heap hooks (alloc_trace: true)
+  static bool enabled();
+
+  // Start attributing to a phase; net growth is measured from here
+  static void set_phase(CallPhase phase);
+  static CallPhase phase();
+  // Allocations from the calling task count as audio allocations. Cheap
+  // after the first call per task, so audio callbacks call it every time.
+  static void watch_current_task();
+
+  // Copy the per-phase totals and start a new tally
+  static void take(PhaseAllocStats stats[PHASE_COUNT]);
+  static const char *phase_name(CallPhase phase);
+  // "setup 212/41.3k peak 18.0k, connected 0/0 ..." for the status sensor
+  static std::string summary(const PhaseAllocStats stats[PHASE_COUNT]);
+};
+
+}  // namespace intercom
+}  // namespace esphome
+
+#endif  // USE_ESP_IDF
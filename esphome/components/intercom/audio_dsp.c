@@ -0,0 +1 @@
+../../../main/audio_dsp.c
\ No newline at end of file
@@ -0,0 +1 @@
+../../../main/include/audio_dsp.h
\ No newline at end of file
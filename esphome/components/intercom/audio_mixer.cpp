@@ -0,0 +1,170 @@
+#include "audio_mixer.h"
+
+#ifdef USE_ESP_IDF
+
+#include "audio_dsp.h"
+#include "esp_cpu.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+namespace intercom {
+
+bool AudioMixer::set_frame_samples(size_t samples) {
+  if (samples == 0 || samples > MAX_FRAME_SAMPLES) {
+    return false;
+  }
+  reset();
+  std::lock_guard<std::mutex> guard(lock_);
+  frame_samples_ = samples;
+  return true;
+}
+
+bool AudioMixer::push_(Fifo &fifo, const int16_t *samples, size_t count) {
+  const size_t cap = 2 * MAX_FRAME_SAMPLES;
+  bool dropped = false;
+  if (count >= cap) {
+    samples += count - cap;
+    count = cap;
+    fifo.len = 0;
+    dropped = true;
+  } else if (fifo.len + count > cap) {
+    size_t drop = fifo.len + count - cap;
+    memmove(fifo.data, fifo.data + drop, (fifo.len - drop) * sizeof(int16_t));
+    fifo.len -= drop;
+    dropped = true;
+  }
+  memcpy(fifo.data + fifo.len, samples, count * sizeof(int16_t));
+  fifo.len += count;
+  return !dropped;
+}
+
+size_t AudioMixer::pop_(Fifo &fifo, int16_t *samples, size_t count) {
+  count = std::min(count, fifo.len);
+  memcpy(samples, fifo.data, count * sizeof(int16_t));
+  fifo.len -= count;
+  memmove(fifo.data, fifo.data + count, fifo.len * sizeof(int16_t));
+  return count;
+}
+
+void AudioMixer::write(size_t slot, const int16_t *samples, size_t count) {
+  if (slot >= MAX_INPUTS || count == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(lock_);
+  if (frame_samples_ == 0) {
+    // The first decoded frame of the call sets the mix period; the local
+    // mic has nobody to go to before that
+    if (slot == LOCAL_SLOT || count > MAX_FRAME_SAMPLES) {
+      return;
+    }
+    frame_samples_ = count;
+  }
+  if (!push_(inputs_[slot], samples, count)) {
+    overruns_++;
+  }
+}
+
+size_t AudioMixer::read(size_t slot, int16_t *samples, size_t count) {
+  if (slot >= MAX_INPUTS) {
+    return 0;
+  }
+  count = std::min(count, 2 * MAX_FRAME_SAMPLES);
+  std::lock_guard<std::mutex> guard(lock_);
+  listening_[slot] = true;
+  if (slot == LOCAL_SLOT && frame_samples_ > 0) {
+    while (outputs_[slot].len < count) {
+      mix_();
+    }
+  }
+  size_t got = pop_(outputs_[slot], samples, count);
+  if (got < count) {
+    memset(samples + got, 0, (count - got) * sizeof(int16_t));
+    if (frame_samples_ > 0) {
+      underruns_++;
+    }
+  }
+  return count;
+}
+
+void AudioMixer::clear(size_t slot) {
+  if (slot >= MAX_INPUTS) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(lock_);
+  inputs_[slot].len = 0;
+}
+
+void AudioMixer::release(size_t slot) {
+  if (slot >= MAX_INPUTS) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(lock_);
+  inputs_[slot].len = 0;
+  outputs_[slot].len = 0;
+  listening_[slot] = false;
+}
+
+void AudioMixer::reset() {
+  std::lock_guard<std::mutex> guard(lock_);
+  frame_samples_ = 0;
+  for (size_t s = 0; s < MAX_INPUTS; s++) {
+    inputs_[s].len = 0;
+    outputs_[s].len = 0;
+    listening_[s] = false;
+  }
+}
+
+void AudioMixer::mix_() {
+  uint32_t start = esp_cpu_get_cycle_count();
+  const size_t n = frame_samples_;
+
+  // A slot contributes a frame only once it has a whole one buffered; a
+  // partial one waits for the next mix
+  bool active[MAX_INPUTS];
+  size_t active_count = 0;
+  for (size_t s = 0; s < MAX_INPUTS; s++) {
+    active[s] = inputs_[s].len >= n;
+    if (active[s]) {
+      pop_(inputs_[s], frames_[s], n);
+      active_count++;
+    }
+  }
+
+  // Mix-minus with saturating adds: each output sums every other input, so
+  // no one's voice has to be subtracted back out of a clipped total. With
+  // at most four slots that is at most three adds per output.
+  for (size_t s = 0; s < MAX_INPUTS; s++) {
+    if (!listening_[s]) {
+      continue;
+    }
+    bool first = true;
+    for (size_t other = 0; other < MAX_INPUTS; other++) {
+      if (other == s || !active[other]) {
+        continue;
+      }
+      if (first) {
+        memcpy(mix_buf_, frames_[other], n * sizeof(int16_t));
+        first = false;
+      } else {
+        audio_dsp_mix_s16(mix_buf_, frames_[other], n);
+      }
+    }
+    if (first) {
+      memset(mix_buf_, 0, n * sizeof(int16_t));
+    }
+    push_(outputs_[s], mix_buf_, n);
+  }
+
+  uint32_t cycles = esp_cpu_get_cycle_count() - start;
+  total_cycles_ += cycles;
+  total_inputs_ += active_count;
+  mix_count_++;
+  max_cycles_ = std::max(max_cycles_, cycles);
+}
+
+}  // namespace intercom
+}  // namespace esphome
+
+#endif  // USE_ESP_IDF
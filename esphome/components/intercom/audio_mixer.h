@@ -0,0 +1,88 @@
+/*
+ * Conference Audio Mixer
+ * Sums the local microphone and every remote leg into per-participant
+ * mix-minus outputs, so each party hears everyone but themselves
+ */
+
+#pragma once
+
+#ifdef USE_ESP_IDF
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace esphome {
+namespace intercom {
+
+class AudioMixer {
+ public:
+  // Slot 0 is the local microphone (input) and speaker (output); slots 1..3
+  // are remote peers (decoded stream in, encoder feed out)
+  static constexpr size_t MAX_INPUTS = 4;
+  static constexpr size_t LOCAL_SLOT = 0;
+  // 20 ms at 48 kHz, the longest frame a call can negotiate
+  static constexpr size_t MAX_FRAME_SAMPLES = 960;
+
+  // Mix period in samples. Unless set here, it is taken from the first
+  // frame a remote leg writes after reset(): the decoder delivers exactly
+  // one negotiated codec frame (rate x ptime) at a time. Returns false,
+  // leaving the mixer as it was, if samples is 0 or above the maximum.
+  bool set_frame_samples(size_t samples);
+  size_t frame_samples() const { return frame_samples_; }
+
+  // Queue samples for a slot, in pieces of any length. Up to two frames
+  // are held; a writer that runs ahead loses its oldest samples.
+  void write(size_t slot, const int16_t *samples, size_t count);
+  // Fill samples with a slot's mix-minus output. Reading LOCAL_SLOT clocks
+  // the mixer: the speaker runs off the I2S clock, so a new frame is mixed
+  // each time its output runs dry. Remote slots read what those mixes left
+  // for them and get silence, counted as an underrun, if it is not there.
+  size_t read(size_t slot, int16_t *samples, size_t count);
+  // Drop a slot's pending input, e.g. when the mic is muted or a peer drops
+  void clear(size_t slot);
+  // Forget a slot entirely (input and output) when its peer leaves
+  void release(size_t slot);
+  // Start a new call: empties every slot and forgets the frame length
+  void reset();
+
+  // Cost of one mix in CPU cycles, averaged, and split per active input;
+  // the per-input figure is what each extra participant adds
+  uint32_t avg_mix_cycles() const { return mix_count_ ? (uint32_t) (total_cycles_ / mix_count_) : 0; }
+  uint32_t avg_cycles_per_input() const {
+    return total_inputs_ ? (uint32_t) (total_cycles_ / total_inputs_) : 0;
+  }
+  uint32_t max_mix_cycles() const { return max_cycles_; }
+  uint32_t mix_count() const { return mix_count_; }
+  uint32_t overruns() const { return overruns_; }
+  uint32_t underruns() const { return underruns_; }
+
+ protected:
+  struct Fifo {
+    int16_t data[2 * MAX_FRAME_SAMPLES];
+    size_t len;
+  };
+  bool push_(Fifo &fifo, const int16_t *samples, size_t count);
+  size_t pop_(Fifo &fifo, int16_t *samples, size_t count);
+  void mix_();
+
+  std::mutex lock_;
+  size_t frame_samples_ = 0;
+  Fifo inputs_[MAX_INPUTS]{};
+  Fifo outputs_[MAX_INPUTS]{};
+  int16_t frames_[MAX_INPUTS][MAX_FRAME_SAMPLES]{};  // Inputs taken for the current mix
+  int16_t mix_buf_[MAX_FRAME_SAMPLES]{};
+  bool listening_[MAX_INPUTS]{};  // Slot has read since reset(), so it gets an output
+
+  uint64_t total_cycles_ = 0;
+  uint64_t total_inputs_ = 0;
+  uint32_t mix_count_ = 0;
+  uint32_t max_cycles_ = 0;
+  uint32_t overruns_ = 0;
+  uint32_t underruns_ = 0;
+};
+
+}  // namespace intercom
+}  // namespace esphome
+
+#endif  // USE_ESP_IDF
@@ -0,0 +1,172 @@
+#include "dtls_certificate.h"
+
+#ifdef USE_ESP_IDF
+
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/x509_crt.h"
+
+#include <cstring>
+#include <ctime>
+
+namespace esphome {
+namespace intercom {
+
+static const char *TAG = "intercom.dtls";
+
+// Anything earlier means SNTP has not set the clock yet
+static const time_t VALID_TIME_THRESHOLD = 1600000000;
+
+bool DtlsCertificate::load_or_generate(uint32_t rotation_s) {
+  if (!pref_loaded_) {
+    pref_ = global_preferences->make_preference<Record>(fnv1_hash("intercom_dtls_cert"), true);
+    if (!pref_.load(&record_) || record_.version != RECORD_VERSION) {
+      record_ = {};
+    }
+    pref_loaded_ = true;
+  }
+
+  time_t now = ::time(nullptr);
+  if (is_valid() && record_.created_at == 0 && now > VALID_TIME_THRESHOLD) {
+    // Generated before the clock was synced - start the rotation clock now
+    record_.created_at = now;
+    pref_.save(&record_);
+  }
+
+  if (is_valid() && !needs_rotation_(rotation_s)) {
+    if (fingerprint_.empty()) {
+      compute_fingerprint_();
+      ESP_LOGI(TAG, "Using stored DTLS certificate %s", fingerprint_.c_str());
+    }
+    return true;
+  }
+
+  if (is_valid()) {
+    ESP_LOGI(TAG, "DTLS certificate older than %u s, rotating", (unsigned) rotation_s);
+  }
+  if (!generate_()) {
+    // Keep serving the old certificate if rotation failed
+    return is_valid();
+  }
+
+  pref_.save(&record_);
+  global_preferences->sync();
+  ESP_LOGI(TAG, "Generated DTLS certificate %s in %u ms", fingerprint_.c_str(), (unsigned) record_.generation_ms);
+  return true;
+}
+
+bool DtlsCertificate::needs_rotation_(uint32_t rotation_s) const {
+  if (rotation_s == 0 || record_.created_at == 0) {
+    return false;
+  }
+  time_t now = ::time(nullptr);
+  if (now < VALID_TIME_THRESHOLD) {
+    return false;
+  }
+  return (uint32_t) (now - record_.created_at) >= rotation_s;
+}
+
+bool DtlsCertificate::generate_() {
+  uint32_t start = millis();
+
+  mbedtls_entropy_context entropy;
+  mbedtls_ctr_drbg_context ctr_drbg;
+  mbedtls_pk_context key;
+  mbedtls_x509write_cert crt;
+  mbedtls_entropy_init(&entropy);
+  mbedtls_ctr_drbg_init(&ctr_drbg);
+  mbedtls_pk_init(&key);
+  mbedtls_x509write_crt_init(&crt);
+
+  Record fresh{};
+  const char *pers = "intercom_dtls";
+  int ret = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy,
+                                  (const unsigned char *) pers, strlen(pers));
+  if (ret == 0) {
+    ret = mbedtls_pk_setup(&key, mbedtls_pk_info_from_type(MBEDTLS_PK_ECKEY));
+  }
+  if (ret == 0) {
+    // ECDSA P-256, the curve every WebRTC stack accepts
+    ret = mbedtls_ecp_gen_key(MBEDTLS_ECP_DP_SECP256R1, mbedtls_pk_ec(key), mbedtls_ctr_drbg_random, &ctr_drbg);
+  }
+  if (ret == 0) {
+    unsigned char serial[8];
+    ret = mbedtls_ctr_drbg_random(&ctr_drbg, serial, sizeof(serial));
+    serial[0] &= 0x7F;  // Keep the serial positive
+    if (ret == 0) {
+      ret = mbedtls_x509write_crt_set_serial_raw(&crt, serial, sizeof(serial));
+    }
+  }
+  if (ret == 0) {
+    mbedtls_x509write_crt_set_version(&crt, MBEDTLS_X509_CRT_VERSION_3);
+    mbedtls_x509write_crt_set_md_alg(&crt, MBEDTLS_MD_SHA256);
+    mbedtls_x509write_crt_set_subject_key(&crt, &key);
+    mbedtls_x509write_crt_set_issuer_key(&crt, &key);
+    ret = mbedtls_x509write_crt_set_subject_name(&crt, "CN=esphome-intercom");
+  }
+  if (ret == 0) {
+    ret = mbedtls_x509write_crt_set_issuer_name(&crt, "CN=esphome-intercom");
+  }
+  if (ret == 0) {
+    // WebRTC authenticates by fingerprint, not validity, so use a wide window
+    ret = mbedtls_x509write_crt_set_validity(&crt, "20240101000000", "20991231235959");
+  }
+  if (ret == 0) {
+    ret = mbedtls_x509write_crt_pem(&crt, (unsigned char *) fresh.cert_pem, sizeof(fresh.cert_pem),
+                                    mbedtls_ctr_drbg_random, &ctr_drbg);
+  }
+  if (ret == 0) {
+    ret = mbedtls_pk_write_key_pem(&key, (unsigned char *) fresh.key_pem, sizeof(fresh.key_pem));
+  }
+
+  mbedtls_x509write_crt_free(&crt);
+  mbedtls_pk_free(&key);
+  mbedtls_ctr_drbg_free(&ctr_drbg);
+  mbedtls_entropy_free(&entropy);
+
+  if (ret != 0) {
+    ESP_LOGE(TAG, "Failed to generate DTLS certificate: -0x%04X", (unsigned) -ret);
+    return false;
+  }
+
+  time_t now = ::time(nullptr);
+  fresh.version = RECORD_VERSION;
+  fresh.created_at = now > VALID_TIME_THRESHOLD ? (uint32_t) now : 0;
+  fresh.generation_ms = millis() - start;
+  fresh.cert_len = strlen(fresh.cert_pem);
+  fresh.key_len = strlen(fresh.key_pem);
+  record_ = fresh;
+  compute_fingerprint_();
+  return true;
+}
+
+void DtlsCertificate::compute_fingerprint_() {
+  fingerprint_.clear();
+
+  mbedtls_x509_crt crt;
+  mbedtls_x509_crt_init(&crt);
+  // PEM parsing requires the terminating NUL in the length
+  if (mbedtls_x509_crt_parse(&crt, (const unsigned char *) record_.cert_pem, record_.cert_len + 1) == 0) {
+    unsigned char hash[32];
+    if (mbedtls_sha256(crt.raw.p, crt.raw.len, hash, 0) == 0) {
+      char hex[4];
+      fingerprint_.reserve(sizeof(hash) * 3);
+      for (size_t i = 0; i < sizeof(hash); i++) {
+        snprintf(hex, sizeof(hex), i == 0 ? "%02X" : ":%02X", hash[i]);
+        fingerprint_ += hex;
+      }
+    }
+  }
+  mbedtls_x509_crt_free(&crt);
+}
+
+}  // namespace intercom
+}  // namespace esphome
+
+#endif  // USE_ESP_IDF
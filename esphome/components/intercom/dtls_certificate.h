@@ -0,0 +1,59 @@
+/*
+ * DTLS Certificate Cache
+ * Self-signed ECDSA certificate generated once and persisted in NVS,
+ * so WebRTC peers never generate keys on the call-setup path
+ */
+
+#pragma once
+
+#ifdef USE_ESP_IDF
+
+#include "esphome/core/preferences.h"
+#include <string>
+
+namespace esphome {
+namespace intercom {
+
+class DtlsCertificate {
+ public:
+  // Load the stored certificate, or generate and persist a new one when none
+  // is stored or the stored one is older than rotation_s. Returns true when a
+  // certificate is available.
+  bool load_or_generate(uint32_t rotation_s);
+
+  bool is_valid() const { return record_.cert_len > 0 && record_.key_len > 0; }
+  const char *cert_pem() const { return record_.cert_pem; }
+  const char *key_pem() const { return record_.key_pem; }
+  const std::string &fingerprint() const { return fingerprint_; }
+  // How long the last generation of this certificate took - the cost every
+  // peer would pay without the cache
+  uint32_t generation_ms() const { return record_.generation_ms; }
+  uint32_t created_at() const { return record_.created_at; }
+
+ protected:
+  static constexpr uint32_t RECORD_VERSION = 1;
+
+  struct Record {
+    uint32_t version;
+    uint32_t created_at;     // Unix time, 0 if the clock was not set yet
+    uint32_t generation_ms;
+    uint16_t cert_len;
+    uint16_t key_len;
+    char cert_pem[768];
+    char key_pem[256];
+  };
+
+  bool generate_();
+  bool needs_rotation_(uint32_t rotation_s) const;
+  void compute_fingerprint_();
+
+  ESPPreferenceObject pref_;
+  bool pref_loaded_ = false;
+  Record record_{};
+  std::string fingerprint_;
+};
+
+}  // namespace intercom
+}  // namespace esphome
+
+#endif  // USE_ESP_IDF
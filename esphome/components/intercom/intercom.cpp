@@ -27,22 +27,53 @@ void IntercomComponent::setup() {
   
   generate_client_id_();
   ESP_LOGCONFIG(TAG, "Client ID: %s", client_id_.c_str());
+  rx_message_.reserve(RX_MESSAGE_RESERVE);
   
   // Connect to signaling server after WiFi is ready
   this->set_timeout(2000, [this]() {
     this->connect_websocket();
   });
+  
+#ifdef USE_ESP_IDF
+  // Load the DTLS certificate and warm the standby peers at boot, not when the doorbell rings
+  this->set_timeout("prepare_next_call", 1000, [this]() { this->prepare_next_call_(); });
+#endif
 }
 
 void IntercomComponent::dump_config() {
   ESP_LOGCONFIG(TAG, "Intercom Component:");
   ESP_LOGCONFIG(TAG, "  Signaling Server: %s:%d%s", signaling_server_.c_str(), signaling_port_, signaling_path_.c_str());
   ESP_LOGCONFIG(TAG, "  Client ID: %s", client_id_.c_str());
+  ESP_LOGCONFIG(TAG, "  Pre-warmed Peer: %s", YESNO(prewarm_peer_));
+  ESP_LOGCONFIG(TAG, "  Max Peers: %u", (unsigned) max_peers_);
+#ifdef USE_ESP_IDF
+  ESP_LOGCONFIG(TAG, "  DTLS Certificate Rotation: %u s", (unsigned) dtls_cert_rotation_s_);
+  for (auto &server : ice_servers_) {
+    ESP_LOGCONFIG(TAG, "  ICE Server: %s%s", server.url.c_str(), server.username.empty() ? "" : " (with credentials)");
+  }
+  ESP_LOGCONFIG(TAG, "  ICE Host Grace: %u ms", (unsigned) ice_host_grace_ms_);
+  ESP_LOGCONFIG(TAG, "  Power Save Off In Call: %s", YESNO(power_save_off_in_call_));
+  if (dtls_cert_.is_valid()) {
+    ESP_LOGCONFIG(TAG, "  DTLS Fingerprint: %s", dtls_cert_.fingerprint().c_str());
+    ESP_LOGCONFIG(TAG, "  DTLS Generation Cost: %u ms (paid once, not per call)", (unsigned) dtls_cert_.generation_ms());
+  }
+  if (mixer_.mix_count() > 0) {
+    ESP_LOGCONFIG(TAG, "  Mixer: %u-sample frames, %u cycles/frame avg, %u max, %u cycles per participant",
+                  (unsigned) mixer_.frame_samples(), (unsigned) mixer_.avg_mix_cycles(),
+                  (unsigned) mixer_.max_mix_cycles(), (unsigned) mixer_.avg_cycles_per_input());
+    ESP_LOGCONFIG(TAG, "  Mixer: %u overruns, %u underruns", (unsigned) mixer_.overruns(),
+                  (unsigned) mixer_.underruns());
+  }
+#endif
+  LOG_SENSOR("  ", "Call Setup Time", call_setup_time_sensor_);
 }
 
 void IntercomComponent::loop() {
 #ifdef USE_ESP_IDF
-  // WebSocket processing is handled by ESP-IDF internally
+  // The WebSocket client and esp_peer run on their own tasks; act on what
+  // they queued
+  process_signaling_queue_();
+  process_peer_events_();
 #else
   web_socket_.loop();
 #endif
@@ -70,6 +101,9 @@ void IntercomComponent::loop() {
     }
   }
   
+#ifdef USE_ESP_IDF
+  update_power_save_();
+#endif
   update_call_state_();
   update_status_text_();
 }
@@ -150,40 +184,33 @@ void IntercomComponent::websocket_event_handler(void *arg, esp_event_base_t even
   esp_websocket_event_id_t ws_event_id = (esp_websocket_event_id_t)event_id;
   esp_websocket_event_data_t *data = (esp_websocket_event_data_t *)event_data;
 
+  // Runs on the WebSocket client's task: only rx_message_ is touched here,
+  // everything else is queued for loop()
   switch (ws_event_id) {
     case WEBSOCKET_EVENT_CONNECTED:
-      ESP_LOGI(TAG, "WebSocket Connected");
-      instance->connected_ = true;
-      instance->generate_session_id_();
-      
-      // Join own room for always-on mode (can receive calls)
-      instance->room_id_ = instance->client_id_;
-      instance->send_join_message_();
-      
-      // If we were waiting to call someone, retry now
-      if (!instance->target_device_id_.empty() && !instance->in_call_) {
-        std::string target = instance->target_device_id_;
-        instance->target_device_id_ = ""; // Reset before calling
-        instance->start_call(target);
-      }
+      instance->queue_signaling_(SignalingEvent::CONNECTED);
       break;
 
     case WEBSOCKET_EVENT_DISCONNECTED:
-      ESP_LOGI(TAG, "WebSocket Disconnected");
-      instance->connected_ = false;
-      instance->in_call_ = false;
-      instance->update_call_state_();
-      // Reconnect after delay
-      instance->set_timeout(5000, [instance]() { instance->connect_websocket(); });
+      instance->queue_signaling_(SignalingEvent::DISCONNECTED);
       break;
 
     case WEBSOCKET_EVENT_DATA:
       if (data->op_code == 0x08 && data->data_len == 2) {
         ESP_LOGI(TAG, "Received closed message");
-      } else {
-        std::string message((char *)data->data_ptr, data->data_len);
-        ESP_LOGD(TAG, "Received: %s", message.c_str());
-        instance->handle_signaling_message_(message);
+      } else if (data->op_code == 0x01) {
+        // Large text frames arrive in payload_offset chunks
+        if (data->payload_offset == 0) {
+          instance->rx_message_.clear();
+        }
+        if ((int) instance->rx_message_.size() != data->payload_offset) {
+          break;
+        }
+        instance->rx_message_.append((const char *) data->data_ptr, data->data_len);
+        if ((int) instance->rx_message_.size() >= data->payload_len) {
+          ESP_LOGV(TAG, "Received %u bytes", (unsigned) instance->rx_message_.size());
+          instance->queue_signaling_(SignalingEvent::MESSAGE);
+        }
       }
       break;
 
@@ -196,6 +223,74 @@ void IntercomComponent::websocket_event_handler(void *arg, esp_event_base_t even
   }
 }
 
+void IntercomComponent::queue_signaling_(SignalingEvent event) {
+  std::lock_guard<std::mutex> guard(signaling_lock_);
+  if (event != SignalingEvent::MESSAGE) {
+    signaling_queue_.push_back({event, std::string()});
+    return;
+  }
+  signaling_queue_.push_back({event, std::move(rx_message_)});
+  if (!spare_messages_.empty()) {
+    rx_message_ = std::move(spare_messages_.back());
+    spare_messages_.pop_back();
+  } else {
+    rx_message_ = std::string();
+    rx_message_.reserve(RX_MESSAGE_RESERVE);
+  }
+}
+
+void IntercomComponent::process_signaling_queue_() {
+  while (true) {
+    PendingSignaling pending;
+    {
+      std::lock_guard<std::mutex> guard(signaling_lock_);
+      if (signaling_queue_.empty()) {
+        return;
+      }
+      pending = std::move(signaling_queue_.front());
+      signaling_queue_.pop_front();
+    }
+    
+    switch (pending.event) {
+      case SignalingEvent::CONNECTED:
+        ESP_LOGI(TAG, "WebSocket Connected");
+        connected_ = true;
+        generate_session_id_();
+        
+        // Join own room for always-on mode (can receive calls)
+        room_id_ = client_id_;
+        send_join_message_();
+        
+        // If we were waiting to call someone, retry now
+        if (!target_device_id_.empty() && !in_call_) {
+          std::string target = target_device_id_;
+          target_device_id_ = "";  // Reset before calling
+          start_call(target);
+        }
+        break;
+        
+      case SignalingEvent::DISCONNECTED:
+        ESP_LOGI(TAG, "WebSocket Disconnected");
+        connected_ = false;
+        in_call_ = false;
+        update_call_state_();
+        // Reconnect after delay
+        this->set_timeout(5000, [this]() { this->connect_websocket(); });
+        break;
+        
+      case SignalingEvent::MESSAGE: {
+        handle_signaling_message_(pending.message);
+        pending.message.clear();
+        std::lock_guard<std::mutex> guard(signaling_lock_);
+        if (spare_messages_.size() < MAX_SPARE_MESSAGES) {
+          spare_messages_.push_back(std::move(pending.message));
+        }
+        break;
+      }
+    }
+  }
+}
+
 #else  // Arduino framework
 void IntercomComponent::connect_websocket() {
   if (!web_socket_.isConnected()) {
@@ -232,7 +327,8 @@ void IntercomComponent::handle_websocket_event_(WStype_t type, uint8_t *payload,
       break;
       
     case WStype_TEXT:
-      handle_signaling_message_(std::string((char*)payload));
+      rx_message_.assign((const char *) payload, length);
+      handle_signaling_message_(rx_message_);
       break;
       
     default:
@@ -248,6 +344,10 @@ void IntercomComponent::send_join_message_() {
   cJSON_AddStringToObject(json, "roomId", room_id_.c_str());
   cJSON_AddStringToObject(json, "clientId", client_id_.c_str());
   cJSON_AddStringToObject(json, "sessionId", session_id_.c_str());
+  if (room_id_ == client_id_ && max_peers_ > 1) {
+    // Our own room hosts the conference: us plus max_peers_ remote legs
+    cJSON_AddNumberToObject(json, "maxPeers", max_peers_ + 1);
+  }
   
   char *json_str = cJSON_PrintUnformatted(json);
   if (json_str) {
@@ -261,6 +361,9 @@ void IntercomComponent::send_join_message_() {
   doc["roomId"] = room_id_;
   doc["clientId"] = client_id_;
   doc["sessionId"] = session_id_;
+  if (room_id_ == client_id_ && max_peers_ > 1) {
+    doc["maxPeers"] = max_peers_ + 1;
+  }
   
   String message;
   serializeJson(doc, message);
@@ -292,11 +395,14 @@ void IntercomComponent::send_ready_message_() {
 #endif
 }
 
-void IntercomComponent::send_offer_message_(const std::string &sdp) {
+void IntercomComponent::send_offer_message_(const std::string &sdp, const std::string &to) {
 #ifdef USE_ESP_IDF
   cJSON *json = cJSON_CreateObject();
   cJSON_AddStringToObject(json, "type", "offer");
   cJSON_AddStringToObject(json, "sdp", sdp.c_str());
+  if (!to.empty()) {
+    cJSON_AddStringToObject(json, "to", to.c_str());
+  }
   
   char *json_str = cJSON_PrintUnformatted(json);
   if (json_str) {
@@ -308,6 +414,9 @@ void IntercomComponent::send_offer_message_(const std::string &sdp) {
   StaticJsonDocument<512> doc;
   doc["type"] = "offer";
   doc["sdp"] = sdp.c_str();
+  if (!to.empty()) {
+    doc["to"] = to.c_str();
+  }
   
   String message;
   serializeJson(doc, message);
@@ -318,14 +427,14 @@ void IntercomComponent::send_offer_message_(const std::string &sdp) {
 void IntercomComponent::send_offer_for_call_() {
 #ifdef USE_ESP_IDF
   // Use ESP WebRTC to create proper offer
-  if (webrtc_peer_ == nullptr) {
-    if (init_webrtc_peer(true) == ESP_OK) {
-      create_offer();
-    } else {
-      ESP_LOGE(TAG, "Failed to initialize WebRTC peer for offer");
-    }
+  PeerLeg *leg = find_leg_(target_device_id_);
+  if (leg == nullptr) {
+    leg = init_webrtc_peer(true, target_device_id_);
+  }
+  if (leg != nullptr) {
+    create_offer(leg);
   } else {
-    create_offer();
+    ESP_LOGE(TAG, "Failed to initialize WebRTC peer for offer");
   }
 #else
   // Fallback to simplified SDP (won't work with Android)
@@ -341,16 +450,19 @@ void IntercomComponent::send_offer_for_call_() {
            "c=IN IP4 %s\r\n",
            millis(), local_ip.c_str(), local_ip.c_str());
   
-  send_offer_message_(sdp);
+  send_offer_message_(sdp, target_device_id_);
   ESP_LOGI(TAG, "Sent simplified offer to %s (not WebRTC compatible)", target_device_id_.c_str());
 #endif
 }
 
-void IntercomComponent::send_answer_message_(const std::string &sdp) {
+void IntercomComponent::send_answer_message_(const std::string &sdp, const std::string &to) {
 #ifdef USE_ESP_IDF
   cJSON *json = cJSON_CreateObject();
   cJSON_AddStringToObject(json, "type", "answer");
   cJSON_AddStringToObject(json, "sdp", sdp.c_str());
+  if (!to.empty()) {
+    cJSON_AddStringToObject(json, "to", to.c_str());
+  }
   
   char *json_str = cJSON_PrintUnformatted(json);
   if (json_str) {
@@ -362,6 +474,9 @@ void IntercomComponent::send_answer_message_(const std::string &sdp) {
   StaticJsonDocument<512> doc;
   doc["type"] = "answer";
   doc["sdp"] = sdp.c_str();
+  if (!to.empty()) {
+    doc["to"] = to.c_str();
+  }
   
   String message;
   serializeJson(doc, message);
@@ -390,11 +505,14 @@ void IntercomComponent::send_leave_message_() {
 #endif
 }
 
-void IntercomComponent::send_candidate_message_(const std::string &candidate) {
+void IntercomComponent::send_candidate_message_(const std::string &candidate, const std::string &to) {
 #ifdef USE_ESP_IDF
   cJSON *json = cJSON_CreateObject();
   cJSON_AddStringToObject(json, "type", "candidate");
   cJSON_AddStringToObject(json, "candidate", candidate.c_str());
+  if (!to.empty()) {
+    cJSON_AddStringToObject(json, "to", to.c_str());
+  }
   
   char *json_str = cJSON_PrintUnformatted(json);
   if (json_str) {
@@ -406,6 +524,32 @@ void IntercomComponent::send_candidate_message_(const std::string &candidate) {
   StaticJsonDocument<256> doc;
   doc["type"] = "candidate";
   doc["candidate"] = candidate.c_str();
+  if (!to.empty()) {
+    doc["to"] = to.c_str();
+  }
+  
+  String message;
+  serializeJson(doc, message);
+  web_socket_.sendTXT(message);
+#endif
+}
+
+void IntercomComponent::send_invite_message_(const std::string &to) {
+#ifdef USE_ESP_IDF
+  cJSON *json = cJSON_CreateObject();
+  cJSON_AddStringToObject(json, "type", "invite");
+  cJSON_AddStringToObject(json, "to", to.c_str());
+  
+  char *json_str = cJSON_PrintUnformatted(json);
+  if (json_str) {
+    send_websocket_message(json_str);
+    free(json_str);
+  }
+  cJSON_Delete(json);
+#else
+  StaticJsonDocument<256> doc;
+  doc["type"] = "invite";
+  doc["to"] = to.c_str();
   
   String message;
   serializeJson(doc, message);
@@ -414,7 +558,8 @@ void IntercomComponent::send_candidate_message_(const std::string &candidate) {
 }
 
 void IntercomComponent::handle_signaling_message_(const std::string &message) {
-  ESP_LOGD(TAG, "Received signaling message: %s", message.c_str());
+  // Size only: offers and answers carry ICE passwords and SRTP keys
+  ESP_LOGD(TAG, "Received signaling message (%u bytes)", (unsigned) message.size());
   
 #ifdef USE_ESP_IDF
   cJSON *json = cJSON_Parse(message.c_str());
@@ -431,6 +576,14 @@ void IntercomComponent::handle_signaling_message_(const std::string &message) {
   
   std::string msg_type = cJSON_GetStringValue(type);
   
+  // The router stamps relayed messages with the sender; older routers only
+  // relay between two peers, where the single leg is implied
+  std::string from;
+  cJSON *from_item = cJSON_GetObjectItem(json, "from");
+  if (from_item && cJSON_IsString(from_item)) {
+    from = cJSON_GetStringValue(from_item);
+  }
+  
   if (msg_type == "joined") {
     cJSON *role = cJSON_GetObjectItem(json, "role");
     if (role && cJSON_IsString(role)) {
@@ -443,6 +596,13 @@ void IntercomComponent::handle_signaling_message_(const std::string &message) {
     ESP_LOGI(TAG, "Room is ready");
     ready_ = true;
     
+    // If we're waiting to start a call and room is ready, send offer
+    if (waiting_for_ready_ && auto_connect_ && !target_device_id_.empty()) {
+      waiting_for_ready_ = false;
+      ESP_LOGI(TAG, "Room ready, sending offer to %s", target_device_id_.c_str());
+      send_offer_for_call_();
+    }
+    
   } else if (msg_type == "offer") {
     cJSON *sdp = cJSON_GetObjectItem(json, "sdp");
     if (sdp && cJSON_IsString(sdp)) {
@@ -450,25 +610,38 @@ void IntercomComponent::handle_signaling_message_(const std::string &message) {
       ESP_LOGI(TAG, "Received offer - %s", auto_accept_ ? "auto-accepting call" : "call incoming");
       
       // Extract sender info if available
+      std::string sender = from;
       cJSON *sender_client_id = cJSON_GetObjectItem(json, "clientId");
-      if (sender_client_id && cJSON_IsString(sender_client_id)) {
-        target_device_id_ = cJSON_GetStringValue(sender_client_id);
-        ESP_LOGI(TAG, "Incoming call from: %s", target_device_id_.c_str());
+      if (sender.empty() && sender_client_id && cJSON_IsString(sender_client_id)) {
+        sender = cJSON_GetStringValue(sender_client_id);
+      }
+      if (!sender.empty()) {
+        ESP_LOGI(TAG, "Incoming call from: %s", sender.c_str());
       }
       
-      if (auto_accept_) {
-#ifdef USE_ESP_IDF
+      PeerLeg *leg = find_leg_(sender);
+      if (leg != nullptr) {
+        // Renegotiation on an existing leg
+        set_remote_description(leg, sdp_str, true);
+      } else if (legs_.size() >= max_peers_) {
+        ESP_LOGW(TAG, "Already bridging %u peers, ignoring offer from %s", (unsigned) legs_.size(), sender.c_str());
+      } else if (auto_accept_) {
+        if (legs_.empty()) {
+          target_device_id_ = sender;
+          call_setup_start_ms_ = millis();
+        }
         // Initialize WebRTC peer as answerer
-        if (init_webrtc_peer(false) == ESP_OK) {
+        leg = init_webrtc_peer(false, sender);
+        if (leg != nullptr) {
           // Set remote description (offer), which will trigger answer creation
-          set_remote_description(sdp_str, true);
+          set_remote_description(leg, sdp_str, true);
         } else {
           ESP_LOGE(TAG, "Failed to initialize WebRTC peer for incoming call");
         }
-#else
-        accept_call();
-#endif
       } else {
+        if (legs_.empty()) {
+          target_device_id_ = sender;
+        }
         ESP_LOGI(TAG, "Call waiting - manual acceptance required");
       }
     }
@@ -479,14 +652,13 @@ void IntercomComponent::handle_signaling_message_(const std::string &message) {
       std::string sdp_str = cJSON_GetStringValue(sdp);
       ESP_LOGI(TAG, "Received answer - setting remote description");
       
-#ifdef USE_ESP_IDF
-      // Set remote description (answer)
-      set_remote_description(sdp_str, false);
-#else
-      // Simplified: mark as in call
-      in_call_ = true;
-      update_call_state_();
-#endif
+      PeerLeg *leg = find_leg_(from);
+      if (leg != nullptr) {
+        // Set remote description (answer)
+        set_remote_description(leg, sdp_str, false);
+      } else {
+        ESP_LOGW(TAG, "Answer from %s does not match any call", from.c_str());
+      }
     }
     
   } else if (msg_type == "candidate") {
@@ -495,18 +667,47 @@ void IntercomComponent::handle_signaling_message_(const std::string &message) {
       std::string candidate_str = cJSON_GetStringValue(candidate);
       ESP_LOGD(TAG, "Received ICE candidate: %s", candidate_str.c_str());
       
-#ifdef USE_ESP_IDF
-      // Add ICE candidate to WebRTC peer
-      add_ice_candidate(candidate_str);
-#endif
+      // Add ICE candidate to the WebRTC peer of its sender
+      PeerLeg *leg = find_leg_(from);
+      if (leg != nullptr) {
+        add_ice_candidate(leg, candidate_str);
+      }
     }
     
   } else if (msg_type == "leave") {
-    ESP_LOGI(TAG, "Remote left - ending call");
-#ifdef USE_ESP_IDF
-    deinit_webrtc_peer();
-#endif
-    end_call();
+    std::string leaving;
+    cJSON *client_id = cJSON_GetObjectItem(json, "clientId");
+    if (client_id && cJSON_IsString(client_id)) {
+      leaving = cJSON_GetStringValue(client_id);
+    }
+    PeerLeg *leg = leaving.empty() ? nullptr : find_leg_(leaving);
+    if (!leaving.empty() && leg == nullptr) {
+      // Another participant of a bridged room we had no leg with
+      ESP_LOGD(TAG, "%s left the room", leaving.c_str());
+    } else if (leg != nullptr && legs_.size() > 1) {
+      ESP_LOGI(TAG, "%s left - %u peers remain", leaving.c_str(), (unsigned) legs_.size() - 1);
+      deinit_webrtc_peer(leg);
+      update_in_call_();
+    } else {
+      ESP_LOGI(TAG, "Remote left - ending call");
+      set_call_phase_(CallPhase::TEARDOWN);
+      deinit_webrtc_peers();
+      end_call();
+    }
+    
+  } else if (msg_type == "invite") {
+    std::string room;
+    cJSON *room_item = cJSON_GetObjectItem(json, "roomId");
+    if (room_item && cJSON_IsString(room_item)) {
+      room = cJSON_GetStringValue(room_item);
+    }
+    ESP_LOGI(TAG, "Invited by %s to room %s", from.c_str(), room.c_str());
+    if (in_call_ || waiting_for_ready_) {
+      ESP_LOGW(TAG, "Busy, ignoring invite");
+    } else if (auto_accept_ && !room.empty()) {
+      // The inviting hub hosts the conference in its own room
+      start_call(room);
+    }
     
   } else if (msg_type == "error") {
     cJSON *error_msg = cJSON_GetObjectItem(json, "message");
@@ -549,7 +750,10 @@ void IntercomComponent::handle_signaling_message_(const std::string &message) {
     ESP_LOGI(TAG, "Received offer - %s", auto_accept_ ? "auto-accepting call" : "call incoming");
     
     // Extract sender info if available
-    std::string sender_client_id = doc["clientId"] | "";
+    std::string sender_client_id = doc["from"] | "";
+    if (sender_client_id.empty()) {
+      sender_client_id = doc["clientId"] | "";
+    }
     if (!sender_client_id.empty()) {
       target_device_id_ = sender_client_id;
       ESP_LOGI(TAG, "Incoming call from: %s", target_device_id_.c_str());
@@ -565,6 +769,7 @@ void IntercomComponent::handle_signaling_message_(const std::string &message) {
     std::string sdp = doc["sdp"] | "";
     ESP_LOGI(TAG, "Received answer - call established");
     in_call_ = true;
+    publish_call_setup_time_();
     update_call_state_();
     
   } else if (type == "candidate") {
@@ -572,8 +777,23 @@ void IntercomComponent::handle_signaling_message_(const std::string &message) {
     ESP_LOGD(TAG, "Received ICE candidate: %s", candidate.c_str());
     
   } else if (type == "leave") {
-    ESP_LOGI(TAG, "Remote left - ending call");
-    end_call();
+    std::string leaving = doc["clientId"] | "";
+    if (!leaving.empty() && leaving != target_device_id_) {
+      ESP_LOGD(TAG, "%s left the room", leaving.c_str());
+    } else {
+      ESP_LOGI(TAG, "Remote left - ending call");
+      end_call();
+    }
+    
+  } else if (type == "invite") {
+    std::string from = doc["from"] | "";
+    std::string room = doc["roomId"] | "";
+    ESP_LOGI(TAG, "Invited by %s to room %s", from.c_str(), room.c_str());
+    if (in_call_ || waiting_for_ready_) {
+      ESP_LOGW(TAG, "Busy, ignoring invite");
+    } else if (auto_accept_ && !room.empty()) {
+      start_call(room);
+    }
     
   } else if (type == "error") {
     std::string error_msg = doc["message"] | "";
@@ -609,6 +829,10 @@ void IntercomComponent::start_call(const std::string &target_device_id) {
   room_id_ = target_device_id;
   generate_session_id_();
   waiting_for_ready_ = true;
+  call_setup_start_ms_ = millis();
+#ifdef USE_ESP_IDF
+  set_call_phase_(CallPhase::SETUP);
+#endif
   
   send_join_message_();
   ESP_LOGI(TAG, "Initiating call to %s (waiting for room ready)", target_device_id.c_str());
@@ -616,17 +840,25 @@ void IntercomComponent::start_call(const std::string &target_device_id) {
 
 void IntercomComponent::end_call() {
   if (!in_call_ && !waiting_for_ready_) {
+#ifdef USE_ESP_IDF
+    // Peers that already disconnected on their own still close the tally
+    set_call_phase_(CallPhase::IDLE);
+#endif
     return;
   }
   
+#ifdef USE_ESP_IDF
+  set_call_phase_(CallPhase::TEARDOWN);
+#endif
   send_leave_message_();
   
 #ifdef USE_ESP_IDF
-  deinit_webrtc_peer();
+  deinit_webrtc_peers();
 #endif
   
   in_call_ = false;
   waiting_for_ready_ = false;
+  call_setup_start_ms_ = 0;
   
   // Reset room to own client ID for always-on mode
   room_id_ = client_id_;
@@ -638,6 +870,9 @@ void IntercomComponent::end_call() {
   target_device_id_ = "";
   
   update_call_state_();
+#ifdef USE_ESP_IDF
+  set_call_phase_(CallPhase::IDLE);
+#endif
   ESP_LOGI(TAG, "Call ended, returned to standby mode");
 }
 
@@ -645,8 +880,8 @@ void IntercomComponent::accept_call() {
 #ifdef USE_ESP_IDF
   // If we received an offer, answer should already be created in set_remote_description
   // But if called manually, create peer as answerer
-  if (webrtc_peer_ == nullptr) {
-    if (init_webrtc_peer(false) == ESP_OK) {
+  if (legs_.empty()) {
+    if (init_webrtc_peer(false, target_device_id_) != nullptr) {
       // Answer will be created when remote description is set
       ESP_LOGI(TAG, "WebRTC peer initialized as answerer");
     } else {
@@ -669,6 +904,25 @@ void IntercomComponent::accept_call() {
 #endif
 }
 
+void IntercomComponent::invite(const std::string &target_device_id) {
+  if (!connected_ || target_device_id.empty()) {
+    ESP_LOGW(TAG, "Cannot invite %s: not connected", target_device_id.c_str());
+    return;
+  }
+  if (max_peers_ < 2) {
+    ESP_LOGW(TAG, "Inviting needs max_peers of 2 or more");
+    return;
+  }
+  if (room_id_ != client_id_) {
+    // Only our own room was created with room for more than two
+    ESP_LOGW(TAG, "Conferences are hosted in this device's own room; end the current call first");
+    return;
+  }
+  
+  send_invite_message_(target_device_id);
+  ESP_LOGI(TAG, "Invited %s to join", target_device_id.c_str());
+}
+
 void IntercomComponent::toggle_mute() {
   muted_ = !muted_;
   ESP_LOGI(TAG, "Mute: %s", muted_ ? "ON" : "OFF");
@@ -687,6 +941,19 @@ void IntercomComponent::update_call_state_() {
   }
 }
 
+void IntercomComponent::publish_call_setup_time_() {
+  if (call_setup_start_ms_ == 0) {
+    return;
+  }
+  
+  uint32_t elapsed = millis() - call_setup_start_ms_;
+  call_setup_start_ms_ = 0;
+  ESP_LOGI(TAG, "Call setup took %u ms", (unsigned) elapsed);
+  if (call_setup_time_sensor_) {
+    call_setup_time_sensor_->publish_state(elapsed);
+  }
+}
+
 void IntercomComponent::update_status_text_() {
   if (call_status_text_sensor_) {
     std::string status;
@@ -745,96 +1012,334 @@ void IntercomComponent::update_status_text_() {
 #ifdef USE_ESP_IDF
 // WebRTC Implementation
 
-esp_err_t IntercomComponent::init_webrtc_peer(bool is_offerer) {
-  if (webrtc_peer_ != nullptr) {
+// Extract the candidate type ("host", "srflx", "prflx", "relay") from an
+// a=candidate line; see RFC 8839 section 5.1
+static std::string candidate_type(const std::string &candidate) {
+  size_t pos = candidate.find(" typ ");
+  if (pos == std::string::npos) {
+    return "unknown";
+  }
+  pos += 5;
+  size_t end = candidate.find(' ', pos);
+  return candidate.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+}
+
+IntercomComponent::PeerLeg *IntercomComponent::init_webrtc_peer(bool is_offerer, const std::string &remote_id) {
+  if (find_leg_(remote_id) != nullptr || legs_.size() >= max_peers_) {
     ESP_LOGW(TAG, "WebRTC peer already initialized");
-    return ESP_ERR_INVALID_STATE;
+    return nullptr;
+  }
+  // Incoming calls start here rather than in start_call()
+  if (AllocTracer::phase() == CallPhase::IDLE) {
+    set_call_phase_(CallPhase::SETUP);
+  }
+  
+  // Hand out the standby peer if one is warm for this role
+  std::unique_ptr<PeerLeg> leg = std::move(standby_legs_[is_offerer ? 1 : 0]);
+  if (leg) {
+    ESP_LOGI(TAG, "WebRTC peer taken from standby (is_offerer=%d)", is_offerer);
+  } else {
+    leg.reset(new PeerLeg());
+    leg->parent = this;
+    if (create_webrtc_peer_(is_offerer, leg.get()) != ESP_OK) {
+      return nullptr;
+    }
+    ESP_LOGI(TAG, "WebRTC peer initialized (is_offerer=%d)", is_offerer);
   }
   
-  is_offerer_ = is_offerer;
+  leg->remote_id = remote_id;
+  leg->mixer_slot = free_mixer_slot_();
+  legs_.push_back(std::move(leg));
+  return legs_.back().get();
+}
+
+esp_err_t IntercomComponent::create_webrtc_peer_(bool is_offerer, PeerLeg *leg) {
+  // The esp_peer config only borrows its strings and arrays, so everything
+  // it points at lives in the leg (or in ice_servers_, which is fixed after
+  // setup) until the peer is closed
+  leg->ice_servers.clear();
+  leg->ice_servers.reserve(ice_servers_.size());
+  for (auto &server : ice_servers_) {
+    esp_peer_ice_server_cfg_t server_cfg = {};
+    server_cfg.stun_url = const_cast<char *>(server.url.c_str());
+    server_cfg.user = server.username.empty() ? nullptr : const_cast<char *>(server.username.c_str());
+    server_cfg.psw = server.password.empty() ? nullptr : const_cast<char *>(server.password.c_str());
+    leg->ice_servers.push_back(server_cfg);
+  }
   
   esp_peer_config_t peer_config = {
     .is_offerer = is_offerer,
-    .ice_servers = NULL,  // No STUN/TURN for now, can add later
-    .ice_server_count = 0,
+    .ice_servers = leg->ice_servers.empty() ? NULL : leg->ice_servers.data(),
+    .ice_server_count = (int) leg->ice_servers.size(),
   };
   
-  // Set callbacks
+  // Reuse the persisted certificate instead of generating a key pair per peer
+  if (dtls_cert_.is_valid()) {
+    leg->dtls_cert_pem = dtls_cert_.cert_pem();
+    leg->dtls_key_pem = dtls_cert_.key_pem();
+    peer_config.dtls_cert = leg->dtls_cert_pem.c_str();
+    peer_config.dtls_key = leg->dtls_key_pem.c_str();
+  }
+  
+  // ICE credentials are single use; they are normally precomputed while
+  // idle. The leg takes them over, leaving next_* empty for the next peer.
+  if (next_ice_ufrag_.empty()) {
+    refresh_ice_credentials_();
+  }
+  leg->ice_ufrag = std::move(next_ice_ufrag_);
+  leg->ice_pwd = std::move(next_ice_pwd_);
+  next_ice_ufrag_.clear();
+  next_ice_pwd_.clear();
+  peer_config.ice_ufrag = leg->ice_ufrag.c_str();
+  peer_config.ice_pwd = leg->ice_pwd.c_str();
+  
+  // Set callbacks; each leg is its own context so events and audio are
+  // routed to the right participant
   esp_peer_event_cb_t event_cb = {
     .on_ice_candidate = ice_candidate_cb,
     .on_connection_state_change = peer_connection_state_cb,
-    .ctx = this,
+    .on_audio_capture = audio_capture_cb,
+    .on_audio_render = audio_render_cb,
+    .ctx = leg,
   };
   
-  esp_err_t ret = esp_peer_create(&peer_config, &event_cb, &webrtc_peer_);
+  uint32_t start = millis();
+  esp_err_t ret = esp_peer_create(&peer_config, &event_cb, &leg->peer);
   if (ret != ESP_OK) {
     ESP_LOGE(TAG, "Failed to create WebRTC peer: %s", esp_err_to_name(ret));
     return ret;
   }
+  leg->is_offerer = is_offerer;
   
-  ESP_LOGI(TAG, "WebRTC peer initialized (is_offerer=%d)", is_offerer);
+  uint32_t elapsed = millis() - start;
+  if (dtls_cert_.is_valid()) {
+    ESP_LOGD(TAG, "WebRTC peer created in %u ms with cached certificate (saved ~%u ms of key generation)",
+             (unsigned) elapsed, (unsigned) dtls_cert_.generation_ms());
+  } else {
+    ESP_LOGD(TAG, "WebRTC peer created in %u ms", (unsigned) elapsed);
+  }
   return ESP_OK;
 }
 
-void IntercomComponent::deinit_webrtc_peer() {
-  if (webrtc_peer_ != nullptr) {
-    esp_peer_destroy(webrtc_peer_);
-    webrtc_peer_ = nullptr;
-    ESP_LOGI(TAG, "WebRTC peer destroyed");
+IntercomComponent::PeerLeg *IntercomComponent::find_leg_(const std::string &remote_id) {
+  // Messages without a sender come from a two-party router: the single leg
+  if (remote_id.empty()) {
+    return legs_.size() == 1 ? legs_.front().get() : nullptr;
+  }
+  for (auto &leg : legs_) {
+    if (leg->remote_id == remote_id) {
+      return leg.get();
+    }
+  }
+  // A leg accepted manually before its peer was known adopts the first sender
+  if (legs_.size() == 1 && legs_.front()->remote_id.empty()) {
+    legs_.front()->remote_id = remote_id;
+    return legs_.front().get();
+  }
+  return nullptr;
+}
+
+size_t IntercomComponent::free_mixer_slot_() const {
+  for (size_t slot = AudioMixer::LOCAL_SLOT + 1; slot < AudioMixer::MAX_INPUTS; slot++) {
+    bool used = false;
+    for (auto &leg : legs_) {
+      used |= leg->mixer_slot == slot;
+    }
+    if (!used) {
+      return slot;
+    }
+  }
+  return AudioMixer::MAX_INPUTS;  // Out of range: the mixer ignores it
+}
+
+void IntercomComponent::update_in_call_() {
+  bool any_connected = false;
+  for (auto &leg : legs_) {
+    any_connected |= leg->connected;
+  }
+  in_call_ = any_connected;
+  if (in_call_) {
+    set_call_phase_(CallPhase::CONNECTED);
+  }
+  update_call_state_();
+}
+
+void IntercomComponent::update_power_save_() {
+  // Polled from loop(), which sees every way a call starts and ends
+  bool off = power_save_off_in_call_ && in_call_;
+  if (off == power_save_in_call_) {
+    return;
+  }
+  power_save_in_call_ = off;
+  if (off) {
+    if (esp_wifi_get_ps(&saved_power_save_) != ESP_OK || esp_wifi_set_ps(WIFI_PS_NONE) != ESP_OK) {
+      ESP_LOGW(TAG, "Could not turn Wi-Fi power save off for the call");
+      return;
+    }
+    power_save_held_ = true;
+    ESP_LOGD(TAG, "Wi-Fi power save off for the call (was %d)", (int) saved_power_save_);
+  } else if (power_save_held_) {
+    power_save_held_ = false;
+    if (esp_wifi_set_ps(saved_power_save_) != ESP_OK) {
+      ESP_LOGW(TAG, "Could not restore Wi-Fi power save");
+    }
+  }
+}
+
+void IntercomComponent::set_call_phase_(CallPhase phase) {
+  if (!AllocTracer::enabled() || AllocTracer::phase() == phase) {
+    return;
+  }
+  ESP_LOGD(TAG, "Allocation phase: %s -> %s", AllocTracer::phase_name(AllocTracer::phase()),
+           AllocTracer::phase_name(phase));
+  AllocTracer::set_phase(phase);
+  if (phase == CallPhase::IDLE) {
+    publish_alloc_stats_();
+  }
+}
+
+void IntercomComponent::publish_alloc_stats_() {
+  PhaseAllocStats stats[AllocTracer::PHASE_COUNT];
+  AllocTracer::take(stats);
+  std::string summary = AllocTracer::summary(stats);
+  
+  // Once connected, the audio path runs on pools and preallocated buffers;
+  // any allocation from an audio task is a regression
+  const PhaseAllocStats &connected = stats[static_cast<size_t>(CallPhase::CONNECTED)];
+  if (connected.audio_allocs > 0) {
+    ESP_LOGW(TAG, "Audio tasks allocated %u times while connected", (unsigned) connected.audio_allocs);
+  }
+  ESP_LOGI(TAG, "Call allocations: %s", summary.c_str());
+  
+  if (connected_allocations_sensor_ != nullptr) {
+    connected_allocations_sensor_->publish_state(connected.audio_allocs);
+  }
+  if (alloc_summary_text_sensor_ != nullptr) {
+    alloc_summary_text_sensor_->publish_state(summary);
+  }
+}
+
+void IntercomComponent::prepare_next_call_() {
+  // Cheap when the certificate is already loaded; regenerates it here, while
+  // idle, once the rotation period has passed
+  dtls_cert_.load_or_generate(dtls_cert_rotation_s_);
+  
+  if (prewarm_peer_) {
+    for (int i = 0; i < 2; i++) {
+      if (!standby_legs_[i]) {
+        std::unique_ptr<PeerLeg> leg(new PeerLeg());
+        leg->parent = this;
+        if (create_webrtc_peer_(i == 1, leg.get()) == ESP_OK) {
+          standby_legs_[i] = std::move(leg);
+        }
+      }
+    }
+  }
+  
+  refresh_ice_credentials_();
+}
+
+void IntercomComponent::refresh_ice_credentials_() {
+  // RFC 8445 ice-chars; ufrag needs >= 4 and pwd >= 22 characters
+  static const char ICE_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  
+  next_ice_ufrag_.resize(8);
+  next_ice_pwd_.resize(24);
+  for (auto &c : next_ice_ufrag_) {
+    c = ICE_CHARS[random_uint32() % (sizeof(ICE_CHARS) - 1)];
+  }
+  for (auto &c : next_ice_pwd_) {
+    c = ICE_CHARS[random_uint32() % (sizeof(ICE_CHARS) - 1)];
   }
 }
 
-esp_err_t IntercomComponent::create_offer() {
-  if (webrtc_peer_ == nullptr) {
+void IntercomComponent::deinit_webrtc_peer(PeerLeg *leg) {
+  for (auto it = legs_.begin(); it != legs_.end(); ++it) {
+    if (it->get() != leg) {
+      continue;
+    }
+    reset_ice_state_(leg);
+    mixer_.release(leg->mixer_slot);
+    if (leg->peer != nullptr) {
+      esp_peer_destroy(leg->peer);
+      ESP_LOGI(TAG, "WebRTC peer for %s destroyed", leg->remote_id.c_str());
+    }
+    {
+      // No callbacks after esp_peer_destroy(); drop what is still queued
+      std::lock_guard<std::mutex> guard(signaling_lock_);
+      for (auto ev = peer_events_.begin(); ev != peer_events_.end();) {
+        ev = ev->leg == leg ? peer_events_.erase(ev) : ev + 1;
+      }
+    }
+    legs_.erase(it);
+    
+    // A used peer carries DTLS/ICE state and cannot be recycled; build a
+    // fresh standby once the call has been torn down and the CPU is idle
+    this->set_timeout("prepare_next_call", 500, [this]() { this->prepare_next_call_(); });
+    return;
+  }
+}
+
+void IntercomComponent::deinit_webrtc_peers() {
+  while (!legs_.empty()) {
+    deinit_webrtc_peer(legs_.back().get());
+  }
+  mixer_.reset();
+}
+
+esp_err_t IntercomComponent::create_offer(PeerLeg *leg) {
+  if (leg == nullptr || leg->peer == nullptr) {
     ESP_LOGE(TAG, "WebRTC peer not initialized");
     return ESP_ERR_INVALID_STATE;
   }
   
   char *offer_sdp = nullptr;
-  esp_err_t ret = esp_peer_create_offer(webrtc_peer_, &offer_sdp);
+  leg->ice_start_ms = millis();
+  esp_err_t ret = esp_peer_create_offer(leg->peer, &offer_sdp);
   if (ret != ESP_OK) {
     ESP_LOGE(TAG, "Failed to create offer: %s", esp_err_to_name(ret));
     return ret;
   }
   
   if (offer_sdp) {
-    send_offer_message_(offer_sdp);
+    send_offer_message_(offer_sdp, leg->remote_id);
     free(offer_sdp);
-    ESP_LOGI(TAG, "Created and sent WebRTC offer");
+    ESP_LOGI(TAG, "Created and sent WebRTC offer to %s", leg->remote_id.c_str());
   }
   
   return ESP_OK;
 }
 
-esp_err_t IntercomComponent::create_answer() {
-  if (webrtc_peer_ == nullptr) {
+esp_err_t IntercomComponent::create_answer(PeerLeg *leg) {
+  if (leg == nullptr || leg->peer == nullptr) {
     ESP_LOGE(TAG, "WebRTC peer not initialized");
     return ESP_ERR_INVALID_STATE;
   }
   
   char *answer_sdp = nullptr;
-  esp_err_t ret = esp_peer_create_answer(webrtc_peer_, &answer_sdp);
+  leg->ice_start_ms = millis();
+  esp_err_t ret = esp_peer_create_answer(leg->peer, &answer_sdp);
   if (ret != ESP_OK) {
     ESP_LOGE(TAG, "Failed to create answer: %s", esp_err_to_name(ret));
     return ret;
   }
   
   if (answer_sdp) {
-    send_answer_message_(answer_sdp);
+    send_answer_message_(answer_sdp, leg->remote_id);
     free(answer_sdp);
-    ESP_LOGI(TAG, "Created and sent WebRTC answer");
+    ESP_LOGI(TAG, "Created and sent WebRTC answer to %s", leg->remote_id.c_str());
   }
   
   return ESP_OK;
 }
 
-esp_err_t IntercomComponent::set_remote_description(const std::string &sdp, bool is_offer) {
-  if (webrtc_peer_ == nullptr) {
+esp_err_t IntercomComponent::set_remote_description(PeerLeg *leg, const std::string &sdp, bool is_offer) {
+  if (leg == nullptr || leg->peer == nullptr) {
     ESP_LOGE(TAG, "WebRTC peer not initialized");
     return ESP_ERR_INVALID_STATE;
   }
   
-  esp_err_t ret = esp_peer_set_remote_description(webrtc_peer_, sdp.c_str(), is_offer);
+  esp_err_t ret = esp_peer_set_remote_description(leg->peer, sdp.c_str(), is_offer);
   if (ret != ESP_OK) {
     ESP_LOGE(TAG, "Failed to set remote description: %s", esp_err_to_name(ret));
     return ret;
@@ -842,40 +1347,113 @@ esp_err_t IntercomComponent::set_remote_description(const std::string &sdp, bool
   
   ESP_LOGI(TAG, "Set remote description (is_offer=%d)", is_offer);
   
-  // If we received an offer, create answer
-  if (is_offer && is_offerer_ == false) {
-    this->set_timeout(100, [this]() {
-      this->create_answer();
-    });
+  // If we received an offer, answer right away - the remote description is
+  // already applied, so there is nothing to wait for
+  if (is_offer && leg->is_offerer == false) {
+    return create_answer(leg);
   }
   
   return ESP_OK;
 }
 
-esp_err_t IntercomComponent::add_ice_candidate(const std::string &candidate) {
-  if (webrtc_peer_ == nullptr) {
+esp_err_t IntercomComponent::add_ice_candidate(PeerLeg *leg, const std::string &candidate) {
+  if (leg == nullptr || leg->peer == nullptr) {
     ESP_LOGE(TAG, "WebRTC peer not initialized");
     return ESP_ERR_INVALID_STATE;
   }
   
-  esp_err_t ret = esp_peer_add_ice_candidate(webrtc_peer_, candidate.c_str());
+  // Give host pairs a head start: on a LAN they connect on the first pair
+  // checked, and srflx/relay pairs only matter if they fail
+  std::string type = candidate_type(candidate);
+  if (type != "host" && !leg->connected && ice_host_grace_ms_ > 0 && !leg->ice_host_grace_expired) {
+    leg->deferred_candidates.push_back(candidate);
+    if (!leg->ice_host_grace_started) {
+      leg->ice_host_grace_started = true;
+      this->set_timeout("ice_host_grace_" + to_string(leg->mixer_slot), ice_host_grace_ms_,
+                        [this, leg]() { this->flush_deferred_candidates_(leg); });
+    }
+    ESP_LOGD(TAG, "Deferred %s ICE candidate", type.c_str());
+    return ESP_OK;
+  }
+  
+  esp_err_t ret = esp_peer_add_ice_candidate(leg->peer, candidate.c_str());
   if (ret != ESP_OK) {
     ESP_LOGE(TAG, "Failed to add ICE candidate: %s", esp_err_to_name(ret));
     return ret;
   }
   
-  ESP_LOGD(TAG, "Added ICE candidate");
+  ESP_LOGD(TAG, "Added %s ICE candidate", type.c_str());
   return ESP_OK;
 }
 
-void IntercomComponent::on_ice_candidate(const char *candidate) {
-  if (candidate) {
+void IntercomComponent::flush_deferred_candidates_(PeerLeg *leg) {
+  // Grace period is over: from now on every candidate is applied immediately
+  leg->ice_host_grace_expired = true;
+  std::vector<std::string> pending;
+  pending.swap(leg->deferred_candidates);
+  if (leg->peer == nullptr || leg->connected) {
+    return;
+  }
+  
+  for (auto &candidate : pending) {
+    if (esp_peer_add_ice_candidate(leg->peer, candidate.c_str()) != ESP_OK) {
+      ESP_LOGW(TAG, "Failed to add deferred ICE candidate");
+    }
+  }
+  ESP_LOGD(TAG, "Applied %u deferred ICE candidates", (unsigned) pending.size());
+}
+
+void IntercomComponent::reset_ice_state_(PeerLeg *leg) {
+  // The timeout captures the leg, so it must not outlive it
+  this->cancel_timeout("ice_host_grace_" + to_string(leg->mixer_slot));
+  leg->deferred_candidates.clear();
+  leg->ice_host_grace_started = false;
+  leg->ice_host_grace_expired = false;
+  leg->ice_start_ms = 0;
+}
+
+void IntercomComponent::on_ice_candidate(PeerLeg *leg, const char *candidate) {
+  if (candidate && candidate[0] != '\0') {
     ESP_LOGD(TAG, "Generated ICE candidate: %s", candidate);
-    send_candidate_message_(candidate);
+    send_candidate_message_(candidate, leg->remote_id);
+    return;
+  }
+  
+  // A null/empty candidate marks the end of gathering
+  if (leg->ice_start_ms != 0) {
+    uint32_t elapsed = millis() - leg->ice_start_ms;
+    ESP_LOGI(TAG, "ICE gathering completed in %u ms", (unsigned) elapsed);
+    if (ice_gathering_time_sensor_) {
+      ice_gathering_time_sensor_->publish_state(elapsed);
+    }
   }
 }
 
-void IntercomComponent::on_peer_connection_state(esp_peer_connection_state_t state) {
+void IntercomComponent::publish_ice_connected_(PeerLeg *leg) {
+  if (leg->ice_start_ms != 0) {
+    uint32_t elapsed = millis() - leg->ice_start_ms;
+    ESP_LOGI(TAG, "ICE connected %u ms after start", (unsigned) elapsed);
+    if (ice_connect_time_sensor_) {
+      ice_connect_time_sensor_->publish_state(elapsed);
+    }
+  }
+  
+  // Remaining srflx/relay candidates are no longer needed
+  this->cancel_timeout("ice_host_grace_" + to_string(leg->mixer_slot));
+  leg->deferred_candidates.clear();
+  
+  char local[128];
+  char remote[128];
+  if (esp_peer_get_selected_candidate_pair(leg->peer, local, sizeof(local), remote, sizeof(remote)) == ESP_OK) {
+    std::string pair_type = candidate_type(local) + "/" + candidate_type(remote);
+    ESP_LOGI(TAG, "Selected candidate pair: %s", pair_type.c_str());
+    if (ice_candidate_type_text_sensor_) {
+      ice_candidate_type_text_sensor_->publish_state(pair_type);
+    }
+  }
+}
+
+void IntercomComponent::on_peer_connection_state(PeerLeg *leg, esp_peer_connection_state_t state) {
   switch (state) {
     case ESP_PEER_CONNECTION_STATE_NEW:
       ESP_LOGI(TAG, "WebRTC: Connection state: NEW");
@@ -884,68 +1462,119 @@ void IntercomComponent::on_peer_connection_state(esp_peer_connection_state_t sta
       ESP_LOGI(TAG, "WebRTC: Connection state: CONNECTING");
       break;
     case ESP_PEER_CONNECTION_STATE_CONNECTED:
-      ESP_LOGI(TAG, "WebRTC: Connection state: CONNECTED");
-      in_call_ = true;
-      update_call_state_();
+      ESP_LOGI(TAG, "WebRTC: Connection state: CONNECTED (%s)", leg->remote_id.c_str());
+      leg->connected = true;
+      publish_ice_connected_(leg);
+      publish_call_setup_time_();
+      update_in_call_();
       break;
     case ESP_PEER_CONNECTION_STATE_DISCONNECTED:
-      ESP_LOGI(TAG, "WebRTC: Connection state: DISCONNECTED");
-      in_call_ = false;
-      update_call_state_();
+      ESP_LOGI(TAG, "WebRTC: Connection state: DISCONNECTED (%s)", leg->remote_id.c_str());
+      leg->connected = false;
+      mixer_.clear(leg->mixer_slot);
+      update_in_call_();
       break;
     case ESP_PEER_CONNECTION_STATE_FAILED:
-      ESP_LOGE(TAG, "WebRTC: Connection state: FAILED");
-      in_call_ = false;
-      update_call_state_();
+      ESP_LOGE(TAG, "WebRTC: Connection state: FAILED (%s)", leg->remote_id.c_str());
+      leg->connected = false;
+      mixer_.clear(leg->mixer_slot);
+      update_in_call_();
       break;
     case ESP_PEER_CONNECTION_STATE_CLOSED:
-      ESP_LOGI(TAG, "WebRTC: Connection state: CLOSED");
-      in_call_ = false;
-      update_call_state_();
+      ESP_LOGI(TAG, "WebRTC: Connection state: CLOSED (%s)", leg->remote_id.c_str());
+      leg->connected = false;
+      mixer_.clear(leg->mixer_slot);
+      update_in_call_();
       break;
     default:
       break;
   }
 }
 
-// Static callbacks
+void IntercomComponent::queue_peer_event_(PeerEvent event) {
+  std::lock_guard<std::mutex> guard(signaling_lock_);
+  peer_events_.push_back(std::move(event));
+}
+
+void IntercomComponent::process_peer_events_() {
+  while (true) {
+    PeerEvent event;
+    {
+      std::lock_guard<std::mutex> guard(signaling_lock_);
+      if (peer_events_.empty()) {
+        return;
+      }
+      event = std::move(peer_events_.front());
+      peer_events_.pop_front();
+    }
+    
+    // Standby peers are not in legs_ and have nothing to report yet
+    bool live = false;
+    for (auto &leg : legs_) {
+      live |= leg.get() == event.leg;
+    }
+    if (!live) {
+      continue;
+    }
+    if (event.is_candidate) {
+      on_ice_candidate(event.leg, event.candidate.c_str());
+    } else {
+      on_peer_connection_state(event.leg, event.state);
+    }
+  }
+}
+
+// Static callbacks, on the esp_peer task
 void IntercomComponent::ice_candidate_cb(void *ctx, const char *candidate) {
-  IntercomComponent *instance = static_cast<IntercomComponent *>(ctx);
-  if (instance) {
-    instance->on_ice_candidate(candidate);
+  PeerLeg *leg = static_cast<PeerLeg *>(ctx);
+  if (leg && leg->parent) {
+    leg->parent->queue_peer_event_({leg, true, ESP_PEER_CONNECTION_STATE_NEW, candidate ? candidate : ""});
   }
 }
 
 void IntercomComponent::peer_connection_state_cb(void *ctx, esp_peer_connection_state_t state) {
-  IntercomComponent *instance = static_cast<IntercomComponent *>(ctx);
-  if (instance) {
-    instance->on_peer_connection_state(state);
+  PeerLeg *leg = static_cast<PeerLeg *>(ctx);
+  if (leg && leg->parent) {
+    leg->parent->queue_peer_event_({leg, false, state, std::string()});
   }
 }
 
 int IntercomComponent::audio_capture_cb(void *ctx, void *buffer, int len) {
-  // TODO: Capture audio from I2S and fill buffer
-  // This should be connected to ESPHome's audio pipeline
-  IntercomComponent *instance = static_cast<IntercomComponent *>(ctx);
-  if (instance && !instance->muted_) {
-    // Capture audio and copy to buffer
-    // For now, return 0 (no audio)
+  // Encoder feed for this leg: everyone else in the call, minus its own voice
+  PeerLeg *leg = static_cast<PeerLeg *>(ctx);
+  if (leg == nullptr || leg->parent == nullptr || len <= 0) {
+    return 0;
   }
-  return 0;
+  AllocTracer::watch_current_task();
+  size_t samples = leg->parent->mixer_.read(leg->mixer_slot, static_cast<int16_t *>(buffer),
+                                            (size_t) len / sizeof(int16_t));
+  return (int) (samples * sizeof(int16_t));
 }
 
 int IntercomComponent::audio_render_cb(void *ctx, void *buffer, int len) {
-  // TODO: Render audio from buffer to I2S/speaker
-  // This should be connected to ESPHome's audio pipeline
-  IntercomComponent *instance = static_cast<IntercomComponent *>(ctx);
-  if (instance) {
-    // Render audio from buffer
-    // For now, just zero the buffer
-    memset(buffer, 0, len);
+  // Decoded audio from this leg goes into its mixer slot; the speaker plays
+  // the mix through read_speaker()
+  PeerLeg *leg = static_cast<PeerLeg *>(ctx);
+  AllocTracer::watch_current_task();
+  if (leg && leg->parent && len > 0) {
+    leg->parent->mixer_.write(leg->mixer_slot, static_cast<const int16_t *>(buffer),
+                              (size_t) len / sizeof(int16_t));
   }
   return len;
 }
 
+void IntercomComponent::write_microphone(const int16_t *samples, size_t count) {
+  if (muted_) {
+    mixer_.clear(AudioMixer::LOCAL_SLOT);
+    return;
+  }
+  mixer_.write(AudioMixer::LOCAL_SLOT, samples, count);
+}
+
+size_t IntercomComponent::read_speaker(int16_t *samples, size_t count) {
+  return mixer_.read(AudioMixer::LOCAL_SLOT, samples, count);
+}
+
 #endif  // USE_ESP_IDF
 
 }  // namespace intercom
@@ -13,12 +13,20 @@
 #include "cJSON.h"
 #include "esp_peer.h"
 #include "esp_webrtc.h"
+#include "esp_wifi.h"
+#include "dtls_certificate.h"
+#include "audio_mixer.h"
+#include "alloc_tracer.h"
 #else
 #include <WebSocketsClient.h>
 #include <ArduinoJson.h>
 #endif
 
 #include <driver/i2s.h>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace esphome {
 namespace intercom {
@@ -44,16 +52,31 @@ class IntercomComponent : public Component {
   void set_end_call_switch(switch_::Switch *sw) { end_call_switch_ = sw; }
   void set_accept_call_switch(switch_::Switch *sw) { accept_call_switch_ = sw; }
   void set_mute_switch(switch_::Switch *sw) { mute_switch_ = sw; }
+  void set_call_setup_time_sensor(sensor::Sensor *sensor) { call_setup_time_sensor_ = sensor; }
+  void set_ice_gathering_time_sensor(sensor::Sensor *sensor) { ice_gathering_time_sensor_ = sensor; }
+  void set_ice_connect_time_sensor(sensor::Sensor *sensor) { ice_connect_time_sensor_ = sensor; }
+  void set_ice_candidate_type_text_sensor(text_sensor::TextSensor *sensor) { ice_candidate_type_text_sensor_ = sensor; }
+  void set_alloc_summary_text_sensor(text_sensor::TextSensor *sensor) { alloc_summary_text_sensor_ = sensor; }
+  void set_connected_allocations_sensor(sensor::Sensor *sensor) { connected_allocations_sensor_ = sensor; }
   
   // Actions
   void start_call(const std::string &target_device_id);
   void end_call();
   void accept_call();
   void toggle_mute();
+  void invite(const std::string &target_device_id);
   
   // Configuration
   void set_auto_accept(bool auto_accept) { auto_accept_ = auto_accept; }
   void set_auto_connect(bool auto_connect) { auto_connect_ = auto_connect; }
+  void set_prewarm_peer(bool prewarm_peer) { prewarm_peer_ = prewarm_peer; }
+  void set_dtls_cert_rotation(uint32_t seconds) { dtls_cert_rotation_s_ = seconds; }
+  void add_ice_server(const std::string &url, const std::string &username, const std::string &password) {
+    ice_servers_.push_back({url, username, password});
+  }
+  void set_ice_host_grace(uint32_t ms) { ice_host_grace_ms_ = ms; }
+  void set_max_peers(uint8_t max_peers) { max_peers_ = max_peers; }
+  void set_power_save_off_in_call(bool off) { power_save_off_in_call_ = off; }
   
   // State
   bool is_in_call() const { return in_call_; }
@@ -61,6 +84,12 @@ class IntercomComponent : public Component {
   bool is_connected() const { return connected_; }
   std::string get_client_id() const { return client_id_; }
   std::string get_current_target() const { return target_device_id_; }
+  
+#ifdef USE_ESP_IDF
+  // Glue for the local audio path: microphone frames in, speaker mix out
+  void write_microphone(const int16_t *samples, size_t count);
+  size_t read_speaker(int16_t *samples, size_t count);
+#endif
 
  protected:
   // Signaling
@@ -76,6 +105,21 @@ class IntercomComponent : public Component {
   bool auto_accept_ = true;      // Automatically accept incoming calls
   bool auto_connect_ = true;     // Automatically send offer when ready
   bool waiting_for_ready_ = false; // Waiting for ready to send offer
+  bool prewarm_peer_ = true;     // Keep a standby WebRTC peer ready between calls
+  uint32_t call_setup_start_ms_ = 0;  // When the current call setup began (0 = not measuring)
+  uint32_t dtls_cert_rotation_s_ = 30 * 24 * 60 * 60;  // Regenerate the DTLS certificate after this age
+  bool power_save_off_in_call_ = true;  // Turn Wi-Fi power save off during calls (ESP-IDF only)
+  
+  // STUN/TURN servers; host candidates get a head start of ice_host_grace_ms_
+  // before remote srflx/relay candidates are applied
+  struct IceServer {
+    std::string url;
+    std::string username;
+    std::string password;
+  };
+  std::vector<IceServer> ice_servers_;
+  uint32_t ice_host_grace_ms_ = 200;
+  uint8_t max_peers_ = 1;  // Remote legs this device bridges at once (>1 makes it a conference hub)
   
   // Device identification
   std::string client_id_;
@@ -85,8 +129,75 @@ class IntercomComponent : public Component {
   
 #ifdef USE_ESP_IDF
   esp_websocket_client_handle_t websocket_client_ = nullptr;
-  esp_peer_handle_t webrtc_peer_ = nullptr;  // WebRTC peer connection
-  bool is_offerer_ = false;  // true when initiating call, false when receiving
+  // One WebRTC peer connection per remote participant
+  struct PeerLeg {
+    IntercomComponent *parent = nullptr;
+    esp_peer_handle_t peer = nullptr;
+    std::string remote_id;   // clientId of the far end
+    bool is_offerer = false; // true when initiating call, false when receiving
+    bool connected = false;
+    size_t mixer_slot = 0;
+    // Remote srflx/relay candidates held back while host pairs get a head start
+    std::vector<std::string> deferred_candidates;
+    bool ice_host_grace_started = false;
+    bool ice_host_grace_expired = false;
+    uint32_t ice_start_ms = 0;  // When local description was created (ICE start)
+    // esp_peer keeps pointers into its config rather than copies, so each
+    // leg owns what it was created with for as long as its peer lives:
+    // later legs get new ICE credentials, and certificate rotation rewrites
+    // dtls_cert_ under standby peers
+    std::string ice_ufrag;
+    std::string ice_pwd;
+    std::string dtls_cert_pem;
+    std::string dtls_key_pem;
+    std::vector<esp_peer_ice_server_cfg_t> ice_servers;
+  };
+  std::vector<std::unique_ptr<PeerLeg>> legs_;
+  // Standby peers created ahead of time, indexed by is_offerer, so a call
+  // never waits for peer allocation and DTLS key generation
+  std::unique_ptr<PeerLeg> standby_legs_[2];
+  AudioMixer mixer_;
+  // Certificate shared by every peer, and ICE credentials for the next one
+  DtlsCertificate dtls_cert_;
+  std::string next_ice_ufrag_;
+  std::string next_ice_pwd_;
+  // Wi-Fi power save is off (WIFI_PS_NONE) while in a call, so packets for
+  // us are not held at the access point until the next DTIM beacon; the
+  // mode from before comes back afterwards
+  bool power_save_in_call_ = false;  // update_power_save_() has acted on this call
+  bool power_save_held_ = false;     // saved_power_save_ is to be restored
+  wifi_ps_type_t saved_power_save_ = WIFI_PS_MIN_MODEM;
+  
+  // WebSocket events arrive on the client's own task. They are queued and
+  // handled in loop(), so call state, the legs, the standby peers and the
+  // next ICE credentials are only ever touched from the main loop. Handled
+  // message strings go back to spare_messages_ to keep their capacity.
+  enum class SignalingEvent : uint8_t { CONNECTED, DISCONNECTED, MESSAGE };
+  struct PendingSignaling {
+    SignalingEvent event;
+    std::string message;
+  };
+  static constexpr size_t MAX_SPARE_MESSAGES = 4;
+  std::mutex signaling_lock_;
+  std::deque<PendingSignaling> signaling_queue_;
+  std::vector<std::string> spare_messages_;
+  void queue_signaling_(SignalingEvent event);
+  void process_signaling_queue_();
+  
+  // esp_peer reports connection state and local candidates from its own
+  // task. They are queued the same way (under signaling_lock_), so legs_
+  // is only read and changed in loop(); a leg's pending events are dropped
+  // when it is destroyed. The audio callbacks touch only their own leg and
+  // the mixer, which has its own lock.
+  struct PeerEvent {
+    PeerLeg *leg;
+    bool is_candidate;
+    esp_peer_connection_state_t state;
+    std::string candidate;
+  };
+  std::deque<PeerEvent> peer_events_;
+  void queue_peer_event_(PeerEvent event);
+  void process_peer_events_();
   
   void websocket_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
   void connect_websocket();
@@ -94,14 +205,28 @@ class IntercomComponent : public Component {
   esp_err_t send_websocket_message(const std::string &message);
   
   // WebRTC methods
-  esp_err_t init_webrtc_peer(bool is_offerer);
-  void deinit_webrtc_peer();
-  esp_err_t create_offer();
-  esp_err_t create_answer();
-  esp_err_t set_remote_description(const std::string &sdp, bool is_offer);
-  esp_err_t add_ice_candidate(const std::string &candidate);
-  void on_ice_candidate(const char *candidate);
-  void on_peer_connection_state(esp_peer_connection_state_t state);
+  PeerLeg *init_webrtc_peer(bool is_offerer, const std::string &remote_id);
+  void deinit_webrtc_peer(PeerLeg *leg);
+  void deinit_webrtc_peers();
+  esp_err_t create_webrtc_peer_(bool is_offerer, PeerLeg *leg);
+  PeerLeg *find_leg_(const std::string &remote_id);
+  size_t free_mixer_slot_() const;
+  void update_in_call_();
+  void update_power_save_();
+  // Allocation tracing; no-ops unless built with alloc_trace: true
+  void set_call_phase_(CallPhase phase);
+  void publish_alloc_stats_();
+  void prepare_next_call_();
+  void refresh_ice_credentials_();
+  void flush_deferred_candidates_(PeerLeg *leg);
+  void reset_ice_state_(PeerLeg *leg);
+  void publish_ice_connected_(PeerLeg *leg);
+  esp_err_t create_offer(PeerLeg *leg);
+  esp_err_t create_answer(PeerLeg *leg);
+  esp_err_t set_remote_description(PeerLeg *leg, const std::string &sdp, bool is_offer);
+  esp_err_t add_ice_candidate(PeerLeg *leg, const std::string &candidate);
+  void on_ice_candidate(PeerLeg *leg, const char *candidate);
+  void on_peer_connection_state(PeerLeg *leg, esp_peer_connection_state_t state);
   
   // Audio callbacks for WebRTC
   static int audio_capture_cb(void *ctx, void *buffer, int len);
@@ -114,20 +239,28 @@ class IntercomComponent : public Component {
   static IntercomComponent *instance_;
 #endif
   
+  // Incoming signaling text, reassembled from WebSocket chunks. Reused for
+  // every message so its capacity, reserved at setup, is allocated once.
+  static constexpr size_t RX_MESSAGE_RESERVE = 4096;
+  std::string rx_message_;
+
   // Signaling methods
   void generate_client_id_();
   void generate_session_id_();
   void handle_signaling_message_(const std::string &message);
   void send_join_message_();
   void send_ready_message_();
-  void send_offer_message_(const std::string &sdp);
-  void send_answer_message_(const std::string &sdp);
+  // "to" names the receiving clientId; empty relays to the whole room
+  void send_offer_message_(const std::string &sdp, const std::string &to = "");
+  void send_answer_message_(const std::string &sdp, const std::string &to = "");
   void send_leave_message_();
-  void send_candidate_message_(const std::string &candidate);
+  void send_candidate_message_(const std::string &candidate, const std::string &to = "");
+  void send_invite_message_(const std::string &to);
   
   // State update
   void update_call_state_();
   void update_status_text_();
+  void publish_call_setup_time_();
   
   // Methods
   void send_offer_for_call_();
@@ -140,6 +273,12 @@ class IntercomComponent : public Component {
   switch_::Switch *end_call_switch_{nullptr};
   switch_::Switch *accept_call_switch_{nullptr};
   switch_::Switch *mute_switch_{nullptr};
+  sensor::Sensor *call_setup_time_sensor_{nullptr};
+  sensor::Sensor *ice_gathering_time_sensor_{nullptr};
+  sensor::Sensor *ice_connect_time_sensor_{nullptr};
+  text_sensor::TextSensor *ice_candidate_type_text_sensor_{nullptr};
+  text_sensor::TextSensor *alloc_summary_text_sensor_{nullptr};
+  sensor::Sensor *connected_allocations_sensor_{nullptr};
 };
 
 }  // namespace intercom
@@ -0,0 +1,77 @@
+#include "hmac_sha1.h"
+
+#include <cstring>
+
+#include "mbedtls/version.h"
+
+// mbedtls 2.x spells the returning variants with _ret
+#if MBEDTLS_VERSION_NUMBER < 0x03000000
+#define sha1_starts mbedtls_sha1_starts_ret
+#define sha1_update mbedtls_sha1_update_ret
+#define sha1_finish mbedtls_sha1_finish_ret
+#else
+#define sha1_starts mbedtls_sha1_starts
+#define sha1_update mbedtls_sha1_update
+#define sha1_finish mbedtls_sha1_finish
+#endif
+
+namespace esphome {
+namespace intercom {
+
+static constexpr size_t SHA1_BLOCK = 64;
+
+HmacSha1::HmacSha1() {
+  mbedtls_sha1_init(&inner_key_);
+  mbedtls_sha1_init(&outer_key_);
+  mbedtls_sha1_init(&ctx_);
+}
+
+HmacSha1::~HmacSha1() {
+  mbedtls_sha1_free(&inner_key_);
+  mbedtls_sha1_free(&outer_key_);
+  mbedtls_sha1_free(&ctx_);
+}
+
+void HmacSha1::set_key(const uint8_t *key, size_t len) {
+  uint8_t block[SHA1_BLOCK] = {0};
+  if (len > SHA1_BLOCK) {
+    sha1_starts(&ctx_);
+    sha1_update(&ctx_, key, len);
+    sha1_finish(&ctx_, block);
+  } else {
+    memcpy(block, key, len);
+  }
+
+  for (uint8_t &b : block) {
+    b ^= 0x36;
+  }
+  sha1_starts(&inner_key_);
+  sha1_update(&inner_key_, block, sizeof(block));
+  for (uint8_t &b : block) {
+    b ^= 0x36 ^ 0x5C;
+  }
+  sha1_starts(&outer_key_);
+  sha1_update(&outer_key_, block, sizeof(block));
+  memset(block, 0, sizeof(block));
+}
+
+void HmacSha1::start() { mbedtls_sha1_clone(&ctx_, &inner_key_); }
+
+void HmacSha1::update(const uint8_t *data, size_t len) { sha1_update(&ctx_, data, len); }
+
+void HmacSha1::finish(uint8_t out[SIZE]) {
+  uint8_t inner[SIZE];
+  sha1_finish(&ctx_, inner);
+  mbedtls_sha1_clone(&ctx_, &outer_key_);
+  sha1_update(&ctx_, inner, sizeof(inner));
+  sha1_finish(&ctx_, out);
+}
+
+void HmacSha1::mac(const uint8_t *data, size_t len, uint8_t out[SIZE]) {
+  start();
+  update(data, len);
+  finish(out);
+}
+
+}  // namespace intercom
+}  // namespace esphome
@@ -0,0 +1,47 @@
+/*
+ * HMAC-SHA1
+ * RFC 2104 over mbedtls' SHA-1, for STUN message integrity (ice_lite.h).
+ *
+ * The key is padded and hashed once in set_key(); every message after that
+ * starts from a copy of those states, so a MAC costs two SHA-1 blocks fewer
+ * than mbedtls_md_hmac() and nothing is allocated.
+ *
+ * Only needs mbedtls, so the same code runs on the host.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "mbedtls/sha1.h"
+
+namespace esphome {
+namespace intercom {
+
+class HmacSha1 {
+ public:
+  static constexpr size_t SIZE = 20;
+
+  HmacSha1();
+  ~HmacSha1();
+  HmacSha1(const HmacSha1 &) = delete;
+  HmacSha1 &operator=(const HmacSha1 &) = delete;
+
+  void set_key(const uint8_t *key, size_t len);
+
+  void start();
+  void update(const uint8_t *data, size_t len);
+  void finish(uint8_t out[SIZE]);
+
+  // start(), update(), finish() in one
+  void mac(const uint8_t *data, size_t len, uint8_t out[SIZE]);
+
+ protected:
+  mbedtls_sha1_context inner_key_;  // SHA-1 state after key ^ ipad
+  mbedtls_sha1_context outer_key_;  // and after key ^ opad
+  mbedtls_sha1_context ctx_;
+};
+
+}  // namespace intercom
+}  // namespace esphome
@@ -0,0 +1,456 @@
+#include "ice_lite.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace intercom {
+
+static constexpr uint32_t STUN_MAGIC_COOKIE = 0x2112A442;
+static constexpr size_t STUN_HEADER = 20;
+
+static constexpr uint16_t STUN_BINDING_REQUEST = 0x0001;
+static constexpr uint16_t STUN_BINDING_SUCCESS = 0x0101;
+static constexpr uint16_t STUN_BINDING_ERROR = 0x0111;
+
+static constexpr uint16_t ATTR_USERNAME = 0x0006;
+static constexpr uint16_t ATTR_MESSAGE_INTEGRITY = 0x0008;
+static constexpr uint16_t ATTR_ERROR_CODE = 0x0009;
+static constexpr uint16_t ATTR_XOR_MAPPED_ADDRESS = 0x0020;
+static constexpr uint16_t ATTR_PRIORITY = 0x0024;
+static constexpr uint16_t ATTR_USE_CANDIDATE = 0x0025;
+static constexpr uint16_t ATTR_FINGERPRINT = 0x8028;
+static constexpr uint16_t ATTR_ICE_CONTROLLED = 0x8029;
+
+static constexpr uint32_t FINGERPRINT_XOR = 0x5354554E;
+
+// Peer-reflexive type preference 110, as in the PRIORITY of our checks
+static constexpr uint32_t PRFLX_PRIORITY = (110u << 24) | (65535u << 8) | 255u;
+
+// RFC 7675: a check every 5 s +-20%, consent lost after 30 s unanswered.
+// A full remote that has not nominated within the same time never will.
+static constexpr uint32_t CONSENT_INTERVAL_MS = 4000;
+static constexpr uint32_t CONSENT_JITTER_MS = 2000;
+static constexpr uint32_t CONSENT_TIMEOUT_MS = 30000;
+static constexpr uint32_t NOMINATION_TIMEOUT_MS = 30000;
+
+static uint16_t get16(const uint8_t *p) { return (uint16_t) ((p[0] << 8) | p[1]); }
+
+static uint32_t get32(const uint8_t *p) {
+  return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static void put16(uint8_t *p, uint16_t v) {
+  p[0] = v >> 8;
+  p[1] = v & 0xFF;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = (v >> 16) & 0xFF;
+  p[2] = (v >> 8) & 0xFF;
+  p[3] = v & 0xFF;
+}
+
+// CRC-32 (ISO 3309) a nibble at a time: a 64-byte table instead of 1 KB
+static uint32_t crc32(const uint8_t *data, size_t len) {
+  static const uint32_t TABLE[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+      0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+  };
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+    crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+  }
+  return crc ^ 0xFFFFFFFF;
+}
+
+bool stun_is_message(const uint8_t *data, size_t len) {
+  return len >= STUN_HEADER && data[0] < 4 && get32(data + 4) == STUN_MAGIC_COOKIE;
+}
+
+bool ice_parse_ipv4(const char *s, size_t len, uint32_t *ip) {
+  uint32_t value = 0;
+  uint32_t octet = 0;
+  size_t digits = 0;
+  size_t dots = 0;
+  for (size_t i = 0; i <= len; i++) {
+    if (i == len || s[i] == '.') {
+      if (digits == 0 || (i < len && ++dots > 3)) {
+        return false;
+      }
+      value = (value << 8) | octet;
+      octet = 0;
+      digits = 0;
+    } else if (s[i] >= '0' && s[i] <= '9' && digits < 3) {
+      octet = octet * 10 + (s[i] - '0');
+      digits++;
+      if (octet > 255) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  if (dots != 3) {
+    return false;
+  }
+  *ip = value;
+  return true;
+}
+
+namespace {
+
+// Builds a STUN message in place; any overflow sticks and finish() returns 0
+class StunWriter {
+ public:
+  StunWriter(uint8_t *buf, size_t cap, uint16_t type, const uint8_t *transaction_id) : buf_(buf), cap_(cap) {
+    if (cap_ < STUN_HEADER) {
+      ok_ = false;
+      return;
+    }
+    put16(buf_, type);
+    put16(buf_ + 2, 0);
+    put32(buf_ + 4, STUN_MAGIC_COOKIE);
+    memcpy(buf_ + 8, transaction_id, 12);
+    len_ = STUN_HEADER;
+  }
+
+  void attribute(uint16_t type, const void *value, size_t len) {
+    size_t padded = (len + 3) & ~(size_t) 3;
+    if (!ok_ || len_ + 4 + padded > cap_) {
+      ok_ = false;
+      return;
+    }
+    put16(buf_ + len_, type);
+    put16(buf_ + len_ + 2, (uint16_t) len);
+    memcpy(buf_ + len_ + 4, value, len);
+    memset(buf_ + len_ + 4 + len, 0, padded - len);
+    len_ += 4 + padded;
+  }
+
+  // MESSAGE-INTEGRITY over everything so far, with the length counting it
+  void integrity(HmacSha1 &key) {
+    if (!ok_ || len_ + 4 + HmacSha1::SIZE > cap_) {
+      ok_ = false;
+      return;
+    }
+    put16(buf_ + 2, (uint16_t) (len_ + 4 + HmacSha1::SIZE - STUN_HEADER));
+    uint8_t mac[HmacSha1::SIZE];
+    key.mac(buf_, len_, mac);
+    attribute(ATTR_MESSAGE_INTEGRITY, mac, sizeof(mac));
+  }
+
+  // FINGERPRINT, which is always last
+  size_t finish() {
+    if (!ok_ || len_ + 8 > cap_) {
+      return 0;
+    }
+    put16(buf_ + 2, (uint16_t) (len_ + 8 - STUN_HEADER));
+    uint8_t crc[4];
+    put32(crc, crc32(buf_, len_) ^ FINGERPRINT_XOR);
+    attribute(ATTR_FINGERPRINT, crc, sizeof(crc));
+    return ok_ ? len_ : 0;
+  }
+
+ protected:
+  uint8_t *buf_;
+  size_t cap_;
+  size_t len_{0};
+  bool ok_{true};
+};
+
+// MESSAGE-INTEGRITY at `offset` checked against `key`
+bool integrity_ok(const uint8_t *data, size_t offset, HmacSha1 &key) {
+  uint8_t header[STUN_HEADER];
+  memcpy(header, data, STUN_HEADER);
+  put16(header + 2, (uint16_t) (offset + 4 + HmacSha1::SIZE - STUN_HEADER));
+  uint8_t mac[HmacSha1::SIZE];
+  key.start();
+  key.update(header, sizeof(header));
+  key.update(data + STUN_HEADER, offset - STUN_HEADER);
+  key.finish(mac);
+  uint8_t diff = 0;
+  for (size_t i = 0; i < HmacSha1::SIZE; i++) {
+    diff |= mac[i] ^ data[offset + 4 + i];
+  }
+  return diff == 0;
+}
+
+}  // namespace
+
+void IceLite::begin(const uint8_t *random) {
+  // 6 bits of randomness per ice-char (RFC 8839): 48 bits of ufrag, 144 of
+  // password
+  static const char ICE_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  for (size_t i = 0; i < sizeof(local_ufrag_) - 1; i++) {
+    local_ufrag_[i] = ICE_CHARS[random[i] & 0x3F];
+  }
+  for (size_t i = 0; i < sizeof(local_pwd_) - 1; i++) {
+    local_pwd_[i] = ICE_CHARS[random[sizeof(local_ufrag_) - 1 + i] & 0x3F];
+  }
+  memcpy(tie_breaker_, random + RANDOM_BYTES - sizeof(tie_breaker_), sizeof(tie_breaker_));
+  local_key_.set_key((const uint8_t *) local_pwd_, strlen(local_pwd_));
+
+  remote_ufrag_[0] = '\0';
+  remote_ice_ = false;
+  remote_lite_ = false;
+  candidate_count_ = 0;
+  selected_ip_ = 0;
+  selected_port_ = 0;
+  selected_priority_ = 0;
+  set_state_(IceState::NEW);
+}
+
+void IceLite::set_remote(const SdpDescription &remote, uint32_t ip, uint16_t port, uint32_t now_ms) {
+  remote_ice_ = remote.ice_ufrag.len > 0 && remote.ice_pwd.len > 0 &&
+                remote.ice_ufrag.copy(remote_ufrag_, sizeof(remote_ufrag_));
+  remote_lite_ = remote.ice_lite;
+  if (remote_ice_) {
+    remote_key_.set_key((const uint8_t *) remote.ice_pwd.data, remote.ice_pwd.len);
+  }
+  for (size_t i = 0; i < remote.candidate_count; i++) {
+    add_remote_candidate(remote.candidates[i]);
+  }
+
+  if (state_ == IceState::CONNECTED) {
+    // A full remote can nominate before its answer gets here
+    return;
+  }
+  if (remote_ice_ && !remote_lite_) {
+    checking_since_ms_ = now_ms;
+    set_state_(IceState::CHECKING);
+  } else if (ip != 0 && port != 0) {
+    // Neither end will check, so the signaled address is the pair
+    Candidate *candidate = add_(ip, port, 0);
+    Candidate direct{ip, port, 0, true};
+    select_(candidate != nullptr ? *candidate : direct, now_ms);
+  } else {
+    set_state_(IceState::FAILED);
+  }
+}
+
+bool IceLite::add_remote_candidate(const SdpCandidate &candidate) {
+  uint32_t ip;
+  if (candidate.component != 1 || candidate.port == 0 ||
+      !ice_parse_ipv4(candidate.address.data, candidate.address.len, &ip)) {
+    return false;
+  }
+  return add_(ip, candidate.port, candidate.priority) != nullptr;
+}
+
+IceLite::Candidate *IceLite::find_(uint32_t ip, uint16_t port) {
+  for (size_t i = 0; i < candidate_count_; i++) {
+    if (candidates_[i].ip == ip && candidates_[i].port == port) {
+      return &candidates_[i];
+    }
+  }
+  return nullptr;
+}
+
+IceLite::Candidate *IceLite::add_(uint32_t ip, uint16_t port, uint32_t priority) {
+  Candidate *candidate = find_(ip, port);
+  if (candidate != nullptr) {
+    return candidate;
+  }
+  if (candidate_count_ >= MAX_CANDIDATES) {
+    return nullptr;
+  }
+  candidate = &candidates_[candidate_count_++];
+  *candidate = Candidate{ip, port, priority, false};
+  return candidate;
+}
+
+void IceLite::select_(const Candidate &candidate, uint32_t now_ms) {
+  bool changed = state_ != IceState::CONNECTED || candidate.ip != selected_ip_ || candidate.port != selected_port_;
+  selected_ip_ = candidate.ip;
+  selected_port_ = candidate.port;
+  selected_priority_ = candidate.priority;
+  if (changed) {
+    // Consent runs from the moment a pair is in use
+    consent_ms_ = now_ms;
+    next_check_ms_ = now_ms;
+    set_state_(IceState::CONNECTED);
+    generation_++;
+  }
+}
+
+void IceLite::set_state_(IceState state) {
+  if (state != state_) {
+    state_ = state;
+    generation_++;
+  }
+}
+
+bool IceLite::selected(uint32_t *ip, uint16_t *port) const {
+  if (state_ != IceState::CONNECTED) {
+    return false;
+  }
+  *ip = selected_ip_;
+  *port = selected_port_;
+  return true;
+}
+
+size_t IceLite::on_stun(const uint8_t *data, size_t len, uint32_t ip, uint16_t port, uint32_t now_ms, uint8_t *out,
+                        size_t cap) {
+  if (!stun_is_message(data, len) || get16(data + 2) != len - STUN_HEADER || (len & 3) != 0) {
+    return 0;
+  }
+
+  size_t username = 0, username_len = 0, integrity = 0, fingerprint = 0;
+  uint32_t priority = 0;
+  bool use_candidate = false;
+  size_t pos = STUN_HEADER;
+  while (pos + 4 <= len) {
+    uint16_t type = get16(data + pos);
+    size_t attr_len = get16(data + pos + 2);
+    size_t value = pos + 4;
+    if (value + attr_len > len) {
+      return 0;
+    }
+    if (type == ATTR_FINGERPRINT) {
+      fingerprint = pos;
+      break;
+    }
+    // Only FINGERPRINT may follow MESSAGE-INTEGRITY
+    if (integrity == 0) {
+      if (type == ATTR_USERNAME) {
+        username = value;
+        username_len = attr_len;
+      } else if (type == ATTR_MESSAGE_INTEGRITY && attr_len == HmacSha1::SIZE) {
+        integrity = pos;
+      } else if (type == ATTR_PRIORITY && attr_len == 4) {
+        priority = get32(data + value);
+      } else if (type == ATTR_USE_CANDIDATE) {
+        use_candidate = true;
+      }
+    }
+    pos = value + ((attr_len + 3) & ~(size_t) 3);
+  }
+  if (fingerprint != 0 && (fingerprint + 8 != len || get32(data + fingerprint + 4) !=
+                                                         (crc32(data, fingerprint) ^ FINGERPRINT_XOR))) {
+    return 0;
+  }
+
+  uint16_t type = get16(data);
+  if (type == STUN_BINDING_REQUEST) {
+    return on_request_(data, username, username_len, integrity, priority, use_candidate, ip, port, now_ms, out, cap);
+  }
+  if (type == STUN_BINDING_SUCCESS && remote_ice_ && integrity != 0 && state_ == IceState::CONNECTED &&
+      ip == selected_ip_ && port == selected_port_) {
+    for (const uint8_t *id : pending_) {
+      if (memcmp(id, data + 8, 12) == 0 && integrity_ok(data, integrity, remote_key_)) {
+        consent_ms_ = now_ms;
+        break;
+      }
+    }
+  }
+  return 0;
+}
+
+size_t IceLite::on_request_(const uint8_t *data, size_t username, size_t username_len, size_t integrity,
+                            uint32_t priority, bool use_candidate, uint32_t ip, uint16_t port, uint32_t now_ms,
+                            uint8_t *out, size_t cap) {
+  const uint8_t *transaction_id = data + 8;
+
+  // USERNAME is "<our ufrag>:<theirs>" and the message is signed with our
+  // password (RFC 8445 7.3). Theirs is not checked: checks can arrive
+  // before their description does.
+  size_t ufrag_len = strlen(local_ufrag_);
+  bool authorized = username != 0 && integrity != 0 && username_len > ufrag_len &&
+                    memcmp(data + username, local_ufrag_, ufrag_len) == 0 && data[username + ufrag_len] == ':' &&
+                    integrity_ok(data, integrity, local_key_);
+  if (!authorized) {
+    // 400 when something is missing, 401 when it is wrong (RFC 5389 10.1.2)
+    bool missing = username == 0 || integrity == 0;
+    StunWriter w(out, cap, STUN_BINDING_ERROR, transaction_id);
+    static const char BAD_REQUEST[] = "Bad Request";
+    static const char UNAUTHORIZED[] = "Unauthorized";
+    const char *reason = missing ? BAD_REQUEST : UNAUTHORIZED;
+    uint8_t error[4 + sizeof(UNAUTHORIZED)] = {0, 0, 4, (uint8_t) (missing ? 0 : 1)};
+    size_t reason_len = strlen(reason);
+    memcpy(error + 4, reason, reason_len);
+    w.attribute(ATTR_ERROR_CODE, error, 4 + reason_len);
+    return w.finish();
+  }
+
+  // A source that was never signaled is a peer-reflexive candidate
+  // (RFC 8445 7.3.1.3), ranked by the PRIORITY the remote gave it
+  Candidate *candidate = add_(ip, port, priority);
+  if (candidate != nullptr && use_candidate) {
+    candidate->nominated = true;
+    if (state_ != IceState::CONNECTED || candidate->priority >= selected_priority_ ||
+        (candidate->ip == selected_ip_ && candidate->port == selected_port_)) {
+      select_(*candidate, now_ms);
+    }
+  }
+
+  StunWriter w(out, cap, STUN_BINDING_SUCCESS, transaction_id);
+  uint8_t mapped[8] = {0, 0x01};
+  put16(mapped + 2, port ^ (STUN_MAGIC_COOKIE >> 16));
+  put32(mapped + 4, ip ^ STUN_MAGIC_COOKIE);
+  w.attribute(ATTR_XOR_MAPPED_ADDRESS, mapped, sizeof(mapped));
+  w.integrity(local_key_);
+  return w.finish();
+}
+
+size_t IceLite::poll(uint32_t now_ms, const uint8_t *transaction_id, uint8_t *out, size_t cap, uint32_t *ip,
+                     uint16_t *port) {
+  if (state_ == IceState::CHECKING && now_ms - checking_since_ms_ > NOMINATION_TIMEOUT_MS) {
+    set_state_(IceState::FAILED);
+    return 0;
+  }
+  if (state_ != IceState::CONNECTED || !remote_ice_) {
+    return 0;
+  }
+  if (now_ms - consent_ms_ > CONSENT_TIMEOUT_MS) {
+    set_state_(IceState::FAILED);
+    return 0;
+  }
+  if ((int32_t) (now_ms - next_check_ms_) < 0) {
+    return 0;
+  }
+
+  // A consent check is a connectivity check on the selected pair (RFC 7675 5.1)
+  StunWriter w(out, cap, STUN_BINDING_REQUEST, transaction_id);
+  char username[sizeof(remote_ufrag_) + sizeof(local_ufrag_)];
+  size_t remote_len = strlen(remote_ufrag_);
+  memcpy(username, remote_ufrag_, remote_len);
+  username[remote_len] = ':';
+  memcpy(username + remote_len + 1, local_ufrag_, strlen(local_ufrag_));
+  w.attribute(ATTR_USERNAME, username, remote_len + 1 + strlen(local_ufrag_));
+  w.attribute(ATTR_ICE_CONTROLLED, tie_breaker_, sizeof(tie_breaker_));
+  uint8_t priority[4];
+  put32(priority, PRFLX_PRIORITY);
+  w.attribute(ATTR_PRIORITY, priority, sizeof(priority));
+  w.integrity(remote_key_);
+  size_t n = w.finish();
+  if (n == 0) {
+    return 0;
+  }
+
+  memcpy(pending_[pending_next_], transaction_id, 12);
+  pending_next_ = (pending_next_ + 1) % PENDING;
+  next_check_ms_ = now_ms + CONSENT_INTERVAL_MS + transaction_id[0] * CONSENT_JITTER_MS / 255;
+  *ip = selected_ip_;
+  *port = selected_port_;
+  return n;
+}
+
+const char *IceLite::state_name(IceState state) {
+  switch (state) {
+    case IceState::NEW:
+      return "new";
+    case IceState::CHECKING:
+      return "checking";
+    case IceState::CONNECTED:
+      return "connected";
+    case IceState::FAILED:
+      return "failed";
+  }
+  return "unknown";
+}
+
+}  // namespace intercom
+}  // namespace esphome
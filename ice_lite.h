@@ -0,0 +1,126 @@
+/*
+ * ICE-lite
+ * The answering side of ICE (RFC 8445, lite implementation) with consent
+ * freshness (RFC 7675), for the raw RTP path where no WebRTC stack is
+ * available.
+ *
+ * Our SDP carries one host candidate and the credentials from begin(). A
+ * full agent on the other end (Android, browsers) sends STUN Binding
+ * requests to it; on_stun() answers them, learns peer-reflexive candidates
+ * and selects the highest-priority pair the remote nominates
+ * (USE-CANDIDATE). A lite or non-ICE remote never checks, so its signaled
+ * address is selected as is.
+ *
+ * Once a pair is selected, poll() sends a Binding request on it every 4 to
+ * 6 seconds. Consent expires when none has been answered for 30 s, and the
+ * pair is dropped so no more media goes to a peer that stopped listening.
+ * Remotes without ICE credentials cannot answer and are not checked.
+ *
+ * Plain C++ over mbedtls (hmac_sha1.h): the caller owns the socket and
+ * passes in the time, so the same code runs on the host.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hmac_sha1.h"
+#include "sdp.h"
+
+namespace esphome {
+namespace intercom {
+
+// STUN shares the port with RTP and RTCP; it is told apart by the first
+// byte (0-3, RFC 7983) and the magic cookie
+bool stun_is_message(const uint8_t *data, size_t len);
+// Dotted IPv4 to a host-order address (a.b.c.d is a << 24 | ...)
+bool ice_parse_ipv4(const char *s, size_t len, uint32_t *ip);
+
+enum class IceState : uint8_t {
+  NEW = 0,    // No remote description yet
+  CHECKING,   // Waiting for the remote to nominate a pair
+  CONNECTED,  // Media may flow on the selected pair
+  FAILED,     // Nothing was nominated in time, or consent expired
+};
+
+class IceLite {
+ public:
+  static constexpr size_t RANDOM_BYTES = 40;
+  static constexpr size_t MAX_CANDIDATES = 6;  // Signaled and peer-reflexive
+  static constexpr size_t MAX_MESSAGE = 160;   // Longest message poll() or on_stun() writes
+
+  // New local credentials and tie-breaker from RANDOM_BYTES of randomness;
+  // forgets the remote
+  void begin(const uint8_t *random);
+  const char *local_ufrag() const { return local_ufrag_; }
+  const char *local_pwd() const { return local_pwd_; }
+
+  // Credentials and candidates from the remote's SDP. ip:port is the
+  // address sdp_negotiate() picked (0 if it found none), used directly
+  // when the remote is lite or does not do ICE.
+  void set_remote(const SdpDescription &remote, uint32_t ip, uint16_t port, uint32_t now_ms);
+  // A candidate trickled over signaling; false if it is not usable
+  bool add_remote_candidate(const SdpCandidate &candidate);
+
+  // A STUN message from ip:port. Returns the length of the response to send
+  // back to it, or 0 if there is none.
+  size_t on_stun(const uint8_t *data, size_t len, uint32_t ip, uint16_t port, uint32_t now_ms, uint8_t *out,
+                 size_t cap);
+  // Timeouts and consent checks. Returns the length of a request to send to
+  // *ip:*port, or 0 if there is none. transaction_id is 12 random bytes for
+  // that request.
+  size_t poll(uint32_t now_ms, const uint8_t *transaction_id, uint8_t *out, size_t cap, uint32_t *ip,
+              uint16_t *port);
+
+  IceState state() const { return state_; }
+  // The pair to send media on; false unless CONNECTED
+  bool selected(uint32_t *ip, uint16_t *port) const;
+  // Bumped whenever the selected pair or the state changes
+  uint32_t generation() const { return generation_; }
+  static const char *state_name(IceState state);
+
+ protected:
+  struct Candidate {
+    uint32_t ip;
+    uint16_t port;
+    uint32_t priority;
+    bool nominated;
+  };
+
+  Candidate *find_(uint32_t ip, uint16_t port);
+  Candidate *add_(uint32_t ip, uint16_t port, uint32_t priority);
+  void select_(const Candidate &candidate, uint32_t now_ms);
+  void set_state_(IceState state);
+  size_t on_request_(const uint8_t *data, size_t username, size_t username_len, size_t integrity, uint32_t priority,
+                     bool use_candidate, uint32_t ip, uint16_t port, uint32_t now_ms, uint8_t *out, size_t cap);
+
+  char local_ufrag_[9]{};
+  char local_pwd_[25]{};
+  uint8_t tie_breaker_[8]{};
+  HmacSha1 local_key_;  // Checks from the remote are signed with our password
+  char remote_ufrag_[33]{};
+  bool remote_ice_{false};  // The remote has credentials, so it answers consent checks
+  bool remote_lite_{false};
+  HmacSha1 remote_key_;
+
+  Candidate candidates_[MAX_CANDIDATES]{};
+  size_t candidate_count_{0};
+
+  IceState state_{IceState::NEW};
+  uint32_t generation_{0};
+  uint32_t selected_ip_{0};
+  uint16_t selected_port_{0};
+  uint32_t selected_priority_{0};
+  uint32_t checking_since_ms_{0};
+  uint32_t consent_ms_{0};  // Last time the selected pair was known to be wanted
+  uint32_t next_check_ms_{0};
+
+  // Outstanding consent checks, to match their responses
+  static constexpr size_t PENDING = 4;
+  uint8_t pending_[PENDING][12]{};
+  size_t pending_next_{0};
+};
+
+}  // namespace intercom
+}  // namespace esphome
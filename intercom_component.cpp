@@ -1,11 +1,47 @@
 #include "intercom_component.h"
 #include "esphome/core/log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+
+#include <algorithm>
+#include <cstring>
 
 namespace esphome {
 namespace intercom {
 
 static const char *TAG = "intercom";
 
+static const uint32_t JITTER_BOUNDS_MS[] = {5, 10, 20, 40, 80, 160};
+static const uint32_t STAGE_BOUNDS_US[] = {50, 100, 250, 500, 1000, 2500};
+static const uint32_t PACING_BOUNDS_US[] = {100, 250, 500, 1000, 2500, 5000};
+static const uint32_t SEND_LATENCY_BOUNDS_US[] = {50, 100, 250, 500, 1000, 5000};
+
+// What the raw RTP path can send and receive, cheapest first
+const SdpCodecCap IntercomComponent::AUDIO_CODECS[] = {
+    {"L16", IntercomComponent::SAMPLE_RATE, 1, 256, IntercomComponent::RTP_PAYLOAD_TYPE},
+};
+const size_t IntercomComponent::AUDIO_CODEC_COUNT = sizeof(AUDIO_CODECS) / sizeof(AUDIO_CODECS[0]);
+
+// Indexed by TelemetryMetric
+static const MetricDef TELEMETRY_METRICS[METRIC_COUNT] = {
+  {"packets_tx", MetricType::COUNTER, "", 0, nullptr, 0},
+  {"packets_rx", MetricType::COUNTER, "", 0, nullptr, 0},
+  {"jitter", MetricType::HISTOGRAM, "ms", 0, JITTER_BOUNDS_MS, 6},
+  {"mos", MetricType::GAUGE, "", 2, nullptr, 0},
+  {"send_cpu", MetricType::HISTOGRAM, "us", 0, STAGE_BOUNDS_US, 6},
+  {"receive_cpu", MetricType::HISTOGRAM, "us", 0, STAGE_BOUNDS_US, 6},
+  {"packets_lost", MetricType::COUNTER, "", 0, nullptr, 0},
+  {"loss", MetricType::GAUGE, "%", 1, nullptr, 0},
+  {"rtt", MetricType::GAUGE, "ms", 0, nullptr, 0},
+  {"bitrate", MetricType::GAUGE, "kbps", 0, nullptr, 0},
+  {"rssi", MetricType::GAUGE, "dBm", 0, nullptr, 0},
+  {"fec_recovered", MetricType::COUNTER, "", 0, nullptr, 0},
+  {"jitter_buffer", MetricType::GAUGE, "frames", 0, nullptr, 0},
+  {"pacing_jitter", MetricType::HISTOGRAM, "us", 0, PACING_BOUNDS_US, 6},
+  {"send_latency", MetricType::HISTOGRAM, "us", 0, SEND_LATENCY_BOUNDS_US, 6},
+  {"clock_drift", MetricType::GAUGE, "ppm", 0, nullptr, 0},
+};
+
 IntercomComponent *IntercomComponent::instance_ = nullptr;
 
 void IntercomComponent::setup() {
@@ -25,8 +61,39 @@ void IntercomComponent::setup() {
   web_socket_.onEvent(websocket_event_);
   web_socket_.setReconnectInterval(5000);
   
-  // Setup UDP for audio
-  udp_.begin(audio_port_);
+  // Setup UDP and the tasks for audio
+  if (!audio_socket_.open(audio_port_, AUDIO_RECEIVE_TIMEOUT_MS)) {
+    ESP_LOGE(TAG, "Could not bind UDP port %d", audio_port_);
+    this->mark_failed();
+    return;
+  }
+  if (audio_dscp_ != DSCP_BEST_EFFORT && !audio_socket_.set_dscp(audio_dscp_)) {
+    ESP_LOGW(TAG, "Could not mark audio with DSCP %u", audio_dscp_);
+  }
+  if (xTaskCreate(capture_task_, "intercom_tx", AUDIO_TASK_STACK, this, AUDIO_TASK_PRIORITY,
+                  &capture_task_handle_) != pdPASS ||
+      xTaskCreate(render_task_, "intercom_rx", AUDIO_TASK_STACK, this, AUDIO_TASK_PRIORITY,
+                  &render_task_handle_) != pdPASS) {
+    ESP_LOGE(TAG, "Could not start the audio tasks");
+    this->mark_failed();
+    return;
+  }
+  esp_timer_create_args_t pace_timer_args = {};
+  pace_timer_args.callback = pace_timer_;
+  pace_timer_args.arg = this;
+  pace_timer_args.dispatch_method = ESP_TIMER_TASK;
+  pace_timer_args.name = "intercom_pace";
+  if (esp_timer_create(&pace_timer_args, &pace_timer_handle_) != ESP_OK) {
+    ESP_LOGE(TAG, "Could not create the pacing timer");
+    this->mark_failed();
+    return;
+  }
+  
+  if (telemetry_interval_s_ > 0 && telemetry_.begin(TELEMETRY_METRICS, METRIC_COUNT, client_id_.c_str())) {
+    this->set_interval("telemetry", TELEMETRY_SNAPSHOT_MS, [this]() { this->telemetry_tick_(); });
+    ESP_LOGCONFIG(TAG, "Telemetry every %us via %s", (unsigned) telemetry_interval_s_,
+                  telemetry_port_ != 0 ? "UDP" : "WebSocket");
+  }
   
   ESP_LOGCONFIG(TAG, "Intercom Component setup complete");
 }
@@ -34,9 +101,13 @@ void IntercomComponent::setup() {
 void IntercomComponent::loop() {
   web_socket_.loop();
   
+  // Audio itself streams in the audio tasks
   if (in_call_) {
-    send_audio_packet_();
-    receive_audio_packet_();
+    if (rtcp_feedback_.exchange(false)) {
+      on_rtcp_feedback_();
+    }
+    poll_ice_();
+    send_rtcp_();
   }
 }
 
@@ -72,12 +143,17 @@ void IntercomComponent::handle_websocket_event_(WStype_t type, uint8_t *payload,
     case WStype_DISCONNECTED:
       ESP_LOGW(TAG, "WebSocket Disconnected");
       connected_ = false;
+      stop_audio_();
       in_call_ = false;
       break;
       
     case WStype_CONNECTED:
       ESP_LOGI(TAG, "WebSocket Connected");
       connected_ = true;
+      // Each reconnect is a new socket
+      if (signaling_dscp_ != DSCP_BEST_EFFORT && !set_socket_dscp(web_socket_.fd(), signaling_dscp_)) {
+        ESP_LOGW(TAG, "Could not mark signaling with DSCP %u", signaling_dscp_);
+      }
       generate_session_id_();
       room_id_ = client_id_;
       send_join_message_();
@@ -117,9 +193,10 @@ void IntercomComponent::send_ready_message_() {
 }
 
 void IntercomComponent::send_offer_message_(const std::string &sdp) {
-  StaticJsonDocument<512> doc;
+  // The SDP is referenced, not copied, so it does not eat into the document
+  StaticJsonDocument<128> doc;
   doc["type"] = "offer";
-  doc["sdp"] = sdp;
+  doc["sdp"] = sdp.c_str();
   
   String message;
   serializeJson(doc, message);
@@ -128,9 +205,9 @@ void IntercomComponent::send_offer_message_(const std::string &sdp) {
 }
 
 void IntercomComponent::send_answer_message_(const std::string &sdp) {
-  StaticJsonDocument<512> doc;
+  StaticJsonDocument<128> doc;
   doc["type"] = "answer";
-  doc["sdp"] = sdp;
+  doc["sdp"] = sdp.c_str();
   
   String message;
   serializeJson(doc, message);
@@ -148,11 +225,14 @@ void IntercomComponent::send_leave_message_() {
   ESP_LOGD(TAG, "Sent leave");
 }
 
-void IntercomComponent::handle_signaling_message_(const std::string &message) {
-  ESP_LOGD(TAG, "Received: %s", message.c_str());
+void IntercomComponent::handle_signaling_message_(std::string message) {
+  // Never log the message itself: dumping SDPs over the UART stalls the loop
+  ESP_LOGV(TAG, "Received %u bytes", (unsigned) message.size());
   
+  // Parsed in place from the mutable copy, so strings (the SDP above all)
+  // point into `message` instead of filling the document
   StaticJsonDocument<512> doc;
-  DeserializationError error = deserializeJson(doc, message.c_str());
+  DeserializationError error = deserializeJson(doc, &message[0]);
   
   if (error) {
     ESP_LOGE(TAG, "JSON parse error: %s", error.c_str());
@@ -170,23 +250,44 @@ void IntercomComponent::handle_signaling_message_(const std::string &message) {
   } else if (type == "ready") {
     ready_ = true;
     ESP_LOGI(TAG, "Room is ready");
+    if (offer_pending_) {
+      offer_pending_ = false;
+      send_offer_();
+    }
     
   } else if (type == "offer") {
-    std::string sdp = doc["sdp"] | "";
+    remote_sdp_ = doc["sdp"] | "";
     ESP_LOGI(TAG, "Received offer - accepting call");
     accept_call();
     
   } else if (type == "answer") {
-    std::string sdp = doc["sdp"] | "";
+    const char *sdp = doc["sdp"] | "";
+    SdpNegotiation negotiation;
+    stop_audio_();
+    if (!apply_remote_sdp_(sdp, strlen(sdp), &negotiation)) {
+      send_leave_message_();
+      return;
+    }
     ESP_LOGI(TAG, "Received answer - call established");
+    start_rtp_session_();
     in_call_ = true;
+    start_audio_();
     
   } else if (type == "candidate") {
-    std::string candidate = doc["candidate"] | "";
-    ESP_LOGD(TAG, "Received ICE candidate: %s", candidate.c_str());
+    const char *candidate = doc["candidate"] | "";
+    SdpCandidate parsed;
+    bool added = false;
+    if (sdp_parse_candidate(candidate, strlen(candidate), &parsed)) {
+      LockGuard lock(state_lock_);
+      added = ice_.add_remote_candidate(parsed);
+    }
+    if (added) {
+      ESP_LOGD(TAG, "Added ICE candidate: %s", candidate);
+    }
     
   } else if (type == "leave") {
     ESP_LOGI(TAG, "Remote left - ending call");
+    stop_audio_();
     in_call_ = false;
     
   } else if (type == "error") {
@@ -205,11 +306,11 @@ void IntercomComponent::start_call(const std::string &target_device_id) {
   room_id_ = target_device_id;
   generate_session_id_();
   
-  // Send join message for the target room
+  // Send join message for the target room; the offer goes out once the
+  // room is ready
+  offer_pending_ = true;
   send_join_message_();
   
-  // After ready, send offer
-  // (In real implementation, would generate proper SDP)
   ESP_LOGI(TAG, "Initiating call to %s", target_device_id.c_str());
 }
 
@@ -218,26 +319,182 @@ void IntercomComponent::end_call() {
     return;
   }
   
+  stop_audio_();
   send_leave_message_();
   in_call_ = false;
+  offer_pending_ = false;
   target_device_id_ = "";
   remote_audio_port_ = 0;
+  srtp_tx_.end();
+  srtp_rx_.end();
   
   ESP_LOGI(TAG, "Call ended");
 }
 
 void IntercomComponent::accept_call() {
-  // Send answer (simplified - in real implementation, generate proper SDP)
-  std::string local_ip = WiFi.localIP().toString().c_str();
-  std::string sdp = "v=0\r\no=- " + std::to_string(millis()) + 
-                    " 2 IN IP4 " + local_ip + "\r\ns=-\r\nt=0 0\r\n";
+  if (remote_sdp_.empty()) {
+    ESP_LOGW(TAG, "No offer to accept");
+    return;
+  }
+  std::string offer;
+  offer.swap(remote_sdp_);
+  stop_audio_();
+  restart_ice_();
+  restart_srtp_();
+  SdpNegotiation negotiation;
+  if (!apply_remote_sdp_(offer.data(), offer.size(), &negotiation)) {
+    send_leave_message_();
+    return;
+  }
+  
+  char sdp[MAX_SDP];
+  if (write_local_sdp_(&negotiation, sdp, sizeof(sdp)) == 0) {
+    ESP_LOGE(TAG, "Answer does not fit in %u bytes", (unsigned) sizeof(sdp));
+    send_leave_message_();
+    return;
+  }
   
   send_answer_message_(sdp);
+  start_rtp_session_();
   in_call_ = true;
+  start_audio_();
   
   ESP_LOGI(TAG, "Call accepted");
 }
 
+void IntercomComponent::send_offer_() {
+  restart_ice_();
+  restart_srtp_();
+  char sdp[MAX_SDP];
+  if (write_local_sdp_(nullptr, sdp, sizeof(sdp)) == 0) {
+    ESP_LOGE(TAG, "Offer does not fit in %u bytes", (unsigned) sizeof(sdp));
+    return;
+  }
+  send_offer_message_(sdp);
+}
+
+bool IntercomComponent::apply_remote_sdp_(const char *sdp, size_t len, SdpNegotiation *negotiation) {
+  SdpDescription remote;
+  if (!sdp_parse(sdp, len, &remote)) {
+    ESP_LOGE(TAG, "Remote SDP has no audio");
+    return false;
+  }
+  if (!sdp_negotiate(remote, AUDIO_CODECS, AUDIO_CODEC_COUNT, negotiation)) {
+    ESP_LOGE(TAG, "No common codec or address in remote SDP");
+    return false;
+  }
+  
+  uint8_t remote_key[SRTP_MASTER_SIZE];
+  if (srtp_select_crypto(remote, &srtp_suite_, &srtp_tag_, remote_key)) {
+    srtp_tx_.begin(srtp_suite_, srtp_local_key_);
+    srtp_rx_.begin(srtp_suite_, remote_key);
+    memset(remote_key, 0, sizeof(remote_key));
+  } else if (srtp_required_) {
+    ESP_LOGE(TAG, "Remote SDP has no usable SRTP key");
+    return false;
+  } else {
+    ESP_LOGW(TAG, "Remote does not do SRTP - audio is not encrypted");
+    srtp_tx_.end();
+    srtp_rx_.end();
+  }
+  
+  uint32_t ip = 0;
+  ice_parse_ipv4(negotiation->remote_address, strlen(negotiation->remote_address), &ip);
+  ice_.set_remote(remote, ip, negotiation->remote_port, millis());
+  update_ice_path_();
+  payload_type_ = negotiation->payload_type;
+  red_payload_type_ = negotiation->red_payload_type;
+  remote_ptime_ = negotiation->ptime;
+  rtcp_mux_ = negotiation->rtcp_mux;
+  ESP_LOGI(TAG, "Audio: %s/%u as %u%s, %s, ICE %s", negotiation->codec->name,
+           (unsigned) negotiation->codec->clock_rate, payload_type_, red_payload_type_ != 0 ? " with RED" : "",
+           srtp_tx_.active() ? srtp_suite_name(srtp_suite_) : "unencrypted", IceLite::state_name(ice_.state()));
+  return ice_.state() != IceState::FAILED;
+}
+
+void IntercomComponent::restart_ice_() {
+  uint8_t random[IceLite::RANDOM_BYTES];
+  esp_fill_random(random, sizeof(random));
+  ice_.begin(random);
+  update_ice_path_();
+}
+
+void IntercomComponent::restart_srtp_() {
+  esp_fill_random(srtp_local_key_, sizeof(srtp_local_key_));
+  srtp_key_to_base64(srtp_local_key_, srtp_local_key_base64_, sizeof(srtp_local_key_base64_));
+  // What we offer; answering takes the suite and tag of the offer
+  srtp_suite_ = SrtpSuite::AES_CM_128_HMAC_SHA1_80;
+  srtp_tag_ = 1;
+  srtp_tx_.end();
+  srtp_rx_.end();
+}
+
+void IntercomComponent::poll_ice_() {
+  uint8_t transaction_id[12];
+  esp_fill_random(transaction_id, sizeof(transaction_id));
+  uint32_t ip;
+  uint16_t port;
+  size_t len;
+  {
+    LockGuard lock(state_lock_);
+    len = ice_.poll(millis(), transaction_id, stun_packet_, sizeof(stun_packet_), &ip, &port);
+  }
+  if (len > 0) {
+    audio_socket_.send(ip, port, stun_packet_, len);
+  }
+  update_ice_path_();
+}
+
+void IntercomComponent::update_ice_path_() {
+  uint32_t ip;
+  uint16_t port;
+  bool connected, failed;
+  {
+    // The render task answers checks as they come; the path it leads to is
+    // picked up here
+    LockGuard lock(state_lock_);
+    if (ice_.generation() == ice_generation_) {
+      return;
+    }
+    ice_generation_ = ice_.generation();
+    connected = ice_.selected(&ip, &port);
+    remote_audio_ip_ = connected ? ip : 0;
+    remote_audio_port_ = connected ? port : 0;
+    failed = ice_.state() == IceState::FAILED;
+  }
+  if (connected) {
+    ESP_LOGI(TAG, "ICE connected to %u.%u.%u.%u:%u", (unsigned) (ip >> 24), (unsigned) ((ip >> 16) & 0xFF),
+             (unsigned) ((ip >> 8) & 0xFF), (unsigned) (ip & 0xFF), (unsigned) port);
+    return;
+  }
+  if (failed && in_call_) {
+    ESP_LOGW(TAG, "ICE failed - ending call");
+    end_call();
+  }
+}
+
+size_t IntercomComponent::write_local_sdp_(const SdpNegotiation *answer, char *buf, size_t cap) {
+  String address = WiFi.localIP().toString();
+  SdpLocal local{};
+  local.session_id = millis();
+  local.version = 2;
+  local.address = address.c_str();
+  local.port = audio_port_;
+  local.caps = AUDIO_CODECS;
+  local.cap_count = AUDIO_CODEC_COUNT;
+  local.answer = answer;
+  local.red_payload_type = redundancy_depth_ > 0 ? RTP_RED_PAYLOAD_TYPE : 0;
+  local.ptime = 20;
+  local.ice_ufrag = ice_.local_ufrag();
+  local.ice_pwd = ice_.local_pwd();
+  if (answer == nullptr || srtp_tx_.active()) {
+    local.crypto_suite = srtp_suite_name(srtp_suite_);
+    local.crypto_key = srtp_local_key_base64_;
+    local.crypto_tag = srtp_tag_;
+  }
+  return sdp_write(local, buf, cap);
+}
+
 void IntercomComponent::toggle_mute() {
   muted_ = !muted_;
   ESP_LOGI(TAG, "Mute: %s", muted_ ? "ON" : "OFF");
@@ -253,7 +510,7 @@ void IntercomComponent::setup_i2s_() {
     .communication_format = I2S_COMM_FORMAT_STAND_I2S,
     .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
     .dma_buf_count = 8,
-    .dma_buf_len = BUFFER_SIZE,
+    .dma_buf_len = CAPTURE_DMA_SAMPLES,
     .use_apll = false,
     .tx_desc_auto_clear = false,
     .fixed_mclk = 0
@@ -298,38 +555,407 @@ void IntercomComponent::setup_i2s_() {
   ESP_LOGCONFIG(TAG, "I2S configured");
 }
 
-void IntercomComponent::send_audio_packet_() {
-  if (muted_ || remote_audio_port_ == 0) {
+void IntercomComponent::start_audio_() {
+  hold_power_save_off_();
+  pacer_.begin(PACER_HOLD_US, PACER_BACKLOG);
+  send_latency_us_ = 0;
+  streaming_ = true;
+  xTaskNotifyGive(capture_task_handle_);
+  xTaskNotifyGive(render_task_handle_);
+  esp_timer_start_once(pace_timer_handle_, PACER_IDLE_US);
+}
+
+void IntercomComponent::stop_audio_() {
+  streaming_ = false;
+  esp_timer_stop(pace_timer_handle_);
+  // Each task sees the flag within one bounded wait; after that the call
+  // state is loop()'s alone again
+  uint32_t start = millis();
+  while ((capture_busy_ || render_busy_ || pace_busy_) && millis() - start < AUDIO_STOP_TIMEOUT_MS) {
+    delay(1);
+  }
+  if (capture_busy_ || render_busy_ || pace_busy_) {
+    ESP_LOGW(TAG, "Audio tasks still busy after %u ms", (unsigned) AUDIO_STOP_TIMEOUT_MS);
+  }
+  restore_power_save_();
+}
+
+void IntercomComponent::hold_power_save_off_() {
+  if (!power_save_off_in_call_ || power_save_held_) {
     return;
   }
+  if (esp_wifi_get_ps(&saved_power_save_) != ESP_OK || esp_wifi_set_ps(WIFI_PS_NONE) != ESP_OK) {
+    ESP_LOGW(TAG, "Could not turn Wi-Fi power save off for the call");
+    return;
+  }
+  power_save_held_ = true;
+  ESP_LOGD(TAG, "Wi-Fi power save off for the call (was %d)", (int) saved_power_save_);
+}
+
+void IntercomComponent::restore_power_save_() {
+  if (!power_save_held_) {
+    return;
+  }
+  power_save_held_ = false;
+  if (esp_wifi_set_ps(saved_power_save_) != ESP_OK) {
+    ESP_LOGW(TAG, "Could not restore Wi-Fi power save");
+  }
+}
+
+void IntercomComponent::capture_task_(void *arg) {
+  IntercomComponent *self = static_cast<IntercomComponent *>(arg);
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    self->capture_busy_ = true;
+    while (self->streaming_) {
+      self->send_audio_packet_();
+    }
+    self->capture_busy_ = false;
+  }
+}
+
+void IntercomComponent::render_task_(void *arg) {
+  IntercomComponent *self = static_cast<IntercomComponent *>(arg);
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    self->render_busy_ = true;
+    while (self->streaming_) {
+      self->receive_audio_packet_();
+    }
+    self->render_busy_ = false;
+  }
+}
+
+void IntercomComponent::pace_timer_(void *arg) { static_cast<IntercomComponent *>(arg)->pace_(); }
+
+void IntercomComponent::pace_() {
+  pace_busy_ = true;
+  if (streaming_) {
+    uint64_t now = esp_timer_get_time();
+    UdpDatagram batch[TxPacer::SLOTS];
+    size_t count = pacer_.due(now, batch, TxPacer::SLOTS);
+    if (count > 0) {
+      // What the packets wait for in lwIP and the Wi-Fi driver: a radio
+      // dozing between beacons, or a busy best-effort queue, shows here
+      uint64_t send_start = esp_timer_get_time();
+      audio_socket_.send_batch(batch, count);
+      uint32_t latency = (uint32_t) ((esp_timer_get_time() - send_start) / count);
+      pacer_.release(count);
+      telemetry_.observe(METRIC_SEND_LATENCY, latency);
+      uint32_t smoothed = send_latency_us_.load(std::memory_order_relaxed);
+      send_latency_us_.store(smoothed + ((int32_t) latency - (int32_t) smoothed) / 16, std::memory_order_relaxed);
+      int32_t deviation = pacer_.stats().last_deviation_us;
+      if (deviation >= 0) {
+        telemetry_.observe(METRIC_PACING_JITTER, deviation);
+      }
+    }
+    // Re-armed for the next departure, or to look again shortly while
+    // nothing is queued
+    uint64_t next = pacer_.next_due_us();
+    esp_timer_start_once(pace_timer_handle_, next == 0 ? PACER_IDLE_US : (next > now ? next - now : 0));
+  }
+  pace_busy_ = false;
+}
+
+void IntercomComponent::send_audio_packet_() {
+  // One packet time of audio, as the congestion controller last decided.
+  // Raw PCM frames over 20 ms are too long for a RED block, so redundancy
+  // pins the packet time at 20 ms.
+  // The remote's ptime, when it gave one, caps it, and so does the pacer's
+  // slot size: a 60 ms L16 packet would be refused outright.
+  uint8_t fec_depth, ptime;
+  {
+    LockGuard lock(state_lock_);
+    const BitrateDecision &decision = bitrate_.decision();
+    fec_depth = red_payload_type_ != 0 ? std::min(decision.fec_depth, redundancy_depth_) : 0;
+    ptime = fec_depth > 0 ? 20 : std::min(decision.ptime_ms, MAX_PLAIN_PTIME_MS);
+  }
+  if (remote_ptime_ >= 20 && ptime > remote_ptime_) {
+    ptime = remote_ptime_;
+  }
   
-  int16_t audio_buffer[BUFFER_SIZE];
-  size_t bytes_read;
-  
-  i2s_read(I2S_NUM_0, audio_buffer, sizeof(audio_buffer), &bytes_read, portMAX_DELAY);
+  // The mic is read even while muted or without a path, which keeps this
+  // task paced and the DMA buffers from filling with stale audio
+  size_t samples = SAMPLE_RATE / 1000 * ptime;
+  size_t bytes_read = 0;
+  i2s_read(I2S_NUM_0, tx_audio_buffer_, samples * sizeof(int16_t), &bytes_read, pdMS_TO_TICKS(2 * ptime));
+  if (bytes_read == 0 || muted_) {
+    return;
+  }
   
-  if (bytes_read > 0) {
-    // Send RTP packet (simplified - no full RTP header)
-    udp_.beginPacket(remote_audio_ip_, remote_audio_port_);
-    udp_.write((uint8_t*)audio_buffer, bytes_read);
-    udp_.endPacket();
+  uint32_t start = micros();
+  uint8_t *payload = (uint8_t *) tx_audio_buffer_;
+  rtp_l16_swap(payload, bytes_read);
+  size_t payload_len;
+  size_t tag_len = 0;
+  uint32_t ip;
+  uint16_t port;
+  {
+    LockGuard lock(state_lock_);
+    if (remote_audio_port_ == 0) {
+      return;
+    }
+    payload_len = red_.encode(payload_type_, payload, bytes_read, rtp_.timestamp(), fec_depth, tx_red_payload_,
+                              sizeof(tx_red_payload_));
+    if (payload_len > 0) {
+      payload = tx_red_payload_;
+    } else {
+      payload_len = bytes_read;
+    }
+    rtp_.set_payload_type(payload == tx_red_payload_ ? red_payload_type_ : payload_type_);
+    rtp_.write_header(rtp_header_, bytes_read / sizeof(int16_t), payload_len, esp_timer_get_time());
+    // Encrypted where it lies (RED has already copied the frame into its
+    // history); the tag goes out after it
+    if (srtp_tx_.active()) {
+      srtp_tx_.protect(rtp_header_, sizeof(rtp_header_), payload, payload_len, tx_srtp_tag_);
+      tag_len = srtp_tx_.tag_size();
+    }
+    ip = remote_audio_ip_;
+    port = remote_audio_port_;
   }
+  // Sent by pace_() when its turn comes
+  uint32_t duration_us = bytes_read / sizeof(int16_t) * 1000000ULL / SAMPLE_RATE;
+  if (!pacer_.push(ip, port, duration_us, esp_timer_get_time(), rtp_header_, sizeof(rtp_header_), payload,
+                   payload_len, tx_srtp_tag_, tag_len)) {
+    const PacerStats &pacing = pacer_.stats();
+    uint32_t rejected = pacing.dropped + pacing.oversized;
+    // The first of a run and then one in a hundred, not fifty a second
+    if (rejected % 100 == 1) {
+      ESP_LOGW(TAG, "Packet not queued (%u bytes): %u dropped, %u oversized so far",
+               (unsigned) (sizeof(rtp_header_) + payload_len + tag_len), (unsigned) pacing.dropped,
+               (unsigned) pacing.oversized);
+    }
+    return;
+  }
+  telemetry_.observe(METRIC_SEND_US, micros() - start);
+  telemetry_.add(METRIC_PACKETS_TX);
 }
 
 void IntercomComponent::receive_audio_packet_() {
-  int packet_size = udp_.parsePacket();
-  if (packet_size > 0) {
-    int16_t audio_buffer[BUFFER_SIZE];
-    int len = udp_.read((char*)audio_buffer, sizeof(audio_buffer));
+  uint32_t from_ip;
+  uint16_t from_port;
+  int len = audio_socket_.receive(rx_packet_, sizeof(rx_packet_), &from_ip, &from_port);
+  if (len <= 0) {
+    return;
+  }
+  uint32_t start = micros();
+  uint64_t now = esp_timer_get_time();
+  
+  {
+    LockGuard lock(state_lock_);
+    if (stun_is_message(rx_packet_, len)) {
+      size_t response =
+          ice_.on_stun(rx_packet_, len, from_ip, from_port, millis(), stun_response_, sizeof(stun_response_));
+      if (response > 0) {
+        audio_socket_.send(from_ip, from_port, stun_response_, response);
+      }
+      return;
+    }
+    
+    if (rtp_is_rtcp(rx_packet_, len)) {
+      if (srtp_rx_.active()) {
+        len = srtp_rx_.unprotect_rtcp(rx_packet_, len);
+      }
+      if (len > 0 && rtp_.on_rtcp(rx_packet_, len, now)) {
+        rtcp_feedback_ = true;
+      }
+      return;
+    }
+    
+    // Unauthenticated and replayed packets go no further
+    if (srtp_rx_.active() && (len = srtp_rx_.unprotect(rx_packet_, len)) == 0) {
+      return;
+    }
     
-    if (len > 0) {
-      // Play audio to speaker
-      size_t bytes_written;
-      i2s_write(I2S_NUM_1, audio_buffer, len, &bytes_written, portMAX_DELAY);
+    size_t offset, payload_len;
+    RtpHeader header;
+    if (!rtp_.on_rtp(rx_packet_, len, now, &offset, &payload_len, &header) || payload_len == 0) {
+      return;
     }
+    const uint8_t *payload = rx_packet_ + offset;
+    if (red_payload_type_ != 0 && header.payload_type == red_payload_type_) {
+      // Redundant copies fill the gaps of earlier losses; hold back as
+      // many frames as the sender covers so they have a chance to
+      RedBlock blocks[RED_MAX_DEPTH + 1];
+      size_t count = rtp_red_parse(payload, payload_len, header.timestamp, blocks, RED_MAX_DEPTH + 1);
+      jitter_buffer_.set_hold(count > 0 ? count - 1 : 0);
+      for (size_t i = 0; i < count; i++) {
+        if (blocks[i].payload_type == payload_type_) {
+          jitter_buffer_.put(header.seq - blocks[i].distance, blocks[i].data, blocks[i].len, blocks[i].distance > 0);
+        }
+      }
+    } else {
+      jitter_buffer_.set_hold(0);
+      jitter_buffer_.put(header.seq, payload, payload_len, false);
+    }
+    telemetry_.observe(METRIC_JITTER, (uint32_t) rtp_.stats().jitter_ms);
+  }
+  telemetry_.observe(METRIC_RECEIVE_US, micros() - start);
+  telemetry_.add(METRIC_PACKETS_RX);
+  
+  render_audio_();
+}
+
+void IntercomComponent::render_audio_() {
+  // Play audio to speaker, in sequence; lost frames are skipped. Frames
+  // stay in the jitter buffer's slots, which only this task writes to, so
+  // the lock is not held while they are resampled to the speaker's clock
+  // and played.
+  for (;;) {
+    uint8_t *frame;
+    size_t frame_len;
+    {
+      LockGuard lock(state_lock_);
+      if (!jitter_buffer_.pop(&frame, &frame_len)) {
+        return;
+      }
+    }
+    if (frame_len > 0) {
+      uint32_t frame_ms = frame_len / sizeof(int16_t) * 1000 / SAMPLE_RATE;
+      rtp_l16_swap(frame, frame_len);
+      resampler_.set_ratio(drift_.ratio());
+      size_t samples =
+          resampler_.process(reinterpret_cast<const int16_t *>(frame), frame_len / sizeof(int16_t), playout_);
+      size_t bytes_written = 0;
+      uint64_t now = esp_timer_get_time();
+      i2s_write(I2S_NUM_1, playout_, samples * sizeof(int16_t), &bytes_written, pdMS_TO_TICKS(2 * frame_ms + 1));
+      drift_.on_output(bytes_written / sizeof(int16_t), now);
+    }
+  }
+}
+
+void IntercomComponent::start_rtp_session_() {
+  rtp_.begin(esp_random(), payload_type_, SAMPLE_RATE, client_id_.c_str(), esp_timer_get_time());
+  reported_lost_ = 0;
+  red_.reset();
+  jitter_buffer_.reset();
+  reported_recovered_ = 0;
+  drift_.begin(SAMPLE_RATE, PLAYOUT_TARGET_SAMPLES);
+  resampler_.begin();
+  bitrate_.begin(min_bitrate_bps_, max_bitrate_bps_, weak_bitrate_bps_, millis());
+  publish_bitrate_decision_();
+}
+
+void IntercomComponent::send_rtcp_() {
+  // Reports are rare and small, so the lock is held throughout
+  LockGuard lock(state_lock_);
+  uint64_t now = esp_timer_get_time();
+  if (remote_audio_port_ == 0 || !rtp_.rtcp_due(now)) {
+    return;
+  }
+  size_t len = rtp_.build_rtcp(rtcp_packet_, RTCP_MAX_PACKET_SIZE, now);
+  if (len > 0 && srtp_tx_.active()) {
+    len = srtp_tx_.protect_rtcp(rtcp_packet_, len, sizeof(rtcp_packet_));
+  }
+  if (len == 0) {
+    return;
+  }
+  // Without rtcp-mux the remote listens for RTCP one port up (RFC 3550)
+  audio_socket_.send(remote_audio_ip_, rtcp_mux_ ? remote_audio_port_ : remote_audio_port_ + 1, rtcp_packet_, len);
+  
+  // Building the report closed a loss interval for the incoming stream
+  const RtcpStats &stats = rtp_.stats();
+  if (stats.cumulative_lost > reported_lost_) {
+    telemetry_.add(METRIC_PACKETS_LOST, stats.cumulative_lost - reported_lost_);
+    reported_lost_ = stats.cumulative_lost;
+  }
+  telemetry_.set(METRIC_LOSS, stats.fraction_lost * 1000 / 256);
+  const PacerStats &pacing = pacer_.stats();
+  ESP_LOGD(TAG, "Pacing: jitter %uus (capture %uus), max %uus; %u batched, %u underruns, %u dropped, %u oversized",
+           (unsigned) pacing.jitter_us, (unsigned) pacing.capture_jitter_us, (unsigned) pacing.max_jitter_us,
+           (unsigned) pacing.batched, (unsigned) pacing.underruns, (unsigned) pacing.dropped,
+           (unsigned) pacing.oversized);
+  const DriftStats &drift = drift_.stats();
+  ESP_LOGD(TAG, "Clock drift: %+.0f ppm, correcting %+.0f ppm; playout %d samples, %u underruns",
+           drift.drift_ppm, drift.correction_ppm, (int) drift.fill, (unsigned) drift.underruns);
+  // Compare runs with and without set_power_save_off_in_call()
+  ESP_LOGD(TAG, "Send latency %uus per packet, Wi-Fi power save %s", (unsigned) send_latency_us_.load(),
+           power_save_held_ ? "off for the call" : "unchanged");
+  const JitterBufferStats &jb = jitter_buffer_.stats();
+  ESP_LOGD(TAG, "FEC: %u frames recovered, %u lost; sending depth %u, overhead %u%%", (unsigned) jb.recovered,
+           (unsigned) jb.lost, red_.last_depth(),
+           (unsigned) (red_.primary_bytes() > 0 ? (uint64_t) red_.redundant_bytes() * 100 / red_.primary_bytes() : 0));
+  
+  // Sampled on the report schedule so a weak link is caught even when the
+  // remote sends no reports
+  int8_t rssi = WiFi.RSSI();
+  telemetry_.set(METRIC_RSSI, rssi);
+  if (bitrate_.on_rssi(rssi, millis())) {
+    publish_bitrate_decision_();
+  }
+}
+
+void IntercomComponent::on_rtcp_feedback_() {
+  // The remote's view of our stream: what bitrate and jitter buffer
+  // adaptation act on
+  LockGuard lock(state_lock_);
+  const RtcpStats &stats = rtp_.stats();
+  if (stats.rtt_valid) {
+    telemetry_.set(METRIC_RTT, (int32_t) stats.rtt_ms);
+  }
+  ESP_LOGD(TAG, "RTCP: remote lost %.1f%% (%d total), jitter %.1fms, RTT %.0fms",
+           stats.remote_fraction_lost * 100.0f / 256.0f, (int) stats.remote_cumulative_lost,
+           stats.remote_jitter_ms, stats.rtt_valid ? stats.rtt_ms : -1.0f);
+  if (bitrate_.on_report(stats.remote_fraction_lost, stats.rtt_valid, stats.rtt_ms, millis())) {
+    publish_bitrate_decision_();
+  }
+}
+
+void IntercomComponent::publish_bitrate_decision_() {
+  const BitrateDecision &d = bitrate_.decision();
+  ESP_LOGD(TAG, "Bitrate %s: %u kbps (encoder %u), %u ms packets, FEC depth %u%s%s",
+           BitrateController::state_name(d.state), (unsigned) (d.bitrate_bps / 1000),
+           (unsigned) (d.encoder_bps / 1000), d.ptime_ms, d.fec_depth, d.overuse ? ", delay rising" : "",
+           d.weak_signal ? ", weak signal" : "");
+  telemetry_.set(METRIC_BITRATE, (int32_t) (d.bitrate_bps / 1000));
+  if (target_bitrate_sensor_ != nullptr) {
+    target_bitrate_sensor_->publish_state(d.bitrate_bps / 1000.0f);
+  }
+  if (packet_time_sensor_ != nullptr) {
+    packet_time_sensor_->publish_state(d.ptime_ms);
+  }
+  if (fec_depth_sensor_ != nullptr) {
+    fec_depth_sensor_->publish_state(d.fec_depth);
+  }
+  if (congestion_state_text_sensor_ != nullptr) {
+    congestion_state_text_sensor_->publish_state(BitrateController::state_name(d.state));
+  }
+}
+
+void IntercomComponent::telemetry_tick_() {
+  if (in_call_) {
+    LockGuard lock(state_lock_);
+    const RtcpStats &stats = rtp_.stats();
+    float mos = Telemetry::estimate_mos(stats.fraction_lost * 100.0f / 256.0f, stats.rtt_ms, stats.jitter_ms);
+    telemetry_.set(METRIC_MOS, (int32_t) (mos * 100.0f));
+    const JitterBufferStats &jb = jitter_buffer_.stats();
+    telemetry_.add(METRIC_FEC_RECOVERED, jb.recovered - reported_recovered_);
+    reported_recovered_ = jb.recovered;
+    telemetry_.set(METRIC_BUFFER_DEPTH, (int32_t) jitter_buffer_.depth());
+    telemetry_.set(METRIC_CLOCK_DRIFT, (int32_t) drift_.stats().drift_ppm);
+  }
+  
+  bool full = telemetry_.snapshot(millis());
+  if (full || ++telemetry_pending_ >= telemetry_interval_s_ * 1000 / TELEMETRY_SNAPSHOT_MS) {
+    send_telemetry_();
+  }
+}
+
+void IntercomComponent::send_telemetry_() {
+  telemetry_pending_ = 0;
+  const uint8_t *frame;
+  size_t len = telemetry_.frame(&frame);
+  if (len == 0) {
+    return;
+  }
+  if (telemetry_port_ != 0) {
+    telemetry_udp_.beginPacket(telemetry_host_.c_str(), telemetry_port_);
+    telemetry_udp_.write(frame, len);
+    telemetry_udp_.endPacket();
+  } else if (connected_) {
+    web_socket_.sendBIN(const_cast<uint8_t *>(frame), len);
   }
 }
 
 }  // namespace intercom
 }  // namespace esphome
-
@@ -12,10 +12,54 @@
 #include <WebSocketsClient.h>
 #include <ArduinoJson.h>
 #include <driver/i2s.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include "bitrate_controller.h"
+#include "clock_drift.h"
+#include "ice_lite.h"
+#include "jitter_buffer.h"
+#include "rtp_red.h"
+#include "rtp_session.h"
+#include "sdp.h"
+#include "srtp.h"
+#include "telemetry.h"
+#include "tx_pacer.h"
+#include "udp_socket.h"
 
 namespace esphome {
 namespace intercom {
 
+// Telemetry metric ids, in schema order
+enum TelemetryMetric : uint8_t {
+  METRIC_PACKETS_TX = 0,
+  METRIC_PACKETS_RX,
+  METRIC_JITTER,        // Histogram of the smoothed interarrival jitter (ms)
+  METRIC_MOS,           // E-model estimate x100
+  METRIC_SEND_US,       // CPU time per stage (us)
+  METRIC_RECEIVE_US,
+  METRIC_PACKETS_LOST,  // From RTCP: remote packets that never arrived
+  METRIC_LOSS,          // Fraction lost in the last report interval (%)
+  METRIC_RTT,           // Round trip from RTCP LSR/DLSR (ms)
+  METRIC_BITRATE,       // Congestion controller target (kbps)
+  METRIC_RSSI,          // Wi-Fi signal (dBm)
+  METRIC_FEC_RECOVERED, // Frames restored from RFC 2198 redundancy
+  METRIC_BUFFER_DEPTH,  // Frames waiting in the jitter buffer
+  METRIC_PACING_JITTER, // Deviation of each send gap from the packet time (us)
+  METRIC_SEND_LATENCY,  // Time each packet spends in the socket send call (us)
+  METRIC_CLOCK_DRIFT,   // Remote sample clock against the speaker's (ppm)
+  METRIC_COUNT,
+};
+
+// WebSocketsClient keeps its TCP connection to itself; this reaches the
+// socket underneath so signaling can be marked like the audio
+class SignalingClient : public WebSocketsClient {
+ public:
+  int fd() { return _client.tcp != nullptr ? _client.tcp->fd() : -1; }
+};
+
 class IntercomComponent : public Component {
  public:
   void setup() override;
@@ -27,6 +71,45 @@ class IntercomComponent : public Component {
   void set_signaling_port(int port) { signaling_port_ = port; }
   void set_signaling_path(const std::string &path) { signaling_path_ = path; }
   void set_audio_port(int port) { audio_port_ = port; }
+  // Seconds between telemetry frames (0 disables telemetry)
+  void set_telemetry_interval(uint32_t seconds) { telemetry_interval_s_ = seconds; }
+  // Send telemetry as UDP datagrams to a collector instead of over the
+  // signaling WebSocket
+  void set_telemetry_collector(const std::string &host, uint16_t port) {
+    telemetry_host_ = host;
+    telemetry_port_ = port;
+  }
+  // Range the congestion controller steers in, and its ceiling while the
+  // Wi-Fi RSSI is weak
+  void set_bitrate_range(uint32_t min_bps, uint32_t max_bps, uint32_t weak_max_bps) {
+    min_bitrate_bps_ = min_bps;
+    max_bitrate_bps_ = max_bps;
+    weak_bitrate_bps_ = weak_max_bps;
+  }
+  // Most earlier frames carried in each packet (RFC 2198) when the
+  // congestion controller asks for FEC; 0 disables redundancy. Each level
+  // costs one more copy of the audio.
+  void set_redundancy_depth(uint8_t depth) { redundancy_depth_ = depth < RED_MAX_DEPTH ? depth : RED_MAX_DEPTH; }
+  // Refuse calls whose SDP offers no SRTP key we can use (the default);
+  // false falls back to cleartext RTP with such peers
+  void set_srtp_required(bool required) { srtp_required_ = required; }
+  // DiffServ code points for the audio socket (RTP, RTCP and STUN) and the
+  // signaling WebSocket, which pick the Wi-Fi queue each waits in; see
+  // udp_socket.h. 0 leaves that traffic best effort.
+  void set_dscp(uint8_t audio, uint8_t signaling) {
+    audio_dscp_ = audio;
+    signaling_dscp_ = signaling;
+  }
+  // Keep the radio awake (WIFI_PS_NONE) while a call streams, so packets
+  // for us are not held at the access point until the next DTIM beacon.
+  // The mode from before the call comes back when it ends.
+  void set_power_save_off_in_call(bool off) { power_save_off_in_call_ = off; }
+  
+  // Congestion controller decisions
+  void set_target_bitrate_sensor(sensor::Sensor *sensor) { target_bitrate_sensor_ = sensor; }
+  void set_packet_time_sensor(sensor::Sensor *sensor) { packet_time_sensor_ = sensor; }
+  void set_fec_depth_sensor(sensor::Sensor *sensor) { fec_depth_sensor_ = sensor; }
+  void set_congestion_state_text_sensor(text_sensor::TextSensor *sensor) { congestion_state_text_sensor_ = sensor; }
   
   // Call control
   void start_call(const std::string &target_device_id);
@@ -38,14 +121,16 @@ class IntercomComponent : public Component {
   bool is_in_call() const { return in_call_; }
   bool is_muted() const { return muted_; }
   std::string get_client_id() const { return client_id_; }
+  const BitrateDecision &get_bitrate_decision() const { return bitrate_.decision(); }
 
  protected:
   // Signaling
   std::string signaling_server_ = "ha.shafferco.com";
   int signaling_port_ = 1880;
   std::string signaling_path_ = "/endpoint/webrtc";
-  WebSocketsClient web_socket_;
+  SignalingClient web_socket_;
   bool connected_ = false;
+  uint8_t signaling_dscp_ = DSCP_AF41;
   
   // Device identification
   std::string client_id_;
@@ -60,14 +145,133 @@ class IntercomComponent : public Component {
   
   // Audio
   int audio_port_ = 5004;
-  WiFiUDP udp_;
-  IPAddress remote_audio_ip_;
-  int remote_audio_port_ = 0;
+  UdpSocket audio_socket_;
+  uint32_t remote_audio_ip_ = 0;  // Host order
+  uint16_t remote_audio_port_ = 0;
+  WiFiUDP telemetry_udp_;
+  uint8_t audio_dscp_ = DSCP_EF;
+  bool power_save_off_in_call_ = true;
+  bool power_save_held_ = false;  // Power save is off for the call and saved_power_save_ is to come back
+  wifi_ps_type_t saved_power_save_ = WIFI_PS_MIN_MODEM;
+  
+  // Audio runs in two tasks of its own, leaving loop() to signaling: one
+  // paced by the mic captures and sends, the other waits on the socket and
+  // plays. Neither blocks on I/O for longer than a couple of packet times,
+  // so a stop is noticed promptly. While they stream, state they share with
+  // loop() is only touched under state_lock_.
+  static constexpr uint32_t AUDIO_TASK_STACK = 4096;
+  static constexpr UBaseType_t AUDIO_TASK_PRIORITY = 5;  // Above the loop task
+  static constexpr uint32_t AUDIO_RECEIVE_TIMEOUT_MS = 20;
+  static constexpr uint32_t AUDIO_STOP_TIMEOUT_MS = 250;
+  TaskHandle_t capture_task_handle_{nullptr};
+  TaskHandle_t render_task_handle_{nullptr};
+  Mutex state_lock_;
+  std::atomic<bool> streaming_{false};
+  std::atomic<bool> capture_busy_{false};
+  std::atomic<bool> render_busy_{false};
+  std::atomic<bool> rtcp_feedback_{false};  // The render task got a report for loop() to act on
+  
+  // Packets leave on a timer, one packet time apart, rather than whenever
+  // capture finishes one. The first after a gap waits PACER_HOLD_US for
+  // capture to settle; more than PACER_BACKLOG waiting go out at once.
+  static constexpr uint32_t PACER_HOLD_US = 10000;
+  static constexpr size_t PACER_BACKLOG = 4;
+  static constexpr uint32_t PACER_IDLE_US = 5000;  // How often to look while nothing is queued
+  TxPacer pacer_;
+  esp_timer_handle_t pace_timer_handle_{nullptr};
+  std::atomic<bool> pace_busy_{false};
+  std::atomic<uint32_t> send_latency_us_{0};  // Smoothed like the pacing jitter
   
   // I2S Configuration
   static constexpr int SAMPLE_RATE = 16000;
   static constexpr int BITS_PER_SAMPLE = I2S_BITS_PER_SAMPLE_16BIT;
   static constexpr int BUFFER_SIZE = 1024;
+  // The mic's DMA blocks are one 20 ms packet, so capture hands packets
+  // over evenly instead of three at a time
+  static constexpr int CAPTURE_DMA_SAMPLES = SAMPLE_RATE / 50;
+  // Packet buffers live with the component rather than on the loop task's
+  // stack (2 KB each) and are reused for every packet
+  int16_t tx_audio_buffer_[BUFFER_SIZE];
+  // Received RTP or RTCP datagram; the audio payload is played in place
+  uint8_t rx_packet_[RTP_MAX_HEADER_SIZE + sizeof(int16_t) * BUFFER_SIZE + SRTP_MAX_TAG];
+  
+  // RTP/RTCP, multiplexed on audio_port_. The payload is 16-bit PCM
+  // (L16, network byte order) under a dynamic payload type; these are the
+  // numbers we offer, an answer to someone else's offer uses theirs.
+  static constexpr uint8_t RTP_PAYLOAD_TYPE = 96;
+  static constexpr uint8_t RTP_RED_PAYLOAD_TYPE = 97;
+  static constexpr size_t MAX_SDP = 512;
+  static const SdpCodecCap AUDIO_CODECS[];
+  static const size_t AUDIO_CODEC_COUNT;
+  static constexpr size_t MAX_RTP_PAYLOAD = 1400;  // Keeps RED packets within one Ethernet MTU
+  RtpSession rtp_;
+  uint8_t rtp_header_[RTP_HEADER_SIZE];
+  // Longest plain L16 packet time, in whole 10 ms, whose header, payload
+  // and SRTP tag fit one pacer slot: 40 ms at 16 kHz
+  static constexpr uint8_t MAX_PLAIN_PTIME_MS =
+      (TxPacer::MAX_PACKET - RTP_HEADER_SIZE - SRTP_MAX_TAG) / (SAMPLE_RATE / 1000 * sizeof(int16_t)) / 10 * 10;
+  uint8_t rtcp_packet_[RTCP_MAX_PACKET_SIZE + SRTCP_TRAILER];
+  int32_t reported_lost_ = 0;
+  
+  // Negotiated from the remote's SDP
+  std::string remote_sdp_;  // Offer waiting for accept_call()
+  bool offer_pending_ = false;  // start_call() sends an offer once the room is ready
+  uint8_t payload_type_ = RTP_PAYLOAD_TYPE;
+  uint8_t red_payload_type_ = 0;  // 0 when the remote has no RED
+  uint8_t remote_ptime_ = 0;  // Longest packet time the remote asked for; 0 if it did not
+  bool rtcp_mux_ = true;
+  
+  // SRTP, keyed with SDES: we send under our key and receive under the
+  // remote's
+  bool srtp_required_ = true;
+  uint8_t srtp_local_key_[SRTP_MASTER_SIZE];
+  char srtp_local_key_base64_[SRTP_MASTER_BASE64];
+  SrtpSuite srtp_suite_ = SrtpSuite::AES_CM_128_HMAC_SHA1_80;
+  uint8_t srtp_tag_ = 1;
+  SrtpContext srtp_tx_;
+  SrtpContext srtp_rx_;
+  uint8_t tx_srtp_tag_[SRTP_MAX_TAG];
+  
+  // ICE-lite on audio_port_: remote_audio_ip_/port_ follow the pair it
+  // selects, and are cleared when consent is lost
+  IceLite ice_;
+  uint32_t ice_generation_ = 0;
+  uint8_t stun_packet_[IceLite::MAX_MESSAGE];    // Consent checks from loop()
+  uint8_t stun_response_[IceLite::MAX_MESSAGE];  // Answers from the render task
+  
+  // Redundancy out, reordering and recovery in
+  uint8_t redundancy_depth_ = 2;
+  RedEncoder red_;
+  uint8_t tx_red_payload_[MAX_RTP_PAYLOAD];
+  JitterBuffer jitter_buffer_;
+  uint32_t reported_recovered_ = 0;
+  
+  // Playout follows the remote's sample clock: each frame is resampled by
+  // the ratio that keeps the speaker's queue PLAYOUT_TARGET_SAMPLES deep
+  static constexpr uint32_t PLAYOUT_TARGET_SAMPLES = SAMPLE_RATE / 25;  // 40 ms
+  DriftEstimator drift_;
+  DriftResampler resampler_;
+  int16_t playout_[DriftResampler::max_output(JitterBuffer::MAX_FRAME / sizeof(int16_t))];
+  
+  // Congestion control. The encoder bitrate applies once a compressed
+  // codec is in the path; raw PCM follows the packet time and FEC depth.
+  // Defaults span wideband Opus up to the PCM rate.
+  BitrateController bitrate_;
+  uint32_t min_bitrate_bps_ = 16000;
+  uint32_t max_bitrate_bps_ = SAMPLE_RATE * 16;
+  uint32_t weak_bitrate_bps_ = 32000;
+  sensor::Sensor *target_bitrate_sensor_{nullptr};
+  sensor::Sensor *packet_time_sensor_{nullptr};
+  sensor::Sensor *fec_depth_sensor_{nullptr};
+  text_sensor::TextSensor *congestion_state_text_sensor_{nullptr};
+  
+  // Telemetry: one snapshot per second, sent in batches
+  static constexpr uint32_t TELEMETRY_SNAPSHOT_MS = 1000;
+  Telemetry telemetry_;
+  uint32_t telemetry_interval_s_ = 10;
+  uint32_t telemetry_pending_ = 0;  // Snapshots in the open batch
+  std::string telemetry_host_;
+  uint16_t telemetry_port_ = 0;
   
   // I2S Pins (adjust for your hardware)
   static constexpr int I2S_MIC_BCLK = 32;
@@ -83,15 +287,37 @@ class IntercomComponent : public Component {
   void generate_session_id_();
   void connect_to_signaling_();
   void handle_websocket_event_(WStype_t type, uint8_t *payload, size_t length);
-  void handle_signaling_message_(const std::string &message);
+  void handle_signaling_message_(std::string message);
   void send_join_message_();
   void send_ready_message_();
   void send_offer_message_(const std::string &sdp);
   void send_answer_message_(const std::string &sdp);
   void send_leave_message_();
+  void send_offer_();
+  bool apply_remote_sdp_(const char *sdp, size_t len, SdpNegotiation *negotiation);
+  size_t write_local_sdp_(const SdpNegotiation *answer, char *buf, size_t cap);
+  void restart_ice_();
+  void restart_srtp_();
+  void poll_ice_();
+  void update_ice_path_();
   void setup_i2s_();
+  void start_audio_();
+  void stop_audio_();
+  void hold_power_save_off_();
+  void restore_power_save_();
+  static void capture_task_(void *arg);
+  static void render_task_(void *arg);
+  static void pace_timer_(void *arg);
+  void pace_();
   void send_audio_packet_();
   void receive_audio_packet_();
+  void render_audio_();
+  void start_rtp_session_();
+  void send_rtcp_();
+  void on_rtcp_feedback_();
+  void publish_bitrate_decision_();
+  void telemetry_tick_();
+  void send_telemetry_();
   
   // Static callback for WebSocket
   static void websocket_event_(WStype_t type, uint8_t *payload, size_t length);
@@ -0,0 +1,97 @@
+#include "jitter_buffer.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace intercom {
+
+void JitterBuffer::reset() {
+  for (Slot &slot : slots_) {
+    slot.valid = false;
+  }
+  count_ = 0;
+  started_ = false;
+  stats_ = JitterBufferStats{};
+}
+
+bool JitterBuffer::put(uint16_t seq, const uint8_t *data, size_t len, bool redundant) {
+  if (len == 0 || len > MAX_FRAME) {
+    return false;
+  }
+  if (!started_) {
+    started_ = true;
+    next_seq_ = seq;
+    newest_seq_ = seq;
+  }
+
+  int16_t ahead = (int16_t) (uint16_t) (seq - next_seq_);
+  if (ahead < 0) {
+    // Redundant copies of frames already played or given up on land here
+    // on every packet; only a primary arriving late is news
+    if (!redundant) {
+      stats_.late++;
+    }
+    return false;
+  }
+  if ((size_t) ahead >= SLOTS) {
+    // Jumped further than the buffer reaches: give up on everything
+    // before the window that ends at this frame
+    uint16_t first = seq - (SLOTS - 1);
+    for (Slot &old : slots_) {
+      if (old.valid && (int16_t) (uint16_t) (old.seq - first) < 0) {
+        old.valid = false;
+        count_--;
+      }
+    }
+    stats_.lost += (uint16_t) (first - next_seq_);
+    next_seq_ = first;
+  }
+
+  Slot &slot = slots_[seq % SLOTS];
+  if (slot.valid && slot.seq == seq) {
+    stats_.duplicates++;
+    return false;
+  }
+  slot.seq = seq;
+  slot.valid = true;
+  slot.redundant = redundant;
+  slot.len = len;
+  memcpy(slot.data, data, len);
+  count_++;
+  if ((int16_t) (uint16_t) (seq - newest_seq_) > 0) {
+    newest_seq_ = seq;
+  }
+  return true;
+}
+
+bool JitterBuffer::pop(uint8_t **data, size_t *len) {
+  if (!started_) {
+    return false;
+  }
+  Slot &slot = slots_[next_seq_ % SLOTS];
+  if (slot.valid && slot.seq == next_seq_) {
+    slot.valid = false;
+    count_--;
+    next_seq_++;
+    stats_.played++;
+    if (slot.redundant) {
+      stats_.recovered++;
+    }
+    *data = slot.data;
+    *len = slot.len;
+    return true;
+  }
+  // Missing: wait while fewer than `hold` later frames are here, since the
+  // next packets may still carry it as redundancy
+  if (count_ > 0 && (int16_t) (uint16_t) (newest_seq_ - next_seq_) > (int16_t) hold_) {
+    next_seq_++;
+    stats_.lost++;
+    *data = nullptr;
+    *len = 0;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace intercom
+}  // namespace esphome
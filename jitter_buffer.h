@@ -0,0 +1,71 @@
+/*
+ * Jitter Buffer
+ * Reorders received audio frames by RTP sequence number and plays them out
+ * in order. A missing frame is waited for until `hold` later frames have
+ * arrived, which is exactly long enough for RFC 2198 redundancy (rtp_red.h)
+ * of that depth to bring it back; after that it is given up as lost.
+ *
+ * Frames recovered from redundancy go in like any other, so the playout
+ * side never sees the difference. With a hold of 0 frames are played as
+ * soon as they arrive, as the receive path always did.
+ *
+ * Plain C++ with no platform calls, so the same code runs on the host.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace intercom {
+
+struct JitterBufferStats {
+  uint32_t played{0};      // Frames handed to playout, recovered ones included
+  uint32_t recovered{0};   // Of those, frames that came from redundancy
+  uint32_t lost{0};        // Frames given up on
+  uint32_t late{0};        // Arrived after their turn had passed
+  uint32_t duplicates{0};  // Already buffered (e.g. the primary after its redundant copy)
+};
+
+class JitterBuffer {
+ public:
+  static constexpr size_t SLOTS = 8;
+  static constexpr size_t MAX_FRAME = 1920;  // 60 ms of 16 kHz 16-bit PCM
+
+  void reset();
+  // Later frames to wait for before giving up on a missing one
+  void set_hold(uint8_t frames) { hold_ = frames < SLOTS - 1 ? frames : SLOTS - 1; }
+  uint8_t hold() const { return hold_; }
+
+  // Store a frame. Returns false if it was dropped (late, duplicate or too
+  // long for a slot).
+  bool put(uint16_t seq, const uint8_t *data, size_t len, bool redundant);
+  // Take the next frame in sequence. Returns false when nothing is ready.
+  // On true, *len is 0 if the frame was lost; *data stays valid until the
+  // next put() and may be converted in place.
+  bool pop(uint8_t **data, size_t *len);
+
+  size_t depth() const { return count_; }
+  const JitterBufferStats &stats() const { return stats_; }
+
+ protected:
+  struct Slot {
+    uint16_t seq;
+    bool valid;
+    bool redundant;
+    size_t len;
+    uint8_t data[MAX_FRAME];
+  };
+
+  Slot slots_[SLOTS]{};
+  size_t count_{0};
+  bool started_{false};
+  uint16_t next_seq_{0};
+  uint16_t newest_seq_{0};
+  uint8_t hold_{0};
+  JitterBufferStats stats_;
+};
+
+}  // namespace intercom
+}  // namespace esphome
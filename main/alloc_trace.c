@@ -0,0 +1,220 @@
+/*
+ * Heap Allocation Tracer Implementation
+ * The hooks run on the allocating task, possibly with the flash cache
+ * disabled, so they live in IRAM and only touch DRAM state
+ *
+ * The free hook runs after the block has gone back to the heap, so its
+ * size can no longer be asked for. Blocks allocated outside the idle phase
+ * are remembered with their size in a small open-addressed table instead;
+ * the table is emptied whenever the tracer goes back to idle, so
+ * long-lived boot allocations never crowd it.
+ */
+
+#include "alloc_trace.h"
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "alloc_trace";
+
+static const char *const PHASE_NAMES[ALLOC_PHASE_COUNT] = {
+    [ALLOC_PHASE_IDLE] = "idle",
+    [ALLOC_PHASE_SETUP] = "setup",
+    [ALLOC_PHASE_CONNECTED] = "connected",
+    [ALLOC_PHASE_TEARDOWN] = "teardown",
+};
+
+#define LIVE_SLOTS 256           // Power of two
+#define LIVE_MASK (LIVE_SLOTS - 1)
+
+typedef struct {
+    void *ptr;                  // NULL when free
+    uint32_t size;
+} live_block_t;
+
+static DRAM_ATTR struct {
+    alloc_phase_stats_t phases[ALLOC_PHASE_COUNT];
+    alloc_phase_t phase;
+    int64_t net_bytes;          // Since the current phase started
+    TaskHandle_t watched[ALLOC_TRACE_MAX_WATCHED];
+    live_block_t live[LIVE_SLOTS];
+} s_trace = {0};
+
+static DRAM_ATTR portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+bool alloc_trace_enabled(void)
+{
+#ifdef CONFIG_HEAP_USE_HOOKS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void alloc_trace_set_phase(alloc_phase_t phase)
+{
+    if (phase >= ALLOC_PHASE_COUNT) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_trace.phase = phase;
+    s_trace.net_bytes = 0;
+    if (phase == ALLOC_PHASE_IDLE) {
+        memset(s_trace.live, 0, sizeof(s_trace.live));
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+alloc_phase_t alloc_trace_get_phase(void)
+{
+    return s_trace.phase;
+}
+
+static void set_watched(TaskHandle_t from, TaskHandle_t to)
+{
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < ALLOC_TRACE_MAX_WATCHED; i++) {
+        if (s_trace.watched[i] == from) {
+            s_trace.watched[i] = to;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void alloc_trace_watch_current_task(void)
+{
+    set_watched(NULL, xTaskGetCurrentTaskHandle());
+}
+
+void alloc_trace_unwatch_current_task(void)
+{
+    set_watched(xTaskGetCurrentTaskHandle(), NULL);
+}
+
+void alloc_trace_take(alloc_phase_stats_t stats[ALLOC_PHASE_COUNT])
+{
+    portENTER_CRITICAL(&s_lock);
+    memcpy(stats, s_trace.phases, sizeof(s_trace.phases));
+    memset(s_trace.phases, 0, sizeof(s_trace.phases));
+    s_trace.net_bytes = 0;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+uint32_t alloc_trace_log(const alloc_phase_stats_t stats[ALLOC_PHASE_COUNT])
+{
+    for (size_t p = 0; p < ALLOC_PHASE_COUNT; p++) {
+        ESP_LOGI(TAG, "%-9s %lu allocs, %lu frees, %llu bytes, peak +%lu bytes, %lu from audio tasks, %lu untracked",
+                 PHASE_NAMES[p], (unsigned long)stats[p].allocs, (unsigned long)stats[p].frees,
+                 (unsigned long long)stats[p].bytes, (unsigned long)stats[p].peak_bytes,
+                 (unsigned long)stats[p].audio_allocs, (unsigned long)stats[p].untracked);
+    }
+    uint32_t audio = stats[ALLOC_PHASE_CONNECTED].audio_allocs;
+    if (audio > 0) {
+        ESP_LOGW(TAG, "Audio tasks allocated %lu times while connected", (unsigned long)audio);
+    }
+    return audio;
+}
+
+#ifdef CONFIG_HEAP_USE_HOOKS
+static bool IRAM_ATTR is_watched_task(void)
+{
+    if (xPortInIsrContext()) {
+        return false;
+    }
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (size_t i = 0; i < ALLOC_TRACE_MAX_WATCHED; i++) {
+        if (s_trace.watched[i] == self) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline IRAM_ATTR size_t live_home(const void *ptr)
+{
+    // Heap blocks are at least 4-byte aligned; Fibonacci hashing spreads the rest
+    return (size_t)(((uint32_t)(uintptr_t)ptr >> 2) * 2654435761u >> 24) & LIVE_MASK;
+}
+
+// Callers hold s_lock
+static bool IRAM_ATTR live_insert(void *ptr, size_t size)
+{
+    size_t i = live_home(ptr);
+    for (size_t n = 0; n < LIVE_SLOTS; n++, i = (i + 1) & LIVE_MASK) {
+        if (!s_trace.live[i].ptr) {
+            s_trace.live[i] = (live_block_t){.ptr = ptr, .size = (uint32_t)size};
+            return true;
+        }
+    }
+    return false;
+}
+
+// Size of a remembered block, forgetting it; 0 if it was never recorded
+static size_t IRAM_ATTR live_remove(const void *ptr)
+{
+    size_t i = live_home(ptr);
+    size_t n = 0;
+    while (s_trace.live[i].ptr != ptr) {
+        if (!s_trace.live[i].ptr || ++n == LIVE_SLOTS) {
+            return 0;
+        }
+        i = (i + 1) & LIVE_MASK;
+    }
+    size_t size = s_trace.live[i].size;
+    // Backward-shift deletion: pull later entries of the probe run into the
+    // hole unless that would move them before their home slot. The hole is
+    // always empty, so the scan stops even in a full table.
+    s_trace.live[i].ptr = NULL;
+    for (size_t j = (i + 1) & LIVE_MASK; s_trace.live[j].ptr; j = (j + 1) & LIVE_MASK) {
+        size_t home = live_home(s_trace.live[j].ptr);
+        if (((j - home) & LIVE_MASK) >= ((j - i) & LIVE_MASK)) {
+            s_trace.live[i] = s_trace.live[j];
+            s_trace.live[j].ptr = NULL;
+            i = j;
+        }
+    }
+    return size;
+}
+
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    if (!ptr) {
+        return;
+    }
+    bool audio = is_watched_task();
+    portENTER_CRITICAL_SAFE(&s_lock);
+    alloc_phase_stats_t *s = &s_trace.phases[s_trace.phase];
+    s->allocs++;
+    s->bytes += size;
+    if (audio) {
+        s->audio_allocs++;
+    }
+    if (s_trace.phase != ALLOC_PHASE_IDLE) {
+        if (live_insert(ptr, size)) {
+            s_trace.net_bytes += size;
+            if (s_trace.net_bytes > (int64_t)s->peak_bytes) {
+                s->peak_bytes = (uint32_t)s_trace.net_bytes;
+            }
+        } else {
+            s->untracked++;
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    // Runs after the block went back to the heap, so its size comes from
+    // the table rather than the heap
+    portENTER_CRITICAL_SAFE(&s_lock);
+    s_trace.phases[s_trace.phase].frees++;
+    s_trace.net_bytes -= (int64_t)live_remove(ptr);
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+#endif
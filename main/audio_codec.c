@@ -1,39 +1,461 @@
 /*
  * Audio Codec Configuration Implementation
  * ES8311 DAC and ES7210 ADC for Waveshare ESP32-P4-86
- * 
- * Note: This is a basic implementation. Full codec initialization
- * requires writing specific register values. Refer to datasheets:
+ *
+ * Register sequences are tables of bursts: runs of consecutive registers
+ * written in one I2C transaction and read back to verify. Clock dividers
+ * come from per sample rate / MCLK ratio tables. Runtime changes go through
+ * a per-codec register shadow: unchanged values never reach the bus and
+ * staged changes are flushed as coalesced bursts. Refer to datasheets:
  * - ES8311: https://www.everest-semi.com/pdf/ES8311%20PB%20V1.0.pdf
  * - ES7210: https://www.everest-semi.com/pdf/ES7210%20PB%20V1.5.pdf
  */
 
 #include "audio_codec.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "driver/i2c_master.h"
 #include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include <string.h>
 
 static const char *TAG = "audio_codec";
 
+#define CODEC_BURST_MAX 8
+#define CODEC_REG_COUNT 256
+// Clean registers a flush may rewrite to join two dirty runs; each costs one
+// byte, while a separate transaction costs address + register bytes and a
+// START/STOP
+#define CODEC_FLUSH_MAX_GAP 2
+
+// Burst flags
+#define BURST_VERIFY 0x01  // Read back and compare after writing
+#define BURST_RESET  0x02  // Resets the chip: register shadow becomes stale
+
+// Registers touched at runtime
+#define ES8311_REG_RESET      0x00
+#define ES8311_REG_DAC_VOLUME 0x32
+#define ES7210_REG_RESET      0x00
+
+#define CODEC_STANDBY_MAX 8
+
+// ES7210 SDP and MIC power depend on how many mics are captured. Up to two
+// fit one I2S frame on SDOUT1; four need TDM.
+#if AUDIO_MIC_CHANNELS == 4
+#define ES7210_SDP_MODE     0x02    // TDM, MIC1-4 in slots 0-3
+#define ES7210_MIC2_POWER   0x08
+#define ES7210_MIC34_POWER  0x00
+#elif AUDIO_MIC_CHANNELS == 2
+#define ES7210_SDP_MODE     0x00    // I2S, MIC1 left, MIC2 right
+#define ES7210_MIC2_POWER   0x08
+#define ES7210_MIC34_POWER  0xFF
+#elif AUDIO_MIC_CHANNELS == 1
+#define ES7210_SDP_MODE     0x00
+#define ES7210_MIC2_POWER   0xFF
+#define ES7210_MIC34_POWER  0xFF
+#else
+#error "AUDIO_MIC_CHANNELS must be 1, 2 or 4"
+#endif
+
+typedef struct {
+    uint8_t reg;        // First register
+    uint8_t len;        // Consecutive registers written
+    uint8_t flags;
+    uint8_t delay_ms;   // Settle time after the write
+    uint8_t val[CODEC_BURST_MAX];
+} codec_burst_t;
+
+#define BURST(r, f, d, ...) \
+    { .reg = (r), .len = sizeof((uint8_t[]){__VA_ARGS__}), .flags = (f), .delay_ms = (d), .val = {__VA_ARGS__} }
+
+typedef struct {
+    const char *name;
+    audio_codec_bus_t bus;
+    bool attached;
+    bool burst_ok;      // Cleared if the chip does not auto-increment
+    uint8_t shadow[CODEC_REG_COUNT];
+    uint32_t valid[CODEC_REG_COUNT / 32];   // Shadow value is known
+    uint32_t dirty[CODEC_REG_COUNT / 32];   // Staged in the shadow, not yet written
+    bool in_standby;
+    uint8_t saved[CODEC_STANDBY_MAX];       // Active values of the standby registers
+} codec_dev_t;
+
 static i2c_master_bus_handle_t i2c_bus_handle = NULL;
 static i2c_master_dev_handle_t es8311_handle = NULL;
 static i2c_master_dev_handle_t es7210_handle = NULL;
 
-// I2C write helper
-static esp_err_t i2c_write_reg(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t value)
+static codec_dev_t s_codecs[AUDIO_CODEC_COUNT] = {
+    [AUDIO_CODEC_ES8311] = { .name = "ES8311" },
+    [AUDIO_CODEC_ES7210] = { .name = "ES7210" },
+};
+static audio_codec_stats_t s_stats;
+
+/* ES8311 clock manager REG02..REG08 for a given fs and MCLK/fs ratio */
+typedef struct {
+    uint32_t sample_rate;
+    uint16_t mclk_ratio;
+    uint8_t regs[7];    // pre_div/mult, fs_mode/adc_osr, dac_osr, adc/dac_div, bclk_div, lrck_h, lrck_l
+} es8311_clock_t;
+
+static const es8311_clock_t ES8311_CLOCKS[] = {
+    {  8000,  256, { 0x00, 0x10, 0x10, 0x00, 0x03, 0x00, 0xFF } },
+    { 16000,  256, { 0x00, 0x10, 0x10, 0x00, 0x03, 0x00, 0xFF } },
+    { 32000,  256, { 0x00, 0x10, 0x10, 0x00, 0x03, 0x00, 0xFF } },
+    { 48000,  256, { 0x00, 0x10, 0x10, 0x00, 0x03, 0x00, 0xFF } },
+    {  8000, 1536, { 0xA0, 0x10, 0x10, 0x00, 0x03, 0x00, 0xFF } },  // pre_div 6
+    { 16000,  768, { 0x40, 0x10, 0x10, 0x00, 0x03, 0x00, 0xFF } },  // pre_div 3
+};
+
+/* ES7210 REG02 (adc_div | doubler | dll), REG04/05 (LRCK divider), REG07 (OSR) */
+typedef struct {
+    uint32_t sample_rate;
+    uint16_t mclk_ratio;
+    uint8_t clk_div;
+    uint8_t lrck_h;
+    uint8_t lrck_l;
+    uint8_t osr;
+} es7210_clock_t;
+
+static const es7210_clock_t ES7210_CLOCKS[] = {
+    {  8000,  256, 0xC1, 0x01, 0x00, 0x20 },
+    { 16000,  256, 0xC1, 0x01, 0x00, 0x20 },
+    { 32000,  256, 0xC1, 0x01, 0x00, 0x20 },
+    { 48000,  256, 0x81, 0x01, 0x00, 0x20 },
+    {  8000, 1536, 0x83, 0x06, 0x00, 0x20 },
+    { 16000,  768, 0xC3, 0x03, 0x00, 0x20 },
+};
+
+static const codec_burst_t ES8311_RESET_SEQ[] = {
+    BURST(0x44, BURST_VERIFY, 0, 0x08),             // GPIO: ADC-to-DAC loopback off
+    BURST(0x00, BURST_RESET, 20, 0x1F),             // Reset all blocks
+    BURST(0x00, 0, 0, 0x00),
+};
+
+static const codec_burst_t ES8311_INIT_SEQ[] = {
+    BURST(0x09, BURST_VERIFY, 0, 0x0C, 0x0C),       // SDP in/out: I2S, 16-bit
+    BURST(0x0B, BURST_VERIFY, 0, 0x00, 0x00),       // System
+    BURST(0x10, BURST_VERIFY, 0, 0x1F, 0x7F, 0x00, 0x10, 0x1A),  // Analog bias, VMID, HP drive
+    BURST(0x0D, BURST_VERIFY, 0, 0x01, 0x02),       // Power up analog, enable ADC/PGA
+    BURST(0x15, BURST_VERIFY, 0, 0x40, 0x24, 0xBF), // ADC ramp, gain, volume 0 dB
+    BURST(0x1B, BURST_VERIFY, 0, 0x0A, 0x6A),       // ADC HPF
+    BURST(0x31, BURST_VERIFY, 0, 0x00, 0xBF),       // DAC unmute, volume 0 dB
+    BURST(0x37, BURST_VERIFY, 0, 0x08),             // DAC ramp, EQ bypass
+    BURST(0x45, BURST_VERIFY, 0, 0x00),
+    BURST(0x00, 0, 0, 0x80),                        // Chip on, slave mode
+};
+
+static const codec_burst_t ES7210_RESET_SEQ[] = {
+    BURST(0x00, BURST_RESET, 10, 0xFF),             // Software reset
+    BURST(0x00, 0, 0, 0x41),
+    BURST(0x01, BURST_VERIFY, 0, 0x3F),             // Gate all clocks while configuring
+};
+
+static const codec_burst_t ES7210_INIT_SEQ[] = {
+    BURST(0x09, BURST_VERIFY, 0, 0x30, 0x30),       // Power-up/down state timing
+    BURST(0x20, BURST_VERIFY, 0, 0x0A, 0x2A, 0x0A, 0x2A),  // ADC HPF
+    BURST(0x11, BURST_VERIFY, 0, 0x60, ES7210_SDP_MODE),   // SDP: I2S, 16-bit
+    BURST(0x40, BURST_VERIFY, 0, 0xC3, 0x70, 0x70), // Analog power, MIC bias 2.87 V
+    BURST(0x43, BURST_VERIFY, 0, 0x1A, 0x1A, 0x1A, 0x1A),  // MIC1-4 PGA +30 dB
+    BURST(0x47, BURST_VERIFY, 0, 0x08, ES7210_MIC2_POWER, 0x08, 0x08),  // MIC1-4 power
+    BURST(0x4B, BURST_VERIFY, 0, 0x00, ES7210_MIC34_POWER),  // MIC1/2 on, MIC3/4 per channel count
+    BURST(0x06, BURST_VERIFY, 0, 0x00),             // Digital power on
+    BURST(0x01, BURST_VERIFY, 0, 0x00),             // Ungate clocks
+    BURST(0x00, 0, 0, 0x71),                        // Restart state machine
+    BURST(0x00, 0, 0, 0x41),
+};
+
+/*
+ * Standby: analog blocks and internal clocks off, everything else left as
+ * configured. Leaving standby restores these registers to the values they
+ * had before, so it costs a few coalesced writes instead of a full init.
+ * Entering standby writes the entries in table order.
+ */
+typedef struct {
+    uint8_t reg;
+    uint8_t value;
+} codec_reg_val_t;
+
+static const codec_reg_val_t ES8311_STANDBY[] = {
+    { 0x32, 0x00 },     // DAC volume to mute first, avoids a pop (keep at index 0)
+    { 0x0D, 0xFA },     // Analog power down, VMID kept
+    { 0x0E, 0xFF },     // PGA/ADC modulator off
+    { 0x12, 0x02 },     // DAC off
+    { 0x14, 0x00 },     // Analog PGA input off
+    { 0x01, 0x00 },     // Gate internal clocks
+};
+
+static const codec_reg_val_t ES7210_STANDBY[] = {
+    { 0x4B, 0xFF },     // MIC1/2 power off
+    { 0x4C, 0xFF },     // MIC3/4 power off
+    { 0x40, 0xC0 },     // Analog reference off
+    { 0x06, 0x07 },     // Digital power down
+    { 0x01, 0x7F },     // Gate all clocks
+};
+
+// I2C implementation of audio_codec_bus_t
+static esp_err_t i2c_bus_write(void *ctx, uint8_t reg, const uint8_t *data, size_t len, uint32_t timeout_ms)
+{
+    uint8_t buf[1 + CODEC_BURST_MAX];
+    if (len > CODEC_BURST_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    buf[0] = reg;
+    memcpy(&buf[1], data, len);
+    return i2c_master_transmit((i2c_master_dev_handle_t)ctx, buf, len + 1, (int)timeout_ms);
+}
+
+static esp_err_t i2c_bus_read(void *ctx, uint8_t reg, uint8_t *data, size_t len, uint32_t timeout_ms)
 {
-    uint8_t data[2] = {reg, value};
-    return i2c_master_transmit(dev_handle, data, sizeof(data), -1);
+    return i2c_master_transmit_receive((i2c_master_dev_handle_t)ctx, &reg, 1, data, len, (int)timeout_ms);
 }
 
-// I2C read helper
-static esp_err_t i2c_read_reg(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t *value)
+static inline bool reg_bit(const uint32_t *map, unsigned reg)
 {
-    esp_err_t ret = i2c_master_transmit_receive(dev_handle, &reg, 1, value, 1, -1);
+    return (map[reg / 32] >> (reg % 32)) & 1;
+}
+
+static inline void reg_bit_set(uint32_t *map, unsigned reg, bool on)
+{
+    if (on) {
+        map[reg / 32] |= 1u << (reg % 32);
+    } else {
+        map[reg / 32] &= ~(1u << (reg % 32));
+    }
+}
+
+static void codec_invalidate(codec_dev_t *codec)
+{
+    memset(codec->valid, 0, sizeof(codec->valid));
+    memset(codec->dirty, 0, sizeof(codec->dirty));
+}
+
+static esp_err_t codec_write(codec_dev_t *codec, uint8_t reg, const uint8_t *data, size_t len)
+{
+    esp_err_t ret = codec->bus.write(codec->bus.ctx, reg, data, len, AUDIO_CODEC_I2C_TIMEOUT_MS);
+    s_stats.transactions++;
+    if (ret != ESP_OK) {
+        s_stats.errors++;
+        ESP_LOGE(TAG, "%s write 0x%02X (%u bytes) failed: %s", codec->name, reg, (unsigned)len, esp_err_to_name(ret));
+        return ret;
+    }
+    s_stats.registers_written += len;
+    for (size_t i = 0; i < len && reg + i < CODEC_REG_COUNT; i++) {
+        codec->shadow[reg + i] = data[i];
+        reg_bit_set(codec->valid, reg + i, true);
+        reg_bit_set(codec->dirty, reg + i, false);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t codec_read(codec_dev_t *codec, uint8_t reg, uint8_t *data, size_t len)
+{
+    esp_err_t ret = codec->bus.read(codec->bus.ctx, reg, data, len, AUDIO_CODEC_I2C_TIMEOUT_MS);
+    s_stats.transactions++;
+    if (ret != ESP_OK) {
+        s_stats.errors++;
+        ESP_LOGE(TAG, "%s read 0x%02X failed: %s", codec->name, reg, esp_err_to_name(ret));
+        return ret;
+    }
+    for (size_t i = 0; i < len && reg + i < CODEC_REG_COUNT; i++) {
+        if (!reg_bit(codec->dirty, reg + i)) {
+            codec->shadow[reg + i] = data[i];
+            reg_bit_set(codec->valid, reg + i, true);
+        }
+    }
+    return ESP_OK;
+}
+
+// Write one register at a time - fallback for parts without auto-increment
+static esp_err_t codec_write_single(codec_dev_t *codec, const codec_burst_t *burst, bool verify)
+{
+    for (uint8_t i = 0; i < burst->len; i++) {
+        esp_err_t ret = codec_write(codec, burst->reg + i, &burst->val[i], 1);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (verify) {
+            uint8_t readback = 0;
+            ret = codec_read(codec, burst->reg + i, &readback, 1);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            if (readback != burst->val[i]) {
+                s_stats.verify_failures++;
+                ESP_LOGE(TAG, "%s reg 0x%02X: wrote 0x%02X, read 0x%02X",
+                         codec->name, burst->reg + i, burst->val[i], readback);
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t codec_write_burst(codec_dev_t *codec, const codec_burst_t *burst)
+{
+    bool verify = (burst->flags & BURST_VERIFY) != 0;
+    esp_err_t ret;
+
+    if (burst->len > 1 && !codec->burst_ok) {
+        ret = codec_write_single(codec, burst, verify);
+    } else {
+        ret = codec_write(codec, burst->reg, burst->val, burst->len);
+        if (ret == ESP_OK && verify) {
+            uint8_t readback[CODEC_BURST_MAX];
+            ret = codec_read(codec, burst->reg, readback, burst->len);
+            if (ret == ESP_OK && memcmp(readback, burst->val, burst->len) != 0) {
+                if (burst->len > 1) {
+                    // Most likely no register auto-increment: redo this and
+                    // every later burst one register at a time
+                    ESP_LOGW(TAG, "%s burst at 0x%02X did not verify, falling back to single writes",
+                             codec->name, burst->reg);
+                    codec->burst_ok = false;
+                    ret = codec_write_single(codec, burst, true);
+                } else {
+                    s_stats.verify_failures++;
+                    ESP_LOGE(TAG, "%s reg 0x%02X: wrote 0x%02X, read 0x%02X",
+                             codec->name, burst->reg, burst->val[0], readback[0]);
+                    ret = ESP_ERR_INVALID_RESPONSE;
+                }
+            }
+        }
+    }
+
+    if (ret == ESP_OK && (burst->flags & BURST_RESET)) {
+        codec_invalidate(codec);
+    }
+    if (ret == ESP_OK && burst->delay_ms > 0) {
+        vTaskDelay(pdMS_TO_TICKS(burst->delay_ms));
+    }
     return ret;
 }
 
+static esp_err_t codec_run_sequence(codec_dev_t *codec, const codec_burst_t *seq, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        esp_err_t ret = codec_write_burst(codec, &seq[i]);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
+
+// Stage (shadow & ~mask) | (value & mask) for reg. Only the shadow changes;
+// codec_flush() writes it. A change that leaves the value as it is costs
+// nothing, which keeps UI sliders and repeated power calls off the bus.
+static esp_err_t codec_update_reg(codec_dev_t *codec, uint8_t reg, uint8_t mask, uint8_t value)
+{
+    if (!codec->attached) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!reg_bit(codec->valid, reg) && mask != 0xFF) {
+        // Masked update of an unknown register: fetch it once
+        uint8_t current = 0;
+        esp_err_t ret = codec_read(codec, reg, &current, 1);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    uint8_t next = (uint8_t)((codec->shadow[reg] & ~mask) | (value & mask));
+    if (reg_bit(codec->valid, reg) && next == codec->shadow[reg]) {
+        if (!reg_bit(codec->dirty, reg)) {
+            s_stats.transactions_saved++;
+        }
+        return ESP_OK;
+    }
+
+    codec->shadow[reg] = next;
+    reg_bit_set(codec->valid, reg, true);
+    reg_bit_set(codec->dirty, reg, true);
+    return ESP_OK;
+}
+
+static bool codec_has_dirty(const codec_dev_t *codec)
+{
+    for (size_t i = 0; i < CODEC_REG_COUNT / 32; i++) {
+        if (codec->dirty[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Write every staged register. Dirty registers that are adjacent, or only
+// separated by a short run of known clean ones, go out as one burst.
+static esp_err_t codec_flush(codec_dev_t *codec)
+{
+    esp_err_t result = ESP_OK;
+    unsigned reg = 0;
+
+    while (reg < CODEC_REG_COUNT) {
+        if (!reg_bit(codec->dirty, reg)) {
+            reg++;
+            continue;
+        }
+
+        unsigned start = reg;
+        unsigned end = reg;
+        unsigned dirty_count = 1;
+        unsigned next = reg + 1;
+        while (next < CODEC_REG_COUNT && next - start < CODEC_BURST_MAX) {
+            if (reg_bit(codec->dirty, next)) {
+                end = next++;
+                dirty_count++;
+                continue;
+            }
+            unsigned gap = 0;
+            while (gap < CODEC_FLUSH_MAX_GAP && next + gap < CODEC_REG_COUNT &&
+                   !reg_bit(codec->dirty, next + gap) && reg_bit(codec->valid, next + gap)) {
+                gap++;
+            }
+            if (gap == 0 || next + gap >= CODEC_REG_COUNT || !reg_bit(codec->dirty, next + gap) ||
+                next + gap - start >= CODEC_BURST_MAX) {
+                break;
+            }
+            next += gap;
+        }
+
+        size_t len = end - start + 1;
+        uint32_t transactions = s_stats.transactions;
+        esp_err_t ret;
+        if (len == 1 || codec->burst_ok) {
+            ret = codec_write(codec, start, &codec->shadow[start], len);
+        } else {
+            ret = ESP_OK;
+            for (unsigned r = start; r <= end && ret == ESP_OK; r++) {
+                if (reg_bit(codec->dirty, r)) {
+                    ret = codec_write(codec, r, &codec->shadow[r], 1);
+                }
+            }
+        }
+        uint32_t used = s_stats.transactions - transactions;
+        if (dirty_count > used) {
+            s_stats.transactions_saved += dirty_count - used;
+        }
+        if (ret != ESP_OK) {
+            // Keep the failed registers dirty for the next flush
+            result = ret;
+        }
+        reg = end + 1;
+    }
+    return result;
+}
+
+esp_err_t audio_codec_attach_bus(audio_codec_id_t codec, const audio_codec_bus_t *bus)
+{
+    if (codec >= AUDIO_CODEC_COUNT || bus == NULL || bus->write == NULL || bus->read == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_codecs[codec].bus = *bus;
+    s_codecs[codec].attached = true;
+    s_codecs[codec].burst_ok = true;
+    codec_invalidate(&s_codecs[codec]);
+    return ESP_OK;
+}
+
 esp_err_t audio_codec_i2c_init(void)
 {
     if (i2c_bus_handle != NULL) {
@@ -83,7 +505,12 @@ esp_err_t audio_codec_i2c_init(void)
         return ret;
     }
 
-    ESP_LOGI(TAG, "I2C bus initialized (SDA=GPIO%d, SCL=GPIO%d, %dkHz)", 
+    audio_codec_bus_t es8311_bus = { .write = i2c_bus_write, .read = i2c_bus_read, .ctx = es8311_handle };
+    audio_codec_bus_t es7210_bus = { .write = i2c_bus_write, .read = i2c_bus_read, .ctx = es7210_handle };
+    audio_codec_attach_bus(AUDIO_CODEC_ES8311, &es8311_bus);
+    audio_codec_attach_bus(AUDIO_CODEC_ES7210, &es7210_bus);
+
+    ESP_LOGI(TAG, "I2C bus initialized (SDA=GPIO%d, SCL=GPIO%d, %dkHz)",
              I2C_SDA_PIN, I2C_SCL_PIN, I2C_FREQ_HZ / 1000);
     ESP_LOGI(TAG, "ES8311 DAC at address 0x%02X", ES8311_I2C_ADDR);
     ESP_LOGI(TAG, "ES7210 ADC at address 0x%02X", ES7210_I2C_ADDR);
@@ -91,120 +518,238 @@ esp_err_t audio_codec_i2c_init(void)
     return ESP_OK;
 }
 
+static const es8311_clock_t *es8311_find_clock(uint32_t sample_rate)
+{
+    uint32_t ratio = AUDIO_CODEC_MCLK_HZ / sample_rate;
+    for (size_t i = 0; i < sizeof(ES8311_CLOCKS) / sizeof(ES8311_CLOCKS[0]); i++) {
+        if (ES8311_CLOCKS[i].sample_rate == sample_rate && ES8311_CLOCKS[i].mclk_ratio == ratio) {
+            return &ES8311_CLOCKS[i];
+        }
+    }
+    return NULL;
+}
+
+static const es7210_clock_t *es7210_find_clock(uint32_t sample_rate)
+{
+    uint32_t ratio = AUDIO_CODEC_MCLK_HZ / sample_rate;
+    for (size_t i = 0; i < sizeof(ES7210_CLOCKS) / sizeof(ES7210_CLOCKS[0]); i++) {
+        if (ES7210_CLOCKS[i].sample_rate == sample_rate && ES7210_CLOCKS[i].mclk_ratio == ratio) {
+            return &ES7210_CLOCKS[i];
+        }
+    }
+    return NULL;
+}
+
+bool audio_codec_supports_rate(uint32_t sample_rate)
+{
+    return sample_rate > 0 && es8311_find_clock(sample_rate) && es7210_find_clock(sample_rate);
+}
+
 esp_err_t audio_codec_es8311_init(uint32_t sample_rate)
 {
-    if (es8311_handle == NULL) {
+    codec_dev_t *codec = &s_codecs[AUDIO_CODEC_ES8311];
+    if (!codec->attached) {
         ESP_LOGE(TAG, "ES8311 device not initialized");
         return ESP_ERR_INVALID_STATE;
     }
+    codec->in_standby = false;
+
+    const es8311_clock_t *clock = es8311_find_clock(sample_rate);
+    if (clock == NULL) {
+        ESP_LOGE(TAG, "ES8311: no clock setting for %luHz with MCLK %dHz",
+                 (unsigned long)sample_rate, AUDIO_CODEC_MCLK_HZ);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    ESP_LOGI(TAG, "Initializing ES8311 DAC at %luHz", (unsigned long)sample_rate);
+    int64_t start = esp_timer_get_time();
+    uint32_t transactions = s_stats.transactions;
+
+    esp_err_t ret = codec_run_sequence(codec, ES8311_RESET_SEQ, sizeof(ES8311_RESET_SEQ) / sizeof(ES8311_RESET_SEQ[0]));
+    if (ret == ESP_OK) {
+        // REG01 (MCLK from pin, all clocks on) followed by the divider block
+        codec_burst_t clock_burst = { .reg = 0x01, .len = 8, .flags = BURST_VERIFY, .val = { 0x3F } };
+        memcpy(&clock_burst.val[1], clock->regs, sizeof(clock->regs));
+        ret = codec_write_burst(codec, &clock_burst);
+    }
+    if (ret == ESP_OK) {
+        ret = codec_run_sequence(codec, ES8311_INIT_SEQ, sizeof(ES8311_INIT_SEQ) / sizeof(ES8311_INIT_SEQ[0]));
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "ES8311 init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
 
-    ESP_LOGI(TAG, "Initializing ES8311 DAC at %dHz", sample_rate);
-
-    // Basic ES8311 initialization
-    // Note: This is a simplified initialization. Full initialization requires
-    // configuring multiple registers based on the datasheet.
-    
-    // Power down all blocks first
-    i2c_write_reg(es8311_handle, 0x00, 0x7F); // Chip power down
-    
-    // Clock configuration
-    // For 48kHz: MCLK = 256 * FS = 256 * 48000 = 12.288MHz
-    // Actual configuration depends on your MCLK source
-    
-    // I2S configuration
-    // Configure for I2S mode, 16-bit, mono
-    i2c_write_reg(es8311_handle, 0x17, 0x18); // I2S format: I2S, 16-bit
-    
-    // DAC configuration
-    i2c_write_reg(es8311_handle, 0x18, 0x02); // DAC mute off
-    i2c_write_reg(es8311_handle, 0x1F, 0x0C); // DAC volume (adjust as needed)
-    
-    // Power up DAC
-    i2c_write_reg(es8311_handle, 0x00, 0x3C); // Power up DAC
-    
-    ESP_LOGI(TAG, "ES8311 DAC initialized");
+    s_stats.es8311_init_us = (uint32_t)(esp_timer_get_time() - start);
+    ESP_LOGI(TAG, "ES8311 DAC initialized in %luus (%lu transactions%s)",
+             (unsigned long)s_stats.es8311_init_us, (unsigned long)(s_stats.transactions - transactions),
+             codec->burst_ok ? "" : ", single-register mode");
     return ESP_OK;
 }
 
 esp_err_t audio_codec_es7210_init(uint32_t sample_rate)
 {
-    if (es7210_handle == NULL) {
+    codec_dev_t *codec = &s_codecs[AUDIO_CODEC_ES7210];
+    if (!codec->attached) {
         ESP_LOGE(TAG, "ES7210 device not initialized");
         return ESP_ERR_INVALID_STATE;
     }
+    codec->in_standby = false;
+
+    const es7210_clock_t *clock = es7210_find_clock(sample_rate);
+    if (clock == NULL) {
+        ESP_LOGE(TAG, "ES7210: no clock setting for %luHz with MCLK %dHz",
+                 (unsigned long)sample_rate, AUDIO_CODEC_MCLK_HZ);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    ESP_LOGI(TAG, "Initializing ES7210 ADC at %luHz", (unsigned long)sample_rate);
+    int64_t start = esp_timer_get_time();
+    uint32_t transactions = s_stats.transactions;
+
+    esp_err_t ret = codec_run_sequence(codec, ES7210_RESET_SEQ, sizeof(ES7210_RESET_SEQ) / sizeof(ES7210_RESET_SEQ[0]));
+    if (ret == ESP_OK) {
+        const codec_burst_t clock_seq[] = {
+            BURST(0x02, BURST_VERIFY, 0, clock->clk_div),
+            BURST(0x04, BURST_VERIFY, 0, clock->lrck_h, clock->lrck_l),
+            BURST(0x07, BURST_VERIFY, 0, clock->osr),
+        };
+        ret = codec_run_sequence(codec, clock_seq, sizeof(clock_seq) / sizeof(clock_seq[0]));
+    }
+    if (ret == ESP_OK) {
+        ret = codec_run_sequence(codec, ES7210_INIT_SEQ, sizeof(ES7210_INIT_SEQ) / sizeof(ES7210_INIT_SEQ[0]));
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "ES7210 init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
 
-    ESP_LOGI(TAG, "Initializing ES7210 ADC at %dHz", sample_rate);
-
-    // Basic ES7210 initialization
-    // Note: This is a simplified initialization. Full initialization requires
-    // configuring multiple registers based on the datasheet.
-    
-    // Reset
-    i2c_write_reg(es7210_handle, 0x00, 0xFF); // Software reset
-    
-    // Clock configuration
-    // For 16kHz: MCLK = 256 * FS = 256 * 16000 = 4.096MHz
-    
-    // I2S configuration
-    i2c_write_reg(es7210_handle, 0x13, 0x10); // I2S format: I2S, 16-bit
-    
-    // ADC configuration
-    i2c_write_reg(es7210_handle, 0x10, 0x41); // Enable ADC, mono
-    i2c_write_reg(es7210_handle, 0x11, 0x50); // ADC gain
-    
-    // Power up
-    i2c_write_reg(es7210_handle, 0x00, 0x00); // Power up
-    
-    ESP_LOGI(TAG, "ES7210 ADC initialized");
+    s_stats.es7210_init_us = (uint32_t)(esp_timer_get_time() - start);
+    ESP_LOGI(TAG, "ES7210 ADC initialized in %luus (%lu transactions%s)",
+             (unsigned long)s_stats.es7210_init_us, (unsigned long)(s_stats.transactions - transactions),
+             codec->burst_ok ? "" : ", single-register mode");
     return ESP_OK;
 }
 
 esp_err_t audio_codec_es8311_set_volume(uint8_t volume)
 {
-    if (es8311_handle == NULL) {
-        return ESP_ERR_INVALID_STATE;
-    }
+    codec_dev_t *codec = &s_codecs[AUDIO_CODEC_ES8311];
 
     // ES8311 volume control (0-100 -> register value)
-    // Volume register is 0x1F (0x00 = mute, 0x33 = max)
-    uint8_t vol_reg = (volume * 0x33) / 100;
-    
-    esp_err_t ret = i2c_write_reg(es8311_handle, 0x1F, vol_reg);
-    if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "ES8311 volume set to %d%%", volume);
+    // DAC volume register is 0x32 (0x00 = -95.5dB, 0xBF = 0dB, 0.5dB steps)
+    if (volume > 100) {
+        volume = 100;
+    }
+    uint8_t vol_reg = (volume * 0xBF) / 100;
+
+    if (codec->in_standby) {
+        // DAC stays muted; the new level is applied on wake
+        codec->saved[0] = vol_reg;
+        return ESP_OK;
+    }
+
+    esp_err_t ret = codec_update_reg(codec, ES8311_REG_DAC_VOLUME, 0xFF, vol_reg);
+    if (ret == ESP_OK && codec_has_dirty(codec)) {
+        ret = codec_flush(codec);
+        if (ret == ESP_OK) {
+            ESP_LOGI(TAG, "ES8311 volume set to %d%%", volume);
+        }
     }
     return ret;
 }
 
 esp_err_t audio_codec_es8311_power(bool enable)
 {
-    if (es8311_handle == NULL) {
-        return ESP_ERR_INVALID_STATE;
-    }
+    codec_dev_t *codec = &s_codecs[AUDIO_CODEC_ES8311];
 
     // Power control register (0x00)
     uint8_t reg_val = enable ? 0x3C : 0x7F; // Power up/down
-    
-    esp_err_t ret = i2c_write_reg(es8311_handle, 0x00, reg_val);
-    if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "ES8311 %s", enable ? "powered on" : "powered off");
+
+    esp_err_t ret = codec_update_reg(codec, ES8311_REG_RESET, 0xFF, reg_val);
+    if (ret == ESP_OK && codec_has_dirty(codec)) {
+        ret = codec_flush(codec);
+        if (ret == ESP_OK) {
+            ESP_LOGI(TAG, "ES8311 %s", enable ? "powered on" : "powered off");
+        }
     }
     return ret;
 }
 
 esp_err_t audio_codec_es7210_power(bool enable)
 {
-    if (es7210_handle == NULL) {
-        return ESP_ERR_INVALID_STATE;
-    }
+    codec_dev_t *codec = &s_codecs[AUDIO_CODEC_ES7210];
 
     // Power control
     uint8_t reg_val = enable ? 0x00 : 0xFF; // Power up/down
-    
-    esp_err_t ret = i2c_write_reg(es7210_handle, 0x00, reg_val);
+
+    esp_err_t ret = codec_update_reg(codec, ES7210_REG_RESET, 0xFF, reg_val);
+    if (ret == ESP_OK && codec_has_dirty(codec)) {
+        ret = codec_flush(codec);
+        if (ret == ESP_OK) {
+            ESP_LOGI(TAG, "ES7210 %s", enable ? "powered on" : "powered off");
+        }
+    }
+    if (ret == ESP_OK && !enable) {
+        // 0xFF holds the chip in reset, which puts every register back to
+        // its default: nothing in the shadow can be trusted afterwards
+        codec_invalidate(codec);
+    }
+    return ret;
+}
+
+static esp_err_t codec_set_standby(codec_dev_t *codec, const codec_reg_val_t *regs, size_t count, bool standby)
+{
+    if (!codec->attached) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (codec->in_standby == standby) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (standby) {
+        // A flush goes out in register order, which would gate the clocks
+        // (0x01) before the DAC is muted (0x32). Flush entry by entry so the
+        // table order holds: mute, analog blocks off, clocks gated last.
+        for (size_t i = 0; i < count && ret == ESP_OK; i++) {
+            codec->saved[i] = codec->shadow[regs[i].reg];
+            ret = codec_update_reg(codec, regs[i].reg, 0xFF, regs[i].value);
+            if (ret == ESP_OK && codec_has_dirty(codec)) {
+                ret = codec_flush(codec);
+            }
+        }
+    } else {
+        // The flush writes in register order, so clocks (0x01) come back
+        // before the analog blocks and the DAC volume last
+        for (size_t i = 0; i < count && ret == ESP_OK; i++) {
+            ret = codec_update_reg(codec, regs[i].reg, 0xFF, codec->saved[i]);
+        }
+        if (ret == ESP_OK) {
+            ret = codec_flush(codec);
+        }
+    }
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "ES7210 %s", enable ? "powered on" : "powered off");
+        codec->in_standby = standby;
+        ESP_LOGD(TAG, "%s %s standby", codec->name, standby ? "entered" : "left");
     }
     return ret;
 }
 
+esp_err_t audio_codec_es8311_standby(bool standby)
+{
+    return codec_set_standby(&s_codecs[AUDIO_CODEC_ES8311], ES8311_STANDBY,
+                             sizeof(ES8311_STANDBY) / sizeof(ES8311_STANDBY[0]), standby);
+}
+
+esp_err_t audio_codec_es7210_standby(bool standby)
+{
+    return codec_set_standby(&s_codecs[AUDIO_CODEC_ES7210], ES7210_STANDBY,
+                             sizeof(ES7210_STANDBY) / sizeof(ES7210_STANDBY[0]), standby);
+}
+
+void audio_codec_get_stats(audio_codec_stats_t *stats)
+{
+    if (stats) {
+        *stats = s_stats;
+    }
+}
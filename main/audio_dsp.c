@@ -0,0 +1,472 @@
+/*
+ * Audio DSP Kernels Implementation
+ *
+ * The 2- and 4-channel cases get their own loops with a constant stride and
+ * restrict pointers, so the compiler can unroll them and keep every
+ * channel's store stream sequential (PIE/auto-vectorisation friendly). The
+ * generic loop only handles odd channel counts.
+ *
+ * The arithmetic kernels have a scalar reference each (*_ref) and, per
+ * backend, an optimized body that handles whole vectors and hands the tail
+ * to the reference. The integer ones are bit-exact by construction: the
+ * SIMD instructions used round and saturate exactly as the reference does
+ * (e.g. vqrshrn is (x + half) >> shift, saturated). The biquad is serial,
+ * so only ESP-DSP replaces it.
+ */
+
+#include "audio_dsp.h"
+#include <math.h>
+
+#if defined(ESP_PLATFORM)
+#include "sdkconfig.h"
+#endif
+
+#if defined(AUDIO_DSP_SCALAR)
+#define DSP_BACKEND "scalar"
+#elif defined(__SSE2__)
+#define DSP_SSE2 1
+#define DSP_BACKEND "sse2"
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define DSP_NEON 1
+#define DSP_BACKEND "neon"
+#include <arm_neon.h>
+#elif defined(CONFIG_IDF_TARGET_ESP32P4) && defined(__has_include) && __has_include("dsps_biquad.h")
+// Only the biquad is accelerated on the P4. ESP-DSP's s16 add, mulc and
+// dotprod neither saturate nor round the way this API promises, and PIE
+// versions need hand-written assembly checked on the chip, so gain, mix,
+// FIR and conversion still run the scalar reference loops here (open item)
+#define DSP_ESP_DSP 1
+#define DSP_BACKEND "esp-dsp"
+#include "dsps_biquad.h"
+#else
+#define DSP_BACKEND "scalar"
+#endif
+
+static void deinterleave2(const int16_t *restrict in, int16_t *restrict a, int16_t *restrict b, size_t frames)
+{
+    for (size_t i = 0; i < frames; i++) {
+        a[i] = in[2 * i];
+        b[i] = in[2 * i + 1];
+    }
+}
+
+static void deinterleave4(const int16_t *restrict in, int16_t *restrict a, int16_t *restrict b,
+                          int16_t *restrict c, int16_t *restrict d, size_t frames)
+{
+    for (size_t i = 0; i < frames; i++) {
+        a[i] = in[4 * i];
+        b[i] = in[4 * i + 1];
+        c[i] = in[4 * i + 2];
+        d[i] = in[4 * i + 3];
+    }
+}
+
+void audio_dsp_deinterleave_s16(const int16_t *in, int16_t *const *out, size_t channels, size_t frames)
+{
+    switch (channels) {
+        case 2:
+            deinterleave2(in, out[0], out[1], frames);
+            break;
+        case 4:
+            deinterleave4(in, out[0], out[1], out[2], out[3], frames);
+            break;
+        default:
+            for (size_t ch = 0; ch < channels; ch++) {
+                int16_t *dst = out[ch];
+                for (size_t i = 0; i < frames; i++) {
+                    dst[i] = in[i * channels + ch];
+                }
+            }
+            break;
+    }
+}
+
+void audio_dsp_interleave_mono_s16(const int16_t *restrict in, int16_t *restrict out, size_t channels, size_t frames)
+{
+    if (channels == 1) {
+        for (size_t i = 0; i < frames; i++) {
+            out[i] = in[i];
+        }
+        return;
+    }
+    for (size_t i = 0; i < frames; i++) {
+        int16_t *frame = out + i * channels;
+        frame[0] = in[i];
+        frame[1] = in[i];
+        for (size_t ch = 2; ch < channels; ch++) {
+            frame[ch] = 0;
+        }
+    }
+}
+
+const char *audio_dsp_backend(void)
+{
+    return DSP_BACKEND;
+}
+
+static inline int16_t saturate16(int32_t v)
+{
+    return (int16_t)(v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v));
+}
+
+// Scalar reference
+
+void audio_dsp_gain_s16_ref(const int16_t *in, int16_t *out, size_t n, int16_t gain)
+{
+    for (size_t i = 0; i < n; i++) {
+        int32_t p = (int32_t)in[i] * gain;
+        out[i] = saturate16((p + (1 << (AUDIO_DSP_GAIN_SHIFT - 1))) >> AUDIO_DSP_GAIN_SHIFT);
+    }
+}
+
+void audio_dsp_mix_s16_ref(int16_t *dst, const int16_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = saturate16((int32_t)dst[i] + src[i]);
+    }
+}
+
+void audio_dsp_fir_s16_ref(const int16_t *in, int16_t *out, size_t n, const int16_t *coeffs, size_t taps)
+{
+    for (size_t i = 0; i < n; i++) {
+        int32_t acc = 0;
+        for (size_t k = 0; k < taps; k++) {
+            acc += (int32_t)coeffs[k] * in[(ptrdiff_t)i - (ptrdiff_t)k];
+        }
+        out[i] = saturate16((acc + (1 << 14)) >> 15);
+    }
+}
+
+void audio_dsp_biquad_f32_ref(const float *in, float *out, size_t n, const float *coeffs, float *state)
+{
+    float w0 = state[0];
+    float w1 = state[1];
+    for (size_t i = 0; i < n; i++) {
+        float d = in[i] - coeffs[3] * w0 - coeffs[4] * w1;
+        out[i] = coeffs[0] * d + coeffs[1] * w0 + coeffs[2] * w1;
+        w1 = w0;
+        w0 = d;
+    }
+    state[0] = w0;
+    state[1] = w1;
+}
+
+void audio_dsp_s16_to_f32_ref(const int16_t *in, float *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (float)in[i] * (1.0f / 32768.0f);
+    }
+}
+
+void audio_dsp_f32_to_s16_ref(const float *in, int16_t *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        // Clamp in float first: converting an out-of-range float is undefined
+        float v = in[i] * 32768.0f;
+        v = v > 32767.0f ? 32767.0f : (v < -32768.0f ? -32768.0f : v);
+        out[i] = (int16_t)lrintf(v);
+    }
+}
+
+uint32_t audio_dsp_peak_s16_ref(const int16_t *in, size_t n)
+{
+    uint32_t peak = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t a = (uint32_t)(in[i] < 0 ? -(int32_t)in[i] : in[i]);
+        if (a > peak) {
+            peak = a;
+        }
+    }
+    return peak;
+}
+
+uint64_t audio_dsp_energy_s16_ref(const int16_t *in, size_t n)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += (uint64_t)((int32_t)in[i] * in[i]);
+    }
+    return sum;
+}
+
+#if DSP_SSE2
+
+void audio_dsp_gain_s16(const int16_t *in, int16_t *out, size_t n, int16_t gain)
+{
+    const __m128i g = _mm_set1_epi16(gain);
+    const __m128i half = _mm_set1_epi32(1 << (AUDIO_DSP_GAIN_SHIFT - 1));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i lo = _mm_mullo_epi16(x, g);
+        __m128i hi = _mm_mulhi_epi16(x, g);
+        __m128i p0 = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), half), AUDIO_DSP_GAIN_SHIFT);
+        __m128i p1 = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), half), AUDIO_DSP_GAIN_SHIFT);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(p0, p1));
+    }
+    audio_dsp_gain_s16_ref(in + i, out + i, n - i, gain);
+}
+
+void audio_dsp_mix_s16(int16_t *dst, const int16_t *src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epi16(a, b));
+    }
+    audio_dsp_mix_s16_ref(dst + i, src + i, n - i);
+}
+
+// Eight outputs at a time; taps go in pairs through pmaddwd, which
+// multiplies interleaved (x[i-k], x[i-k-1]) by (h[k], h[k+1]) and adds
+void audio_dsp_fir_s16(const int16_t *in, int16_t *out, size_t n, const int16_t *coeffs, size_t taps)
+{
+    const __m128i half = _mm_set1_epi32(1 << 14);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i acc0 = _mm_setzero_si128();
+        __m128i acc1 = _mm_setzero_si128();
+        size_t k = 0;
+        for (; k + 2 <= taps; k += 2) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(in + i - k));
+            __m128i b = _mm_loadu_si128((const __m128i *)(in + i - k - 1));
+            __m128i h = _mm_set1_epi32((int32_t)(uint16_t)coeffs[k] | ((int32_t)coeffs[k + 1] << 16));
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), h));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), h));
+        }
+        if (k < taps) {
+            // Odd tap count: pair the last tap with a zero coefficient
+            __m128i a = _mm_loadu_si128((const __m128i *)(in + i - k));
+            __m128i h = _mm_set1_epi32((int32_t)(uint16_t)coeffs[k]);
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(a, a), h));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(a, a), h));
+        }
+        acc0 = _mm_srai_epi32(_mm_add_epi32(acc0, half), 15);
+        acc1 = _mm_srai_epi32(_mm_add_epi32(acc1, half), 15);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(acc0, acc1));
+    }
+    audio_dsp_fir_s16_ref(in + i, out + i, n - i, coeffs, taps);
+}
+
+void audio_dsp_s16_to_f32(const int16_t *in, float *out, size_t n)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        // Sign-extend by placing each sample in the top half and shifting down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    audio_dsp_s16_to_f32_ref(in + i, out + i, n - i);
+}
+
+void audio_dsp_f32_to_s16(const float *in, int16_t *out, size_t n)
+{
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 lo_limit = _mm_set1_ps(-32768.0f);
+    const __m128 hi_limit = _mm_set1_ps(32767.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(in + i), scale);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(in + i + 4), scale);
+        a = _mm_min_ps(_mm_max_ps(a, lo_limit), hi_limit);
+        b = _mm_min_ps(_mm_max_ps(b, lo_limit), hi_limit);
+        // cvtps rounds in the current mode, as lrintf does
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+    }
+    audio_dsp_f32_to_s16_ref(in + i, out + i, n - i);
+}
+
+uint32_t audio_dsp_peak_s16(const int16_t *in, size_t n)
+{
+    __m128i mx = _mm_setzero_si128();
+    __m128i mn = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        mx = _mm_max_epi16(mx, x);
+        mn = _mm_min_epi16(mn, x);
+    }
+    int16_t hi[8];
+    int16_t lo[8];
+    _mm_storeu_si128((__m128i *)hi, mx);
+    _mm_storeu_si128((__m128i *)lo, mn);
+    uint32_t peak = audio_dsp_peak_s16_ref(in + i, n - i);
+    for (size_t j = 0; j < 8; j++) {
+        uint32_t a = (uint32_t)(hi[j] > -(int32_t)lo[j] ? hi[j] : -(int32_t)lo[j]);
+        if (a > peak) {
+            peak = a;
+        }
+    }
+    return peak;
+}
+
+// pmaddwd squares and adds pairs; the pair sum reaches 2^31 only for two
+// -32768 samples, which is still right read as unsigned
+uint64_t audio_dsp_energy_s16(const int16_t *in, size_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i sq = _mm_madd_epi16(x, x);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sq, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sq, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return lanes[0] + lanes[1] + audio_dsp_energy_s16_ref(in + i, n - i);
+}
+
+#elif DSP_NEON
+
+void audio_dsp_gain_s16(const int16_t *in, int16_t *out, size_t n, int16_t gain)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(in + i);
+        int32x4_t p0 = vmull_n_s16(vget_low_s16(x), gain);
+        int32x4_t p1 = vmull_n_s16(vget_high_s16(x), gain);
+        vst1q_s16(out + i, vcombine_s16(vqrshrn_n_s32(p0, AUDIO_DSP_GAIN_SHIFT),
+                                        vqrshrn_n_s32(p1, AUDIO_DSP_GAIN_SHIFT)));
+    }
+    audio_dsp_gain_s16_ref(in + i, out + i, n - i, gain);
+}
+
+void audio_dsp_mix_s16(int16_t *dst, const int16_t *src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        vst1q_s16(dst + i, vqaddq_s16(vld1q_s16(dst + i), vld1q_s16(src + i)));
+    }
+    audio_dsp_mix_s16_ref(dst + i, src + i, n - i);
+}
+
+void audio_dsp_fir_s16(const int16_t *in, int16_t *out, size_t n, const int16_t *coeffs, size_t taps)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int32x4_t acc0 = vdupq_n_s32(0);
+        int32x4_t acc1 = vdupq_n_s32(0);
+        for (size_t k = 0; k < taps; k++) {
+            int16x8_t x = vld1q_s16(in + i - k);
+            acc0 = vmlal_n_s16(acc0, vget_low_s16(x), coeffs[k]);
+            acc1 = vmlal_n_s16(acc1, vget_high_s16(x), coeffs[k]);
+        }
+        vst1q_s16(out + i, vcombine_s16(vqrshrn_n_s32(acc0, 15), vqrshrn_n_s32(acc1, 15)));
+    }
+    audio_dsp_fir_s16_ref(in + i, out + i, n - i, coeffs, taps);
+}
+
+void audio_dsp_s16_to_f32(const int16_t *in, float *out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(in + i);
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), 1.0f / 32768.0f));
+        vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), 1.0f / 32768.0f));
+    }
+    audio_dsp_s16_to_f32_ref(in + i, out + i, n - i);
+}
+
+void audio_dsp_f32_to_s16(const float *in, int16_t *out, size_t n)
+{
+    const float32x4_t lo_limit = vdupq_n_f32(-32768.0f);
+    const float32x4_t hi_limit = vdupq_n_f32(32767.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t a = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(in + i), 32768.0f), lo_limit), hi_limit);
+        float32x4_t b = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(in + i + 4), 32768.0f), lo_limit), hi_limit);
+        // Round to nearest even, lrintf's default mode
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b))));
+    }
+    audio_dsp_f32_to_s16_ref(in + i, out + i, n - i);
+}
+
+uint32_t audio_dsp_peak_s16(const int16_t *in, size_t n)
+{
+    int16x8_t mx = vdupq_n_s16(0);
+    int16x8_t mn = vdupq_n_s16(0);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(in + i);
+        mx = vmaxq_s16(mx, x);
+        mn = vminq_s16(mn, x);
+    }
+    uint32_t peak = audio_dsp_peak_s16_ref(in + i, n - i);
+    uint32_t hi = (uint32_t)vmaxvq_s16(mx);
+    uint32_t lo = (uint32_t)(-(int32_t)vminvq_s16(mn));
+    hi = hi > lo ? hi : lo;
+    return hi > peak ? hi : peak;
+}
+
+uint64_t audio_dsp_energy_s16(const int16_t *in, size_t n)
+{
+    int64x2_t acc = vdupq_n_s64(0);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(in + i);
+        acc = vpadalq_s32(acc, vmull_s16(vget_low_s16(x), vget_low_s16(x)));
+        acc = vpadalq_s32(acc, vmull_s16(vget_high_s16(x), vget_high_s16(x)));
+    }
+    return (uint64_t)vaddvq_s64(acc) + audio_dsp_energy_s16_ref(in + i, n - i);
+}
+
+#else
+
+void audio_dsp_gain_s16(const int16_t *in, int16_t *out, size_t n, int16_t gain)
+{
+    audio_dsp_gain_s16_ref(in, out, n, gain);
+}
+
+void audio_dsp_mix_s16(int16_t *dst, const int16_t *src, size_t n)
+{
+    audio_dsp_mix_s16_ref(dst, src, n);
+}
+
+void audio_dsp_fir_s16(const int16_t *in, int16_t *out, size_t n, const int16_t *coeffs, size_t taps)
+{
+    audio_dsp_fir_s16_ref(in, out, n, coeffs, taps);
+}
+
+void audio_dsp_s16_to_f32(const int16_t *in, float *out, size_t n)
+{
+    audio_dsp_s16_to_f32_ref(in, out, n);
+}
+
+void audio_dsp_f32_to_s16(const float *in, int16_t *out, size_t n)
+{
+    audio_dsp_f32_to_s16_ref(in, out, n);
+}
+
+uint32_t audio_dsp_peak_s16(const int16_t *in, size_t n)
+{
+    return audio_dsp_peak_s16_ref(in, n);
+}
+
+uint64_t audio_dsp_energy_s16(const int16_t *in, size_t n)
+{
+    return audio_dsp_energy_s16_ref(in, n);
+}
+
+#endif
+
+void audio_dsp_biquad_f32(const float *in, float *out, size_t n, const float *coeffs, float *state)
+{
+#if DSP_ESP_DSP
+    dsps_biquad_f32(in, out, (int)n, (float *)coeffs, state);
+#else
+    audio_dsp_biquad_f32_ref(in, out, n, coeffs, state);
+#endif
+}
+
+float audio_dsp_rms_s16(const int16_t *in, size_t n)
+{
+    return n ? sqrtf((float)((double)audio_dsp_energy_s16(in, n) / (double)n)) : 0.0f;
+}
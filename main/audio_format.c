@@ -0,0 +1,214 @@
+/*
+ * Audio Format Implementation
+ * SDP format selection and the between-calls switch of codec clocks, I2S
+ * and pipeline frame size
+ */
+
+#include "audio_format.h"
+#include "audio_codec.h"
+#include "audio_handler.h"
+#include "audio_power.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "audio_format";
+
+#define SDP_MAX_PAYLOADS 16
+
+static audio_format_t s_format = {
+    .sample_rate = AUDIO_FORMAT_DEFAULT_RATE,
+    .channels = 1,
+    .bits_per_sample = 16,
+    .frame_ms = AUDIO_FORMAT_FRAME_MS,
+    .payload_type = 0,
+    .encoding = "L16",
+};
+
+void audio_format_default(audio_format_t *format)
+{
+    *format = (audio_format_t){
+        .sample_rate = AUDIO_FORMAT_DEFAULT_RATE,
+        .channels = 1,
+        .bits_per_sample = 16,
+        .frame_ms = AUDIO_FORMAT_FRAME_MS,
+        .payload_type = 0,
+        .encoding = "L16",
+    };
+}
+
+const audio_format_t *audio_format_get(void)
+{
+    return &s_format;
+}
+
+// Find "<prefix><pt>" at the start of a line and return what follows it
+static const char *sdp_find_attr(const char *sdp, const char *prefix, int pt)
+{
+    char key[24];
+    int key_len = snprintf(key, sizeof(key), "%s%d ", prefix, pt);
+    for (const char *line = sdp; line && *line; ) {
+        if (strncmp(line, key, key_len) == 0) {
+            return line + key_len;
+        }
+        line = strchr(line, '\n');
+        if (line) {
+            line++;
+        }
+    }
+    return NULL;
+}
+
+// Native rate of one payload type, or 0 if it has none we can use
+static uint32_t sdp_payload_rate(const char *sdp, int pt, char *encoding, size_t encoding_len)
+{
+    uint32_t rtpmap_rate = 0;
+    const char *rtpmap = sdp_find_attr(sdp, "a=rtpmap:", pt);
+    if (rtpmap) {
+        // "<encoding>/<clock rate>[/<channels>]"
+        size_t n = strcspn(rtpmap, "/\r\n");
+        if (n == 0 || n >= encoding_len || rtpmap[n] != '/') {
+            return 0;
+        }
+        memcpy(encoding, rtpmap, n);
+        encoding[n] = '\0';
+        rtpmap_rate = (uint32_t)strtoul(rtpmap + n + 1, NULL, 10);
+    } else if (pt == 0 || pt == 8 || pt == 9) {
+        // Static payload types (RFC 3551) may omit the rtpmap
+        snprintf(encoding, encoding_len, "%s", pt == 0 ? "PCMU" : pt == 8 ? "PCMA" : "G722");
+        rtpmap_rate = 8000;
+    } else {
+        return 0;
+    }
+
+    if (strcasecmp(encoding, "PCMU") == 0 || strcasecmp(encoding, "PCMA") == 0) {
+        return 8000;
+    }
+    if (strcasecmp(encoding, "G722") == 0) {
+        // rtpmap says 8000 for historical reasons; audio is 16 kHz
+        return 16000;
+    }
+    if (strcasecmp(encoding, "L16") == 0) {
+        return rtpmap_rate;
+    }
+    if (strcasecmp(encoding, "opus") == 0) {
+        // Opus always signals 48000; the receiver's real bandwidth is in fmtp
+        const char *fmtp = sdp_find_attr(sdp, "a=fmtp:", pt);
+        const char *max = fmtp ? strstr(fmtp, "maxplaybackrate=") : NULL;
+        const char *eol = fmtp ? strchr(fmtp, '\n') : NULL;
+        if (max && (!eol || max < eol)) {
+            uint32_t rate = (uint32_t)strtoul(max + strlen("maxplaybackrate="), NULL, 10);
+            // Opus runs at 8/12/16/24/48 kHz internally; take the next one up
+            // that the codecs can clock
+            static const uint32_t OPUS_RATES[] = { 8000, 16000, 48000 };
+            for (size_t i = 0; i < sizeof(OPUS_RATES) / sizeof(OPUS_RATES[0]); i++) {
+                if (OPUS_RATES[i] >= rate) {
+                    return OPUS_RATES[i];
+                }
+            }
+        }
+        return 48000;
+    }
+    return 0;
+}
+
+esp_err_t audio_format_from_sdp(const char *sdp, audio_format_t *format)
+{
+    if (!sdp || !format) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // "m=audio <port> <proto> <pt> <pt> ..." in preference order
+    const char *media = strstr(sdp, "m=audio ");
+    if (!media) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    const char *p = media + strlen("m=audio ");
+    for (int field = 0; field < 2 && p; field++) {
+        p = strchr(p, ' ');
+        if (p) {
+            p++;
+        }
+    }
+
+    for (int count = 0; p && *p && *p != '\r' && *p != '\n' && count < SDP_MAX_PAYLOADS; count++) {
+        char *end;
+        long pt = strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        p = (*end == ' ') ? end + 1 : end;
+
+        char encoding[sizeof(format->encoding)];
+        uint32_t rate = sdp_payload_rate(sdp, (int)pt, encoding, sizeof(encoding));
+        if (rate && audio_codec_supports_rate(rate)) {
+            audio_format_default(format);
+            format->sample_rate = rate;
+            format->payload_type = (uint8_t)pt;
+            snprintf(format->encoding, sizeof(format->encoding), "%s", encoding);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+// Codecs go down first so they never see I2S clocks at a rate they are not
+// configured for; coming back up from OFF re-runs their init at s_format
+static esp_err_t format_switch(const audio_format_t *format, audio_power_state_t restore)
+{
+    s_format = *format;
+
+    esp_err_t ret = audio_power_set_state(AUDIO_POWER_OFF);
+    if (ret == ESP_OK) {
+        ret = audio_handler_set_format(&s_format);
+    }
+    if (ret == ESP_OK) {
+        ret = audio_power_set_state(restore);
+    }
+    return ret;
+}
+
+esp_err_t audio_format_apply(const audio_format_t *format)
+{
+    if (!format || format->channels != 1 || format->bits_per_sample != 16 ||
+        audio_format_frame_samples(format) == 0 || audio_format_frame_samples(format) > BUFFER_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!audio_codec_supports_rate(format->sample_rate)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    audio_power_state_t state = audio_power_get_state();
+    if (state == AUDIO_POWER_ACTIVE) {
+        ESP_LOGW(TAG, "Format change requested during a call");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (format->sample_rate == s_format.sample_rate && format->frame_ms == s_format.frame_ms) {
+        // Same clocks: only the RTP side changes
+        s_format.payload_type = format->payload_type;
+        memcpy(s_format.encoding, format->encoding, sizeof(s_format.encoding));
+        return ESP_OK;
+    }
+
+    int64_t start = esp_timer_get_time();
+    audio_format_t previous = s_format;
+    esp_err_t ret = format_switch(format, state);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Switch to %luHz failed (%s), restoring %luHz",
+                 (unsigned long)format->sample_rate, esp_err_to_name(ret),
+                 (unsigned long)previous.sample_rate);
+        if (format_switch(&previous, state) != ESP_OK) {
+            ESP_LOGE(TAG, "Restoring previous format failed");
+        }
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Audio path now %s %luHz, %ums frames (%luus)", s_format.encoding,
+             (unsigned long)s_format.sample_rate, s_format.frame_ms,
+             (unsigned long)(esp_timer_get_time() - start));
+    return ESP_OK;
+}
@@ -10,81 +10,173 @@
  */
 
 #include "audio_handler.h"
+#include "alloc_trace.h"
+#include "audio_codec.h"
+#include "audio_beamformer.h"
+#include "audio_dsp.h"
+#include "audio_pipeline.h"
+#include "audio_stages.h"
+#include "mem_pool.h"
 #include "esp_log.h"
 #include "driver/i2s.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include <string.h>
 
 static const char *TAG = "audio_handler";
 
+// Bounded so the tasks notice a stop (and return their pool buffers) even
+// after the I2S clocks have been stopped
+#define I2S_IO_TIMEOUT_MS 100
+
+// How long stop waits for a task to leave its loop: one I2S timeout plus
+// a callback's worth of slack
+#define TASK_EXIT_TIMEOUT_MS (I2S_IO_TIMEOUT_MS * 5)
+
+// Compile-time stage lists, see audio_stages.h
+static const audio_stage_t *const s_capture_stages[] = {AUDIO_CAPTURE_STAGES NULL};
+static const audio_stage_t *const s_render_stages[] = {AUDIO_RENDER_STAGES NULL};
+
+// I2S frame layout follows the number of captured mics; the speaker shares
+// the frame and uses slots 0/1
+#if AUDIO_MIC_CHANNELS == 4
+#define I2S_FRAME_FORMAT I2S_CHANNEL_FMT_MULTIPLE
+#define I2S_FRAME_CHANNELS (I2S_TDM_ACTIVE_CH0 | I2S_TDM_ACTIVE_CH1 | I2S_TDM_ACTIVE_CH2 | I2S_TDM_ACTIVE_CH3)
+#elif AUDIO_MIC_CHANNELS == 2
+#define I2S_FRAME_FORMAT I2S_CHANNEL_FMT_RIGHT_LEFT
+#define I2S_FRAME_CHANNELS I2S_CHANNEL_STEREO
+#else
+#define I2S_FRAME_FORMAT I2S_CHANNEL_FMT_ONLY_LEFT
+#define I2S_FRAME_CHANNELS I2S_CHANNEL_MONO
+#endif
+
 // Audio handler state
 static struct {
     bool initialized;
     bool capture_active;
     bool playback_active;
     bool amplifier_enabled;
+    bool clocks_enabled;
+    audio_format_t format;
+    size_t frame_samples;       // Samples per capture/playback chunk
     audio_capture_cb_t capture_cb;
     void *capture_user_data;
     audio_playback_cb_t playback_cb;
     void *playback_user_data;
     TaskHandle_t capture_task_handle;
     TaskHandle_t playback_task_handle;
+    // Given by each task once it has returned its pool blocks
+    SemaphoreHandle_t capture_done;
+    SemaphoreHandle_t playback_done;
+    StaticSemaphore_t capture_done_buf;
+    StaticSemaphore_t playback_done_buf;
 } s_audio = {0};
 
+// Last thing a task does: its buffers are back in the pool by now
+static void audio_task_exit(SemaphoreHandle_t done)
+{
+    xSemaphoreGive(done);
+    vTaskDelete(NULL);
+}
+
+// Wait for a stopped task to signal its exit
+static esp_err_t audio_task_join(SemaphoreHandle_t done, const char *name)
+{
+    if (xSemaphoreTake(done, pdMS_TO_TICKS(TASK_EXIT_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGE(TAG, "%s task did not exit within %d ms", name, TASK_EXIT_TIMEOUT_MS);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
 // Audio capture task
-// Note: Microphone uses ES7210 ADC at 16kHz
+// Frames are delivered at the negotiated format rate (ES7210 runs at it).
+// With several mics the interleaved frames are beamformed to mono first;
+// the capture pipeline then runs in place on the mono frame.
 static void audio_capture_task(void *pvParameters)
 {
-    int16_t *buffer = (int16_t *)malloc(BUFFER_SIZE * sizeof(int16_t));
-    if (!buffer) {
+    // Buffers come from the preallocated pools: nothing in the capture loop
+    // touches the heap
+    int16_t *buffer = (int16_t *)mem_pool_alloc(MEM_POOL_I2S_DMA);
+    int16_t *mono = (AUDIO_MIC_CHANNELS > 1) ? (int16_t *)mem_pool_alloc(MEM_POOL_FRAME) : buffer;
+    if (!buffer || !mono) {
         ESP_LOGE(TAG, "Failed to allocate capture buffer");
-        vTaskDelete(NULL);
+        mem_pool_free(MEM_POOL_I2S_DMA, buffer);
+        if (mono != buffer) {
+            mem_pool_free(MEM_POOL_FRAME, mono);
+        }
+        audio_task_exit(s_audio.capture_done);
         return;
     }
 
+    alloc_trace_watch_current_task();
     while (s_audio.capture_active) {
         size_t bytes_read = 0;
         // Read from shared I2S bus (DIN pin)
-        esp_err_t ret = i2s_read(I2S_NUM_0, buffer, BUFFER_SIZE * sizeof(int16_t), &bytes_read, portMAX_DELAY);
+        esp_err_t ret = i2s_read(I2S_NUM_0, buffer, s_audio.frame_samples * AUDIO_MIC_CHANNELS * sizeof(int16_t),
+                                 &bytes_read, pdMS_TO_TICKS(I2S_IO_TIMEOUT_MS));
         
         if (ret == ESP_OK && bytes_read > 0) {
-            size_t samples = bytes_read / sizeof(int16_t);
+            size_t samples = bytes_read / (AUDIO_MIC_CHANNELS * sizeof(int16_t));
+            if (AUDIO_MIC_CHANNELS > 1) {
+                beamformer_process(buffer, mono, samples);
+            }
+            samples = audio_pipeline_process(AUDIO_PIPELINE_CAPTURE, mono, samples, BUFFER_SIZE);
             if (s_audio.capture_cb) {
-                s_audio.capture_cb(buffer, samples, s_audio.capture_user_data);
+                s_audio.capture_cb(mono, samples, s_audio.capture_user_data);
             }
-        } else if (ret != ESP_OK) {
+        } else if (ret != ESP_OK && ret != ESP_ERR_TIMEOUT) {
             ESP_LOGE(TAG, "I2S read error: %s", esp_err_to_name(ret));
         }
     }
 
-    free(buffer);
-    vTaskDelete(NULL);
+    if (mono != buffer) {
+        mem_pool_free(MEM_POOL_FRAME, mono);
+    }
+    mem_pool_free(MEM_POOL_I2S_DMA, buffer);
+    alloc_trace_unwatch_current_task();
+    audio_task_exit(s_audio.capture_done);
 }
 
 // Audio playback task
-// Note: Speaker uses ES8311 DAC at 48kHz
-// Input audio should be resampled from 16kHz to 48kHz if needed
+// The callback fills frames at the negotiated format rate; the ES8311 is
+// clocked at the same rate so no resampling is needed. The render pipeline
+// runs in place on the mono frame before it is spread over the I2S slots.
 static void audio_playback_task(void *pvParameters)
 {
-    int16_t *buffer = (int16_t *)malloc(BUFFER_SIZE * sizeof(int16_t));
-    if (!buffer) {
+    // With one mic the mono frame goes to I2S as is, so it needs the DMA pool
+    const mem_pool_id_t mono_pool = (AUDIO_MIC_CHANNELS > 1) ? MEM_POOL_FRAME : MEM_POOL_I2S_DMA;
+    int16_t *buffer = (int16_t *)mem_pool_alloc(mono_pool);
+    int16_t *frames = (AUDIO_MIC_CHANNELS > 1) ? (int16_t *)mem_pool_alloc(MEM_POOL_I2S_DMA) : buffer;
+    if (!buffer || !frames) {
         ESP_LOGE(TAG, "Failed to allocate playback buffer");
-        vTaskDelete(NULL);
+        mem_pool_free(mono_pool, buffer);
+        if (frames != buffer) {
+            mem_pool_free(MEM_POOL_I2S_DMA, frames);
+        }
+        audio_task_exit(s_audio.playback_done);
         return;
     }
 
+    alloc_trace_watch_current_task();
     while (s_audio.playback_active) {
         if (s_audio.playback_cb) {
-            // Get audio data from callback (expected at 48kHz)
-            s_audio.playback_cb(buffer, BUFFER_SIZE, s_audio.playback_user_data);
+            size_t samples = s_audio.frame_samples;
+            s_audio.playback_cb(buffer, samples, s_audio.playback_user_data);
+            samples = audio_pipeline_process(AUDIO_PIPELINE_RENDER, buffer, samples, BUFFER_SIZE);
+            if (AUDIO_MIC_CHANNELS > 1) {
+                // TX shares the capture frame layout
+                audio_dsp_interleave_mono_s16(buffer, frames, AUDIO_MIC_CHANNELS, samples);
+            }
             
             // Write to shared I2S bus (DOUT pin) - ES8311 DAC
             size_t bytes_written = 0;
-            esp_err_t ret = i2s_write(I2S_NUM_0, buffer, BUFFER_SIZE * sizeof(int16_t), &bytes_written, portMAX_DELAY);
+            esp_err_t ret = i2s_write(I2S_NUM_0, frames, samples * AUDIO_MIC_CHANNELS * sizeof(int16_t),
+                                      &bytes_written, pdMS_TO_TICKS(I2S_IO_TIMEOUT_MS));
             
-            if (ret != ESP_OK) {
+            if (ret != ESP_OK && ret != ESP_ERR_TIMEOUT) {
                 ESP_LOGE(TAG, "I2S write error: %s", esp_err_to_name(ret));
             }
         } else {
@@ -93,16 +185,24 @@ static void audio_playback_task(void *pvParameters)
         }
     }
 
-    free(buffer);
-    vTaskDelete(NULL);
+    if (frames != buffer) {
+        mem_pool_free(MEM_POOL_I2S_DMA, frames);
+    }
+    mem_pool_free(mono_pool, buffer);
+    alloc_trace_unwatch_current_task();
+    audio_task_exit(s_audio.playback_done);
 }
 
-esp_err_t audio_handler_init(void)
+esp_err_t audio_handler_init(const audio_format_t *format)
 {
     if (s_audio.initialized) {
         ESP_LOGW(TAG, "Audio handler already initialized");
         return ESP_ERR_INVALID_STATE;
     }
+    s_audio.format = *format;
+    s_audio.frame_samples = audio_format_frame_samples(format);
+    s_audio.capture_done = xSemaphoreCreateBinaryStatic(&s_audio.capture_done_buf);
+    s_audio.playback_done = xSemaphoreCreateBinaryStatic(&s_audio.playback_done_buf);
 
     // Configure audio amplifier GPIO
     gpio_config_t amp_gpio_config = {
@@ -118,24 +218,25 @@ esp_err_t audio_handler_init(void)
     ESP_LOGI(TAG, "Audio amplifier GPIO configured (GPIO%d)", AUDIO_AMP_PIN);
 
     // Configure shared I2S bus for duplex mode (RX + TX)
-    // Note: ES8311 DAC and ES7210 ADC share the same I2S bus
-    // We configure for duplex mode - speaker at 48kHz, mic at 16kHz
-    // In practice, we'll configure for 48kHz and resample mic input, or use separate I2S instances
-    
-    // For now, configure I2S_NUM_0 in duplex mode at 48kHz (speaker rate)
-    // Microphone will be resampled from 16kHz to 48kHz if needed
+    // Note: ES8311 DAC and ES7210 ADC share the same I2S bus, so both run at
+    // the format rate. MCLK is fixed so the codec clock tables stay valid
+    // for every supported rate.
     i2s_config_t i2s_config = {
         .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_TX),
-        .sample_rate = SPEAKER_SAMPLE_RATE, // 48kHz for ES8311 DAC
+        .sample_rate = format->sample_rate,
         .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
-        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT, // Mono
+        .channel_format = I2S_FRAME_FORMAT,
         .communication_format = I2S_COMM_FORMAT_STAND_I2S,
         .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
         .dma_buf_count = 8,
         .dma_buf_len = BUFFER_SIZE,
         .use_apll = true, // Use APLL for better clock quality
         .tx_desc_auto_clear = true,
-        .fixed_mclk = 0,
+        .fixed_mclk = AUDIO_CODEC_MCLK_HZ,
+#if AUDIO_MIC_CHANNELS == 4
+        .chan_mask = I2S_FRAME_CHANNELS,
+        .total_chan = 4,
+#endif
     };
 
     // Shared I2S pin configuration for Waveshare ESP32-P4-86
@@ -162,11 +263,21 @@ esp_err_t audio_handler_init(void)
 
     i2s_zero_dma_buffer(I2S_NUM_0);
 
+    if (AUDIO_MIC_CHANNELS > 1) {
+        beamformer_init(AUDIO_MIC_CHANNELS, NULL);
+    }
+    if (audio_pipeline_build(AUDIO_PIPELINE_CAPTURE, s_capture_stages, format) != ESP_OK ||
+        audio_pipeline_build(AUDIO_PIPELINE_RENDER, s_render_stages, format) != ESP_OK) {
+        ESP_LOGW(TAG, "Audio pipeline setup failed, running without processing stages");
+    }
+
+    s_audio.clocks_enabled = true; // i2s_driver_install starts the channel
     s_audio.initialized = true;
     ESP_LOGI(TAG, "Audio handler initialized for Waveshare ESP32-P4-86");
     ESP_LOGI(TAG, "I2S: MCLK=GPIO%d, BCLK=GPIO%d, LRCLK=GPIO%d", I2S_MCLK_PIN, I2S_BCLK_PIN, I2S_LRCLK_PIN);
-    ESP_LOGI(TAG, "Microphone (ES7210): DIN=GPIO%d, Sample rate=%dHz", I2S_DIN_PIN, MIC_SAMPLE_RATE);
-    ESP_LOGI(TAG, "Speaker (ES8311): DOUT=GPIO%d, Sample rate=%dHz", I2S_DOUT_PIN, SPEAKER_SAMPLE_RATE);
+    ESP_LOGI(TAG, "Microphone (ES7210): DIN=GPIO%d, Speaker (ES8311): DOUT=GPIO%d", I2S_DIN_PIN, I2S_DOUT_PIN);
+    ESP_LOGI(TAG, "Sample rate=%luHz, %u samples per frame",
+             (unsigned long)format->sample_rate, (unsigned)s_audio.frame_samples);
     
     return ESP_OK;
 }
@@ -194,6 +305,8 @@ esp_err_t audio_handler_start_capture(void)
         return ESP_ERR_INVALID_STATE;
     }
 
+    // Drop an exit left over from a stop that timed out
+    xSemaphoreTake(s_audio.capture_done, 0);
     s_audio.capture_active = true;
     xTaskCreate(audio_capture_task, "audio_capture", 4096, NULL, 5, &s_audio.capture_task_handle);
 
@@ -209,7 +322,12 @@ esp_err_t audio_handler_stop_capture(void)
 
     s_audio.capture_active = false;
     if (s_audio.capture_task_handle) {
-        vTaskDelay(pdMS_TO_TICKS(100)); // Wait for task to finish
+        // The task may be blocked in I2S for up to I2S_IO_TIMEOUT_MS and
+        // still holds its pool blocks until it exits
+        esp_err_t ret = audio_task_join(s_audio.capture_done, "Capture");
+        if (ret != ESP_OK) {
+            return ret;
+        }
         s_audio.capture_task_handle = NULL;
     }
 
@@ -228,6 +346,8 @@ esp_err_t audio_handler_start_playback(void)
         return ESP_ERR_INVALID_STATE;
     }
 
+    // Drop an exit left over from a stop that timed out
+    xSemaphoreTake(s_audio.playback_done, 0);
     s_audio.playback_active = true;
     xTaskCreate(audio_playback_task, "audio_playback", 4096, NULL, 5, &s_audio.playback_task_handle);
 
@@ -243,7 +363,12 @@ esp_err_t audio_handler_stop_playback(void)
 
     s_audio.playback_active = false;
     if (s_audio.playback_task_handle) {
-        vTaskDelay(pdMS_TO_TICKS(100)); // Wait for task to finish
+        // The task may be blocked in I2S for up to I2S_IO_TIMEOUT_MS and
+        // still holds its pool blocks until it exits
+        esp_err_t ret = audio_task_join(s_audio.playback_done, "Playback");
+        if (ret != ESP_OK) {
+            return ret;
+        }
         s_audio.playback_task_handle = NULL;
     }
 
@@ -269,6 +394,64 @@ esp_err_t audio_handler_set_amplifier(bool enable)
     return ESP_OK;
 }
 
+esp_err_t audio_handler_set_format(const audio_format_t *format)
+{
+    if (!s_audio.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_audio.capture_active || s_audio.playback_active) {
+        ESP_LOGW(TAG, "Cannot change format while streaming");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // i2s_set_clk() restarts the channel; put it back the way it was
+    esp_err_t ret = i2s_set_clk(I2S_NUM_0, format->sample_rate, I2S_BITS_PER_SAMPLE_16BIT, I2S_FRAME_CHANNELS);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set I2S clock to %luHz: %s",
+                 (unsigned long)format->sample_rate, esp_err_to_name(ret));
+        return ret;
+    }
+    if (!s_audio.clocks_enabled) {
+        i2s_stop(I2S_NUM_0);
+    }
+    i2s_zero_dma_buffer(I2S_NUM_0);
+
+    s_audio.format = *format;
+    s_audio.frame_samples = audio_format_frame_samples(format);
+    // Filter coefficients follow the rate
+    ret = audio_pipeline_set_format(format);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ESP_LOGI(TAG, "I2S reconfigured: %luHz, %u samples per frame",
+             (unsigned long)format->sample_rate, (unsigned)s_audio.frame_samples);
+    return ESP_OK;
+}
+
+esp_err_t audio_handler_set_clocks(bool enable)
+{
+    if (!s_audio.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_audio.clocks_enabled == enable) {
+        return ESP_OK;
+    }
+
+    // Stopping I2S halts MCLK/BCLK/LRCLK; the driver and DMA buffers stay
+    // allocated so restarting is cheap
+    esp_err_t ret = enable ? i2s_start(I2S_NUM_0) : i2s_stop(I2S_NUM_0);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to %s I2S clocks: %s", enable ? "start" : "stop", esp_err_to_name(ret));
+        return ret;
+    }
+    if (enable) {
+        i2s_zero_dma_buffer(I2S_NUM_0);
+    }
+    s_audio.clocks_enabled = enable;
+    ESP_LOGD(TAG, "I2S clocks %s", enable ? "running" : "stopped");
+    return ESP_OK;
+}
+
 void audio_handler_deinit(void)
 {
     audio_handler_stop_capture();
@@ -0,0 +1,188 @@
+/*
+ * Audio Pipeline Implementation
+ *
+ * Stage state is laid out back to back in a static arena, 8-byte aligned,
+ * when a pipeline is built. Only the cycle counter and logging come from
+ * ESP-IDF, so this file builds unchanged on the host (with a cycle counter
+ * shim) to benchmark stage lists offline.
+ */
+
+#include "audio_pipeline.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "audio_pipeline";
+
+#define STATE_ALIGN 8
+
+typedef struct {
+    const audio_stage_t *stage;
+    void *state;
+    uint32_t blocks;
+    uint64_t samples;
+    uint64_t cycles;
+    uint32_t max_cycles;
+} stage_slot_t;
+
+typedef struct {
+    size_t count;
+    size_t state_bytes;
+    uint32_t latency_samples;
+    audio_format_t format;
+    stage_slot_t slots[AUDIO_PIPELINE_MAX_STAGES];
+    uint64_t arena[AUDIO_PIPELINE_STATE_SIZE / sizeof(uint64_t)];
+} pipeline_t;
+
+static pipeline_t s_pipelines[AUDIO_PIPELINE_COUNT];
+
+static const char *pipeline_name(audio_pipeline_id_t id)
+{
+    return id == AUDIO_PIPELINE_CAPTURE ? "capture" : "render";
+}
+
+static void clear_stats(pipeline_t *p)
+{
+    for (size_t i = 0; i < p->count; i++) {
+        p->slots[i].blocks = 0;
+        p->slots[i].samples = 0;
+        p->slots[i].cycles = 0;
+        p->slots[i].max_cycles = 0;
+    }
+}
+
+// Zero each stage's state and run its init at the pipeline's format
+static esp_err_t init_stages(audio_pipeline_id_t id)
+{
+    pipeline_t *p = &s_pipelines[id];
+    memset(p->arena, 0, p->state_bytes);
+    for (size_t i = 0; i < p->count; i++) {
+        const audio_stage_t *stage = p->slots[i].stage;
+        if (stage->init) {
+            esp_err_t ret = stage->init(p->slots[i].state, &p->format);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "%s stage %s init failed: %s", pipeline_name(id), stage->name,
+                         esp_err_to_name(ret));
+                return ret;
+            }
+        }
+    }
+    clear_stats(p);
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_build(audio_pipeline_id_t id, const audio_stage_t *const *stages,
+                               const audio_format_t *format)
+{
+    if (id >= AUDIO_PIPELINE_COUNT || !stages || !format) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pipeline_t *p = &s_pipelines[id];
+    p->count = 0;
+    p->state_bytes = 0;
+    p->latency_samples = 0;
+    p->format = *format;
+
+    size_t count = 0;
+    size_t offset = 0;
+    uint32_t latency = 0;
+    for (; stages[count]; count++) {
+        const audio_stage_t *stage = stages[count];
+        if (count == AUDIO_PIPELINE_MAX_STAGES) {
+            ESP_LOGE(TAG, "%s pipeline has more than %d stages", pipeline_name(id), AUDIO_PIPELINE_MAX_STAGES);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (!stage->process) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        size_t size = (stage->state_size + STATE_ALIGN - 1) & ~(size_t)(STATE_ALIGN - 1);
+        if (size > sizeof(p->arena) - offset) {
+            ESP_LOGE(TAG, "%s stage %s needs %u state bytes, %u left", pipeline_name(id), stage->name,
+                     (unsigned)stage->state_size, (unsigned)(sizeof(p->arena) - offset));
+            return ESP_ERR_INVALID_SIZE;
+        }
+        p->slots[count] = (stage_slot_t){
+            .stage = stage,
+            .state = size ? (uint8_t *)p->arena + offset : NULL,
+        };
+        offset += size;
+        latency += stage->latency_samples;
+    }
+    p->count = count;
+    p->state_bytes = offset;
+    p->latency_samples = latency;
+
+    esp_err_t ret = init_stages(id);
+    if (ret != ESP_OK) {
+        p->count = 0;
+        p->state_bytes = 0;
+        p->latency_samples = 0;
+        return ret;
+    }
+    ESP_LOGI(TAG, "%s pipeline: %u stages, %u state bytes, %lu samples latency", pipeline_name(id),
+             (unsigned)count, (unsigned)offset, (unsigned long)latency);
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_set_format(const audio_format_t *format)
+{
+    esp_err_t result = ESP_OK;
+    for (int id = 0; id < AUDIO_PIPELINE_COUNT; id++) {
+        s_pipelines[id].format = *format;
+        esp_err_t ret = init_stages((audio_pipeline_id_t)id);
+        if (ret != ESP_OK) {
+            result = ret;
+        }
+    }
+    return result;
+}
+
+size_t audio_pipeline_process(audio_pipeline_id_t id, int16_t *block, size_t samples, size_t capacity)
+{
+    pipeline_t *p = &s_pipelines[id];
+    for (size_t i = 0; i < p->count; i++) {
+        stage_slot_t *slot = &p->slots[i];
+        uint32_t start = esp_cpu_get_cycle_count();
+        samples = slot->stage->process(slot->state, block, samples, capacity);
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+        slot->blocks++;
+        slot->samples += samples;
+        slot->cycles += cycles;
+        if (cycles > slot->max_cycles) {
+            slot->max_cycles = cycles;
+        }
+    }
+    return samples;
+}
+
+uint32_t audio_pipeline_latency(audio_pipeline_id_t id)
+{
+    return s_pipelines[id].latency_samples;
+}
+
+void audio_pipeline_get_stats(audio_pipeline_id_t id, audio_pipeline_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    const pipeline_t *p = &s_pipelines[id];
+    memset(stats, 0, sizeof(*stats));
+    stats->stages = p->count;
+    stats->state_bytes = p->state_bytes;
+    stats->latency_samples = p->latency_samples;
+    for (size_t i = 0; i < p->count; i++) {
+        const stage_slot_t *slot = &p->slots[i];
+        audio_stage_stats_t *out = &stats->stage[i];
+        out->name = slot->stage->name;
+        out->blocks = slot->blocks;
+        out->avg_cycles = slot->blocks ? (uint32_t)(slot->cycles / slot->blocks) : 0;
+        out->max_cycles = slot->max_cycles;
+        out->cycles_per_sample = slot->samples ? (float)((double)slot->cycles / (double)slot->samples) : 0.0f;
+    }
+}
+
+void audio_pipeline_reset(audio_pipeline_id_t id)
+{
+    init_stages(id);
+}
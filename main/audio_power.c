@@ -0,0 +1,173 @@
+/*
+ * Audio Power Management Implementation
+ * Sequences the amplifier, codecs and I2S clocks between OFF, STANDBY and
+ * ACTIVE and keeps residency/wake statistics
+ */
+
+#include "audio_power.h"
+#include "audio_codec.h"
+#include "audio_format.h"
+#include "audio_handler.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "audio_power";
+
+static const char *STATE_NAMES[AUDIO_POWER_STATE_COUNT] = {
+    "OFF",
+    "STANDBY",
+    "ACTIVE",
+};
+
+static struct {
+    bool initialized;
+    int64_t state_since_us;
+    audio_power_stats_t stats;
+} s_power = {0};
+
+// Everything that makes noise or draws analog current goes down first
+static esp_err_t power_down(bool keep_registers)
+{
+    audio_handler_set_amplifier(false);
+
+    esp_err_t ret;
+    if (keep_registers) {
+        ret = audio_codec_es8311_standby(true);
+        if (ret == ESP_OK) {
+            ret = audio_codec_es7210_standby(true);
+        }
+    } else {
+        ret = audio_codec_es8311_power(false);
+        if (ret == ESP_OK) {
+            ret = audio_codec_es7210_power(false);
+        }
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Codecs no longer need MCLK
+    return audio_handler_set_clocks(false);
+}
+
+// Clocks first (codec PLLs and register writes that verify need MCLK), then
+// the codecs; the caller switches the amplifier on last
+static esp_err_t power_up_codecs(bool cold)
+{
+    esp_err_t ret = audio_handler_set_clocks(true);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (cold) {
+        uint32_t rate = audio_format_get()->sample_rate;
+        ret = audio_codec_es8311_init(rate);
+        if (ret == ESP_OK) {
+            ret = audio_codec_es7210_init(rate);
+        }
+        s_power.stats.cold_wakes++;
+    } else {
+        ret = audio_codec_es8311_standby(false);
+        if (ret == ESP_OK) {
+            ret = audio_codec_es7210_standby(false);
+        }
+    }
+    return ret;
+}
+
+static void account_state(int64_t now)
+{
+    s_power.stats.time_in_state_us[s_power.stats.state] += (uint64_t)(now - s_power.state_since_us);
+    s_power.state_since_us = now;
+}
+
+esp_err_t audio_power_init(void)
+{
+    s_power.stats = (audio_power_stats_t){ .state = AUDIO_POWER_ACTIVE };
+    s_power.state_since_us = esp_timer_get_time();
+    s_power.initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t audio_power_set_state(audio_power_state_t state)
+{
+    if (!s_power.initialized || state >= AUDIO_POWER_STATE_COUNT) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    audio_power_state_t from = s_power.stats.state;
+    if (from == state) {
+        return ESP_OK;
+    }
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = ESP_OK;
+
+    switch (state) {
+        case AUDIO_POWER_ACTIVE:
+            ret = power_up_codecs(from == AUDIO_POWER_OFF);
+            if (ret == ESP_OK) {
+                vTaskDelay(pdMS_TO_TICKS(AUDIO_POWER_AMP_SETTLE_MS));
+                ret = audio_handler_set_amplifier(true);
+            }
+            break;
+        case AUDIO_POWER_STANDBY:
+            if (from == AUDIO_POWER_OFF) {
+                // Registers were lost; bring the codecs up once so standby
+                // has a configuration to keep
+                ret = power_up_codecs(true);
+            }
+            if (ret == ESP_OK) {
+                ret = power_down(true);
+            }
+            break;
+        case AUDIO_POWER_OFF:
+        default:
+            ret = power_down(false);
+            break;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (ret != ESP_OK) {
+        s_power.stats.failures++;
+        ESP_LOGE(TAG, "%s -> %s failed: %s", STATE_NAMES[from], STATE_NAMES[state], esp_err_to_name(ret));
+        return ret;
+    }
+
+    account_state(now);
+    s_power.stats.state = state;
+
+    uint32_t elapsed_us = (uint32_t)(now - start);
+    if (state == AUDIO_POWER_ACTIVE) {
+        s_power.stats.wakes++;
+        s_power.stats.last_wake_us = elapsed_us;
+        if (elapsed_us > s_power.stats.max_wake_us) {
+            s_power.stats.max_wake_us = elapsed_us;
+        }
+        if (elapsed_us > AUDIO_POWER_WAKE_TARGET_US) {
+            s_power.stats.slow_wakes++;
+            ESP_LOGW(TAG, "Wake from %s took %luus (target %dus)", STATE_NAMES[from],
+                     (unsigned long)elapsed_us, AUDIO_POWER_WAKE_TARGET_US);
+        }
+    }
+    ESP_LOGI(TAG, "%s -> %s in %luus", STATE_NAMES[from], STATE_NAMES[state], (unsigned long)elapsed_us);
+    return ESP_OK;
+}
+
+audio_power_state_t audio_power_get_state(void)
+{
+    return s_power.stats.state;
+}
+
+void audio_power_get_stats(audio_power_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    if (s_power.initialized) {
+        account_state(esp_timer_get_time());
+    }
+    *stats = s_power.stats;
+}
@@ -0,0 +1,46 @@
+/*
+ * Audio Pipeline Stages Implementation
+ */
+
+#include "audio_stages.h"
+#include <math.h>
+
+typedef struct {
+    float pole;
+    float x1;
+    float y1;
+} dc_block_t;
+
+static esp_err_t dc_block_init(void *state, const audio_format_t *format)
+{
+    dc_block_t *s = (dc_block_t *)state;
+    s->pole = 1.0f - 2.0f * (float)M_PI * AUDIO_DC_BLOCK_HZ / (float)format->sample_rate;
+    return ESP_OK;
+}
+
+// y[n] = x[n] - x[n-1] + pole * y[n-1]
+static size_t dc_block_process(void *state, int16_t *block, size_t samples, size_t capacity)
+{
+    dc_block_t *s = (dc_block_t *)state;
+    float x1 = s->x1;
+    float y1 = s->y1;
+    for (size_t i = 0; i < samples; i++) {
+        float x = block[i];
+        float y = x - x1 + s->pole * y1;
+        x1 = x;
+        y1 = y;
+        long v = lrintf(y);
+        block[i] = (int16_t)(v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v));
+    }
+    s->x1 = x1;
+    s->y1 = y1;
+    return samples;
+}
+
+const audio_stage_t audio_stage_dc_block = {
+    .name = "dc_block",
+    .state_size = sizeof(dc_block_t),
+    .latency_samples = 0,
+    .init = dc_block_init,
+    .process = dc_block_process,
+};
@@ -0,0 +1,71 @@
+/*
+ * Heap Allocation Tracer
+ * Attributes heap allocations to call phases through the ESP-IDF heap
+ * hooks. Enable with CONFIG_HEAP_USE_HOOKS=y (see sdkconfig.defaults);
+ * without it every function here is a cheap no-op.
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ALLOC_TRACE_MAX_WATCHED 4
+
+typedef enum {
+    ALLOC_PHASE_IDLE = 0,
+    ALLOC_PHASE_SETUP,          // Offer/answer exchange, codec wake
+    ALLOC_PHASE_CONNECTED,      // Media flowing
+    ALLOC_PHASE_TEARDOWN,       // Stopping audio after leave
+    ALLOC_PHASE_COUNT,
+} alloc_phase_t;
+
+typedef struct {
+    uint32_t allocs;
+    uint32_t frees;
+    uint64_t bytes;             // Total bytes allocated
+    uint32_t peak_bytes;        // Highest net growth (allocated - freed) within the phase; 0 for idle
+    uint32_t audio_allocs;      // Allocations made by watched audio tasks
+    uint32_t untracked;         // Left out of peak_bytes: the size table was full
+} alloc_phase_stats_t;
+
+/**
+ * @brief True when built with CONFIG_HEAP_USE_HOOKS
+ */
+bool alloc_trace_enabled(void);
+
+/**
+ * @brief Attribute allocations from now on to a phase
+ */
+void alloc_trace_set_phase(alloc_phase_t phase);
+
+alloc_phase_t alloc_trace_get_phase(void);
+
+/**
+ * @brief Count allocations from the calling task as audio allocations
+ *
+ * Audio tasks call this when they start and alloc_trace_unwatch_current_task()
+ * before they delete themselves.
+ */
+void alloc_trace_watch_current_task(void);
+void alloc_trace_unwatch_current_task(void);
+
+/**
+ * @brief Copy the per-phase totals and start a new tally
+ */
+void alloc_trace_take(alloc_phase_stats_t stats[ALLOC_PHASE_COUNT]);
+
+/**
+ * @brief Log one line per phase; warns if audio tasks allocated while connected
+ * @return Number of audio task allocations in the connected phase
+ */
+uint32_t alloc_trace_log(const alloc_phase_stats_t stats[ALLOC_PHASE_COUNT]);
+
+#ifdef __cplusplus
+}
+#endif
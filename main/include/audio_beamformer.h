@@ -0,0 +1,62 @@
+/*
+ * Microphone Array Beamformer
+ * Delay-and-sum of the ES7210 channels into one enhanced mono stream
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BEAMFORMER_MAX_CHANNELS 4
+#define BEAMFORMER_MAX_DELAY 16     // Steering delay limit in samples
+#define BEAMFORMER_MAX_FRAMES 1024  // Largest frame accepted by process()
+
+typedef struct {
+    size_t channels;
+    uint32_t frames_processed;
+    uint32_t avg_deinterleave_cycles;   // Per frame
+    uint32_t avg_beamform_cycles;       // Per frame
+    uint32_t max_total_cycles;
+    // Mean mic power over output power. On-axis speech sums coherently and
+    // stays near 0 dB; uncorrelated noise drops by up to 10*log10(channels),
+    // so during noise-only periods this is the SNR gain of the array.
+    float array_gain_db;
+} beamformer_stats_t;
+
+/**
+ * @brief Set up the beamformer
+ *
+ * @param channels Microphones in each interleaved frame (1-4)
+ * @param delays Per-channel steering delay in samples, or NULL for
+ *               broadside (talker straight in front of the panel)
+ */
+esp_err_t beamformer_init(size_t channels, const uint8_t *delays);
+
+/**
+ * @brief Beamform one block of interleaved capture frames
+ *
+ * @param in Interleaved samples, frames * channels long
+ * @param out Mono output, frames long (may not alias in)
+ * @param frames Frames in the block (at most BEAMFORMER_MAX_FRAMES)
+ */
+esp_err_t beamformer_process(const int16_t *in, int16_t *out, size_t frames);
+
+/**
+ * @brief Get CPU cost and array gain statistics
+ */
+void beamformer_get_stats(beamformer_stats_t *stats);
+
+/**
+ * @brief Clear statistics and delay history
+ */
+void beamformer_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,6 +7,8 @@
 
 #include "esp_err.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -19,20 +21,74 @@ extern "C" {
 #define ES8311_I2C_ADDR 0x18
 #define ES7210_I2C_ADDR 0x40
 
+// Upper bound for a single codec I2C transaction; a stuck bus fails the
+// call instead of blocking the caller forever
+#define AUDIO_CODEC_I2C_TIMEOUT_MS 20
+
+// MCLK supplied on I2S_MCLK_PIN (APLL, 256 x 48 kHz). Codec clock dividers
+// are selected from MCLK / sample_rate.
+#define AUDIO_CODEC_MCLK_HZ 12288000
+
+// Microphones captured from the ES7210: 1, 2 (I2S stereo frame) or 4 (TDM).
+// With more than one, the capture path beamforms them into one mono stream.
+#ifndef AUDIO_MIC_CHANNELS
+#define AUDIO_MIC_CHANNELS 2
+#endif
+
+typedef enum {
+    AUDIO_CODEC_ES8311 = 0,
+    AUDIO_CODEC_ES7210,
+    AUDIO_CODEC_COUNT,
+} audio_codec_id_t;
+
+/**
+ * @brief Register access for one codec
+ *
+ * Writes and reads start at reg and auto-increment over len registers.
+ * audio_codec_i2c_init() installs the I2C implementation; a test harness can
+ * attach its own (e.g. a register-file mock) instead.
+ */
+typedef struct {
+    esp_err_t (*write)(void *ctx, uint8_t reg, const uint8_t *data, size_t len, uint32_t timeout_ms);
+    esp_err_t (*read)(void *ctx, uint8_t reg, uint8_t *data, size_t len, uint32_t timeout_ms);
+    void *ctx;
+} audio_codec_bus_t;
+
+typedef struct {
+    uint32_t transactions;       // Bus transactions issued (writes and reads)
+    uint32_t registers_written;  // Registers covered by those writes
+    uint32_t errors;             // Failed or timed out transactions
+    uint32_t verify_failures;    // Read-back mismatches after a write
+    uint32_t transactions_saved; // Writes skipped as no-ops or merged into a burst
+    uint32_t es8311_init_us;     // Duration of the last ES8311 init
+    uint32_t es7210_init_us;     // Duration of the last ES7210 init
+} audio_codec_stats_t;
+
 /**
  * @brief Initialize I2C bus for audio codecs
  */
 esp_err_t audio_codec_i2c_init(void);
 
+/**
+ * @brief Attach a register access implementation to a codec
+ */
+esp_err_t audio_codec_attach_bus(audio_codec_id_t codec, const audio_codec_bus_t *bus);
+
+/**
+ * @brief Check that both codecs have clock settings for a sample rate at
+ *        AUDIO_CODEC_MCLK_HZ
+ */
+bool audio_codec_supports_rate(uint32_t sample_rate);
+
 /**
  * @brief Initialize ES8311 DAC (speaker)
- * @param sample_rate Sample rate in Hz (e.g., 48000)
+ * @param sample_rate Sample rate in Hz (see audio_codec_supports_rate())
  */
 esp_err_t audio_codec_es8311_init(uint32_t sample_rate);
 
 /**
  * @brief Initialize ES7210 ADC (microphone)
- * @param sample_rate Sample rate in Hz (e.g., 16000)
+ * @param sample_rate Sample rate in Hz (see audio_codec_supports_rate())
  */
 esp_err_t audio_codec_es7210_init(uint32_t sample_rate);
 
@@ -52,7 +108,25 @@ esp_err_t audio_codec_es8311_power(bool enable);
  */
 esp_err_t audio_codec_es7210_power(bool enable);
 
+/**
+ * @brief Put ES8311 into standby or bring it back
+ *
+ * Standby mutes the DAC and powers down the analog blocks and internal
+ * clocks but keeps the register file, so waking takes a few I2C writes
+ * instead of a full init. MCLK may be stopped while in standby.
+ */
+esp_err_t audio_codec_es8311_standby(bool standby);
+
+/**
+ * @brief Put ES7210 into standby or bring it back (see audio_codec_es8311_standby)
+ */
+esp_err_t audio_codec_es7210_standby(bool standby);
+
+/**
+ * @brief Get codec bus and init timing statistics
+ */
+void audio_codec_get_stats(audio_codec_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
-
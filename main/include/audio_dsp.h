@@ -0,0 +1,126 @@
+/*
+ * Audio DSP Kernels
+ * Sample layout conversion between interleaved I2S/TDM frames and planar
+ * per-channel buffers, and the arithmetic kernels pipeline stages are built
+ * from: gain, mix, FIR, biquad, int16/float conversion, peak and energy
+ *
+ * One API, with the implementation picked at build time: SSE2 on x86 hosts,
+ * NEON on AArch64 hosts, ESP-DSP on the ESP32-P4 for the biquad only (the
+ * P4's integer kernels are not accelerated yet), and the scalar reference
+ * everywhere else. Define AUDIO_DSP_SCALAR
+ * to force the reference. Every kernel except the biquad returns the same
+ * bits as its reference on every backend.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Split interleaved frames into one buffer per channel
+ *
+ * @param in Interleaved samples, frames * channels long
+ * @param out One destination per channel, each frames long
+ * @param channels Channels per frame (1-4)
+ * @param frames Frames to convert
+ */
+void audio_dsp_deinterleave_s16(const int16_t *in, int16_t *const *out, size_t channels, size_t frames);
+
+/**
+ * @brief Spread a mono buffer over interleaved frames
+ *
+ * The sample goes to slots 0 and 1 (left/right, where the ES8311 listens);
+ * any further TDM slots are zeroed.
+ */
+void audio_dsp_interleave_mono_s16(const int16_t *in, int16_t *out, size_t channels, size_t frames);
+
+#define AUDIO_DSP_GAIN_SHIFT 12
+#define AUDIO_DSP_GAIN_UNITY (1 << AUDIO_DSP_GAIN_SHIFT)    // Gains are Q12: -8.0 to just under 8.0
+
+/**
+ * @brief out = in * gain, rounded and saturated
+ *
+ * @param gain Q12 factor, AUDIO_DSP_GAIN_UNITY for 1.0; in and out may alias
+ */
+void audio_dsp_gain_s16(const int16_t *in, int16_t *out, size_t n, int16_t gain);
+
+/**
+ * @brief dst += src, saturated
+ */
+void audio_dsp_mix_s16(int16_t *dst, const int16_t *src, size_t n);
+
+/**
+ * @brief FIR filter, Q15 coefficients
+ *
+ * out[i] = sum(coeffs[k] * in[i - k]) for k < taps, rounded and saturated.
+ * Keep the sum of |coeffs| at or below 32768 (a gain of 1.0) so the 32-bit
+ * accumulator cannot overflow; within that every backend is bit-exact.
+ *
+ * @param in Input; the taps - 1 samples before in[0] must be valid history
+ * @param out Output, n long (may not alias in)
+ */
+void audio_dsp_fir_s16(const int16_t *in, int16_t *out, size_t n, const int16_t *coeffs, size_t taps);
+
+/**
+ * @brief Biquad filter, direct form II
+ *
+ * Same layout as ESP-DSP's dsps_biquad_f32, so it can stand in for it.
+ * Float rounding may differ in the last bit between backends.
+ *
+ * @param coeffs b0, b1, b2, a1, a2 (a0 normalised to 1)
+ * @param state Two delay elements, zero to start; in and out may alias
+ */
+void audio_dsp_biquad_f32(const float *in, float *out, size_t n, const float *coeffs, float *state);
+
+/**
+ * @brief int16 to float in [-1, 1)
+ */
+void audio_dsp_s16_to_f32(const int16_t *in, float *out, size_t n);
+
+/**
+ * @brief Float in [-1, 1) to int16, rounded to nearest and saturated
+ *
+ * NaN inputs give an unspecified sample.
+ */
+void audio_dsp_f32_to_s16(const float *in, int16_t *out, size_t n);
+
+/**
+ * @brief Largest absolute sample, 0-32768
+ */
+uint32_t audio_dsp_peak_s16(const int16_t *in, size_t n);
+
+/**
+ * @brief Sum of squared samples
+ */
+uint64_t audio_dsp_energy_s16(const int16_t *in, size_t n);
+
+/**
+ * @brief RMS level of a block, 0-32768
+ */
+float audio_dsp_rms_s16(const int16_t *in, size_t n);
+
+// Scalar reference implementations. Always built, whatever the backend,
+// so the optimized kernels can be checked against them.
+void audio_dsp_gain_s16_ref(const int16_t *in, int16_t *out, size_t n, int16_t gain);
+void audio_dsp_mix_s16_ref(int16_t *dst, const int16_t *src, size_t n);
+void audio_dsp_fir_s16_ref(const int16_t *in, int16_t *out, size_t n, const int16_t *coeffs, size_t taps);
+void audio_dsp_biquad_f32_ref(const float *in, float *out, size_t n, const float *coeffs, float *state);
+void audio_dsp_s16_to_f32_ref(const int16_t *in, float *out, size_t n);
+void audio_dsp_f32_to_s16_ref(const float *in, int16_t *out, size_t n);
+uint32_t audio_dsp_peak_s16_ref(const int16_t *in, size_t n);
+uint64_t audio_dsp_energy_s16_ref(const int16_t *in, size_t n);
+
+/**
+ * @brief Name of the backend this build uses
+ */
+const char *audio_dsp_backend(void);
+
+#ifdef __cplusplus
+}
+#endif
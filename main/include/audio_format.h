@@ -0,0 +1,71 @@
+/*
+ * Audio Format
+ * The single sample format shared by the codecs, the I2S bus and the audio
+ * pipeline, negotiated per call from the remote SDP
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Used until a call negotiates something else: wideband, 20 ms frames
+#define AUDIO_FORMAT_DEFAULT_RATE 16000
+#define AUDIO_FORMAT_FRAME_MS 20
+
+typedef struct {
+    uint32_t sample_rate;       // Codec, I2S and pipeline rate in Hz
+    uint8_t channels;           // Always 1: the board has one speaker
+    uint8_t bits_per_sample;
+    uint8_t frame_ms;           // Pipeline frame duration
+    uint8_t payload_type;       // Negotiated RTP payload type
+    char encoding[16];          // Negotiated RTP encoding name, e.g. "opus"
+} audio_format_t;
+
+/**
+ * @brief Samples per channel in one pipeline frame
+ */
+static inline size_t audio_format_frame_samples(const audio_format_t *format)
+{
+    return (size_t)format->sample_rate * format->frame_ms / 1000;
+}
+
+/**
+ * @brief Fill a format with the boot-time default (16 kHz mono, 16-bit)
+ */
+void audio_format_default(audio_format_t *format);
+
+/**
+ * @brief Pick the format for a call from a remote SDP
+ *
+ * Walks the audio payload types in the remote's preference order and picks
+ * the first one whose native rate the codecs can run directly, so no stage
+ * has to resample: PCMU/PCMA at 8 kHz, G.722 at 16 kHz, L16 at its rtpmap
+ * rate and Opus at its maxplaybackrate (48 kHz if not given).
+ *
+ * @return ESP_ERR_NOT_FOUND if no offered payload type maps to a supported rate
+ */
+esp_err_t audio_format_from_sdp(const char *sdp, audio_format_t *format);
+
+/**
+ * @brief Format the codecs, I2S and pipeline are currently running
+ */
+const audio_format_t *audio_format_get(void);
+
+/**
+ * @brief Switch codecs, I2S and pipeline to a new format
+ *
+ * Must be called between calls (audio power not ACTIVE, capture and
+ * playback stopped). Either every stage switches or, if one fails, all of
+ * them are put back on the previous format.
+ */
+esp_err_t audio_format_apply(const audio_format_t *format);
+
+#ifdef __cplusplus
+}
+#endif
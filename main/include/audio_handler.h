@@ -5,7 +5,10 @@
 
 #pragma once
 
+#include "audio_format.h"
 #include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -23,12 +26,10 @@ extern "C" {
 // Audio amplifier control
 #define AUDIO_AMP_PIN GPIO_NUM_53
 
-// Audio Configuration
-#define MIC_SAMPLE_RATE 16000    // Microphone sample rate
-#define SPEAKER_SAMPLE_RATE 48000 // Speaker sample rate
+// Audio Configuration (sample rate comes from audio_format_t)
 #define BITS_PER_SAMPLE 16
 #define CHANNELS 1
-#define BUFFER_SIZE 1024
+#define BUFFER_SIZE 1024         // DMA buffer length and largest frame in samples
 
 typedef void (*audio_capture_cb_t)(int16_t *data, size_t samples, void *user_data);
 typedef void (*audio_playback_cb_t)(int16_t *data, size_t samples, void *user_data);
@@ -37,8 +38,9 @@ typedef void (*audio_playback_cb_t)(int16_t *data, size_t samples, void *user_da
  * @brief Initialize I2S audio for Waveshare ESP32-P4-86
  * 
  * Configures shared I2S bus for ES8311 DAC (speaker) and ES7210 ADC (microphone)
+ * @param format Initial sample format for both directions
  */
-esp_err_t audio_handler_init(void);
+esp_err_t audio_handler_init(const audio_format_t *format);
 
 /**
  * @brief Set audio capture callback
@@ -57,6 +59,10 @@ esp_err_t audio_handler_start_capture(void);
 
 /**
  * @brief Stop audio capture
+ *
+ * Returns once the capture task has exited and released its pool blocks.
+ *
+ * @return ESP_ERR_TIMEOUT if the task did not exit in time
  */
 esp_err_t audio_handler_stop_capture(void);
 
@@ -67,6 +73,10 @@ esp_err_t audio_handler_start_playback(void);
 
 /**
  * @brief Stop audio playback
+ *
+ * Returns once the playback task has exited and released its pool blocks.
+ *
+ * @return ESP_ERR_TIMEOUT if the task did not exit in time
  */
 esp_err_t audio_handler_stop_playback(void);
 
@@ -80,6 +90,21 @@ void audio_handler_process(void);
  */
 esp_err_t audio_handler_set_amplifier(bool enable);
 
+/**
+ * @brief Change I2S rate and frame size
+ *
+ * Capture and playback must be stopped. Use audio_format_apply() rather than
+ * calling this directly so the codecs follow.
+ */
+esp_err_t audio_handler_set_format(const audio_format_t *format);
+
+/**
+ * @brief Start/stop the I2S clocks (MCLK, BCLK, LRCLK)
+ *
+ * Capture and playback must be stopped before the clocks are stopped.
+ */
+esp_err_t audio_handler_set_clocks(bool enable);
+
 /**
  * @brief Deinitialize audio handler
  */
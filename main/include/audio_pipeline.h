@@ -0,0 +1,104 @@
+/*
+ * Audio Pipeline
+ * Ordered processing stages between the I2S tasks and the call: capture
+ * runs after the beamformer and before the capture callback, render after
+ * the playback callback and before the frame goes to I2S
+ *
+ * Stages work in place on the task's pool block, so the block is the one
+ * buffer between stages and nothing is allocated per frame. Each stage's
+ * state is carved out of a static per-pipeline arena when the pipeline is
+ * built. Every process() call is timed with the CPU cycle counter.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "audio_format.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_PIPELINE_MAX_STAGES 8
+#define AUDIO_PIPELINE_STATE_SIZE 4096  // State bytes for all stages of one pipeline
+
+typedef enum {
+    AUDIO_PIPELINE_CAPTURE = 0,     // Beamformed mic to the capture callback
+    AUDIO_PIPELINE_RENDER,          // Playback callback to the speaker
+    AUDIO_PIPELINE_COUNT,
+} audio_pipeline_id_t;
+
+typedef struct {
+    const char *name;
+    size_t state_size;              // Bytes reserved for the stage, zeroed before init
+    uint32_t latency_samples;       // Delay the stage adds to the signal
+    // Optional. Runs on build, on each format change and on reset.
+    esp_err_t (*init)(void *state, const audio_format_t *format);
+    // Process a mono block in place and return its new length. A stage may
+    // lengthen the block up to capacity (e.g. a resampler).
+    size_t (*process)(void *state, int16_t *block, size_t samples, size_t capacity);
+} audio_stage_t;
+
+typedef struct {
+    const char *name;
+    uint32_t blocks;
+    uint32_t avg_cycles;            // Per block
+    uint32_t max_cycles;
+    float cycles_per_sample;
+} audio_stage_stats_t;
+
+typedef struct {
+    size_t stages;
+    size_t state_bytes;             // Arena in use
+    uint32_t latency_samples;       // Sum over stages
+    audio_stage_stats_t stage[AUDIO_PIPELINE_MAX_STAGES];
+} audio_pipeline_stats_t;
+
+/**
+ * @brief Set the stages of a pipeline and initialise them
+ *
+ * @param stages NULL-terminated list, run in order; the descriptors must
+ *               outlive the pipeline
+ * @return ESP_ERR_INVALID_SIZE if there are too many stages or their state
+ *         does not fit the arena; the pipeline is left empty on any error
+ */
+esp_err_t audio_pipeline_build(audio_pipeline_id_t id, const audio_stage_t *const *stages,
+                               const audio_format_t *format);
+
+/**
+ * @brief Re-initialise every stage of every pipeline for a new format
+ *
+ * Call while capture and playback are stopped.
+ */
+esp_err_t audio_pipeline_set_format(const audio_format_t *format);
+
+/**
+ * @brief Run a block through a pipeline
+ *
+ * @param block Mono samples, processed in place
+ * @param samples Samples in the block
+ * @param capacity Samples the block can hold
+ * @return Samples in the block afterwards
+ */
+size_t audio_pipeline_process(audio_pipeline_id_t id, int16_t *block, size_t samples, size_t capacity);
+
+/**
+ * @brief Signal delay of a pipeline in samples
+ */
+uint32_t audio_pipeline_latency(audio_pipeline_id_t id);
+
+/**
+ * @brief Get per-stage CPU cost of a pipeline
+ */
+void audio_pipeline_get_stats(audio_pipeline_id_t id, audio_pipeline_stats_t *stats);
+
+/**
+ * @brief Clear statistics and put every stage back in its initial state
+ */
+void audio_pipeline_reset(audio_pipeline_id_t id);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,80 @@
+/*
+ * Audio Power Management
+ * Standby / wake state machine for the codecs, amplifier and I2S clocks
+ *
+ * States:
+ * - OFF:     codecs powered down, I2S clocks stopped, amplifier off. Leaving
+ *            OFF re-runs the codec init sequences (cold start).
+ * - STANDBY: codec analog blocks and internal clocks off with the register
+ *            file kept, I2S clocks stopped, amplifier off. Idle state
+ *            between calls.
+ * - ACTIVE:  everything running; capture and playback may be started.
+ *
+ * Standby is entered amplifier first, then codecs, then I2S clocks; waking
+ * runs the reverse order so the amplifier only sees a settled DAC output
+ * (no pop on GPIO53).
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Budget for STANDBY -> ACTIVE; a slower wake is logged as a warning
+#define AUDIO_POWER_WAKE_TARGET_US 20000
+// DAC output settle time before the amplifier is switched on
+#define AUDIO_POWER_AMP_SETTLE_MS 5
+
+typedef enum {
+    AUDIO_POWER_OFF = 0,
+    AUDIO_POWER_STANDBY,
+    AUDIO_POWER_ACTIVE,
+    AUDIO_POWER_STATE_COUNT,
+} audio_power_state_t;
+
+typedef struct {
+    audio_power_state_t state;
+    // Residency per state, including the time spent in the current one. There
+    // is no current sensor on the board, so residency is the idle-current
+    // proxy: time in STANDBY/OFF is time the codecs and amplifier are off.
+    uint64_t time_in_state_us[AUDIO_POWER_STATE_COUNT];
+    uint32_t wakes;            // Transitions into ACTIVE
+    uint32_t cold_wakes;       // ... of which needed a full codec init
+    uint32_t last_wake_us;
+    uint32_t max_wake_us;
+    uint32_t slow_wakes;       // Wakes over AUDIO_POWER_WAKE_TARGET_US
+    uint32_t failures;         // Transitions that returned an error
+} audio_power_stats_t;
+
+/**
+ * @brief Initialize power management
+ *
+ * Call after the codecs and the audio handler are initialized. Starts in
+ * ACTIVE. Waking from OFF re-initializes the codecs at audio_format_get().
+ */
+esp_err_t audio_power_init(void);
+
+/**
+ * @brief Move the audio path to a power state
+ *
+ * Capture and playback must be stopped before leaving ACTIVE.
+ */
+esp_err_t audio_power_set_state(audio_power_state_t state);
+
+/**
+ * @brief Current power state
+ */
+audio_power_state_t audio_power_get_state(void);
+
+/**
+ * @brief Get power state residency and wake timing statistics
+ */
+void audio_power_get_stats(audio_power_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,33 @@
+/*
+ * Audio Pipeline Stages
+ * Stage descriptors for the capture and render pipelines, and the lists
+ * the audio handler builds them from
+ */
+
+#pragma once
+
+#include "audio_pipeline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief First-order high-pass at AUDIO_DC_BLOCK_HZ
+ *
+ * Removes the ES7210's DC offset before it reaches the encoder, where it
+ * would cost bits and upset level detection.
+ */
+extern const audio_stage_t audio_stage_dc_block;
+
+#define AUDIO_DC_BLOCK_HZ 20
+
+// Stage lists, run in order; each entry is "&stage," and the list may be
+// empty. Adding AEC, noise suppression, AGC or an encoder is a matter of
+// defining its audio_stage_t and naming it here.
+#define AUDIO_CAPTURE_STAGES &audio_stage_dc_block,
+#define AUDIO_RENDER_STAGES
+
+#ifdef __cplusplus
+}
+#endif
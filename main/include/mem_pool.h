@@ -0,0 +1,126 @@
+/*
+ * Memory Pools
+ * Preallocated buffers for the audio path and a PSRAM arena for signaling,
+ * so a call in progress does not touch the general heap
+ *
+ * - I2S_DMA: DMA-capable internal RAM, one interleaved I2S frame per block
+ * - FRAME:   internal RAM, one mono pipeline frame per block
+ * - Arena:   PSRAM (internal RAM if the board has none) bump allocator for
+ *            one signaling message at a time: reassembled WebSocket text and
+ *            its cJSON tree, released in one go when the message is handled
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "audio_codec.h"
+#include "audio_handler.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEM_I2S_BLOCK_SIZE (BUFFER_SIZE * AUDIO_MIC_CHANNELS * sizeof(int16_t))
+#define MEM_I2S_BLOCKS 2            // Capture + playback task
+#define MEM_FRAME_BLOCK_SIZE (BUFFER_SIZE * sizeof(int16_t))
+#define MEM_FRAME_BLOCKS 4
+#define MEM_ARENA_SIZE (16 * 1024)  // Largest signaling message plus its cJSON tree
+
+typedef enum {
+    MEM_POOL_I2S_DMA = 0,
+    MEM_POOL_FRAME,
+    MEM_POOL_COUNT,
+} mem_pool_id_t;
+
+typedef struct {
+    const char *name;
+    size_t block_size;
+    uint16_t blocks;
+    uint16_t in_use;
+    uint16_t high_water;
+    uint32_t failures;          // Allocations refused because the pool was empty
+} mem_pool_stats_t;
+
+typedef struct {
+    size_t size;
+    size_t used;
+    size_t high_water;
+    bool in_psram;
+    uint32_t messages;          // Arena sessions (mem_arena_begin/end pairs)
+    uint32_t overflows;         // Allocations that fell back to the heap
+    uint32_t refused;           // mem_arena_begin() calls that failed: no arena, or another task held it
+} mem_arena_stats_t;
+
+typedef struct {
+    mem_pool_stats_t pools[MEM_POOL_COUNT];
+    mem_arena_stats_t arena;
+    // General heap, for comparison with the pools. Fragmentation is the share
+    // of free memory not in the largest free block.
+    size_t internal_free;
+    size_t internal_min_free;
+    size_t internal_largest_block;
+    uint8_t internal_fragmentation_pct;
+    size_t psram_free;
+    size_t psram_largest_block;
+    uint8_t psram_fragmentation_pct;
+} mem_stats_t;
+
+/**
+ * @brief Allocate all pools and the signaling arena
+ *
+ * Call once at boot, before the audio handler starts any task.
+ */
+esp_err_t mem_pool_init(void);
+
+/**
+ * @brief Take a block from a pool
+ * @return NULL if the pool is empty or not initialized
+ */
+void *mem_pool_alloc(mem_pool_id_t pool);
+
+/**
+ * @brief Return a block to the pool it came from (NULL is ignored)
+ */
+void mem_pool_free(mem_pool_id_t pool, void *block);
+
+/**
+ * @brief Start using the arena from the calling task
+ *
+ * Only the task that called this gets arena memory from mem_arena_alloc();
+ * any other caller (and any request that does not fit) is served from the
+ * heap. Returns false if another task holds the arena.
+ *
+ * cJSON hooks pointed at mem_arena_alloc()/mem_arena_free() are global:
+ * while they are installed, every cJSON tree the holding task builds is
+ * arena memory and is gone after mem_arena_end(). Install them only around
+ * trees that are freed before the arena ends, and restore the defaults
+ * before running code that may keep a tree.
+ */
+bool mem_arena_begin(void);
+
+/**
+ * @brief Release everything allocated since mem_arena_begin()
+ */
+void mem_arena_end(void);
+
+/**
+ * @brief Allocate from the arena if the calling task holds it, else the heap
+ */
+void *mem_arena_alloc(size_t size);
+
+/**
+ * @brief Free memory from mem_arena_alloc(); arena memory is left for mem_arena_end()
+ */
+void mem_arena_free(void *ptr);
+
+/**
+ * @brief Get pool, arena and heap statistics
+ */
+void mem_get_stats(mem_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,9 +4,15 @@
  */
 
 #include "intercom_app.h"
+#include "alloc_trace.h"
 #include "signaling_client.h"
 #include "audio_handler.h"
+#include "audio_beamformer.h"
+#include "audio_pipeline.h"
 #include "audio_codec.h"
+#include "audio_format.h"
+#include "audio_power.h"
+#include "mem_pool.h"
 #include "esp_wifi.h"
 #include "esp_log.h"
 #include "esp_mac.h"
@@ -15,10 +21,6 @@
 #include <string.h>
 #include <stdio.h>
 
-// Audio sample rates (from audio_handler.h)
-#define MIC_SAMPLE_RATE 16000
-#define SPEAKER_SAMPLE_RATE 48000
-
 static const char *TAG = "intercom_app";
 
 // Configuration - TODO: Move to Kconfig or NVS
@@ -100,6 +102,20 @@ static esp_err_t init_wifi(void)
     return ESP_OK;
 }
 
+// Run the codecs, I2S and pipeline at the remote's preferred native rate
+static void negotiate_audio_format(const char *sdp)
+{
+    audio_format_t format;
+    if (!sdp || audio_format_from_sdp(sdp, &format) != ESP_OK) {
+        ESP_LOGW(TAG, "No natively supported audio codec in SDP, keeping %luHz",
+                 (unsigned long)audio_format_get()->sample_rate);
+        return;
+    }
+    if (audio_format_apply(&format) != ESP_OK) {
+        ESP_LOGW(TAG, "Keeping %luHz audio format", (unsigned long)audio_format_get()->sample_rate);
+    }
+}
+
 // Signaling message callback
 static void on_signaling_message(signaling_message_t *msg, void *user_data)
 {
@@ -111,26 +127,86 @@ static void on_signaling_message(signaling_message_t *msg, void *user_data)
         // Start WebRTC peer connection
     } else if (strcmp(msg->type, "offer") == 0) {
         ESP_LOGI(TAG, "Received offer");
+        alloc_trace_set_phase(ALLOC_PHASE_SETUP);
+        negotiate_audio_format(msg->sdp);
+        // Wake the audio path while the answer is negotiated so it is ready
+        // by the time media flows
+        audio_power_set_state(AUDIO_POWER_ACTIVE);
         // Handle WebRTC offer
         // TODO: Create answer using esp_peer API
     } else if (strcmp(msg->type, "answer") == 0) {
         ESP_LOGI(TAG, "Received answer");
         // Handle WebRTC answer
         is_in_call = true;
-        // Enable audio amplifier when call starts
-        audio_handler_set_amplifier(true);
+        if (alloc_trace_get_phase() == ALLOC_PHASE_IDLE) {
+            alloc_trace_set_phase(ALLOC_PHASE_SETUP);
+        }
+        negotiate_audio_format(msg->sdp);
+        // Codecs, clocks and amplifier up before capture/playback start
+        audio_power_set_state(AUDIO_POWER_ACTIVE);
         audio_handler_start_capture();
         audio_handler_start_playback();
+        alloc_trace_set_phase(ALLOC_PHASE_CONNECTED);
     } else if (strcmp(msg->type, "candidate") == 0) {
         ESP_LOGI(TAG, "Received ICE candidate");
         // Handle ICE candidate
     } else if (strcmp(msg->type, "leave") == 0) {
         ESP_LOGI(TAG, "Remote left");
+        alloc_trace_set_phase(ALLOC_PHASE_TEARDOWN);
         is_in_call = false;
-        // Disable audio amplifier when call ends
         audio_handler_stop_capture();
         audio_handler_stop_playback();
-        audio_handler_set_amplifier(false);
+        // Back to standby between calls: amplifier, codecs and clocks off
+        audio_power_set_state(AUDIO_POWER_STANDBY);
+
+        audio_power_stats_t power;
+        audio_power_get_stats(&power);
+        ESP_LOGI(TAG, "Audio power: %lu wakes, last %luus, max %luus, standby %llums, active %llums",
+                 (unsigned long)power.wakes, (unsigned long)power.last_wake_us,
+                 (unsigned long)power.max_wake_us,
+                 (unsigned long long)(power.time_in_state_us[AUDIO_POWER_STANDBY] / 1000),
+                 (unsigned long long)(power.time_in_state_us[AUDIO_POWER_ACTIVE] / 1000));
+
+        if (AUDIO_MIC_CHANNELS > 1) {
+            beamformer_stats_t bf;
+            beamformer_get_stats(&bf);
+            ESP_LOGI(TAG, "Beamformer: %u mics, %lu frames, %lu+%lu cycles/frame (max %lu), array gain %.1fdB",
+                     (unsigned)bf.channels, (unsigned long)bf.frames_processed,
+                     (unsigned long)bf.avg_deinterleave_cycles, (unsigned long)bf.avg_beamform_cycles,
+                     (unsigned long)bf.max_total_cycles, bf.array_gain_db);
+            beamformer_reset();
+        }
+
+        for (int id = 0; id < AUDIO_PIPELINE_COUNT; id++) {
+            audio_pipeline_stats_t pipe;
+            audio_pipeline_get_stats((audio_pipeline_id_t)id, &pipe);
+            for (size_t i = 0; i < pipe.stages; i++) {
+                ESP_LOGI(TAG, "%s stage %s: %lu blocks, %lu cycles/block (max %lu), %.1f cycles/sample",
+                         id == AUDIO_PIPELINE_CAPTURE ? "Capture" : "Render", pipe.stage[i].name,
+                         (unsigned long)pipe.stage[i].blocks, (unsigned long)pipe.stage[i].avg_cycles,
+                         (unsigned long)pipe.stage[i].max_cycles, pipe.stage[i].cycles_per_sample);
+            }
+            audio_pipeline_reset((audio_pipeline_id_t)id);
+        }
+
+        mem_stats_t mem;
+        mem_get_stats(&mem);
+        for (size_t p = 0; p < MEM_POOL_COUNT; p++) {
+            ESP_LOGI(TAG, "Pool %s: %u/%u blocks high water, %lu failures", mem.pools[p].name,
+                     (unsigned)mem.pools[p].high_water, (unsigned)mem.pools[p].blocks,
+                     (unsigned long)mem.pools[p].failures);
+        }
+        ESP_LOGI(TAG, "Signaling arena: %u/%u bytes high water, %lu overflows, %lu refused; heap %u free, %u%% fragmented",
+                 (unsigned)mem.arena.high_water, (unsigned)mem.arena.size, (unsigned long)mem.arena.overflows,
+                 (unsigned long)mem.arena.refused,
+                 (unsigned)mem.internal_free, (unsigned)mem.internal_fragmentation_pct);
+
+        alloc_trace_set_phase(ALLOC_PHASE_IDLE);
+        if (alloc_trace_enabled()) {
+            alloc_phase_stats_t allocs[ALLOC_PHASE_COUNT];
+            alloc_trace_take(allocs);
+            alloc_trace_log(allocs);
+        }
     }
 }
 
@@ -175,18 +251,43 @@ void intercom_app_start(void)
     // Generate client ID
     generate_client_id();
     
+    // Both codecs share the I2S bus and start at the default format; each
+    // call may switch them to the rate it negotiates
+    const audio_format_t *format = audio_format_get();
+
+    // Initialize audio handler (I2S) first: it starts MCLK, which the codec
+    // PLLs and the verifying register writes below depend on
+    bool audio_ready = audio_handler_init(format) == ESP_OK;
+
     // Initialize I2C for audio codecs
     if (audio_codec_i2c_init() == ESP_OK) {
-        // Initialize ES8311 DAC (speaker) at 48kHz
-        audio_codec_es8311_init(SPEAKER_SAMPLE_RATE);
-        // Initialize ES7210 ADC (microphone) at 16kHz
-        audio_codec_es7210_init(MIC_SAMPLE_RATE);
+        // Initialize ES8311 DAC (speaker)
+        if (audio_codec_es8311_init(format->sample_rate) != ESP_OK) {
+            ESP_LOGW(TAG, "ES8311 init failed, speaker may be silent");
+        }
+        // Initialize ES7210 ADC (microphone)
+        if (audio_codec_es7210_init(format->sample_rate) != ESP_OK) {
+            ESP_LOGW(TAG, "ES7210 init failed, microphone may be silent");
+        }
+        audio_codec_stats_t stats;
+        audio_codec_get_stats(&stats);
+        ESP_LOGI(TAG, "Codec bring-up: %lu I2C transactions, %lu errors, %lu verify failures",
+                 (unsigned long)stats.transactions, (unsigned long)stats.errors,
+                 (unsigned long)stats.verify_failures);
     } else {
         ESP_LOGW(TAG, "I2C codec initialization failed, continuing without codec config");
     }
     
-    // Initialize audio handler (I2S)
-    audio_handler_init();
+    // Audio buffers and the signaling arena are reserved once, up front
+    if (mem_pool_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Memory pool setup failed, audio will not start");
+    }
+
+    if (audio_ready) {
+        // Idle in standby until a call needs audio
+        audio_power_init();
+        audio_power_set_state(AUDIO_POWER_STANDBY);
+    }
     
     // Initialize WiFi
     init_wifi();
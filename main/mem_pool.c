@@ -0,0 +1,240 @@
+/*
+ * Memory Pools Implementation
+ * Fixed-block pools over one slab each, plus the signaling arena
+ */
+
+#include "mem_pool.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "mem_pool";
+
+#define MEM_POOL_MAX_BLOCKS 8
+#define MEM_ARENA_ALIGN 8
+
+typedef struct {
+    const char *name;
+    size_t block_size;
+    uint16_t blocks;
+    uint32_t caps;
+    uint8_t *slab;
+    uint8_t free_list[MEM_POOL_MAX_BLOCKS];     // Stack of free block indices
+    uint16_t free_count;
+    uint16_t high_water;
+    uint32_t failures;
+} mem_pool_t;
+
+static mem_pool_t s_pools[MEM_POOL_COUNT] = {
+    [MEM_POOL_I2S_DMA] = {
+        .name = "i2s_dma",
+        .block_size = MEM_I2S_BLOCK_SIZE,
+        .blocks = MEM_I2S_BLOCKS,
+        .caps = MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL,
+    },
+    [MEM_POOL_FRAME] = {
+        .name = "frame",
+        .block_size = MEM_FRAME_BLOCK_SIZE,
+        .blocks = MEM_FRAME_BLOCKS,
+        .caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+    },
+};
+
+static struct {
+    uint8_t *base;
+    size_t used;
+    size_t high_water;
+    bool in_psram;
+    TaskHandle_t owner;
+    uint32_t messages;
+    uint32_t overflows;
+    uint32_t refused;
+} s_arena = {0};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t mem_pool_init(void)
+{
+    for (size_t p = 0; p < MEM_POOL_COUNT; p++) {
+        mem_pool_t *pool = &s_pools[p];
+        if (pool->slab) {
+            continue;
+        }
+        pool->slab = heap_caps_malloc(pool->block_size * pool->blocks, pool->caps);
+        if (!pool->slab) {
+            ESP_LOGE(TAG, "Failed to allocate %s pool (%u x %u bytes)", pool->name,
+                     (unsigned)pool->blocks, (unsigned)pool->block_size);
+            return ESP_ERR_NO_MEM;
+        }
+        for (uint16_t i = 0; i < pool->blocks; i++) {
+            pool->free_list[i] = (uint8_t)(pool->blocks - 1 - i);
+        }
+        pool->free_count = pool->blocks;
+        ESP_LOGI(TAG, "Pool %s: %u x %u bytes", pool->name, (unsigned)pool->blocks, (unsigned)pool->block_size);
+    }
+
+    if (!s_arena.base) {
+        s_arena.base = heap_caps_malloc(MEM_ARENA_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        s_arena.in_psram = s_arena.base != NULL;
+        if (!s_arena.base) {
+            s_arena.base = heap_caps_malloc(MEM_ARENA_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        }
+        if (!s_arena.base) {
+            ESP_LOGE(TAG, "Failed to allocate signaling arena");
+            return ESP_ERR_NO_MEM;
+        }
+        ESP_LOGI(TAG, "Signaling arena: %u bytes in %s", (unsigned)MEM_ARENA_SIZE,
+                 s_arena.in_psram ? "PSRAM" : "internal RAM");
+    }
+    return ESP_OK;
+}
+
+void *mem_pool_alloc(mem_pool_id_t id)
+{
+    if (id >= MEM_POOL_COUNT) {
+        return NULL;
+    }
+    mem_pool_t *pool = &s_pools[id];
+    void *block = NULL;
+
+    portENTER_CRITICAL(&s_lock);
+    if (pool->free_count > 0) {
+        uint8_t index = pool->free_list[--pool->free_count];
+        block = pool->slab + (size_t)index * pool->block_size;
+        uint16_t in_use = pool->blocks - pool->free_count;
+        if (in_use > pool->high_water) {
+            pool->high_water = in_use;
+        }
+    } else {
+        pool->failures++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!block) {
+        ESP_LOGW(TAG, "Pool %s exhausted", pool->name);
+    }
+    return block;
+}
+
+void mem_pool_free(mem_pool_id_t id, void *block)
+{
+    if (id >= MEM_POOL_COUNT || !block) {
+        return;
+    }
+    mem_pool_t *pool = &s_pools[id];
+    size_t offset = (size_t)((uint8_t *)block - pool->slab);
+    if ((uint8_t *)block < pool->slab || offset % pool->block_size != 0 ||
+        offset / pool->block_size >= pool->blocks) {
+        ESP_LOGE(TAG, "Block %p does not belong to pool %s", block, pool->name);
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    pool->free_list[pool->free_count++] = (uint8_t)(offset / pool->block_size);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static bool arena_contains(const void *ptr)
+{
+    return s_arena.base && (const uint8_t *)ptr >= s_arena.base &&
+           (const uint8_t *)ptr < s_arena.base + MEM_ARENA_SIZE;
+}
+
+bool mem_arena_begin(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    bool ok = false;
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_arena.base && (s_arena.owner == NULL || s_arena.owner == self)) {
+        s_arena.owner = self;
+        s_arena.used = 0;
+        s_arena.messages++;
+        ok = true;
+    } else {
+        s_arena.refused++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ok;
+}
+
+void mem_arena_end(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (s_arena.owner == xTaskGetCurrentTaskHandle()) {
+        s_arena.used = 0;
+        s_arena.owner = NULL;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void *mem_arena_alloc(size_t size)
+{
+    // Only the owning task bumps the offset, so no lock is needed here
+    if (s_arena.owner != NULL && s_arena.owner == xTaskGetCurrentTaskHandle()) {
+        size_t start = (s_arena.used + MEM_ARENA_ALIGN - 1) & ~(size_t)(MEM_ARENA_ALIGN - 1);
+        if (start + size <= MEM_ARENA_SIZE) {
+            s_arena.used = start + size;
+            if (s_arena.used > s_arena.high_water) {
+                s_arena.high_water = s_arena.used;
+            }
+            return s_arena.base + start;
+        }
+        s_arena.overflows++;
+    }
+    return malloc(size);
+}
+
+void mem_arena_free(void *ptr)
+{
+    if (ptr && !arena_contains(ptr)) {
+        free(ptr);
+    }
+}
+
+static uint8_t fragmentation_pct(size_t free_bytes, size_t largest)
+{
+    return free_bytes ? (uint8_t)(100 - (largest * 100) / free_bytes) : 0;
+}
+
+void mem_get_stats(mem_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    portENTER_CRITICAL(&s_lock);
+    for (size_t p = 0; p < MEM_POOL_COUNT; p++) {
+        const mem_pool_t *pool = &s_pools[p];
+        stats->pools[p] = (mem_pool_stats_t){
+            .name = pool->name,
+            .block_size = pool->block_size,
+            .blocks = pool->blocks,
+            .in_use = pool->slab ? pool->blocks - pool->free_count : 0,
+            .high_water = pool->high_water,
+            .failures = pool->failures,
+        };
+    }
+    stats->arena = (mem_arena_stats_t){
+        .size = s_arena.base ? MEM_ARENA_SIZE : 0,
+        .used = s_arena.used,
+        .high_water = s_arena.high_water,
+        .in_psram = s_arena.in_psram,
+        .messages = s_arena.messages,
+        .overflows = s_arena.overflows,
+        .refused = s_arena.refused,
+    };
+    portEXIT_CRITICAL(&s_lock);
+
+    stats->internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    stats->internal_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    stats->internal_largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    stats->internal_fragmentation_pct = fragmentation_pct(stats->internal_free, stats->internal_largest_block);
+    stats->psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    stats->psram_largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM);
+    stats->psram_fragmentation_pct = fragmentation_pct(stats->psram_free, stats->psram_largest_block);
+}
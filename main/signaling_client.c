@@ -9,6 +9,7 @@
 #include "esp_http_client.h"
 #include "cJSON.h"
 #include "esp_websocket_client.h"
+#include "mem_pool.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -27,6 +28,8 @@ typedef struct {
     void *state_user_data;
     esp_websocket_client_handle_t websocket_handle;
     bool connected;
+    char *rx_buffer;        // Message being reassembled from WebSocket frames
+    int rx_len;
 } signaling_client_t;
 
 static signaling_client_t s_client = {0};
@@ -42,13 +45,14 @@ static void set_state(signaling_state_t state)
     }
 }
 
-// Parse signaling message from JSON
-static void parse_signaling_message(const char *json_str, signaling_message_t *msg)
+// Parse signaling message from JSON. The message fields point into the
+// returned tree, so it must outlive the message callback.
+static cJSON *parse_signaling_message(const char *json_str, signaling_message_t *msg)
 {
     cJSON *json = cJSON_Parse(json_str);
     if (!json) {
         ESP_LOGE(TAG, "Failed to parse JSON");
-        return;
+        return NULL;
     }
 
     cJSON *type = cJSON_GetObjectItem(json, "type");
@@ -67,7 +71,70 @@ static void parse_signaling_message(const char *json_str, signaling_message_t *m
     if (candidate && cJSON_IsString(candidate)) msg->candidate = cJSON_GetStringValue(candidate);
     if (message && cJSON_IsString(message)) msg->message = cJSON_GetStringValue(message);
 
+    return json;
+}
+
+// cJSON allocates through process-wide hooks. They point at the arena only
+// while this task parses or frees a received message, never while other
+// code (the message callback, esp_peer) may build a tree that outlives it.
+static void use_arena_for_json(bool arena)
+{
+    cJSON_Hooks hooks = {
+        .malloc_fn = mem_arena_alloc,
+        .free_fn = mem_arena_free,
+    };
+    cJSON_InitHooks(arena ? &hooks : NULL);
+}
+
+// Collect a text message that may span several WebSocket frames; the text
+// and its cJSON tree live in the signaling arena until it has been handled
+static void handle_websocket_data(const esp_websocket_event_data_t *data)
+{
+    if (data->payload_offset == 0) {
+        if (s_client.rx_buffer) {
+            mem_arena_free(s_client.rx_buffer);
+            mem_arena_end();
+        }
+        if (!mem_arena_begin()) {
+            // Still handled, from the heap; mem_get_stats() counts it as refused
+            ESP_LOGW(TAG, "Signaling arena unavailable, using the heap for this message");
+        }
+        s_client.rx_buffer = mem_arena_alloc(data->payload_len + 1);
+        s_client.rx_len = 0;
+        if (!s_client.rx_buffer) {
+            ESP_LOGE(TAG, "No memory for %d byte message", data->payload_len);
+            mem_arena_end();
+            return;
+        }
+    }
+    if (!s_client.rx_buffer || data->payload_offset != s_client.rx_len ||
+        data->payload_offset + data->data_len > data->payload_len) {
+        return;
+    }
+
+    memcpy(s_client.rx_buffer + s_client.rx_len, data->data_ptr, data->data_len);
+    s_client.rx_len += data->data_len;
+    if (s_client.rx_len < data->payload_len) {
+        return;
+    }
+    s_client.rx_buffer[s_client.rx_len] = '\0';
+
+    // Size only: offers and answers carry ICE passwords and SRTP keys
+    ESP_LOGD(TAG, "Received %d bytes", s_client.rx_len);
+    signaling_message_t msg = {0};
+    use_arena_for_json(true);
+    cJSON *json = parse_signaling_message(s_client.rx_buffer, &msg);
+    use_arena_for_json(false);
+    if (json && s_client.message_cb) {
+        s_client.message_cb(&msg, s_client.message_user_data);
+    }
+    use_arena_for_json(true);
     cJSON_Delete(json);
+    use_arena_for_json(false);
+
+    mem_arena_free(s_client.rx_buffer);
+    s_client.rx_buffer = NULL;
+    mem_arena_end();
 }
 
 // WebSocket event handler
@@ -93,13 +160,9 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base,
         case WEBSOCKET_EVENT_DATA:
             if (data->op_code == 0x08 && data->data_len == 2) {
                 ESP_LOGI(TAG, "Received closed message");
-            } else {
-                ESP_LOGI(TAG, "Received=%.*s", data->data_len, (char *)data->data_ptr);
-                signaling_message_t msg = {0};
-                parse_signaling_message((char *)data->data_ptr, &msg);
-                if (s_client.message_cb) {
-                    s_client.message_cb(&msg, s_client.message_user_data);
-                }
+            } else if (data->op_code == 0x01) {
+                // Text frame; large ones arrive in payload_offset chunks
+                handle_websocket_data(data);
             }
             break;
 
@@ -203,7 +266,7 @@ static esp_err_t send_json_message(cJSON *json)
         s_client.websocket_handle,
         json_str, strlen(json_str), portMAX_DELAY);
 
-    free(json_str);
+    cJSON_free(json_str);
     return ret;
 }
 
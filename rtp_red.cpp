@@ -0,0 +1,121 @@
+#include "rtp_red.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace intercom {
+
+static constexpr uint32_t RED_MAX_OFFSET = (1u << 14) - 1;
+
+void RedEncoder::reset() {
+  history_count_ = 0;
+  history_next_ = 0;
+  last_depth_ = 0;
+  primary_bytes_ = 0;
+  redundant_bytes_ = 0;
+}
+
+void RedEncoder::remember_(const uint8_t *frame, size_t len, uint32_t timestamp) {
+  // A frame too long for a block is kept as a gap, so the frames before it
+  // are never sent as if they were adjacent to the primary
+  bool fits = len <= RED_MAX_BLOCK;
+  if (fits) {
+    memcpy(history_[history_next_], frame, len);
+  }
+  history_len_[history_next_] = fits ? len : 0;
+  history_ts_[history_next_] = timestamp;
+  history_next_ = (history_next_ + 1) % RED_MAX_DEPTH;
+  if (history_count_ < RED_MAX_DEPTH) {
+    history_count_++;
+  }
+}
+
+size_t RedEncoder::encode(uint8_t payload_type, const uint8_t *frame, size_t len, uint32_t timestamp,
+                          uint8_t depth, uint8_t *out, size_t cap) {
+  if (depth > RED_MAX_DEPTH) {
+    depth = RED_MAX_DEPTH;
+  }
+
+  // Take the most recent frames for as long as they are contiguous and fit
+  size_t total = 1 + len;
+  uint8_t blocks = 0;
+  for (uint8_t d = 1; d <= depth && d <= history_count_; d++) {
+    size_t k = (history_next_ + RED_MAX_DEPTH - d) % RED_MAX_DEPTH;
+    if (history_len_[k] == 0 || timestamp - history_ts_[k] > RED_MAX_OFFSET ||
+        total + 4 + history_len_[k] > cap) {
+      break;
+    }
+    total += 4 + history_len_[k];
+    blocks = d;
+  }
+
+  last_depth_ = blocks;
+  if (blocks == 0) {
+    remember_(frame, len, timestamp);
+    return 0;
+  }
+
+  uint8_t *p = out;
+  for (uint8_t d = blocks; d > 0; d--) {
+    size_t k = (history_next_ + RED_MAX_DEPTH - d) % RED_MAX_DEPTH;
+    uint32_t word = ((timestamp - history_ts_[k]) << 10) | (uint32_t) history_len_[k];
+    p[0] = 0x80 | (payload_type & 0x7F);
+    p[1] = (word >> 16) & 0xFF;
+    p[2] = (word >> 8) & 0xFF;
+    p[3] = word & 0xFF;
+    p += 4;
+  }
+  *p++ = payload_type & 0x7F;
+  for (uint8_t d = blocks; d > 0; d--) {
+    size_t k = (history_next_ + RED_MAX_DEPTH - d) % RED_MAX_DEPTH;
+    memcpy(p, history_[k], history_len_[k]);
+    p += history_len_[k];
+    redundant_bytes_ += history_len_[k];
+  }
+  memcpy(p, frame, len);
+  primary_bytes_ += len;
+
+  remember_(frame, len, timestamp);
+  return total;
+}
+
+size_t rtp_red_parse(const uint8_t *payload, size_t len, uint32_t timestamp, RedBlock *blocks, size_t max_blocks) {
+  size_t count = 0;
+  size_t pos = 0;
+  while (true) {
+    if (pos >= len || count >= max_blocks) {
+      return 0;
+    }
+    RedBlock &block = blocks[count++];
+    block.payload_type = payload[pos] & 0x7F;
+    if (!(payload[pos] & 0x80)) {
+      block.timestamp = timestamp;
+      pos++;
+      break;
+    }
+    if (pos + 4 > len) {
+      return 0;
+    }
+    uint32_t word = ((uint32_t) payload[pos + 1] << 16) | ((uint32_t) payload[pos + 2] << 8) | payload[pos + 3];
+    block.timestamp = timestamp - (word >> 10);
+    block.len = word & 0x3FF;
+    pos += 4;
+  }
+
+  for (size_t i = 0; i + 1 < count; i++) {
+    if (pos + blocks[i].len > len) {
+      return 0;
+    }
+    blocks[i].data = payload + pos;
+    blocks[i].distance = (uint8_t) (count - 1 - i);
+    pos += blocks[i].len;
+  }
+  RedBlock &primary = blocks[count - 1];
+  primary.data = payload + pos;
+  primary.len = len - pos;
+  primary.distance = 0;
+  return count;
+}
+
+}  // namespace intercom
+}  // namespace esphome
@@ -0,0 +1,74 @@
+/*
+ * RTP Redundant Audio
+ * RFC 2198 redundancy for the raw RTP path: each packet carries the current
+ * frame plus copies of up to RED_MAX_DEPTH earlier frames, so a burst of
+ * that many lost packets is recovered from the next packet that arrives.
+ *
+ * Payload layout: a 4-byte header per redundant block (F=1, block payload
+ * type, 14-bit timestamp offset, 10-bit length), a 1-byte header for the
+ * primary block (F=0, payload type), then the redundant data oldest first
+ * and the primary data last.
+ *
+ * The redundant blocks are always the frames immediately before the
+ * primary, with no gaps, so the receiver maps block i of n to RTP sequence
+ * number seq - (n - 1 - i) and can key recovered frames by sequence.
+ *
+ * Plain C++ with no platform calls, so the same code runs on the host.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace intercom {
+
+static constexpr size_t RED_MAX_DEPTH = 3;
+static constexpr size_t RED_MAX_BLOCK = 1023;  // 10-bit block length
+
+struct RedBlock {
+  uint8_t payload_type;
+  uint32_t timestamp;
+  uint8_t distance;  // Frames before the primary; 0 for the primary itself
+  const uint8_t *data;
+  size_t len;
+};
+
+class RedEncoder {
+ public:
+  void reset();
+
+  // Build the RED payload for a new frame with up to `depth` earlier frames,
+  // as many as fit in `cap` bytes. Returns its length, or 0 when no earlier
+  // frame could be added and the frame should go out as a plain packet.
+  // Either way the frame is kept for the packets that follow.
+  size_t encode(uint8_t payload_type, const uint8_t *frame, size_t len, uint32_t timestamp, uint8_t depth,
+                uint8_t *out, size_t cap);
+
+  // Redundant blocks in the last payload built
+  uint8_t last_depth() const { return last_depth_; }
+  // Bytes of primary and redundant audio sent, for the overhead ratio
+  uint32_t primary_bytes() const { return primary_bytes_; }
+  uint32_t redundant_bytes() const { return redundant_bytes_; }
+
+ protected:
+  void remember_(const uint8_t *frame, size_t len, uint32_t timestamp);
+
+  uint8_t history_[RED_MAX_DEPTH][RED_MAX_BLOCK];
+  size_t history_len_[RED_MAX_DEPTH]{};
+  uint32_t history_ts_[RED_MAX_DEPTH]{};
+  size_t history_count_{0};
+  size_t history_next_{0};
+  uint8_t last_depth_{0};
+  uint32_t primary_bytes_{0};
+  uint32_t redundant_bytes_{0};
+};
+
+// Split a RED payload into its blocks, oldest first and the primary last.
+// Returns the block count, or 0 if the payload is malformed or has more
+// than max_blocks blocks.
+size_t rtp_red_parse(const uint8_t *payload, size_t len, uint32_t timestamp, RedBlock *blocks, size_t max_blocks);
+
+}  // namespace intercom
+}  // namespace esphome
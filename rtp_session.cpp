@@ -0,0 +1,378 @@
+#include "rtp_session.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace intercom {
+
+static constexpr uint8_t RTCP_SR = 200;
+static constexpr uint8_t RTCP_RR = 201;
+static constexpr uint8_t RTCP_SDES = 202;
+static constexpr uint8_t SDES_CNAME = 1;
+static constexpr size_t SDES_MAX_CNAME = 64;  // Keeps the compound packet within RTCP_MAX_PACKET_SIZE
+
+// RFC 3550 A.1
+static constexpr uint32_t RTP_SEQ_MOD = 1u << 16;
+static constexpr uint32_t MAX_DROPOUT = 3000;
+static constexpr uint32_t MAX_MISORDER = 100;
+static constexpr uint32_t MIN_SEQUENTIAL = 2;
+
+static inline void put_be16(uint8_t *p, uint16_t v) {
+  p[0] = v >> 8;
+  p[1] = v & 0xFF;
+}
+
+static inline void put_be32(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = (v >> 16) & 0xFF;
+  p[2] = (v >> 8) & 0xFF;
+  p[3] = v & 0xFF;
+}
+
+static inline uint16_t get_be16(const uint8_t *p) { return (uint16_t) ((p[0] << 8) | p[1]); }
+
+static inline uint32_t get_be32(const uint8_t *p) {
+  return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+// Middle 32 bits of an NTP timestamp, as used by LSR and RTT
+static inline uint32_t ntp_mid(uint64_t ntp) { return (uint32_t) (ntp >> 16); }
+
+void rtp_l16_swap(uint8_t *data, size_t len) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  for (size_t i = 0; i + 1 < len; i += 2) {
+    uint8_t t = data[i];
+    data[i] = data[i + 1];
+    data[i + 1] = t;
+  }
+#endif
+}
+
+size_t rtp_write_header(uint8_t *buf, const RtpHeader &header) {
+  buf[0] = 0x80;  // V=2, no padding, extension or CSRCs
+  buf[1] = (header.marker ? 0x80 : 0x00) | (header.payload_type & 0x7F);
+  put_be16(buf + 2, header.seq);
+  put_be32(buf + 4, header.timestamp);
+  put_be32(buf + 8, header.ssrc);
+  return RTP_HEADER_SIZE;
+}
+
+bool rtp_parse_header(const uint8_t *packet, size_t len, RtpHeader *header, size_t *payload_offset,
+                      size_t *payload_len) {
+  if (len < RTP_HEADER_SIZE || (packet[0] >> 6) != 2) {
+    return false;
+  }
+  size_t offset = RTP_HEADER_SIZE + 4 * (packet[0] & 0x0F);
+  if (packet[0] & 0x10) {
+    if (offset + 4 > len) {
+      return false;
+    }
+    offset += 4 + 4 * (size_t) get_be16(packet + offset + 2);
+  }
+  if (offset > len) {
+    return false;
+  }
+  size_t payload = len - offset;
+  if (packet[0] & 0x20) {
+    uint8_t padding = packet[len - 1];
+    if (padding == 0 || padding > payload) {
+      return false;
+    }
+    payload -= padding;
+  }
+  header->marker = packet[1] & 0x80;
+  header->payload_type = packet[1] & 0x7F;
+  header->seq = get_be16(packet + 2);
+  header->timestamp = get_be32(packet + 4);
+  header->ssrc = get_be32(packet + 8);
+  *payload_offset = offset;
+  *payload_len = payload;
+  return true;
+}
+
+bool rtp_is_rtcp(const uint8_t *packet, size_t len) {
+  return len >= 8 && (packet[0] >> 6) == 2 && packet[1] >= 192 && packet[1] <= 223;
+}
+
+uint64_t rtp_ntp_from_us(uint64_t us) {
+  uint64_t seconds = us / 1000000;
+  uint64_t fraction = ((us % 1000000) << 32) / 1000000;
+  return (seconds << 32) | fraction;
+}
+
+void RtpSession::begin(uint32_t ssrc, uint8_t payload_type, uint32_t clock_rate, const char *cname,
+                       uint64_t now_us) {
+  *this = RtpSession();
+  ssrc_ = ssrc;
+  payload_type_ = payload_type;
+  clock_rate_ = clock_rate;
+  cname_ = cname;
+  random_ = ssrc ^ (uint32_t) now_us;
+  if (random_ == 0) {
+    random_ = 0x2545F491;
+  }
+  // Random initial sequence number and timestamp (section 5.1)
+  seq_ = (uint16_t) (ssrc >> 16);
+  timestamp_ = ssrc * 2654435761u;
+  schedule_rtcp_(now_us, true);
+}
+
+size_t RtpSession::write_header(uint8_t *buf, uint32_t samples, size_t payload_len, uint64_t now_us) {
+  RtpHeader header{payload_type_, packets_sent_ == 0, seq_, timestamp_, ssrc_};
+  rtp_write_header(buf, header);
+  last_send_us_ = now_us;
+  seq_++;
+  timestamp_ += samples;
+  packets_sent_++;
+  octets_sent_ += payload_len;
+  sent_since_report_ = true;
+  return RTP_HEADER_SIZE;
+}
+
+void RtpSession::init_seq_(uint16_t seq) {
+  base_seq_ = seq;
+  max_seq_ = seq;
+  bad_seq_ = RTP_SEQ_MOD + 1;
+  cycles_ = 0;
+  received_ = 0;
+  received_prior_ = 0;
+  expected_prior_ = 0;
+}
+
+bool RtpSession::update_seq_(uint16_t seq) {
+  uint16_t udelta = seq - max_seq_;
+  if (probation_) {
+    // A source is valid once MIN_SEQUENTIAL packets arrive in sequence
+    if (seq == (uint16_t) (max_seq_ + 1)) {
+      probation_--;
+      max_seq_ = seq;
+      if (probation_ == 0) {
+        init_seq_(seq);
+        received_++;
+        return true;
+      }
+    } else {
+      probation_ = MIN_SEQUENTIAL - 1;
+      max_seq_ = seq;
+    }
+    return false;
+  }
+  if (udelta < MAX_DROPOUT) {
+    // In order, with permissible gap
+    if (seq < max_seq_) {
+      cycles_ += RTP_SEQ_MOD;
+    }
+    max_seq_ = seq;
+  } else if (udelta <= RTP_SEQ_MOD - MAX_MISORDER) {
+    // A very large jump: resync if the next packet follows it, as the
+    // sender has probably restarted
+    if (seq == bad_seq_) {
+      init_seq_(seq);
+    } else {
+      bad_seq_ = (seq + 1) & (RTP_SEQ_MOD - 1);
+      return false;
+    }
+  }
+  // Otherwise a duplicate or reordered packet: counted, not tracked
+  received_++;
+  return true;
+}
+
+bool RtpSession::on_rtp(const uint8_t *packet, size_t len, uint64_t now_us, size_t *payload_offset,
+                        size_t *payload_len, RtpHeader *parsed) {
+  RtpHeader header;
+  if (!rtp_parse_header(packet, len, &header, payload_offset, payload_len)) {
+    return false;
+  }
+  if (!have_remote_ || header.ssrc != remote_ssrc_) {
+    have_remote_ = true;
+    remote_ssrc_ = header.ssrc;
+    init_seq_(header.seq);
+    max_seq_ = header.seq - 1;
+    probation_ = MIN_SEQUENTIAL;
+    have_transit_ = false;
+    jitter_q4_ = 0;
+  }
+  if (!update_seq_(header.seq)) {
+    return false;
+  }
+
+  // Interarrival jitter (A.8), with arrival time in timestamp units
+  uint32_t arrival = (uint32_t) (now_us * clock_rate_ / 1000000);
+  int32_t transit = (int32_t) (arrival - header.timestamp);
+  if (have_transit_) {
+    int32_t d = transit - transit_;
+    if (d < 0) {
+      d = -d;
+    }
+    jitter_q4_ += d - ((jitter_q4_ + 8) >> 4);
+  }
+  transit_ = transit;
+  have_transit_ = true;
+
+  stats_.packets_received = received_;
+  stats_.jitter = jitter_q4_ >> 4;
+  stats_.jitter_ms = stats_.jitter * 1000.0f / clock_rate_;
+  if (parsed != nullptr) {
+    *parsed = header;
+  }
+  return true;
+}
+
+void RtpSession::schedule_rtcp_(uint64_t now_us, bool initial) {
+  // Section 6.2: with two members and RTCP at 5% of an audio session the
+  // computed interval is far below the 5 s minimum, so the minimum applies
+  // (halved for the first report), randomized over [0.5, 1.5] and divided
+  // by e - 3/2 to compensate for the timer reconsideration bias
+  random_ ^= random_ << 13;
+  random_ ^= random_ >> 17;
+  random_ ^= random_ << 5;
+  uint64_t interval_ms = initial ? RTCP_MIN_INTERVAL_MS / 2 : RTCP_MIN_INTERVAL_MS;
+  uint64_t factor = 500 + random_ % 1001;  // 0.500 .. 1.500
+  next_rtcp_us_ = now_us + interval_ms * factor * 1000 / 1218;
+}
+
+size_t RtpSession::write_report_block_(uint8_t *p, uint64_t now_us) {
+  // Loss (A.3)
+  uint32_t extended_max = cycles_ + max_seq_;
+  uint32_t expected = extended_max - base_seq_ + 1;
+  int32_t lost = (int32_t) (expected - received_);
+  if (lost > 0x7FFFFF) {
+    lost = 0x7FFFFF;
+  } else if (lost < -0x800000) {
+    lost = -0x800000;
+  }
+  uint32_t expected_interval = expected - expected_prior_;
+  expected_prior_ = expected;
+  uint32_t received_interval = received_ - received_prior_;
+  received_prior_ = received_;
+  int32_t lost_interval = (int32_t) (expected_interval - received_interval);
+  uint8_t fraction = 0;
+  if (expected_interval != 0 && lost_interval > 0) {
+    fraction = (uint8_t) (((uint32_t) lost_interval << 8) / expected_interval);
+  }
+  stats_.fraction_lost = fraction;
+  stats_.cumulative_lost = lost;
+
+  uint32_t dlsr = 0;
+  if (last_sr_recv_us_ != 0) {
+    dlsr = (uint32_t) ((now_us - last_sr_recv_us_) * 65536 / 1000000);
+  }
+
+  put_be32(p, remote_ssrc_);
+  put_be32(p + 4, ((uint32_t) fraction << 24) | ((uint32_t) lost & 0xFFFFFF));
+  put_be32(p + 8, extended_max);
+  put_be32(p + 12, jitter_q4_ >> 4);
+  put_be32(p + 16, last_sr_ntp_mid_);
+  put_be32(p + 20, dlsr);
+  return 24;
+}
+
+size_t RtpSession::build_rtcp(uint8_t *buf, size_t cap, uint64_t now_us) {
+  if (cap < RTCP_MAX_PACKET_SIZE) {
+    return 0;
+  }
+  uint8_t blocks = (have_remote_ && probation_ == 0) ? 1 : 0;
+  uint8_t *p = buf;
+
+  if (sent_since_report_) {
+    // Sender report; its RTP timestamp is the media clock now, extrapolated
+    // from the last packet sent
+    uint64_t ntp = rtp_ntp_from_us(now_us);
+    uint32_t rtp_now = timestamp_ + (uint32_t) ((now_us - last_send_us_) * clock_rate_ / 1000000);
+    size_t len = 28 + 24 * blocks;
+    p[0] = 0x80 | blocks;
+    p[1] = RTCP_SR;
+    put_be16(p + 2, len / 4 - 1);
+    put_be32(p + 4, ssrc_);
+    put_be32(p + 8, (uint32_t) (ntp >> 32));
+    put_be32(p + 12, (uint32_t) ntp);
+    put_be32(p + 16, rtp_now);
+    put_be32(p + 20, packets_sent_);
+    put_be32(p + 24, octets_sent_);
+    p += 28;
+  } else {
+    size_t len = 8 + 24 * blocks;
+    p[0] = 0x80 | blocks;
+    p[1] = RTCP_RR;
+    put_be16(p + 2, len / 4 - 1);
+    put_be32(p + 4, ssrc_);
+    p += 8;
+  }
+  if (blocks) {
+    p += write_report_block_(p, now_us);
+  }
+
+  // SDES with the CNAME is mandatory in every compound packet (6.1)
+  size_t cname_len = strnlen(cname_, SDES_MAX_CNAME);
+  size_t sdes_len = (8 + 2 + cname_len + 1 + 3) & ~(size_t) 3;
+  memset(p, 0, sdes_len);
+  p[0] = 0x81;
+  p[1] = RTCP_SDES;
+  put_be16(p + 2, sdes_len / 4 - 1);
+  put_be32(p + 4, ssrc_);
+  p[8] = SDES_CNAME;
+  p[9] = (uint8_t) cname_len;
+  memcpy(p + 10, cname_, cname_len);
+  p += sdes_len;
+
+  sent_since_report_ = false;
+  stats_.reports_sent++;
+  schedule_rtcp_(now_us, false);
+  return p - buf;
+}
+
+bool RtpSession::on_rtcp(const uint8_t *packet, size_t len, uint64_t now_us) {
+  bool about_us = false;
+  size_t offset = 0;
+  while (offset + 8 <= len) {
+    const uint8_t *p = packet + offset;
+    if ((p[0] >> 6) != 2) {
+      break;
+    }
+    size_t length = 4 * ((size_t) get_be16(p + 2) + 1);
+    if (offset + length > len) {
+      break;
+    }
+    uint8_t count = p[0] & 0x1F;
+    const uint8_t *block = nullptr;
+    if (p[1] == RTCP_SR && length >= 28) {
+      uint64_t ntp = ((uint64_t) get_be32(p + 8) << 32) | get_be32(p + 12);
+      last_sr_ntp_mid_ = ntp_mid(ntp);
+      last_sr_recv_us_ = now_us;
+      block = p + 28;
+    } else if (p[1] == RTCP_RR) {
+      block = p + 8;
+    }
+    for (uint8_t i = 0; block != nullptr && i < count && block + 24 <= p + length; i++, block += 24) {
+      if (get_be32(block) != ssrc_) {
+        continue;
+      }
+      about_us = true;
+      stats_.remote_report = true;
+      stats_.remote_fraction_lost = block[4];
+      // Cumulative loss is a signed 24-bit field
+      int32_t lost = (int32_t) ((get_be32(block + 4) & 0xFFFFFF) << 8) >> 8;
+      stats_.remote_cumulative_lost = lost;
+      stats_.remote_jitter_ms = get_be32(block + 12) * 1000.0f / clock_rate_;
+      uint32_t lsr = get_be32(block + 16);
+      uint32_t dlsr = get_be32(block + 20);
+      if (lsr != 0) {
+        // RTT = A - LSR - DLSR, in 1/65536 s (6.4.1)
+        uint32_t rtt = ntp_mid(rtp_ntp_from_us(now_us)) - lsr - dlsr;
+        if ((int32_t) rtt >= 0) {
+          stats_.rtt_ms = rtt * 1000.0f / 65536.0f;
+          stats_.rtt_valid = true;
+        }
+      }
+    }
+    if (block != nullptr) {
+      stats_.reports_received++;
+    }
+    offset += length;
+  }
+  return about_us;
+}
+
+}  // namespace intercom
+}  // namespace esphome
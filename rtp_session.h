@@ -0,0 +1,146 @@
+/*
+ * RTP Session
+ * RTP packetization and RTCP sender/receiver reports for the raw UDP audio
+ * path (RFC 3550). RTCP is multiplexed on the RTP port (RFC 5761).
+ *
+ * The receive side keeps the RFC 3550 appendix A statistics: sequence
+ * tracking with probation (A.1), cumulative and interval loss (A.3) and
+ * interarrival jitter (A.8). Reports go out at the randomized interval of
+ * section 6.2 and the round-trip time follows from LSR/DLSR in the peer's
+ * reports (section 6.4.1).
+ *
+ * Plain C++ with no platform calls: the caller passes in the time, so the
+ * same code runs on the host.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace intercom {
+
+static constexpr size_t RTP_HEADER_SIZE = 12;
+static constexpr size_t RTP_MAX_HEADER_SIZE = RTP_HEADER_SIZE + 15 * 4;  // With a full CSRC list
+static constexpr size_t RTCP_MAX_PACKET_SIZE = 128;  // SR + one report block + SDES CNAME
+
+struct RtpHeader {
+  uint8_t payload_type;
+  bool marker;
+  uint16_t seq;
+  uint32_t timestamp;
+  uint32_t ssrc;
+};
+
+// What RTCP tells us about both directions of the call
+struct RtcpStats {
+  // Remote stream, as measured here
+  uint32_t packets_received{0};
+  int32_t cumulative_lost{0};
+  uint8_t fraction_lost{0};         // Last report interval, in 1/256
+  uint32_t jitter{0};               // Timestamp units
+  float jitter_ms{0.0f};
+  // Our stream, as the remote reported it
+  bool remote_report{false};
+  uint8_t remote_fraction_lost{0};
+  int32_t remote_cumulative_lost{0};
+  float remote_jitter_ms{0.0f};
+  // Round trip from LSR/DLSR; valid once the remote has echoed one of our SRs
+  bool rtt_valid{false};
+  float rtt_ms{0.0f};
+  uint32_t reports_sent{0};
+  uint32_t reports_received{0};
+};
+
+// Encode/decode a fixed RTP header; parse skips CSRCs and header extensions
+size_t rtp_write_header(uint8_t *buf, const RtpHeader &header);
+bool rtp_parse_header(const uint8_t *packet, size_t len, RtpHeader *header, size_t *payload_offset,
+                      size_t *payload_len);
+// RFC 5761 demultiplexing: RTCP packet types 192-223 sit where RTP would
+// have payload types 64-95
+bool rtp_is_rtcp(const uint8_t *packet, size_t len);
+// 64-bit NTP format (32.32 fixed point seconds) from microseconds
+uint64_t rtp_ntp_from_us(uint64_t us);
+// L16 samples are big endian on the wire (RFC 3551 4.5.11); converts in
+// place, in either direction
+void rtp_l16_swap(uint8_t *data, size_t len);
+
+class RtpSession {
+ public:
+  static constexpr uint32_t RTCP_MIN_INTERVAL_MS = 5000;
+
+  // cname names this endpoint in SDES and must outlive the session
+  void begin(uint32_t ssrc, uint8_t payload_type, uint32_t clock_rate, const char *cname, uint64_t now_us);
+
+  // Sender: write the header for the next packet of `samples` samples.
+  // Returns RTP_HEADER_SIZE.
+  size_t write_header(uint8_t *buf, uint32_t samples, size_t payload_len, uint64_t now_us);
+  // Payload type of the packets that follow (e.g. switching to RED and back)
+  void set_payload_type(uint8_t payload_type) { payload_type_ = payload_type; }
+  // RTP timestamp the next packet will carry
+  uint32_t timestamp() const { return timestamp_; }
+
+  // Receiver: validate and account for an RTP packet. Returns false for
+  // packets to drop (wrong version, probation, duplicates far out of order).
+  // The parsed header is copied to `header` if given.
+  bool on_rtp(const uint8_t *packet, size_t len, uint64_t now_us, size_t *payload_offset, size_t *payload_len,
+              RtpHeader *header = nullptr);
+
+  // True when the next report is due; call build_rtcp() then
+  bool rtcp_due(uint64_t now_us) const { return now_us >= next_rtcp_us_; }
+  // SR if we sent media since the last report, else RR, followed by SDES
+  // CNAME. Schedules the next report. Returns the compound packet length.
+  size_t build_rtcp(uint8_t *buf, size_t cap, uint64_t now_us);
+  // Parse a compound RTCP packet. Returns true if it carried a report
+  // block about our stream (new loss/RTT figures are in stats()).
+  bool on_rtcp(const uint8_t *packet, size_t len, uint64_t now_us);
+
+  const RtcpStats &stats() const { return stats_; }
+  uint32_t ssrc() const { return ssrc_; }
+  uint32_t remote_ssrc() const { return remote_ssrc_; }
+
+ protected:
+  void init_seq_(uint16_t seq);
+  bool update_seq_(uint16_t seq);
+  void schedule_rtcp_(uint64_t now_us, bool initial);
+  size_t write_report_block_(uint8_t *p, uint64_t now_us);
+
+  // Sender
+  uint32_t ssrc_{0};
+  uint8_t payload_type_{0};
+  uint32_t clock_rate_{8000};
+  const char *cname_{""};
+  uint16_t seq_{0};
+  uint32_t timestamp_{0};
+  uint64_t last_send_us_{0};
+  uint32_t packets_sent_{0};
+  uint32_t octets_sent_{0};
+  bool sent_since_report_{false};
+  uint64_t next_rtcp_us_{0};
+  uint32_t random_{0};
+
+  // Receiver (RFC 3550 A.1)
+  bool have_remote_{false};
+  uint32_t remote_ssrc_{0};
+  uint16_t max_seq_{0};
+  uint32_t cycles_{0};
+  uint32_t base_seq_{0};
+  uint32_t bad_seq_{0};
+  uint32_t probation_{0};
+  uint32_t received_{0};
+  uint32_t expected_prior_{0};
+  uint32_t received_prior_{0};
+  int32_t transit_{0};
+  bool have_transit_{false};
+  uint32_t jitter_q4_{0};           // Jitter x16 (A.8)
+
+  // Last SR from the remote, for LSR/DLSR
+  uint32_t last_sr_ntp_mid_{0};
+  uint64_t last_sr_recv_us_{0};
+
+  RtcpStats stats_;
+};
+
+}  // namespace intercom
+}  // namespace esphome
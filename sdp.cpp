@@ -0,0 +1,532 @@
+#include "sdp.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+namespace esphome {
+namespace intercom {
+
+static inline char lower(char c) { return c >= 'A' && c <= 'Z' ? (char) (c - 'A' + 'a') : c; }
+
+bool SdpString::equals(const char *s) const {
+  size_t n = strlen(s);
+  return n == len && memcmp(data, s, n) == 0;
+}
+
+bool SdpString::iequals(const char *s) const {
+  size_t n = strlen(s);
+  if (n != len) {
+    return false;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (lower(data[i]) != lower(s[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SdpString::copy(char *out, size_t cap) const {
+  if (cap == 0) {
+    return false;
+  }
+  size_t n = len < cap - 1 ? len : cap - 1;
+  if (n > 0) {
+    memcpy(out, data, n);
+  }
+  out[n] = '\0';
+  return n == len;
+}
+
+bool SdpReader::next(SdpLine *line) {
+  while (p_ < end_) {
+    const char *start = p_;
+    const char *nl = (const char *) memchr(start, '\n', end_ - start);
+    const char *stop = nl != nullptr ? nl : end_;
+    p_ = nl != nullptr ? nl + 1 : end_;
+    if (stop > start && stop[-1] == '\r') {
+      stop--;
+    }
+    if (stop - start >= 2 && start[1] == '=') {
+      line->type = start[0];
+      line->value = {start + 2, (size_t) (stop - start - 2)};
+      return true;
+    }
+  }
+  return false;
+}
+
+// Take the next space-separated token
+static bool next_token(SdpString *rest, SdpString *token) {
+  const char *p = rest->data;
+  const char *end = rest->data + rest->len;
+  while (p < end && *p == ' ') {
+    p++;
+  }
+  const char *start = p;
+  while (p < end && *p != ' ') {
+    p++;
+  }
+  *token = {start, (size_t) (p - start)};
+  *rest = {p, (size_t) (end - p)};
+  return token->len > 0;
+}
+
+// Split at the first `sep`: head before it, tail after it (empty if absent)
+static SdpString split(SdpString s, char sep, SdpString *tail) {
+  const char *p = (const char *) memchr(s.data, sep, s.len);
+  if (p == nullptr) {
+    *tail = {s.data + s.len, 0};
+    return s;
+  }
+  *tail = {p + 1, (size_t) (s.data + s.len - p - 1)};
+  return {s.data, (size_t) (p - s.data)};
+}
+
+static bool parse_u32(SdpString s, uint32_t *out) {
+  if (s.len == 0 || s.len > 10) {
+    return false;
+  }
+  uint64_t v = 0;
+  for (size_t i = 0; i < s.len; i++) {
+    if (s.data[i] < '0' || s.data[i] > '9') {
+      return false;
+    }
+    v = v * 10 + (uint32_t) (s.data[i] - '0');
+  }
+  if (v > UINT32_MAX) {
+    return false;
+  }
+  *out = (uint32_t) v;
+  return true;
+}
+
+static bool parse_u8(SdpString s, uint8_t *out) {
+  uint32_t v;
+  if (!parse_u32(s, &v) || v > UINT8_MAX) {
+    return false;
+  }
+  *out = (uint8_t) v;
+  return true;
+}
+
+static bool parse_u16(SdpString s, uint16_t *out) {
+  uint32_t v;
+  if (!parse_u32(s, &v) || v > UINT16_MAX) {
+    return false;
+  }
+  *out = (uint16_t) v;
+  return true;
+}
+
+static SdpString literal(const char *s) { return {s, strlen(s)}; }
+
+// RFC 3551 static payload types that may come without an rtpmap
+static void static_codec(SdpCodec *codec) {
+  switch (codec->payload_type) {
+    case 0:
+      codec->name = literal("PCMU");
+      codec->clock_rate = 8000;
+      break;
+    case 8:
+      codec->name = literal("PCMA");
+      codec->clock_rate = 8000;
+      break;
+    case 9:
+      codec->name = literal("G722");
+      codec->clock_rate = 8000;  // Sampled at 16 kHz, clocked at 8 kHz (RFC 3551 4.5.2)
+      break;
+    case 10:
+      codec->name = literal("L16");
+      codec->clock_rate = 44100;
+      codec->channels = 2;
+      break;
+    case 11:
+      codec->name = literal("L16");
+      codec->clock_rate = 44100;
+      break;
+    default:
+      break;
+  }
+}
+
+static SdpCodec *find_codec(SdpDescription *d, uint8_t pt) {
+  for (size_t i = 0; i < d->codec_count; i++) {
+    if (d->codecs[i].payload_type == pt) {
+      return &d->codecs[i];
+    }
+  }
+  return nullptr;
+}
+
+static void parse_media(SdpString value, SdpDescription *d) {
+  SdpString port, proto, fmt;
+  next_token(&value, &port);  // "audio" already taken
+  SdpString count;
+  if (!parse_u16(split(port, '/', &count), &d->port)) {
+    return;
+  }
+  next_token(&value, &proto);
+  d->proto = proto;
+  while (next_token(&value, &fmt) && d->codec_count < SdpDescription::MAX_CODECS) {
+    SdpCodec &codec = d->codecs[d->codec_count];
+    codec = SdpCodec{};
+    codec.channels = 1;
+    if (!parse_u8(fmt, &codec.payload_type) || codec.payload_type > 127) {
+      continue;
+    }
+    static_codec(&codec);
+    d->codec_count++;
+  }
+}
+
+static bool parse_candidate_value(SdpString value, SdpCandidate *c) {
+  // foundation component transport priority address port "typ" type ...
+  SdpString foundation, component, transport, priority, address, port, typ, type;
+  if (!next_token(&value, &foundation) || !next_token(&value, &component) || !next_token(&value, &transport) ||
+      !next_token(&value, &priority) || !next_token(&value, &address) || !next_token(&value, &port) ||
+      !next_token(&value, &typ) || !next_token(&value, &type) || !typ.equals("typ") || !transport.iequals("udp")) {
+    return false;
+  }
+  *c = SdpCandidate{};
+  if (!parse_u8(component, &c->component) || !parse_u32(priority, &c->priority) || !parse_u16(port, &c->port)) {
+    return false;
+  }
+  c->address = address;
+  c->type = type;
+  return true;
+}
+
+static void parse_candidate(SdpString value, SdpDescription *d) {
+  SdpCandidate c;
+  if (d->candidate_count < SdpDescription::MAX_CANDIDATES && parse_candidate_value(value, &c)) {
+    d->candidates[d->candidate_count++] = c;
+  }
+}
+
+static void parse_crypto(SdpString value, SdpDescription *d) {
+  // tag suite key-method:key-info[|lifetime][|MKI:length] ...
+  SdpString tag, suite, key_params, key;
+  if (d->crypto_count >= SdpDescription::MAX_CRYPTO || !next_token(&value, &tag) || !next_token(&value, &suite) ||
+      !next_token(&value, &key_params)) {
+    return;
+  }
+  SdpCrypto c{};
+  SdpString method = split(key_params, ':', &key);
+  if (!parse_u8(tag, &c.tag) || !method.equals("inline")) {
+    return;
+  }
+  SdpString rest;
+  c.suite = suite;
+  c.key = split(key, '|', &rest);
+  d->crypto[d->crypto_count++] = c;
+}
+
+static void parse_attribute(SdpString attr, SdpDescription *d, bool media) {
+  SdpString value;
+  SdpString name = split(attr, ':', &value);
+  if (name.equals("ice-lite")) {
+    d->ice_lite = true;
+  } else if (name.equals("ice-ufrag")) {
+    if (media || d->ice_ufrag.len == 0) {
+      d->ice_ufrag = value;
+    }
+  } else if (name.equals("ice-pwd")) {
+    if (media || d->ice_pwd.len == 0) {
+      d->ice_pwd = value;
+    }
+  } else if (!media) {
+    return;  // The rest only matter inside the audio section
+  } else if (name.equals("rtpmap") || name.equals("fmtp")) {
+    SdpString pt_str, params;
+    next_token(&value, &pt_str);
+    next_token(&value, &params);
+    uint8_t pt;
+    SdpCodec *codec = parse_u8(pt_str, &pt) ? find_codec(d, pt) : nullptr;
+    if (codec == nullptr) {
+      return;
+    }
+    if (name.equals("fmtp")) {
+      // Parameters may contain spaces after ';'
+      codec->fmtp = {params.data, (size_t) (value.data + value.len - params.data)};
+      return;
+    }
+    // <encoding>/<clock rate>[/<channels>]
+    SdpString rest, channels;
+    SdpString encoding = split(params, '/', &rest);
+    SdpString rate = split(rest, '/', &channels);
+    uint32_t clock_rate;
+    if (encoding.len == 0 || !parse_u32(rate, &clock_rate)) {
+      return;
+    }
+    codec->name = encoding;
+    codec->clock_rate = clock_rate;
+    codec->channels = 1;
+    if (channels.len > 0) {
+      parse_u8(channels, &codec->channels);
+    }
+  } else if (name.equals("ptime")) {
+    parse_u8(value, &d->ptime);
+  } else if (name.equals("maxptime")) {
+    parse_u8(value, &d->maxptime);
+  } else if (name.equals("sendrecv")) {
+    d->direction = SdpDirection::SENDRECV;
+  } else if (name.equals("sendonly")) {
+    d->direction = SdpDirection::SENDONLY;
+  } else if (name.equals("recvonly")) {
+    d->direction = SdpDirection::RECVONLY;
+  } else if (name.equals("inactive")) {
+    d->direction = SdpDirection::INACTIVE;
+  } else if (name.equals("rtcp-mux")) {
+    d->rtcp_mux = true;
+  } else if (name.equals("candidate")) {
+    parse_candidate(value, d);
+  } else if (name.equals("crypto")) {
+    parse_crypto(value, d);
+  }
+}
+
+// "IN IP4 <address>[/<ttl>]"
+static SdpString parse_connection(SdpString value) {
+  SdpString net, type, address, ttl;
+  if (!next_token(&value, &net) || !next_token(&value, &type) || !next_token(&value, &address)) {
+    return {value.data, 0};
+  }
+  return split(address, '/', &ttl);
+}
+
+bool sdp_parse(const char *sdp, size_t len, SdpDescription *out) {
+  *out = SdpDescription{};
+  SdpReader reader(sdp, len);
+  SdpLine line;
+  if (!reader.next(&line) || line.type != 'v' || !line.value.equals("0")) {
+    return false;
+  }
+
+  enum { SESSION, AUDIO, OTHER } section = SESSION;
+  SdpString session_address{sdp, 0};
+  SdpString media_address{sdp, 0};
+  while (reader.next(&line)) {
+    if (line.type == 'm') {
+      SdpString rest = line.value, media;
+      next_token(&rest, &media);
+      if (media.equals("audio") && !out->has_audio) {
+        out->has_audio = true;
+        section = AUDIO;
+        parse_media(rest, out);
+      } else {
+        section = OTHER;
+      }
+    } else if (section == OTHER) {
+      continue;
+    } else if (line.type == 'c') {
+      (section == AUDIO ? media_address : session_address) = parse_connection(line.value);
+    } else if (line.type == 'a') {
+      parse_attribute(line.value, out, section == AUDIO);
+    }
+  }
+  out->address = media_address.len > 0 ? media_address : session_address;
+  return out->has_audio;
+}
+
+static bool is_ipv4(SdpString s) {
+  if (s.len < 7 || s.len > 15) {
+    return false;
+  }
+  int dots = 0;
+  for (size_t i = 0; i < s.len; i++) {
+    if (s.data[i] == '.') {
+      dots++;
+    } else if (s.data[i] < '0' || s.data[i] > '9') {
+      return false;
+    }
+  }
+  return dots == 3;
+}
+
+bool sdp_parse_candidate(const char *line, size_t len, SdpCandidate *out) {
+  SdpString value{line, len};
+  while (value.len > 0 && (value.data[value.len - 1] == '\r' || value.data[value.len - 1] == '\n')) {
+    value.len--;
+  }
+  static const char *const PREFIXES[] = {"a=", "candidate:"};
+  for (const char *prefix : PREFIXES) {
+    size_t n = strlen(prefix);
+    if (value.len >= n && memcmp(value.data, prefix, n) == 0) {
+      value.data += n;
+      value.len -= n;
+    }
+  }
+  return parse_candidate_value(value, out);
+}
+
+bool sdp_negotiate(const SdpDescription &remote, const SdpCodecCap *caps, size_t cap_count, SdpNegotiation *out) {
+  *out = SdpNegotiation{};
+  if (!remote.has_audio || remote.port == 0) {
+    return false;
+  }
+
+  // Cheapest shared codec; among equals, the remote's preference
+  const SdpCodec *chosen = nullptr;
+  for (size_t i = 0; i < remote.codec_count; i++) {
+    const SdpCodec &codec = remote.codecs[i];
+    for (size_t c = 0; c < cap_count; c++) {
+      const SdpCodecCap &cap = caps[c];
+      if (codec.name.iequals(cap.name) && codec.clock_rate == cap.clock_rate && codec.channels == cap.channels &&
+          (out->codec == nullptr || cap.cost < out->codec->cost)) {
+        out->codec = &cap;
+        chosen = &codec;
+      }
+    }
+  }
+  if (chosen == nullptr) {
+    return false;
+  }
+  out->payload_type = chosen->payload_type;
+
+  // RED at the same rate whose fmtp (if any) starts with the chosen type
+  for (size_t i = 0; i < remote.codec_count; i++) {
+    const SdpCodec &codec = remote.codecs[i];
+    if (!codec.name.iequals("red") || codec.clock_rate != chosen->clock_rate) {
+      continue;
+    }
+    SdpString rest;
+    uint8_t primary;
+    if (codec.fmtp.len == 0 || (parse_u8(split(codec.fmtp, '/', &rest), &primary) && primary == chosen->payload_type)) {
+      out->red_payload_type = codec.payload_type;
+      break;
+    }
+  }
+
+  out->ptime = remote.ptime;
+  out->rtcp_mux = remote.rtcp_mux;
+  out->direction = remote.direction;
+
+  // The c= address, unless it is a placeholder (ICE puts 0.0.0.0 or an
+  // IPv6 address there): then the best IPv4 RTP candidate
+  SdpString address = remote.address;
+  uint16_t port = remote.port;
+  if (!is_ipv4(address) || address.equals("0.0.0.0")) {
+    const SdpCandidate *best = nullptr;
+    for (size_t i = 0; i < remote.candidate_count; i++) {
+      const SdpCandidate &c = remote.candidates[i];
+      if (c.component == 1 && is_ipv4(c.address) && (best == nullptr || c.priority > best->priority)) {
+        best = &c;
+      }
+    }
+    if (best == nullptr) {
+      return remote.ice_ufrag.len > 0;
+    }
+    address = best->address;
+    port = best->port;
+  }
+  address.copy(out->remote_address, sizeof(out->remote_address));
+  out->remote_port = port;
+  return true;
+}
+
+namespace {
+
+// Appends with bounds checking; any overflow sticks
+class SdpWriter {
+ public:
+  SdpWriter(char *buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+  void put(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    if (!ok_) {
+      return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf_ + len_, cap_ - len_, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t) n >= cap_ - len_) {
+      ok_ = false;
+      return;
+    }
+    len_ += n;
+  }
+
+  size_t finish() const { return ok_ ? len_ : 0; }
+
+ protected:
+  char *buf_;
+  size_t cap_;
+  size_t len_{0};
+  bool ok_{true};
+};
+
+void put_rtpmap(SdpWriter &w, uint8_t pt, const SdpCodecCap &cap) {
+  if (cap.channels > 1) {
+    w.put("a=rtpmap:%u %s/%u/%u\r\n", pt, cap.name, (unsigned) cap.clock_rate, cap.channels);
+  } else {
+    w.put("a=rtpmap:%u %s/%u\r\n", pt, cap.name, (unsigned) cap.clock_rate);
+  }
+}
+
+}  // namespace
+
+size_t sdp_write(const SdpLocal &local, char *buf, size_t cap) {
+  if (buf == nullptr || cap == 0) {
+    return 0;
+  }
+  SdpWriter w(buf, cap);
+  w.put("v=0\r\no=- %u %u IN IP4 %s\r\ns=-\r\nc=IN IP4 %s\r\nt=0 0\r\n", (unsigned) local.session_id,
+        (unsigned) local.version, local.address, local.address);
+  bool ice = local.ice_ufrag != nullptr && local.ice_pwd != nullptr;
+  if (ice) {
+    w.put("a=ice-lite\r\n");
+  }
+
+  const SdpNegotiation *answer = local.answer;
+  const SdpCodecCap *primary = answer != nullptr ? answer->codec : (local.cap_count > 0 ? &local.caps[0] : nullptr);
+  if (primary == nullptr) {
+    return 0;
+  }
+  uint8_t primary_pt = answer != nullptr ? answer->payload_type : primary->payload_type;
+  uint8_t red_pt = answer != nullptr ? answer->red_payload_type : local.red_payload_type;
+
+  bool srtp = local.crypto_suite != nullptr && local.crypto_key != nullptr;
+  w.put("m=audio %u %s", local.port, srtp ? "RTP/SAVP" : "RTP/AVP");
+  if (answer != nullptr) {
+    w.put(" %u", primary_pt);
+  } else {
+    for (size_t i = 0; i < local.cap_count; i++) {
+      w.put(" %u", local.caps[i].payload_type);
+    }
+  }
+  if (red_pt != 0) {
+    w.put(" %u", red_pt);
+  }
+  w.put("\r\n");
+
+  if (answer != nullptr) {
+    put_rtpmap(w, primary_pt, *primary);
+  } else {
+    for (size_t i = 0; i < local.cap_count; i++) {
+      put_rtpmap(w, local.caps[i].payload_type, local.caps[i]);
+    }
+  }
+  if (red_pt != 0) {
+    // Redundancy over the primary codec only (RFC 2198 section 5)
+    w.put("a=rtpmap:%u red/%u\r\na=fmtp:%u %u/%u\r\n", red_pt, (unsigned) primary->clock_rate, red_pt, primary_pt,
+          primary_pt);
+  }
+  if (local.ptime != 0) {
+    w.put("a=ptime:%u\r\n", local.ptime);
+  }
+  if (ice) {
+    // Host type preference 126, local preference 65535, component 1 (RFC 8445 5.1.2.1)
+    w.put("a=ice-ufrag:%s\r\na=ice-pwd:%s\r\na=candidate:1 1 UDP %u %s %u typ host\r\n", local.ice_ufrag,
+          local.ice_pwd, (unsigned) ((126u << 24) | (65535u << 8) | 255u), local.address, local.port);
+  }
+  if (srtp) {
+    w.put("a=crypto:%u %s inline:%s\r\n", local.crypto_tag, local.crypto_suite, local.crypto_key);
+  }
+  w.put("a=rtcp-mux\r\na=sendrecv\r\n");
+  return w.finish();
+}
+
+}  // namespace intercom
+}  // namespace esphome
@@ -0,0 +1,167 @@
+/*
+ * SDP
+ * Session descriptions for the raw RTP path: a line tokenizer, a parser for
+ * the audio section, an offer/answer negotiator and a writer (RFC 4566,
+ * RFC 3264).
+ *
+ * Parsing is zero-copy: SdpString fields point into the SDP text, so a
+ * parsed SdpDescription is only valid while that text is. Nothing is
+ * allocated; descriptions with more codecs or candidates than fit keep the
+ * first ones.
+ *
+ * Plain C++ with no platform calls, so the same code runs on the host.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace intercom {
+
+struct SdpString {
+  const char *data;
+  size_t len;
+
+  bool equals(const char *s) const;
+  // Case-insensitive, as encoding names are
+  bool iequals(const char *s) const;
+  // Copy into a NUL-terminated buffer, truncating; returns false if it did
+  bool copy(char *out, size_t cap) const;
+};
+
+struct SdpLine {
+  char type;        // 'v', 'o', 'm', 'c', 'a', ...
+  SdpString value;  // Everything after "<type>="
+};
+
+// Splits SDP text into lines; accepts CRLF or bare LF and skips malformed lines
+class SdpReader {
+ public:
+  SdpReader(const char *sdp, size_t len) : p_(sdp), end_(sdp + len) {}
+  bool next(SdpLine *line);
+
+ protected:
+  const char *p_;
+  const char *end_;
+};
+
+struct SdpCodec {
+  uint8_t payload_type;
+  SdpString name;  // From a=rtpmap, or the RFC 3551 name of a static type
+  uint32_t clock_rate;
+  uint8_t channels;
+  SdpString fmtp;  // Empty if none
+};
+
+struct SdpCandidate {
+  SdpString address;
+  uint16_t port;
+  uint32_t priority;
+  uint8_t component;
+  SdpString type;  // host, srflx, prflx or relay
+};
+
+// SDES key offer (RFC 4568): a=crypto:<tag> <suite> inline:<key>[|...]
+struct SdpCrypto {
+  uint8_t tag;
+  SdpString suite;  // e.g. AES_CM_128_HMAC_SHA1_80
+  SdpString key;    // Base64 master key and salt, lifetime and MKI cut off
+};
+
+enum class SdpDirection : uint8_t {
+  SENDRECV = 0,
+  SENDONLY,
+  RECVONLY,
+  INACTIVE,
+};
+
+struct SdpDescription {
+  static constexpr size_t MAX_CODECS = 8;
+  static constexpr size_t MAX_CANDIDATES = 4;
+  static constexpr size_t MAX_CRYPTO = 2;
+
+  // First audio section; port 0 means it was rejected
+  bool has_audio;
+  uint16_t port;
+  SdpString proto;    // RTP/AVP, RTP/SAVPF, UDP/TLS/RTP/SAVPF ...
+  SdpString address;  // Media c= if present, else the session c=
+  SdpCodec codecs[MAX_CODECS];  // In the m= line's preference order
+  size_t codec_count;
+  uint8_t ptime;                // 0 if not given
+  uint8_t maxptime;
+  SdpDirection direction;
+  bool rtcp_mux;
+  SdpString ice_ufrag;
+  SdpString ice_pwd;
+  bool ice_lite;
+  SdpCandidate candidates[MAX_CANDIDATES];
+  size_t candidate_count;
+  SdpCrypto crypto[MAX_CRYPTO];  // In the remote's preference order
+  size_t crypto_count;
+};
+
+// Returns false if the text is not SDP (no v=0 first) or has no audio section
+bool sdp_parse(const char *sdp, size_t len, SdpDescription *out);
+// One candidate attribute, with or without its "a=" or "candidate:" prefix,
+// as trickled over signaling. Returns false unless it is a UDP candidate.
+bool sdp_parse_candidate(const char *line, size_t len, SdpCandidate *out);
+
+// A codec this end can run. cost orders the choice when both ends share
+// several (e.g. bits per second on the wire); the cheapest wins.
+struct SdpCodecCap {
+  const char *name;
+  uint32_t clock_rate;
+  uint8_t channels;
+  uint16_t cost;
+  uint8_t payload_type;  // What we offer it as; answers use the offerer's
+};
+
+struct SdpNegotiation {
+  const SdpCodecCap *codec;
+  uint8_t payload_type;      // Send and receive under this number
+  uint8_t red_payload_type;  // RFC 2198 over the chosen codec; 0 if not shared
+  uint8_t ptime;             // What the remote asked for, or 0 for our default
+  char remote_address[46];
+  uint16_t remote_port;
+  bool rtcp_mux;
+  SdpDirection direction;  // The remote's
+};
+
+// Pick the cheapest codec both ends have and the remote's RTP transport.
+// Works on an offer (we answer with what it returns) as well as on the
+// answer to our offer. Returns false if nothing is shared, the audio was
+// rejected, or there is no address to send to. A remote that does ICE may
+// have none yet (trickle): then remote_port is 0 and ICE finds the address.
+bool sdp_negotiate(const SdpDescription &remote, const SdpCodecCap *caps, size_t cap_count, SdpNegotiation *out);
+
+// Our side of an offer or answer
+struct SdpLocal {
+  uint32_t session_id;
+  uint32_t version;
+  const char *address;  // Dotted IPv4
+  uint16_t port;
+  // Offer: every cap under its own payload type. Answer: just `answer`.
+  const SdpCodecCap *caps;
+  size_t cap_count;
+  const SdpNegotiation *answer;
+  uint8_t red_payload_type;  // Offer RED under this type; 0 for none (offers only)
+  uint8_t ptime;
+  // ICE-lite credentials (ice_lite.h); nullptr leaves ICE out. The c= address
+  // and port go in as the one host candidate.
+  const char *ice_ufrag;
+  const char *ice_pwd;
+  // SDES key (srtp.h); nullptr sends plain RTP/AVP. Answers echo the tag of
+  // the offer's crypto line they accepted.
+  const char *crypto_suite;
+  const char *crypto_key;
+  uint8_t crypto_tag;
+};
+
+// Write an offer (local.answer == nullptr) or answer. Returns the length
+// written, or 0 if it did not fit in cap (NUL included).
+size_t sdp_write(const SdpLocal &local, char *buf, size_t cap);
+
+}  // namespace intercom
+}  // namespace esphome
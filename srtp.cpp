@@ -0,0 +1,332 @@
+#include "srtp.h"
+
+#include <cstring>
+
+#include "mbedtls/base64.h"
+#include "rtp_session.h"
+
+namespace esphome {
+namespace intercom {
+
+// Key derivation labels (RFC 3711 4.3.1)
+static constexpr uint8_t LABEL_RTP_ENCRYPTION = 0x00;
+static constexpr uint8_t LABEL_RTP_AUTH = 0x01;
+static constexpr uint8_t LABEL_RTP_SALT = 0x02;
+static constexpr uint8_t LABEL_RTCP_ENCRYPTION = 0x03;
+static constexpr uint8_t LABEL_RTCP_AUTH = 0x04;
+static constexpr uint8_t LABEL_RTCP_SALT = 0x05;
+
+static constexpr size_t AUTH_KEY_SIZE = 20;
+static constexpr size_t SRTCP_TAG_SIZE = 10;
+static constexpr uint32_t SRTCP_E_FLAG = 0x80000000;
+
+static uint32_t get32(const uint8_t *p) {
+  return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = (v >> 16) & 0xFF;
+  p[2] = (v >> 8) & 0xFF;
+  p[3] = v & 0xFF;
+}
+
+// Fixed header, CSRCs and extension: everything SRTP leaves in the clear.
+// 0 if the packet is not RTP.
+static size_t rtp_header_length(const uint8_t *packet, size_t len) {
+  if (len < RTP_HEADER_SIZE || (packet[0] >> 6) != 2) {
+    return 0;
+  }
+  size_t header = RTP_HEADER_SIZE + 4 * (packet[0] & 0x0F);
+  if (packet[0] & 0x10) {
+    if (header + 4 > len) {
+      return 0;
+    }
+    header += 4 + 4 * (size_t) ((packet[header + 2] << 8) | packet[header + 3]);
+  }
+  return header <= len ? header : 0;
+}
+
+static bool tags_equal(const uint8_t *a, const uint8_t *b, size_t len) {
+  uint8_t diff = 0;
+  for (size_t i = 0; i < len; i++) {
+    diff |= a[i] ^ b[i];
+  }
+  return diff == 0;
+}
+
+// AES-CM PRF over the master key (RFC 3711 4.3.3), with a key derivation
+// rate of 0
+static void derive(mbedtls_aes_context *master, const uint8_t *master_salt, uint8_t label, uint8_t *out, size_t len) {
+  uint8_t iv[16] = {0};
+  memcpy(iv, master_salt, SRTP_SALT_SIZE);
+  iv[7] ^= label;
+  uint8_t stream_block[16];
+  size_t offset = 0;
+  memset(out, 0, len);
+  mbedtls_aes_crypt_ctr(master, len, &offset, iv, stream_block, out, out);
+}
+
+const char *srtp_suite_name(SrtpSuite suite) {
+  switch (suite) {
+    case SrtpSuite::AES_CM_128_HMAC_SHA1_80:
+      return "AES_CM_128_HMAC_SHA1_80";
+    case SrtpSuite::AES_CM_128_HMAC_SHA1_32:
+      return "AES_CM_128_HMAC_SHA1_32";
+  }
+  return "unknown";
+}
+
+bool srtp_suite_from_name(const char *name, size_t len, SrtpSuite *suite) {
+  static const SrtpSuite SUITES[] = {SrtpSuite::AES_CM_128_HMAC_SHA1_80, SrtpSuite::AES_CM_128_HMAC_SHA1_32};
+  for (SrtpSuite s : SUITES) {
+    const char *known = srtp_suite_name(s);
+    if (strlen(known) == len && memcmp(known, name, len) == 0) {
+      *suite = s;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool srtp_key_to_base64(const uint8_t *master, char *out, size_t cap) {
+  size_t written;
+  return mbedtls_base64_encode((unsigned char *) out, cap, &written, master, SRTP_MASTER_SIZE) == 0;
+}
+
+bool srtp_key_from_base64(const char *b64, size_t len, uint8_t *master) {
+  size_t written;
+  return mbedtls_base64_decode(master, SRTP_MASTER_SIZE, &written, (const unsigned char *) b64, len) == 0 &&
+         written == SRTP_MASTER_SIZE;
+}
+
+bool srtp_select_crypto(const SdpDescription &remote, SrtpSuite *suite, uint8_t *tag, uint8_t *master) {
+  for (size_t i = 0; i < remote.crypto_count; i++) {
+    const SdpCrypto &crypto = remote.crypto[i];
+    if (srtp_suite_from_name(crypto.suite.data, crypto.suite.len, suite) &&
+        srtp_key_from_base64(crypto.key.data, crypto.key.len, master)) {
+      *tag = crypto.tag;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SrtpContext::ReplayWindow::check(uint64_t index) const {
+  if (!started || index > highest) {
+    return true;
+  }
+  uint64_t age = highest - index;
+  return age < 64 && !((bitmap >> age) & 1);
+}
+
+void SrtpContext::ReplayWindow::update(uint64_t index) {
+  if (!started) {
+    started = true;
+    highest = index;
+    bitmap = 1;
+  } else if (index > highest) {
+    uint64_t shift = index - highest;
+    bitmap = shift < 64 ? (bitmap << shift) | 1 : 1;
+    highest = index;
+  } else {
+    bitmap |= (uint64_t) 1 << (highest - index);
+  }
+}
+
+SrtpContext::SrtpContext() {
+  mbedtls_aes_init(&rtp_aes_);
+  mbedtls_aes_init(&rtcp_aes_);
+}
+
+SrtpContext::~SrtpContext() {
+  mbedtls_aes_free(&rtp_aes_);
+  mbedtls_aes_free(&rtcp_aes_);
+}
+
+void SrtpContext::begin(SrtpSuite suite, const uint8_t *master) {
+  const uint8_t *master_salt = master + SRTP_KEY_SIZE;
+  mbedtls_aes_context master_aes;
+  mbedtls_aes_init(&master_aes);
+  mbedtls_aes_setkey_enc(&master_aes, master, SRTP_KEY_SIZE * 8);
+
+  uint8_t key[AUTH_KEY_SIZE];
+  derive(&master_aes, master_salt, LABEL_RTP_ENCRYPTION, key, SRTP_KEY_SIZE);
+  mbedtls_aes_setkey_enc(&rtp_aes_, key, SRTP_KEY_SIZE * 8);
+  derive(&master_aes, master_salt, LABEL_RTP_AUTH, key, AUTH_KEY_SIZE);
+  rtp_auth_.set_key(key, AUTH_KEY_SIZE);
+  derive(&master_aes, master_salt, LABEL_RTP_SALT, rtp_salt_, SRTP_SALT_SIZE);
+  derive(&master_aes, master_salt, LABEL_RTCP_ENCRYPTION, key, SRTP_KEY_SIZE);
+  mbedtls_aes_setkey_enc(&rtcp_aes_, key, SRTP_KEY_SIZE * 8);
+  derive(&master_aes, master_salt, LABEL_RTCP_AUTH, key, AUTH_KEY_SIZE);
+  rtcp_auth_.set_key(key, AUTH_KEY_SIZE);
+  derive(&master_aes, master_salt, LABEL_RTCP_SALT, rtcp_salt_, SRTP_SALT_SIZE);
+  memset(key, 0, sizeof(key));
+  mbedtls_aes_free(&master_aes);
+
+  tag_size_ = suite == SrtpSuite::AES_CM_128_HMAC_SHA1_32 ? 4 : 10;
+  tx_started_ = false;
+  tx_roc_ = 0;
+  tx_rtcp_index_ = 0;
+  rx_roc_ = 0;
+  rx_window_ = ReplayWindow{};
+  rx_rtcp_window_ = ReplayWindow{};
+  stats_ = SrtpStats{};
+  active_ = true;
+}
+
+// Keystream IV: salt ^ (SSRC << 64) ^ (index << 16) (RFC 3711 4.1.1)
+void SrtpContext::crypt_(mbedtls_aes_context *aes, const uint8_t *salt, uint32_t ssrc, uint64_t index, uint8_t *data,
+                         size_t len) {
+  uint8_t iv[16] = {0};
+  memcpy(iv, salt, SRTP_SALT_SIZE);
+  for (int i = 0; i < 4; i++) {
+    iv[4 + i] ^= (ssrc >> (24 - 8 * i)) & 0xFF;
+  }
+  for (int i = 0; i < 6; i++) {
+    iv[8 + i] ^= (index >> (40 - 8 * i)) & 0xFF;
+  }
+  uint8_t stream_block[16];
+  size_t offset = 0;
+  mbedtls_aes_crypt_ctr(aes, len, &offset, iv, stream_block, data, data);
+}
+
+bool SrtpContext::protect(const uint8_t *header, size_t header_len, uint8_t *payload, size_t payload_len,
+                          uint8_t *tag) {
+  if (!active_ || header_len < RTP_HEADER_SIZE) {
+    return false;
+  }
+  // Sequence numbers only move forward here: a smaller one is a rollover
+  uint16_t seq = (header[2] << 8) | header[3];
+  if (tx_started_ && seq < tx_seq_) {
+    tx_roc_++;
+  }
+  tx_started_ = true;
+  tx_seq_ = seq;
+  uint32_t roc = tx_roc_;
+
+  crypt_(&rtp_aes_, rtp_salt_, get32(header + 8), ((uint64_t) roc << 16) | seq, payload, payload_len);
+
+  uint8_t roc_bytes[4];
+  put32(roc_bytes, roc);
+  uint8_t mac[HmacSha1::SIZE];
+  rtp_auth_.start();
+  rtp_auth_.update(header, header_len);
+  rtp_auth_.update(payload, payload_len);
+  rtp_auth_.update(roc_bytes, sizeof(roc_bytes));
+  rtp_auth_.finish(mac);
+  memcpy(tag, mac, tag_size_);
+  stats_.protected_packets++;
+  return true;
+}
+
+size_t SrtpContext::protect(uint8_t *packet, size_t len, size_t cap) {
+  size_t header = rtp_header_length(packet, len);
+  if (header == 0 || len + tag_size_ > cap ||
+      !protect(packet, header, packet + header, len - header, packet + len)) {
+    return 0;
+  }
+  return len + tag_size_;
+}
+
+size_t SrtpContext::unprotect(uint8_t *packet, size_t len) {
+  size_t header = len > tag_size_ ? rtp_header_length(packet, len - tag_size_) : 0;
+  if (!active_ || header == 0) {
+    return 0;
+  }
+  size_t body = len - tag_size_;
+  uint16_t seq = (packet[2] << 8) | packet[3];
+  uint32_t ssrc = get32(packet + 8);
+
+  // Guess the sender's rollover counter from the highest sequence number so
+  // far (RFC 3711 3.3.1). A new SSRC starts a new stream.
+  bool new_stream = !rx_window_.started || ssrc != rx_ssrc_;
+  uint32_t roc = new_stream ? 0 : rx_roc_;
+  if (!new_stream) {
+    if (rx_seq_ < 0x8000) {
+      if (seq > rx_seq_ + 0x8000) {
+        roc--;
+      }
+    } else if (seq < rx_seq_ - 0x8000) {
+      roc++;
+    }
+  }
+  uint64_t index = ((uint64_t) roc << 16) | seq;
+  if (!new_stream && !rx_window_.check(index)) {
+    stats_.replays++;
+    return 0;
+  }
+
+  uint8_t roc_bytes[4];
+  put32(roc_bytes, roc);
+  uint8_t mac[HmacSha1::SIZE];
+  rtp_auth_.start();
+  rtp_auth_.update(packet, body);
+  rtp_auth_.update(roc_bytes, sizeof(roc_bytes));
+  rtp_auth_.finish(mac);
+  if (!tags_equal(mac, packet + body, tag_size_)) {
+    stats_.auth_failures++;
+    return 0;
+  }
+
+  crypt_(&rtp_aes_, rtp_salt_, ssrc, index, packet + header, body - header);
+
+  if (new_stream) {
+    rx_ssrc_ = ssrc;
+    rx_roc_ = roc;
+    rx_seq_ = seq;
+    rx_window_ = ReplayWindow{};
+  } else if (roc == rx_roc_ + 1 || (roc == rx_roc_ && seq > rx_seq_)) {
+    rx_roc_ = roc;
+    rx_seq_ = seq;
+  }
+  rx_window_.update(index);
+  stats_.unprotected_packets++;
+  return body;
+}
+
+size_t SrtpContext::protect_rtcp(uint8_t *packet, size_t len, size_t cap) {
+  if (!active_ || len < 8 || len + SRTCP_TRAILER > cap) {
+    return 0;
+  }
+  uint32_t index = tx_rtcp_index_;
+  tx_rtcp_index_ = (tx_rtcp_index_ + 1) & 0x7FFFFFFF;
+
+  // Everything after the first header and sender SSRC is encrypted
+  crypt_(&rtcp_aes_, rtcp_salt_, get32(packet + 4), index, packet + 8, len - 8);
+  put32(packet + len, SRTCP_E_FLAG | index);
+  uint8_t mac[HmacSha1::SIZE];
+  rtcp_auth_.mac(packet, len + 4, mac);
+  memcpy(packet + len + 4, mac, SRTCP_TAG_SIZE);
+  stats_.protected_packets++;
+  return len + 4 + SRTCP_TAG_SIZE;
+}
+
+size_t SrtpContext::unprotect_rtcp(uint8_t *packet, size_t len) {
+  if (!active_ || len < 8 + 4 + SRTCP_TAG_SIZE) {
+    return 0;
+  }
+  size_t body = len - 4 - SRTCP_TAG_SIZE;
+  uint32_t word = get32(packet + body);
+  uint32_t index = word & 0x7FFFFFFF;
+  if (!rx_rtcp_window_.check(index)) {
+    stats_.replays++;
+    return 0;
+  }
+
+  uint8_t mac[HmacSha1::SIZE];
+  rtcp_auth_.mac(packet, body + 4, mac);
+  if (!tags_equal(mac, packet + body + 4, SRTCP_TAG_SIZE)) {
+    stats_.auth_failures++;
+    return 0;
+  }
+  if (word & SRTCP_E_FLAG) {
+    crypt_(&rtcp_aes_, rtcp_salt_, get32(packet + 4), index, packet + 8, body - 8);
+  }
+  rx_rtcp_window_.update(index);
+  stats_.unprotected_packets++;
+  return body;
+}
+
+}  // namespace intercom
+}  // namespace esphome
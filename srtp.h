@@ -0,0 +1,131 @@
+/*
+ * SRTP
+ * Encryption and authentication for the raw RTP path (RFC 3711) with the
+ * AES_CM_128_HMAC_SHA1_80 and _32 suites, keyed over SDP with SDES
+ * (RFC 4568).
+ *
+ * Packets are processed in place: the payload is encrypted or decrypted
+ * where it lies and the tag goes right after it, or into a separate
+ * buffer when the caller writes header and payload separately. Session
+ * keys are derived once in begin(), and the HMAC key schedule is
+ * precomputed (hmac_sha1.h). Per packet, the cost is one AES-CTR pass and
+ * two SHA-1 runs over the data.
+ *
+ * AES and SHA-1 come from mbedtls, which on the ESP32 runs them on the
+ * crypto hardware (CONFIG_MBEDTLS_HARDWARE_AES/SHA). Otherwise this is plain
+ * C++, so the same code runs on the host.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hmac_sha1.h"
+#include "mbedtls/aes.h"
+#include "sdp.h"
+
+namespace esphome {
+namespace intercom {
+
+enum class SrtpSuite : uint8_t {
+  AES_CM_128_HMAC_SHA1_80 = 0,
+  AES_CM_128_HMAC_SHA1_32,
+};
+
+static constexpr size_t SRTP_KEY_SIZE = 16;
+static constexpr size_t SRTP_SALT_SIZE = 14;
+static constexpr size_t SRTP_MASTER_SIZE = SRTP_KEY_SIZE + SRTP_SALT_SIZE;  // What SDES carries
+static constexpr size_t SRTP_MASTER_BASE64 = 41;  // Base64 of the above, NUL included
+static constexpr size_t SRTP_MAX_TAG = 10;
+// SRTCP appends the E flag and index, then an 80-bit tag with either suite
+static constexpr size_t SRTCP_TRAILER = 4 + SRTP_MAX_TAG;
+
+const char *srtp_suite_name(SrtpSuite suite);
+bool srtp_suite_from_name(const char *name, size_t len, SrtpSuite *suite);
+// SDES inline key-info: the master key and salt in base64
+bool srtp_key_to_base64(const uint8_t *master, char *out, size_t cap);
+bool srtp_key_from_base64(const char *b64, size_t len, uint8_t *master);
+// The remote's most preferred crypto line that we can run
+bool srtp_select_crypto(const SdpDescription &remote, SrtpSuite *suite, uint8_t *tag, uint8_t *master);
+
+struct SrtpStats {
+  uint32_t protected_packets{0};
+  uint32_t unprotected_packets{0};
+  uint32_t auth_failures{0};
+  uint32_t replays{0};
+};
+
+// The crypto context for one direction: use one to send and another, with
+// the remote's key, to receive
+class SrtpContext {
+ public:
+  SrtpContext();
+  ~SrtpContext();
+  SrtpContext(const SrtpContext &) = delete;
+  SrtpContext &operator=(const SrtpContext &) = delete;
+
+  // Derives the session keys from SRTP_MASTER_SIZE bytes of master key and
+  // salt, and starts the sequence and replay state afresh
+  void begin(SrtpSuite suite, const uint8_t *master);
+  void end() { active_ = false; }
+  bool active() const { return active_; }
+  size_t tag_size() const { return tag_size_; }
+
+  // Sender. Encrypts the payload in place and writes tag_size() bytes of
+  // tag, to be sent right after it.
+  bool protect(const uint8_t *header, size_t header_len, uint8_t *payload, size_t payload_len, uint8_t *tag);
+  // Sender, whole packet with room for the tag; returns the new length or 0
+  size_t protect(uint8_t *packet, size_t len, size_t cap);
+  // Receiver. Checks the tag and the replay window, then decrypts in place.
+  // Returns the length without the tag, or 0 if the packet was rejected.
+  size_t unprotect(uint8_t *packet, size_t len);
+
+  // The same for a compound RTCP packet; protect_rtcp needs SRTCP_TRAILER
+  // bytes of room
+  size_t protect_rtcp(uint8_t *packet, size_t len, size_t cap);
+  size_t unprotect_rtcp(uint8_t *packet, size_t len);
+
+  const SrtpStats &stats() const { return stats_; }
+
+ protected:
+  // 64-packet replay window over a 48-bit (SRTP) or 31-bit (SRTCP) index
+  struct ReplayWindow {
+    bool started;
+    uint64_t highest;
+    uint64_t bitmap;  // Bit n: highest - n was seen
+
+    bool check(uint64_t index) const;
+    void update(uint64_t index);
+  };
+
+  void crypt_(mbedtls_aes_context *aes, const uint8_t *salt, uint32_t ssrc, uint64_t index, uint8_t *data,
+              size_t len);
+
+  bool active_{false};
+  size_t tag_size_{SRTP_MAX_TAG};
+  mbedtls_aes_context rtp_aes_;
+  mbedtls_aes_context rtcp_aes_;
+  HmacSha1 rtp_auth_;
+  HmacSha1 rtcp_auth_;
+  uint8_t rtp_salt_[SRTP_SALT_SIZE];
+  uint8_t rtcp_salt_[SRTP_SALT_SIZE];
+
+  // Sender: rollover counter over the sequence numbers sent
+  bool tx_started_{false};
+  uint16_t tx_seq_{0};
+  uint32_t tx_roc_{0};
+  uint32_t tx_rtcp_index_{0};
+  // Receiver: the stream's SSRC, rollover counter and highest sequence
+  // number (s_l in RFC 3711 3.3.1)
+  uint32_t rx_ssrc_{0};
+  uint32_t rx_roc_{0};
+  uint16_t rx_seq_{0};
+  ReplayWindow rx_window_{};
+  ReplayWindow rx_rtcp_window_{};
+
+  SrtpStats stats_;
+};
+
+}  // namespace intercom
+}  // namespace esphome
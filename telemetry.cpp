@@ -0,0 +1,206 @@
+#include "telemetry.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace intercom {
+
+static uint32_t fnv1a(const char *s) {
+  uint32_t hash = 2166136261u;
+  for (; *s; s++) {
+    hash = (hash ^ (uint8_t) *s) * 16777619u;
+  }
+  return hash;
+}
+
+bool Telemetry::begin(const MetricDef *defs, size_t count, const char *device_name) {
+  if (defs == nullptr || count == 0 || count > MAX_METRICS) {
+    return false;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (defs[i].type == MetricType::HISTOGRAM && (size_t) defs[i].bound_count + 1 > MAX_BUCKETS) {
+      return false;
+    }
+  }
+  defs_ = defs;
+  count_ = count;
+  device_name_ = device_name;
+  device_id_ = fnv1a(device_name);
+  len_ = 0;
+  snapshots_ = 0;
+
+  // A frame must hold the header, the schema and at least one snapshot
+  size_t size = 16 + strnlen(device_name, 255);
+  for (size_t i = 0; i < count; i++) {
+    size += 4 + strnlen(defs[i].name, 255) + strnlen(defs[i].unit, 255);
+    if (defs[i].type == MetricType::HISTOGRAM) {
+      size += 1 + 5 * (size_t) defs[i].bound_count;
+    }
+  }
+  if (size + snapshot_size_() > FRAME_SIZE) {
+    count_ = 0;
+    return false;
+  }
+  return true;
+}
+
+void Telemetry::add(uint8_t id, uint32_t n) {
+  if (id < count_) {
+    counters_[id].fetch_add(n, std::memory_order_relaxed);
+  }
+}
+
+void Telemetry::set(uint8_t id, int32_t value) {
+  if (id < count_) {
+    gauges_[id].store(value, std::memory_order_relaxed);
+  }
+}
+
+int32_t Telemetry::gauge(uint8_t id) const {
+  return id < count_ ? gauges_[id].load(std::memory_order_relaxed) : 0;
+}
+
+void Telemetry::observe(uint8_t id, uint32_t value) {
+  if (id >= count_) {
+    return;
+  }
+  const MetricDef &def = defs_[id];
+  uint8_t bucket = 0;
+  while (bucket < def.bound_count && value > def.bounds[bucket]) {
+    bucket++;
+  }
+  buckets_[id][bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Telemetry::put_u16_(uint16_t v) {
+  put_u8_(v & 0xFF);
+  put_u8_(v >> 8);
+}
+
+void Telemetry::put_u32_(uint32_t v) {
+  put_u16_(v & 0xFFFF);
+  put_u16_(v >> 16);
+}
+
+void Telemetry::put_varint_(uint32_t v) {
+  while (v >= 0x80) {
+    put_u8_((uint8_t) (v | 0x80));
+    v >>= 7;
+  }
+  put_u8_((uint8_t) v);
+}
+
+void Telemetry::put_str_(const char *s) {
+  size_t n = strnlen(s, 255);
+  put_u8_((uint8_t) n);
+  memcpy(buf_ + len_, s, n);
+  len_ += n;
+}
+
+// Worst case, with every varint at its 5-byte maximum
+size_t Telemetry::snapshot_size_() const {
+  size_t size = 5;
+  for (size_t i = 0; i < count_; i++) {
+    size += defs_[i].type == MetricType::HISTOGRAM ? 5 * ((size_t) defs_[i].bound_count + 1) : 5;
+  }
+  return size;
+}
+
+void Telemetry::start_frame_(uint32_t now_ms) {
+  bool schema = seq_ % SCHEMA_EVERY == 0;
+  len_ = 0;
+  put_u8_('I');
+  put_u8_('T');
+  put_u8_('M');
+  put_u8_(VERSION);
+  put_u8_(schema ? 0x01 : 0x00);
+  put_u16_(seq_);
+  put_u32_(device_id_);
+  put_u32_(now_ms);
+  start_ms_ = now_ms;
+
+  if (schema) {
+    put_str_(device_name_);
+    put_u8_((uint8_t) count_);
+    for (size_t i = 0; i < count_; i++) {
+      const MetricDef &def = defs_[i];
+      put_u8_((uint8_t) def.type);
+      put_u8_(def.scale);
+      put_str_(def.name);
+      put_str_(def.unit);
+      if (def.type == MetricType::HISTOGRAM) {
+        put_u8_(def.bound_count);
+        for (uint8_t b = 0; b < def.bound_count; b++) {
+          put_varint_(def.bounds[b]);
+        }
+      }
+    }
+  }
+  count_pos_ = len_;
+  put_u8_(0);
+}
+
+bool Telemetry::snapshot(uint32_t now_ms) {
+  if (count_ == 0) {
+    return false;
+  }
+  if (snapshots_ == 0) {
+    start_frame_(now_ms);
+  }
+  if (len_ + snapshot_size_() > FRAME_SIZE) {
+    return true;
+  }
+
+  put_varint_(now_ms - start_ms_);
+  for (size_t i = 0; i < count_; i++) {
+    switch (defs_[i].type) {
+      case MetricType::COUNTER: {
+        uint32_t value = counters_[i].load(std::memory_order_relaxed);
+        put_varint_(value - last_counters_[i]);
+        last_counters_[i] = value;
+        break;
+      }
+      case MetricType::GAUGE: {
+        int32_t value = gauges_[i].load(std::memory_order_relaxed);
+        put_varint_(((uint32_t) value << 1) ^ (uint32_t) (value >> 31));
+        break;
+      }
+      case MetricType::HISTOGRAM:
+        for (uint8_t b = 0; b <= defs_[i].bound_count; b++) {
+          put_varint_(buckets_[i][b].exchange(0, std::memory_order_relaxed));
+        }
+        break;
+    }
+  }
+  snapshots_++;
+  return snapshots_ == UINT8_MAX || len_ + snapshot_size_() > FRAME_SIZE;
+}
+
+size_t Telemetry::frame(const uint8_t **data) {
+  if (snapshots_ == 0) {
+    return 0;
+  }
+  buf_[count_pos_] = snapshots_;
+  *data = buf_;
+  size_t len = len_;
+  snapshots_ = 0;
+  seq_++;
+  return len;
+}
+
+float Telemetry::estimate_mos(float loss_pct, float rtt_ms, float jitter_ms) {
+  float delay = rtt_ms / 2.0f + 2.0f * jitter_ms;
+  float id = 0.024f * delay + (delay > 177.3f ? 0.11f * (delay - 177.3f) : 0.0f);
+  float ie = loss_pct > 0.0f ? 95.0f * loss_pct / (loss_pct + 4.3f) : 0.0f;
+  float r = 93.2f - id - ie;
+  if (r <= 0.0f) {
+    return 1.0f;
+  }
+  if (r >= 100.0f) {
+    return 4.5f;
+  }
+  return 1.0f + 0.035f * r + 7.0e-6f * r * (r - 60.0f) * (100.0f - r);
+}
+
+}  // namespace intercom
+}  // namespace esphome
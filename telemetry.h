@@ -0,0 +1,108 @@
+/*
+ * Binary Telemetry
+ * Compact, self-describing call quality metrics. Counters, gauges and
+ * histograms are sampled into snapshots, and snapshots are batched into
+ * frames small enough for one UDP datagram or WebSocket binary message.
+ * tools/telemetry_decode.py decodes the frames on Linux.
+ *
+ * Frame layout (little endian, varints are LEB128, gauges zigzag encoded):
+ *
+ *   "ITM" version   4 bytes
+ *   flags           u8   bit 0: schema follows
+ *   seq             u16
+ *   device_id       u32  FNV-1a of the device name
+ *   start_ms        u32  uptime of the first snapshot
+ *   [schema]        device name, u8 metric_count, then per metric: type,
+ *                   scale, name, unit and, for histograms, u8 bound_count
+ *                   and the bucket upper bounds
+ *   snapshot_count  u8
+ *   snapshots       varint ms since start_ms, then one value per metric:
+ *                   counter delta, gauge value, or one count per bucket
+ *
+ * The schema goes in the first frame and every SCHEMA_EVERY frames after,
+ * so a collector that starts late or drops a datagram resynchronizes.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace intercom {
+
+enum class MetricType : uint8_t {
+  COUNTER = 1,    // Monotonic, sent as the increase since the last snapshot
+  GAUGE = 2,      // Last value set
+  HISTOGRAM = 3,  // Observations per bucket since the last snapshot
+};
+
+struct MetricDef {
+  const char *name;
+  MetricType type;
+  const char *unit;
+  uint8_t scale;             // Decimal places: the decoder divides values and bounds by 10^scale
+  const uint32_t *bounds;    // Histogram bucket upper bounds; one more open bucket follows
+  uint8_t bound_count;
+};
+
+class Telemetry {
+ public:
+  static constexpr uint8_t VERSION = 1;
+  static constexpr size_t MAX_METRICS = 16;
+  static constexpr size_t MAX_BUCKETS = 8;
+  static constexpr size_t FRAME_SIZE = 1200;  // Below a typical path MTU
+  static constexpr uint16_t SCHEMA_EVERY = 8;
+
+  // defs must outlive the telemetry object; the index is the metric id
+  bool begin(const MetricDef *defs, size_t count, const char *device_name);
+
+  // Safe from any task: each call is one relaxed atomic operation
+  void add(uint8_t id, uint32_t n = 1);
+  void set(uint8_t id, int32_t value);
+  void observe(uint8_t id, uint32_t value);
+  int32_t gauge(uint8_t id) const;
+
+  // Sample every metric into the open batch. Returns true when the batch is
+  // full and should be sent with frame() before the next snapshot.
+  bool snapshot(uint32_t now_ms);
+  // Close the open batch. Returns its length (0 if it holds no snapshot)
+  // and starts a new one; the data stays valid until the next snapshot().
+  size_t frame(const uint8_t **data);
+
+  uint32_t frames_sent() const { return seq_; }
+
+  // ITU-T G.107 E-model, simplified for narrowband PCM without PLC
+  // (Ie = 0, Bpl = 4.3); jitter is counted as buffering delay
+  static float estimate_mos(float loss_pct, float rtt_ms, float jitter_ms);
+
+ protected:
+  size_t snapshot_size_() const;
+  void start_frame_(uint32_t now_ms);
+  void put_u8_(uint8_t v) { buf_[len_++] = v; }
+  void put_u16_(uint16_t v);
+  void put_u32_(uint32_t v);
+  void put_varint_(uint32_t v);
+  void put_str_(const char *s);
+
+  const MetricDef *defs_{nullptr};
+  size_t count_{0};
+  const char *device_name_{""};
+  uint32_t device_id_{0};
+
+  std::atomic<uint32_t> counters_[MAX_METRICS]{};
+  std::atomic<int32_t> gauges_[MAX_METRICS]{};
+  std::atomic<uint32_t> buckets_[MAX_METRICS][MAX_BUCKETS]{};
+  uint32_t last_counters_[MAX_METRICS]{};
+
+  uint8_t buf_[FRAME_SIZE];
+  size_t len_{0};
+  size_t count_pos_{0};  // Where snapshot_count is patched in
+  uint8_t snapshots_{0};
+  uint32_t start_ms_{0};
+  uint16_t seq_{0};
+};
+
+}  // namespace intercom
+}  // namespace esphome
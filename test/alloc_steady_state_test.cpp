@@ -0,0 +1,351 @@
+/*
+ * Steady-state connected audio must not touch the heap. Every malloc and
+ * free in the process goes through the allocation tracer's hooks (as
+ * CONFIG_HEAP_USE_HOOKS does on the device), and a call is played through
+ * the portable modules the way the device runs them:
+ *
+ *   capture: beamformer, capture pipeline, RED, RTP, pacer, UDP
+ *   receive: UDP, RTP, RED, jitter buffer, drift resampler, mixer,
+ *            render pipeline
+ *   every 5 s: RTCP both ways, bitrate controller, telemetry
+ *
+ * Setup may allocate; the connected phase after it must not, not even
+ * once. A deliberate allocation in a second connected window proves the
+ * hooks see what the code under test would do.
+ */
+
+#include "alloc_trace.h"
+#include "audio_beamformer.h"
+#include "audio_mixer.h"
+#include "audio_pipeline.h"
+#include "audio_stages.h"
+#include "bitrate_controller.h"
+#include "clock_drift.h"
+#include "jitter_buffer.h"
+#include "rtp_red.h"
+#include "rtp_session.h"
+#include "telemetry.h"
+#include "tx_pacer.h"
+#include "udp_socket.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace esphome::intercom;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+// The heap hooks, as ESP-IDF calls them: after the allocation, and after
+// the block went back to the heap
+extern "C" {
+void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps);
+void esp_heap_trace_free_hook(void *ptr);
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+  void *ptr = __libc_malloc(size);
+  esp_heap_trace_alloc_hook(ptr, size, 0);
+  return ptr;
+}
+
+void *calloc(size_t count, size_t size) {
+  void *ptr = __libc_calloc(count, size);
+  esp_heap_trace_alloc_hook(ptr, count * size, 0);
+  return ptr;
+}
+
+void *realloc(void *old, size_t size) {
+  void *ptr = __libc_realloc(old, size);
+  if (ptr != nullptr || size == 0) {
+    esp_heap_trace_free_hook(old);
+  }
+  esp_heap_trace_alloc_hook(ptr, size, 0);
+  return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  void *ptr = __libc_memalign(alignment, size);
+  esp_heap_trace_alloc_hook(ptr, size, 0);
+  return ptr;
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+  *out = __libc_memalign(alignment, size);
+  esp_heap_trace_alloc_hook(*out, size, 0);
+  return *out ? 0 : 12;  // ENOMEM
+}
+
+void free(void *ptr) {
+  __libc_free(ptr);
+  esp_heap_trace_free_hook(ptr);
+}
+}
+
+static constexpr uint32_t SAMPLE_RATE = 16000;
+static constexpr size_t FRAME = 320;  // 20 ms
+static constexpr uint64_t FRAME_US = 20000;
+static constexpr size_t MICS = 2;
+static constexpr uint8_t PAYLOAD_TYPE = 96;
+static constexpr uint8_t RED_PAYLOAD_TYPE = 97;
+static constexpr uint32_t LOOPBACK = 0x7F000001;
+static constexpr uint16_t FIRST_PORT = 47004;
+
+enum { METRIC_PACKETS_TX, METRIC_PACKETS_RX, METRIC_JITTER, METRIC_BITRATE, METRIC_COUNT };
+static const uint32_t JITTER_BOUNDS[] = {5, 10, 20, 40, 80};
+static const MetricDef METRICS[METRIC_COUNT] = {
+    {"packets_tx", MetricType::COUNTER, "", 0, nullptr, 0},
+    {"packets_rx", MetricType::COUNTER, "", 0, nullptr, 0},
+    {"jitter", MetricType::HISTOGRAM, "ms", 0, JITTER_BOUNDS, 5},
+    {"bitrate", MetricType::GAUGE, "kbps", 0, nullptr, 0},
+};
+
+// Everything a call holds, static as on the device
+struct Call {
+  UdpSocket socket;
+  uint16_t port = 0;
+  RtpSession tx, rx;
+  RedEncoder red;
+  TxPacer pacer;
+  JitterBuffer jitter_buffer;
+  DriftEstimator drift;
+  DriftResampler resampler;
+  AudioMixer mixer;
+  BitrateController bitrate;
+  Telemetry telemetry;
+
+  int16_t mic[FRAME * MICS];
+  int16_t mono[FRAME];
+  uint8_t frame[FRAME * sizeof(int16_t)];
+  uint8_t red_payload[RED_MAX_DEPTH * (FRAME * sizeof(int16_t) + 4) + FRAME * sizeof(int16_t) + 1];
+  uint8_t header[RTP_HEADER_SIZE];
+  uint8_t packet[TxPacer::MAX_PACKET];
+  uint8_t rtcp[RTCP_MAX_PACKET_SIZE];
+  int16_t playout[DriftResampler::max_output(FRAME)];
+  int16_t speaker[FRAME];
+  int16_t feed[FRAME];
+  uint32_t sent = 0, received = 0, played = 0;
+};
+
+static Call call;
+
+static bool setup(uint64_t now_us) {
+  for (uint16_t port = FIRST_PORT; port < FIRST_PORT + 16 && call.port == 0; port += 2) {
+    if (call.socket.open(port, 100)) {
+      call.port = port;
+    }
+  }
+  if (call.port == 0) {
+    fprintf(stderr, "no free UDP port from %u\n", (unsigned) FIRST_PORT);
+    return false;
+  }
+  call.tx.begin(0x1234, PAYLOAD_TYPE, SAMPLE_RATE, "panel", now_us);
+  call.rx.begin(0x5678, PAYLOAD_TYPE, SAMPLE_RATE, "peer", now_us);
+  call.red.reset();
+  call.pacer.begin(5000, 2);
+  call.jitter_buffer.reset();
+  call.drift.begin(SAMPLE_RATE, SAMPLE_RATE / 25);
+  call.resampler.begin();
+  call.mixer.reset();
+  call.bitrate.begin(16000, 256000, 48000, (uint32_t) (now_us / 1000));
+  call.telemetry.begin(METRICS, METRIC_COUNT, "panel");
+
+  audio_format_t format = {};
+  format.sample_rate = SAMPLE_RATE;
+  format.channels = 1;
+  format.bits_per_sample = 16;
+  format.frame_ms = 20;
+  format.payload_type = PAYLOAD_TYPE;
+  strcpy(format.encoding, "L16");
+  static const audio_stage_t *const capture[] = {AUDIO_CAPTURE_STAGES nullptr};
+  static const audio_stage_t *const render[] = {AUDIO_RENDER_STAGES nullptr};
+  return beamformer_init(MICS, nullptr) == ESP_OK &&
+         audio_pipeline_build(AUDIO_PIPELINE_CAPTURE, capture, &format) == ESP_OK &&
+         audio_pipeline_build(AUDIO_PIPELINE_RENDER, render, &format) == ESP_OK;
+}
+
+static void receive(uint64_t now_us, bool lose) {
+  uint32_t from_ip;
+  uint16_t from_port;
+  int len = call.socket.receive(call.packet, sizeof(call.packet), &from_ip, &from_port);
+  if (len <= 0 || lose) {
+    return;
+  }
+  size_t offset, payload_len;
+  RtpHeader header;
+  if (!call.rx.on_rtp(call.packet, len, now_us, &offset, &payload_len, &header) || payload_len == 0) {
+    return;
+  }
+  call.received++;
+  const uint8_t *payload = call.packet + offset;
+  if (header.payload_type == RED_PAYLOAD_TYPE) {
+    RedBlock blocks[RED_MAX_DEPTH + 1];
+    size_t count = rtp_red_parse(payload, payload_len, header.timestamp, blocks, RED_MAX_DEPTH + 1);
+    call.jitter_buffer.set_hold(count > 0 ? count - 1 : 0);
+    for (size_t i = 0; i < count; i++) {
+      if (blocks[i].payload_type == PAYLOAD_TYPE) {
+        call.jitter_buffer.put(header.seq - blocks[i].distance, blocks[i].data, blocks[i].len, blocks[i].distance > 0);
+      }
+    }
+  } else {
+    call.jitter_buffer.set_hold(0);
+    call.jitter_buffer.put(header.seq, payload, payload_len, false);
+  }
+  call.telemetry.observe(METRIC_JITTER, (uint32_t) call.rx.stats().jitter_ms);
+  call.telemetry.add(METRIC_PACKETS_RX);
+}
+
+static void render(uint64_t now_us) {
+  uint8_t *frame;
+  size_t frame_len;
+  while (call.jitter_buffer.pop(&frame, &frame_len)) {
+    if (frame_len == 0) {
+      continue;
+    }
+    rtp_l16_swap(frame, frame_len);
+    call.resampler.set_ratio(call.drift.ratio());
+    size_t samples = call.resampler.process(reinterpret_cast<const int16_t *>(frame), frame_len / 2, call.playout);
+    call.drift.on_output(samples, now_us);
+    // The peer and a second leg into the conference mixer; the speaker
+    // clocks it, the leg's encoder feed reads its mix-minus
+    call.mixer.write(1, call.playout, samples);
+    call.mixer.write(2, call.playout, samples);
+    call.mixer.read(AudioMixer::LOCAL_SLOT, call.speaker, FRAME);
+    call.mixer.read(1, call.feed, FRAME);
+    audio_pipeline_process(AUDIO_PIPELINE_RENDER, call.speaker, FRAME, FRAME);
+    call.played++;
+  }
+}
+
+static void step(uint64_t k) {
+  uint64_t now_us = k * FRAME_US;
+
+  // Capture: two mics, beamformed and through the capture pipeline
+  for (size_t i = 0; i < FRAME; i++) {
+    int16_t s = (int16_t) (6000.0f * sinf(6.2831853f * 300.0f * (float) (k * FRAME + i) / SAMPLE_RATE));
+    call.mic[i * MICS] = s;
+    call.mic[i * MICS + 1] = (int16_t) (s + (int16_t) ((k * 7 + i * 13) % 64));
+  }
+  beamformer_process(call.mic, call.mono, FRAME);
+  audio_pipeline_process(AUDIO_PIPELINE_CAPTURE, call.mono, FRAME, FRAME);
+  call.mixer.write(AudioMixer::LOCAL_SLOT, call.mono, FRAME);
+
+  // Send, paced, to ourselves
+  memcpy(call.frame, call.mono, sizeof(call.frame));
+  rtp_l16_swap(call.frame, sizeof(call.frame));
+  const uint8_t *payload = call.frame;
+  size_t payload_len = call.red.encode(PAYLOAD_TYPE, call.frame, sizeof(call.frame), call.tx.timestamp(),
+                                       call.bitrate.decision().fec_depth, call.red_payload, sizeof(call.red_payload));
+  if (payload_len > 0) {
+    payload = call.red_payload;
+  } else {
+    payload_len = sizeof(call.frame);
+  }
+  call.tx.set_payload_type(payload == call.red_payload ? RED_PAYLOAD_TYPE : PAYLOAD_TYPE);
+  call.tx.write_header(call.header, FRAME, payload_len, now_us);
+  call.pacer.push(LOOPBACK, call.port, (uint32_t) FRAME_US, now_us, call.header, sizeof(call.header), payload,
+                  payload_len);
+  call.telemetry.add(METRIC_PACKETS_TX);
+  UdpDatagram due[TxPacer::SLOTS];
+  size_t count = call.pacer.due(now_us + FRAME_US / 2, due, TxPacer::SLOTS);
+  size_t went = call.socket.send_batch(due, count);
+  call.pacer.release(count);
+  call.sent += went;
+
+  // Receive what went out; one packet in 37 is lost on the way
+  for (size_t i = 0; i < went; i++) {
+    receive(now_us + FRAME_US / 2, (call.sent - i) % 37 == 0);
+  }
+  render(now_us + FRAME_US / 2);
+
+  // Reports both ways every 5 s
+  if (k % 250 == 249) {
+    size_t len = call.rx.build_rtcp(call.rtcp, sizeof(call.rtcp), now_us);
+    if (call.tx.on_rtcp(call.rtcp, len, now_us + 1000)) {
+      const RtcpStats &stats = call.tx.stats();
+      call.bitrate.on_report(stats.fraction_lost, stats.rtt_valid, stats.rtt_ms, (uint32_t) (now_us / 1000));
+    }
+    len = call.tx.build_rtcp(call.rtcp, sizeof(call.rtcp), now_us);
+    call.rx.on_rtcp(call.rtcp, len, now_us + 1000);
+    call.telemetry.set(METRIC_BITRATE, (int32_t) (call.bitrate.decision().bitrate_bps / 1000));
+    if (call.telemetry.snapshot((uint32_t) (now_us / 1000))) {
+      const uint8_t *data;
+      call.telemetry.frame(&data);
+    }
+  }
+}
+
+int main() {
+  alloc_phase_stats_t stats[ALLOC_PHASE_COUNT];
+  alloc_trace_watch_current_task();
+  CHECK(alloc_trace_enabled());
+  printf("Steady-state allocations over a simulated call\n");
+
+  // Setup and the first seconds: sockets, RED history, first reports
+  alloc_trace_set_phase(ALLOC_PHASE_SETUP);
+  if (!setup(0)) {
+    return 1;
+  }
+  uint64_t k = 0;
+  for (; k < 500; k++) {
+    step(k);
+  }
+
+  // Ten minutes connected, not one allocation or free
+  alloc_trace_take(stats);
+  alloc_trace_set_phase(ALLOC_PHASE_CONNECTED);
+  uint32_t sent = call.sent, played = call.played;
+  for (; k < 500 + 30000; k++) {
+    step(k);
+  }
+  alloc_trace_set_phase(ALLOC_PHASE_TEARDOWN);
+  call.socket.close();
+  alloc_trace_set_phase(ALLOC_PHASE_IDLE);
+  alloc_trace_take(stats);
+  alloc_trace_log(stats);
+
+  const alloc_phase_stats_t &connected = stats[ALLOC_PHASE_CONNECTED];
+  CHECK(connected.allocs == 0);
+  CHECK(connected.frees == 0);
+  CHECK(connected.audio_allocs == 0);
+  // The call really ran: everything sent was received, lost or recovered,
+  // and frames kept playing
+  CHECK(call.sent - sent >= 29990);
+  CHECK(call.played - played >= 29000);
+  printf("connected: %u packets sent, %u received, %u frames played, %u allocations\n",
+         (unsigned) (call.sent - sent), (unsigned) call.received, (unsigned) (call.played - played),
+         (unsigned) connected.allocs);
+
+  // The hooks see what a careless change would add, e.g. a status string
+  alloc_trace_set_phase(ALLOC_PHASE_CONNECTED);
+  std::string status = "connected";
+  status += " to " + std::to_string(call.port) + " for a while now, with audio";
+  void *block = malloc(64);
+  free(block);
+  alloc_trace_set_phase(ALLOC_PHASE_IDLE);
+  alloc_trace_take(stats);
+  CHECK(stats[ALLOC_PHASE_CONNECTED].allocs >= 2);
+  CHECK(stats[ALLOC_PHASE_CONNECTED].audio_allocs == stats[ALLOC_PHASE_CONNECTED].allocs);
+  CHECK(stats[ALLOC_PHASE_CONNECTED].peak_bytes >= 64);
+
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("alloc_steady_state: all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,271 @@
+/*
+ * Audio DSP Kernel Checks
+ *
+ * Bit-exactness of each kernel against its scalar reference, and cycles
+ * per sample of both. Built by the host test target with the cycle counter
+ * shim in stubs/, so it costs the firmware neither boot time nor flash.
+ */
+
+#include "audio_dsp_check.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "audio_dsp";
+
+#define CHECK_SAMPLES 1024
+#define FIR_TAPS 31                 // Odd, to exercise the SIMD tap tail
+#define BENCH_SAMPLES 320           // 20 ms at 16 kHz
+#define BENCH_RUNS 8
+
+typedef struct {
+    int16_t a[CHECK_SAMPLES + FIR_TAPS + 8];
+    int16_t b[CHECK_SAMPLES + 8];
+    int16_t out[CHECK_SAMPLES + 8];
+    int16_t ref[CHECK_SAMPLES + 8];
+    float fa[CHECK_SAMPLES + 8];
+    float fout[CHECK_SAMPLES + 8];
+    float fref[CHECK_SAMPLES + 8];
+    int16_t coeffs[FIR_TAPS];
+} scratch_t;
+
+static const char *const KERNEL_NAMES[AUDIO_DSP_KERNELS] = {
+    "gain", "mix", "fir", "biquad", "s16_to_f32", "f32_to_s16", "peak", "energy",
+};
+
+// Lengths around the 8-sample vector width, and a full frame
+static const size_t LENGTHS[] = {0, 1, 7, 8, 9, 15, 17, 320, CHECK_SAMPLES};
+
+// 2nd-order Butterworth low-pass at 0.1 fs
+static const float BIQUAD[5] = {0.0674553f, 0.1349106f, 0.0674553f, -1.1429805f, 0.4128016f};
+
+static uint32_t s_seed;
+
+static uint32_t next_random(void)
+{
+    // xorshift32
+    s_seed ^= s_seed << 13;
+    s_seed ^= s_seed >> 17;
+    s_seed ^= s_seed << 5;
+    return s_seed;
+}
+
+// Random samples with full-scale extremes mixed in
+static void fill_s16(int16_t *x, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        uint32_t r = next_random();
+        switch (r & 15) {
+            case 0:
+                x[i] = INT16_MIN;
+                break;
+            case 1:
+                x[i] = INT16_MAX;
+                break;
+            default:
+                x[i] = (int16_t)(r >> 16);
+                break;
+        }
+    }
+}
+
+// Spans past full scale both ways, plus exact rounding midpoints
+static void fill_f32(float *x, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        uint32_t r = next_random();
+        if ((r & 7) == 0) {
+            x[i] = ((float)(int16_t)(r >> 16) + 0.5f) / 32768.0f;
+        } else {
+            x[i] = ((float)(int32_t)r / 2147483648.0f) * 1.25f;
+        }
+    }
+}
+
+// Scale random taps so their absolute sum is exactly at the 1.0 limit
+static void fill_coeffs(int16_t *h, size_t taps)
+{
+    int32_t sum = 0;
+    for (size_t k = 0; k < taps; k++) {
+        h[k] = (int16_t)(next_random() >> 16);
+        sum += abs(h[k]);
+    }
+    for (size_t k = 0; k < taps; k++) {
+        h[k] = (int16_t)((int64_t)h[k] * 32768 / (sum ? sum : 1));
+    }
+}
+
+static bool mismatch(const char *kernel, size_t n, size_t offset)
+{
+    ESP_LOGE(TAG, "%s (%s) differs from reference: %u samples at offset %u", kernel, audio_dsp_backend(),
+             (unsigned)n, (unsigned)offset);
+    return false;
+}
+
+static bool check_length(scratch_t *s, size_t n, size_t offset)
+{
+    static const int16_t GAINS[] = {0, AUDIO_DSP_GAIN_UNITY, INT16_MAX, INT16_MIN, -AUDIO_DSP_GAIN_UNITY / 3};
+    const int16_t *a = s->a + FIR_TAPS + offset;
+    const int16_t *b = s->b + offset;
+    const float *fa = s->fa + offset;
+    const size_t bytes = n * sizeof(int16_t);
+
+    for (size_t g = 0; g < sizeof(GAINS) / sizeof(GAINS[0]); g++) {
+        audio_dsp_gain_s16(a, s->out, n, GAINS[g]);
+        audio_dsp_gain_s16_ref(a, s->ref, n, GAINS[g]);
+        if (memcmp(s->out, s->ref, bytes) != 0) {
+            return mismatch("gain", n, offset);
+        }
+    }
+
+    memcpy(s->out, a, bytes);
+    memcpy(s->ref, a, bytes);
+    audio_dsp_mix_s16(s->out, b, n);
+    audio_dsp_mix_s16_ref(s->ref, b, n);
+    if (memcmp(s->out, s->ref, bytes) != 0) {
+        return mismatch("mix", n, offset);
+    }
+
+    for (size_t taps = 1; taps <= FIR_TAPS; taps += 5) {
+        fill_coeffs(s->coeffs, taps);
+        audio_dsp_fir_s16(a, s->out, n, s->coeffs, taps);
+        audio_dsp_fir_s16_ref(a, s->ref, n, s->coeffs, taps);
+        if (memcmp(s->out, s->ref, bytes) != 0) {
+            return mismatch("fir", n, offset);
+        }
+    }
+
+    // Backends may round differently in the last bit, and a recursive
+    // filter carries that along; 1e-5 of full scale is far below 16 bits
+    float w[2] = {0};
+    float w_ref[2] = {0};
+    audio_dsp_biquad_f32(fa, s->fout, n, BIQUAD, w);
+    audio_dsp_biquad_f32_ref(fa, s->fref, n, BIQUAD, w_ref);
+    for (size_t i = 0; i < n; i++) {
+        if (fabsf(s->fout[i] - s->fref[i]) > 1e-5f) {
+            return mismatch("biquad", n, offset);
+        }
+    }
+
+    audio_dsp_s16_to_f32(a, s->fout, n);
+    audio_dsp_s16_to_f32_ref(a, s->fref, n);
+    if (memcmp(s->fout, s->fref, n * sizeof(float)) != 0) {
+        return mismatch("s16_to_f32", n, offset);
+    }
+
+    audio_dsp_f32_to_s16(fa, s->out, n);
+    audio_dsp_f32_to_s16_ref(fa, s->ref, n);
+    if (memcmp(s->out, s->ref, bytes) != 0) {
+        return mismatch("f32_to_s16", n, offset);
+    }
+
+    if (audio_dsp_peak_s16(a, n) != audio_dsp_peak_s16_ref(a, n)) {
+        return mismatch("peak", n, offset);
+    }
+    if (audio_dsp_energy_s16(a, n) != audio_dsp_energy_s16_ref(a, n)) {
+        return mismatch("energy", n, offset);
+    }
+    return true;
+}
+
+esp_err_t audio_dsp_verify(void)
+{
+    scratch_t *s = malloc(sizeof(scratch_t));
+    if (!s) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_seed = 0x12345678;
+    fill_s16(s->a, sizeof(s->a) / sizeof(s->a[0]));
+    fill_s16(s->b, sizeof(s->b) / sizeof(s->b[0]));
+    fill_f32(s->fa, sizeof(s->fa) / sizeof(s->fa[0]));
+
+    esp_err_t ret = ESP_OK;
+    for (size_t l = 0; l < sizeof(LENGTHS) / sizeof(LENGTHS[0]) && ret == ESP_OK; l++) {
+        size_t n = LENGTHS[l];
+        // Aligned and one sample off, for the unaligned loads
+        for (size_t offset = 0; offset < 2; offset++) {
+            if (!check_length(s, n, offset)) {
+                ret = ESP_FAIL;
+                break;
+            }
+        }
+    }
+    free(s);
+    return ret;
+}
+
+// Best of BENCH_RUNS, so an interrupt in one run does not count
+#define TIME_KERNEL(result, call)                                   \
+    do {                                                            \
+        uint32_t best = UINT32_MAX;                                 \
+        for (int run = 0; run < BENCH_RUNS; run++) {                \
+            uint32_t start = esp_cpu_get_cycle_count();             \
+            call;                                                   \
+            uint32_t cycles = esp_cpu_get_cycle_count() - start;    \
+            best = cycles < best ? cycles : best;                   \
+        }                                                           \
+        (result) = (float)best / BENCH_SAMPLES;                     \
+    } while (0)
+
+// Results of the reductions go here so the calls are not optimised out
+static volatile uint64_t s_sink;
+
+static void bench_kernels(scratch_t *s, bool ref, float *cycles)
+{
+    const int16_t *a = s->a + FIR_TAPS;
+    float w[2] = {0};
+    const size_t n = BENCH_SAMPLES;
+
+    if (ref) {
+        TIME_KERNEL(cycles[0], audio_dsp_gain_s16_ref(a, s->out, n, AUDIO_DSP_GAIN_UNITY / 2));
+        TIME_KERNEL(cycles[1], audio_dsp_mix_s16_ref(s->out, s->b, n));
+        TIME_KERNEL(cycles[2], audio_dsp_fir_s16_ref(a, s->out, n, s->coeffs, FIR_TAPS));
+        TIME_KERNEL(cycles[3], audio_dsp_biquad_f32_ref(s->fa, s->fout, n, BIQUAD, w));
+        TIME_KERNEL(cycles[4], audio_dsp_s16_to_f32_ref(a, s->fout, n));
+        TIME_KERNEL(cycles[5], audio_dsp_f32_to_s16_ref(s->fa, s->out, n));
+        TIME_KERNEL(cycles[6], s_sink = audio_dsp_peak_s16_ref(a, n));
+        TIME_KERNEL(cycles[7], s_sink = audio_dsp_energy_s16_ref(a, n));
+    } else {
+        TIME_KERNEL(cycles[0], audio_dsp_gain_s16(a, s->out, n, AUDIO_DSP_GAIN_UNITY / 2));
+        TIME_KERNEL(cycles[1], audio_dsp_mix_s16(s->out, s->b, n));
+        TIME_KERNEL(cycles[2], audio_dsp_fir_s16(a, s->out, n, s->coeffs, FIR_TAPS));
+        TIME_KERNEL(cycles[3], audio_dsp_biquad_f32(s->fa, s->fout, n, BIQUAD, w));
+        TIME_KERNEL(cycles[4], audio_dsp_s16_to_f32(a, s->fout, n));
+        TIME_KERNEL(cycles[5], audio_dsp_f32_to_s16(s->fa, s->out, n));
+        TIME_KERNEL(cycles[6], s_sink = audio_dsp_peak_s16(a, n));
+        TIME_KERNEL(cycles[7], s_sink = audio_dsp_energy_s16(a, n));
+    }
+}
+
+esp_err_t audio_dsp_benchmark(audio_dsp_bench_t *bench)
+{
+    if (!bench) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    scratch_t *s = malloc(sizeof(scratch_t));
+    if (!s) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_seed = 0x9e3779b9;
+    fill_s16(s->a, sizeof(s->a) / sizeof(s->a[0]));
+    fill_s16(s->b, sizeof(s->b) / sizeof(s->b[0]));
+    fill_f32(s->fa, sizeof(s->fa) / sizeof(s->fa[0]));
+    fill_coeffs(s->coeffs, FIR_TAPS);
+
+    float opt[AUDIO_DSP_KERNELS];
+    float ref[AUDIO_DSP_KERNELS];
+    bench_kernels(s, false, opt);
+    bench_kernels(s, true, ref);
+
+    bench->backend = audio_dsp_backend();
+    for (size_t k = 0; k < AUDIO_DSP_KERNELS; k++) {
+        bench->kernels[k].name = KERNEL_NAMES[k];
+        bench->kernels[k].cycles_per_sample = opt[k];
+        bench->kernels[k].ref_cycles_per_sample = ref[k];
+    }
+    free(s);
+    return ESP_OK;
+}
@@ -0,0 +1,180 @@
+/*
+ * Beamformer against the multichannel WAV fixtures: SNR gain per scene,
+ * steered and unsteered, the array gain the module reports against the
+ * measured one, block-size independence, and cost per 20 ms frame for the
+ * de-interleave and delay-and-sum steps (nanoseconds on the host)
+ */
+
+#include "audio_beamformer.h"
+#include "beamformer_fixtures.h"
+#include "wav_io.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME 320  // 20 ms at 16 kHz, what the capture task hands over
+
+static int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+static double power(const int16_t *x, size_t n, size_t stride)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sum += (double)x[i * stride] * x[i * stride];
+    }
+    return sum / n;
+}
+
+// Mean power over the channels of an interleaved recording
+static double mean_power(const wav_t *wav)
+{
+    double sum = 0.0;
+    for (size_t ch = 0; ch < wav->channels; ch++) {
+        sum += power(wav->samples + ch, wav->frames, wav->channels);
+    }
+    return sum / wav->channels;
+}
+
+// Beamforms the whole recording in blocks of `block` frames into out
+static void run(const wav_t *wav, const uint8_t *delays, size_t block, int16_t *out, beamformer_stats_t *stats)
+{
+    CHECK(beamformer_init(wav->channels, delays) == ESP_OK);
+    for (size_t at = 0; at < wav->frames; at += block) {
+        size_t n = wav->frames - at < block ? wav->frames - at : block;
+        CHECK(beamformer_process(wav->samples + at * wav->channels, out + at, n) == ESP_OK);
+    }
+    beamformer_get_stats(stats);
+}
+
+static int load(const char *dir, const fixture_scene_t *scene, const char *kind, wav_t *wav)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s_%s.wav", dir, scene->name, kind);
+    if (wav_read(path, wav) != 0) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return -1;
+    }
+    if (wav->channels != scene->channels || wav->sample_rate != FIXTURE_SAMPLE_RATE) {
+        fprintf(stderr, "%s: %u channels at %u Hz, expected %u at %u\n", path, (unsigned)wav->channels,
+                (unsigned)wav->sample_rate, (unsigned)scene->channels, (unsigned)FIXTURE_SAMPLE_RATE);
+        return -1;
+    }
+    return 0;
+}
+
+static void bench_scene(const char *dir, const fixture_scene_t *scene)
+{
+    wav_t talker, noise;
+    if (scene->channels > BEAMFORMER_MAX_CHANNELS) {
+        fprintf(stderr, "%s: more mics than the beamformer takes\n", scene->name);
+        failures++;
+        return;
+    }
+    if (load(dir, scene, "talker", &talker) != 0 || load(dir, scene, "noise", &noise) != 0) {
+        failures++;
+        return;
+    }
+    size_t frames = talker.frames < noise.frames ? talker.frames : noise.frames;
+    talker.frames = noise.frames = frames;
+    int16_t *out_talker = malloc(frames * sizeof(int16_t));
+    int16_t *out_noise = malloc(frames * sizeof(int16_t));
+    int16_t *out_other = malloc(frames * sizeof(int16_t));
+
+    // Delay the early mics so the talker lines up with the latest one
+    uint8_t delays[BEAMFORMER_MAX_CHANNELS] = {0};
+    uint8_t latest = 0;
+    for (size_t ch = 0; ch < scene->channels; ch++) {
+        latest = scene->arrival[ch] > latest ? scene->arrival[ch] : latest;
+    }
+    for (size_t ch = 0; ch < scene->channels; ch++) {
+        delays[ch] = (uint8_t)(latest - scene->arrival[ch]);
+    }
+
+    double in_snr = 10.0 * log10(mean_power(&talker) / mean_power(&noise));
+    double ideal = 10.0 * log10((double)scene->channels);
+    beamformer_stats_t talker_stats, noise_stats;
+
+    // Steered
+    run(&talker, delays, FRAME, out_talker, &talker_stats);
+    run(&noise, delays, FRAME, out_noise, &noise_stats);
+    double noise_drop = 10.0 * log10(mean_power(&noise) / power(out_noise, frames, 1));
+    double steered = 10.0 * log10(power(out_talker, frames, 1) / power(out_noise, frames, 1)) - in_snr;
+    uint32_t deinterleave_ns = noise_stats.avg_deinterleave_cycles;
+    uint32_t beamform_ns = noise_stats.avg_beamform_cycles;
+
+    // The talker sums coherently and the noise does not
+    CHECK(steered > ideal - 0.5);
+    CHECK(fabs(talker_stats.array_gain_db) < 0.2);
+    // What the module reports on noise alone is the measured noise drop
+    CHECK(fabs(noise_stats.array_gain_db - noise_drop) < 0.05);
+
+    // The block size the capture task happens to use must not matter
+    const size_t blocks[] = {1, 160, BEAMFORMER_MAX_FRAMES};
+    beamformer_stats_t other_stats;
+    for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+        run(&talker, delays, blocks[b], out_other, &other_stats);
+        CHECK(memcmp(out_other, out_talker, frames * sizeof(int16_t)) == 0);
+    }
+
+    // Unsteered: an off-axis talker no longer adds up in phase. At a few
+    // samples of offset only its upper harmonics suffer, so the loss is
+    // small but must be there.
+    run(&talker, NULL, FRAME, out_other, &other_stats);
+    double unsteered = 10.0 * log10(power(out_other, frames, 1) / power(out_noise, frames, 1)) - in_snr;
+    if (latest > 0) {
+        CHECK(unsteered < steered - 0.1);
+    } else {
+        CHECK(memcmp(out_other, out_talker, frames * sizeof(int16_t)) == 0);
+    }
+
+    printf("  %-14s %u mics  input SNR %5.1f dB  gain %4.2f dB steered (ideal %4.2f), %5.2f dB unsteered"
+           "  %5u + %5u ns/frame (%.3f%% of real time)\n",
+           scene->name, (unsigned)scene->channels, in_snr, steered, ideal, unsteered, (unsigned)deinterleave_ns,
+           (unsigned)beamform_ns, 100.0 * (deinterleave_ns + beamform_ns) / (FRAME * 1e9 / FIXTURE_SAMPLE_RATE));
+
+    free(out_talker);
+    free(out_noise);
+    free(out_other);
+    free(talker.samples);
+    free(noise.samples);
+}
+
+static void test_arguments(void)
+{
+    const uint8_t too_far[2] = {0, BEAMFORMER_MAX_DELAY + 1};
+    CHECK(beamformer_init(0, NULL) == ESP_ERR_INVALID_ARG);
+    CHECK(beamformer_init(BEAMFORMER_MAX_CHANNELS + 1, NULL) == ESP_ERR_INVALID_ARG);
+    CHECK(beamformer_init(2, too_far) == ESP_ERR_INVALID_ARG);
+    CHECK(beamformer_init(2, NULL) == ESP_OK);
+    static int16_t in[(BEAMFORMER_MAX_FRAMES + 1) * 2], out[BEAMFORMER_MAX_FRAMES + 1];
+    CHECK(beamformer_process(in, out, BEAMFORMER_MAX_FRAMES + 1) == ESP_ERR_INVALID_SIZE);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <fixture directory>\n", argv[0]);
+        return 2;
+    }
+    test_arguments();
+    printf("Delay-and-sum beamformer, %u-frame blocks\n", (unsigned)FRAME);
+    for (size_t s = 0; s < FIXTURE_SCENE_COUNT; s++) {
+        bench_scene(argv[1], &FIXTURE_SCENES[s]);
+    }
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("beamformer: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * Writes the beamformer fixture scenes as multichannel WAV files into the
+ * directory given: <scene>_talker.wav and <scene>_noise.wav for each scene
+ * in beamformer_fixtures.h. Deterministic, so every build gets the same
+ * files.
+ */
+
+#include "beamformer_fixtures.h"
+#include "wav_io.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FRAMES (FIXTURE_SAMPLE_RATE * FIXTURE_SECONDS)
+#define LEAD 8  // Talker history before the first sample, covers the largest arrival delay
+
+// Voiced, speech-like source: harmonics under 3.8 kHz of a pitch gliding
+// between 110 and 220 Hz, in syllables of about 4 Hz with short pauses
+static void make_talker(float *out, size_t frames)
+{
+    double phase = 0.0;
+    for (size_t n = 0; n < frames; n++) {
+        double t = (double)n / FIXTURE_SAMPLE_RATE;
+        double f0 = 165.0 + 55.0 * sin(2.0 * M_PI * 0.7 * t);
+        phase += 2.0 * M_PI * f0 / FIXTURE_SAMPLE_RATE;
+        double syllable = sin(2.0 * M_PI * 4.0 * t);
+        double envelope = syllable > 0.0 ? syllable : 0.0;
+        double v = 0.0;
+        for (int k = 1; k * f0 < 3800.0; k++) {
+            v += sin(k * phase) / k;
+        }
+        out[n] = (float)(6000.0 * envelope * v);
+    }
+}
+
+static uint32_t xorshift(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// Roughly Gaussian, gently low-passed like room noise
+static void make_noise(int16_t *out, size_t frames, size_t stride, uint32_t seed)
+{
+    uint32_t state = seed;
+    float y = 0.0f;
+    for (size_t n = 0; n < frames; n++) {
+        float x = 0.0f;
+        for (int i = 0; i < 4; i++) {
+            x += (float)(xorshift(&state) >> 8) / 16777216.0f - 0.5f;
+        }
+        y = 0.5f * y + 0.5f * x;
+        out[n * stride] = (int16_t)lrintf(6000.0f * y);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <output directory>\n", argv[0]);
+        return 2;
+    }
+    static float talker[LEAD + FRAMES];
+    static int16_t buffer[FRAMES * 4];
+    make_talker(talker, LEAD + FRAMES);
+
+    char path[512];
+    for (size_t s = 0; s < FIXTURE_SCENE_COUNT; s++) {
+        const fixture_scene_t *scene = &FIXTURE_SCENES[s];
+        size_t ch_count = scene->channels;
+
+        for (size_t ch = 0; ch < ch_count; ch++) {
+            for (size_t n = 0; n < FRAMES; n++) {
+                buffer[n * ch_count + ch] = (int16_t)lrintf(talker[LEAD + n - scene->arrival[ch]]);
+            }
+        }
+        snprintf(path, sizeof(path), "%s/%s_talker.wav", argv[1], scene->name);
+        if (wav_write(path, buffer, FRAMES, scene->channels, FIXTURE_SAMPLE_RATE) != 0) {
+            fprintf(stderr, "cannot write %s\n", path);
+            return 1;
+        }
+
+        for (size_t ch = 0; ch < ch_count; ch++) {
+            make_noise(buffer + ch, FRAMES, ch_count, 0x9E3779B9u * (uint32_t)(s * 4 + ch + 1));
+        }
+        snprintf(path, sizeof(path), "%s/%s_noise.wav", argv[1], scene->name);
+        if (wav_write(path, buffer, FRAMES, scene->channels, FIXTURE_SAMPLE_RATE) != 0) {
+            fprintf(stderr, "cannot write %s\n", path);
+            return 1;
+        }
+    }
+    return 0;
+}
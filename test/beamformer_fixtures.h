@@ -0,0 +1,28 @@
+/*
+ * Beamformer fixture scenes, shared by the generator and the benchmark.
+ * Each scene is two multichannel WAV files at 16 kHz: the talker alone,
+ * arriving at each mic a whole number of samples after the first, and
+ * the noise alone, independent at each mic. The beamformer is linear, so
+ * running the two through it separately gives its output SNR exactly.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FIXTURE_SAMPLE_RATE 16000
+#define FIXTURE_SECONDS 4
+
+typedef struct {
+    const char *name;
+    uint16_t channels;
+    uint8_t arrival[4];  // Talker's delay at each mic, samples
+} fixture_scene_t;
+
+static const fixture_scene_t FIXTURE_SCENES[] = {
+    {"broadside_2ch", 2, {0, 0}},        // Two-mic panel, talker straight in front
+    {"offaxis_2ch", 2, {0, 3}},          // Talker to the side: MIC2 hears it 3 samples late
+    {"offaxis_4ch", 4, {0, 1, 2, 3}},    // Four mics in a line, talker at an angle
+};
+#define FIXTURE_SCENE_COUNT (sizeof(FIXTURE_SCENES) / sizeof(FIXTURE_SCENES[0]))
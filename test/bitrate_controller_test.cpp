@@ -0,0 +1,204 @@
+/*
+ * Bitrate controller against simulated bandwidth traces: a bottleneck with
+ * a drop-tail queue turns the chosen rate into RTCP loss and RTT, and the
+ * controller has to follow capacity steps without standing loss or a
+ * full queue. Also checks the RSSI and FEC hysteresis.
+ */
+
+#include "bitrate_controller.h"
+
+#include <cstdio>
+
+using namespace esphome::intercom;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+static constexpr uint32_t MIN_BPS = 16000;
+static constexpr uint32_t MAX_BPS = 128000;
+static constexpr uint32_t WEAK_MAX_BPS = 48000;
+
+struct Phase {
+  uint32_t seconds;
+  float capacity_bps;
+};
+
+// Drop-tail bottleneck: ticks of 10 ms, RTCP reports every 5 s as
+// RtpSession sends them
+struct Link {
+  static constexpr uint32_t TICK_MS = 10;
+  static constexpr uint32_t REPORT_MS = 5000;
+  static constexpr float BASE_RTT_MS = 40.0f;
+  static constexpr float QUEUE_LIMIT_MS = 400.0f;
+
+  float queue_bits = 0.0f;
+  float sent_bits = 0.0f;
+  float dropped_bits = 0.0f;
+};
+
+struct PhaseResult {
+  float mean_rate_bps;  // Second half of the phase
+  float loss;           // Second half of the phase
+  float max_queue_ms;   // Second half of the phase
+};
+
+static void run_trace(const char *name, const Phase *phases, size_t count, PhaseResult *results) {
+  BitrateController controller;
+  Link link;
+  uint32_t now_ms = 0;
+  controller.begin(MIN_BPS, MAX_BPS, WEAK_MAX_BPS, now_ms);
+  printf("%s\n", name);
+
+  for (size_t p = 0; p < count; p++) {
+    const Phase &phase = phases[p];
+    double rate_sum = 0.0, sent = 0.0, dropped = 0.0;
+    uint32_t samples = 0;
+    float max_queue_ms = 0.0f;
+    uint32_t phase_end = now_ms + phase.seconds * 1000;
+    uint32_t half = now_ms + phase.seconds * 500;
+    while (now_ms < phase_end) {
+      now_ms += Link::TICK_MS;
+      float rate = (float) controller.decision().bitrate_bps;
+      float in = rate * Link::TICK_MS / 1000.0f;
+      float limit = phase.capacity_bps * Link::QUEUE_LIMIT_MS / 1000.0f;
+      link.queue_bits += in;
+      link.sent_bits += in;
+      if (link.queue_bits > limit) {
+        link.dropped_bits += link.queue_bits - limit;
+        if (now_ms > half) {
+          dropped += link.queue_bits - limit;
+        }
+        link.queue_bits = limit;
+      }
+      link.queue_bits -= phase.capacity_bps * Link::TICK_MS / 1000.0f;
+      if (link.queue_bits < 0.0f) {
+        link.queue_bits = 0.0f;
+      }
+      float queue_ms = link.queue_bits * 1000.0f / phase.capacity_bps;
+      if (now_ms > half) {
+        rate_sum += rate;
+        sent += in;
+        samples++;
+        if (queue_ms > max_queue_ms) {
+          max_queue_ms = queue_ms;
+        }
+      }
+
+      if (now_ms % Link::REPORT_MS == 0) {
+        float loss = link.sent_bits > 0.0f ? link.dropped_bits / link.sent_bits : 0.0f;
+        uint8_t fraction = (uint8_t) (loss * 256.0f > 255.0f ? 255.0f : loss * 256.0f);
+        controller.on_report(fraction, true, Link::BASE_RTT_MS + queue_ms, now_ms);
+        link.sent_bits = 0.0f;
+        link.dropped_bits = 0.0f;
+      }
+    }
+    results[p].mean_rate_bps = (float) (rate_sum / samples);
+    results[p].loss = sent > 0.0 ? (float) (dropped / sent) : 0.0f;
+    results[p].max_queue_ms = max_queue_ms;
+    printf("  capacity %6.0f bps for %3u s: rate %6.0f bps (%3.0f%%), loss %4.1f%%, queue up to %3.0f ms\n",
+           phase.capacity_bps, (unsigned) phase.seconds, results[p].mean_rate_bps,
+           100.0f * results[p].mean_rate_bps / phase.capacity_bps, 100.0f * results[p].loss,
+           results[p].max_queue_ms);
+  }
+}
+
+static void test_capacity_steps() {
+  // Plenty, then a neighbour starts streaming, then it stops again
+  const Phase phases[] = {{120, 200000}, {180, 40000}, {240, 100000}};
+  PhaseResult results[3];
+  run_trace("capacity steps", phases, 3, results);
+  // Free link: sits at the configured maximum
+  CHECK(results[0].mean_rate_bps >= MAX_BPS * 0.95f);
+  CHECK(results[0].loss < 0.001f);
+  // Squeezed: below capacity, little loss and no standing queue once settled
+  CHECK(results[1].mean_rate_bps <= phases[1].capacity_bps);
+  CHECK(results[1].mean_rate_bps >= phases[1].capacity_bps * 0.5f);
+  CHECK(results[1].loss < 0.02f);
+  CHECK(results[1].max_queue_ms < Link::QUEUE_LIMIT_MS);
+  // Freed again: climbs back to use most of the new capacity
+  CHECK(results[2].mean_rate_bps >= phases[2].capacity_bps * 0.6f);
+  CHECK(results[2].loss < 0.02f);
+}
+
+static void test_slow_squeeze() {
+  // Capacity shrinks in steps a little under the current rate each time
+  const Phase phases[] = {{60, 150000}, {90, 96000}, {90, 64000}, {90, 32000}};
+  PhaseResult results[4];
+  run_trace("slow squeeze", phases, 4, results);
+  for (size_t p = 1; p < 4; p++) {
+    CHECK(results[p].mean_rate_bps <= phases[p].capacity_bps);
+    CHECK(results[p].loss < 0.03f);
+  }
+}
+
+static void test_weak_signal() {
+  BitrateController controller;
+  controller.begin(MIN_BPS, MAX_BPS, WEAK_MAX_BPS, 0);
+  CHECK(controller.decision().bitrate_bps == MAX_BPS);
+  CHECK(controller.decision().ptime_ms == 20);
+
+  CHECK(controller.on_rssi(-80, 1000));
+  const BitrateDecision &weak = controller.decision();
+  CHECK(weak.weak_signal);
+  CHECK(weak.bitrate_bps <= WEAK_MAX_BPS);
+  CHECK(weak.ptime_ms >= 40);
+  CHECK(weak.fec_depth >= 1);
+  CHECK(weak.encoder_bps == weak.bitrate_bps / (1 + weak.fec_depth));
+
+  // Between the two thresholds nothing changes; above the exit it recovers
+  CHECK(!controller.on_rssi(-72, 2000));
+  CHECK(controller.decision().weak_signal);
+  controller.on_rssi(-65, 3000);
+  CHECK(!controller.decision().weak_signal);
+  // The cap lifts, but growth still waits out the hold after the decrease
+  controller.on_report(0, false, 0.0f, 5000);
+  CHECK(controller.decision().bitrate_bps <= WEAK_MAX_BPS);
+  uint32_t now = 5000;
+  for (int i = 0; i < 40; i++) {
+    now += 5000;
+    controller.on_report(0, false, 0.0f, now);
+  }
+  CHECK(controller.decision().bitrate_bps == MAX_BPS);
+}
+
+static void test_fec_hysteresis() {
+  BitrateController controller;
+  controller.begin(MIN_BPS, MAX_BPS, WEAK_MAX_BPS, 0);
+  uint32_t now = 0;
+  auto report = [&](float loss) {
+    now += 5000;
+    controller.on_report((uint8_t) (loss * 256.0f), false, 0.0f, now);
+    return controller.decision().fec_depth;
+  };
+  CHECK(report(0.0f) == 0);
+  CHECK(report(0.04f) == 1);   // Enters at 3%
+  CHECK(report(0.02f) == 1);   // Holds above the 1% exit
+  CHECK(report(0.12f) == 2);   // Enters at 10%
+  CHECK(report(0.06f) == 2);   // Holds above the 5% exit
+  CHECK(report(0.02f) == 2);   // Below the exit: three reports in a row...
+  CHECK(report(0.02f) == 2);
+  CHECK(report(0.02f) == 1);   // ...before it steps down
+  CHECK(report(0.0f) == 1);
+  CHECK(report(0.0f) == 1);
+  CHECK(report(0.0f) == 0);
+}
+
+int main() {
+  test_capacity_steps();
+  test_slow_squeeze();
+  test_weak_signal();
+  test_fec_hysteresis();
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("bitrate_controller: all checks passed\n");
+  return 0;
+}
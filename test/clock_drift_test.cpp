@@ -0,0 +1,213 @@
+/*
+ * Clock drift compensation under simulated clock offsets: a remote whose
+ * crystal runs some ppm off ours sends 20 ms frames, with or without
+ * network jitter, and the receive side resamples each one and writes it to
+ * a speaker queue drained by our sample clock, as the component does. The
+ * queue must stay level without running dry and the estimate must settle
+ * on the offset. Also checks the resampler's fidelity and that changing
+ * the ratio between blocks does not click.
+ */
+
+#include "clock_drift.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace esphome::intercom;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+static constexpr uint32_t SAMPLE_RATE = 16000;
+static constexpr size_t FRAME = 320;                     // 20 ms
+static constexpr uint32_t TARGET_FILL = SAMPLE_RATE / 25;  // 40 ms, as the component
+static constexpr uint32_t CALL_S = 600;
+static constexpr uint32_t SETTLED_S = 400;  // Checked from here on
+
+struct CallResult {
+  float drift_ppm;
+  int64_t min_fill;  // Real queue depth after settling, in samples
+  int64_t max_fill;
+  uint32_t underruns;
+};
+
+// A tone, so the resampler has something to do
+static void make_frame(uint64_t first, int16_t *frame) {
+  for (size_t i = 0; i < FRAME; i++) {
+    frame[i] = (int16_t) (8000.0 * sin(2.0 * M_PI * 440.0 * (first + i) / SAMPLE_RATE));
+  }
+}
+
+static CallResult run_call(float offset_ppm, uint32_t jitter_ms) {
+  static DriftEstimator drift;
+  static DriftResampler resampler;
+  drift.begin(SAMPLE_RATE, TARGET_FILL);
+  resampler.begin();
+  int16_t frame[FRAME];
+  int16_t out[DriftResampler::max_output(FRAME)];
+  srand(11);
+
+  // The remote sends a frame every 20 ms of its own clock. Frames leave
+  // the jitter buffer in order, so one delayed frame holds up the next.
+  const double period_us = 20000.0 / (1.0 + offset_ppm * 1e-6);
+  const uint64_t frames = (uint64_t) (CALL_S * 1e6 / period_us);
+  // The real queue, independent of the estimator's model of it
+  uint64_t queue_start_us = 0;
+  int64_t queued = 0;
+  CallResult result{0.0f, INT64_MAX, INT64_MIN, 0};
+  uint64_t last_us = 0;
+  for (uint64_t k = 0; k < frames; k++) {
+    uint64_t now_us = (uint64_t) (k * period_us) + 50000;
+    if (jitter_ms > 0) {
+      now_us += (uint64_t) (rand() % (jitter_ms * 1000));
+    }
+    if (now_us < last_us) {
+      now_us = last_us;
+    }
+    last_us = now_us;
+
+    make_frame(k * FRAME, frame);
+    resampler.set_ratio(drift.ratio());
+    size_t samples = resampler.process(frame, FRAME, out);
+
+    if (k == 0) {
+      queue_start_us = now_us;
+      queued = TARGET_FILL;
+    }
+    int64_t fill = queued - (int64_t) ((now_us - queue_start_us) * SAMPLE_RATE / 1000000);
+    if (fill < 0) {
+      // Ran dry: the speaker played silence until this write
+      queue_start_us = now_us;
+      queued = 0;
+      fill = 0;
+      if (now_us >= (uint64_t) SETTLED_S * 1000000) {
+        result.underruns++;
+      }
+    }
+    if (now_us >= (uint64_t) SETTLED_S * 1000000) {
+      result.min_fill = fill < result.min_fill ? fill : result.min_fill;
+      result.max_fill = fill > result.max_fill ? fill : result.max_fill;
+    }
+    drift.on_output(samples, now_us);
+    queued += samples;
+  }
+  result.drift_ppm = drift.stats().drift_ppm;
+  return result;
+}
+
+static void test_offsets() {
+  const float offsets[] = {0.0f, 100.0f, -100.0f, 300.0f, -300.0f, 480.0f, -480.0f};
+  const uint32_t jitters[] = {0, 30};
+  printf("offset ppm  jitter ms  estimate ppm  queue after %u s (samples)\n", (unsigned) SETTLED_S);
+  for (uint32_t jitter_ms : jitters) {
+    for (float offset : offsets) {
+      CallResult r = run_call(offset, jitter_ms);
+      printf("  %8.0f  %9u  %12.1f  %5lld..%lld\n", offset, (unsigned) jitter_ms, r.drift_ppm,
+             (long long) r.min_fill, (long long) r.max_fill);
+      CHECK(r.underruns == 0);
+      // Our clock is the reference: a remote fast by x ppm is x ppm
+      // against us, to first order
+      CHECK(fabsf(r.drift_ppm - offset) < (jitter_ms ? 40.0f : 2.0f));
+      // Level around the target: within a frame without jitter, and
+      // above empty and below twice the target with it
+      if (jitter_ms == 0) {
+        CHECK(r.min_fill > (int64_t) (TARGET_FILL - FRAME) && r.max_fill < (int64_t) (TARGET_FILL + 2 * FRAME));
+      } else {
+        CHECK(r.min_fill >= 0 && r.max_fill < (int64_t) (3 * TARGET_FILL));
+      }
+    }
+  }
+}
+
+// Tones through a fixed ratio against the ideal tone at the output
+// instants, after the TAPS / 2 group delay
+static void test_fidelity() {
+  const double ratios[] = {1.0, 1.0 + 480e-6, 1.0 - 480e-6, 1.01, 0.99};
+  // Up to 3 kHz is where speech is; 6 kHz is in the filter's transition
+  // towards the 7.4 kHz cutoff and is held to less
+  const double freqs[] = {440.0, 1000.0, 3000.0, 6000.0};
+  static DriftResampler resampler;
+  for (double ratio : ratios) {
+    for (double freq : freqs) {
+      resampler.begin();
+      resampler.set_ratio(ratio);
+      const size_t blocks = 100;
+      int16_t in[FRAME];
+      int16_t out[DriftResampler::max_output(FRAME)];
+      double signal = 0.0, noise = 0.0;
+      size_t produced = 0;
+      for (size_t b = 0; b < blocks; b++) {
+        for (size_t i = 0; i < FRAME; i++) {
+          in[i] = (int16_t) lrint(16000.0 * sin(2.0 * M_PI * freq * (double) (b * FRAME + i) / SAMPLE_RATE));
+        }
+        size_t n = resampler.process(in, FRAME, out);
+        for (size_t i = 0; i < n; i++, produced++) {
+          // Output sample j sits at input position j * ratio, TAPS / 2 late
+          double t = produced * ratio - DriftResampler::TAPS / 2.0;
+          if (t < DriftResampler::TAPS) {
+            continue;  // The filter is still filling from silence
+          }
+          double want = 16000.0 * sin(2.0 * M_PI * freq * t / SAMPLE_RATE);
+          signal += want * want;
+          noise += (out[i] - want) * (out[i] - want);
+        }
+      }
+      // The number of outputs follows the ratio
+      double expected = blocks * FRAME / ratio;
+      CHECK(fabs((double) produced - expected) <= 2.0);
+      double snr = 10.0 * log10(signal / noise);
+      printf("ratio %.6f, %4.0f Hz: SNR %.1f dB\n", ratio, freq, snr);
+      CHECK(snr > (freq < 4000.0 ? 65.0 : 45.0));
+    }
+  }
+}
+
+// The ratio flipping between the two extremes every block must not step
+// the output: a 200 Hz tone at full scale moves at most ~2500 per sample,
+// and a discontinuity would add to that
+static void test_no_clicks() {
+  static DriftResampler resampler;
+  resampler.begin();
+  int16_t in[FRAME];
+  int16_t out[DriftResampler::max_output(FRAME)];
+  const double amplitude = 32000.0, freq = 200.0;
+  const double max_step = amplitude * 2.0 * M_PI * freq / SAMPLE_RATE * 1.05;
+  int16_t prev = 0;
+  int worst = 0;
+  for (size_t b = 0; b < 500; b++) {
+    for (size_t i = 0; i < FRAME; i++) {
+      in[i] = (int16_t) lrint(amplitude * sin(2.0 * M_PI * freq * (double) (b * FRAME + i) / SAMPLE_RATE));
+    }
+    resampler.set_ratio(b % 2 ? 1.0 + DriftResampler::MAX_RATIO_OFFSET : 1.0 - DriftResampler::MAX_RATIO_OFFSET);
+    size_t n = resampler.process(in, FRAME, out);
+    for (size_t i = 0; i < n; i++) {
+      if (b > 0) {  // The first block rises from silence
+        int step = abs(out[i] - prev);
+        worst = step > worst ? step : worst;
+      }
+      prev = out[i];
+    }
+  }
+  printf("ratio flipped every block: largest step %d (a clean tone: up to %.0f)\n", worst, max_step);
+  CHECK(worst <= max_step);
+}
+
+int main() {
+  test_offsets();
+  test_fidelity();
+  test_no_clicks();
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("clock_drift: all checks passed\n");
+  return 0;
+}
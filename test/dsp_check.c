@@ -0,0 +1,29 @@
+/*
+ * DSP kernels on the host: fails if any kernel of the backend this build
+ * picked differs from its scalar reference, then prints cycles per sample
+ * (nanoseconds on the host) of each kernel and its reference
+ */
+
+#include "audio_dsp_check.h"
+
+#include <stdio.h>
+
+int main(void)
+{
+    if (audio_dsp_verify() != ESP_OK) {
+        fprintf(stderr, "DSP kernels (%s) do not match the scalar reference\n", audio_dsp_backend());
+        return 1;
+    }
+
+    audio_dsp_bench_t bench;
+    if (audio_dsp_benchmark(&bench) != ESP_OK) {
+        fprintf(stderr, "DSP benchmark failed\n");
+        return 1;
+    }
+    printf("DSP kernels (%s), ns/sample over a 20 ms frame at 16 kHz\n", bench.backend);
+    for (size_t k = 0; k < AUDIO_DSP_KERNELS; k++) {
+        printf("  %-10s %6.2f, reference %6.2f\n", bench.kernels[k].name, bench.kernels[k].cycles_per_sample,
+               bench.kernels[k].ref_cycles_per_sample);
+    }
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * Conference mixer on the host: checks the mix-minus outputs against a
+ * saturating reference, frame sizing and speaker clocking, then measures
+ * what one mix costs with 1..4 active participants
+ */
+
+#include "audio_dsp.h"
+#include "audio_mixer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <time.h>
+
+using esphome::intercom::AudioMixer;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                    \
+    }                                                                \
+  } while (0)
+
+static constexpr size_t SLOTS = AudioMixer::MAX_INPUTS;
+
+static void fill_random(int16_t *samples, size_t count, int16_t amplitude) {
+  for (size_t i = 0; i < count; i++) {
+    samples[i] = (int16_t) ((rand() % (2 * amplitude + 1)) - amplitude);
+  }
+}
+
+// Every slot hears the others summed in slot order with saturation at each
+// step, which is what audio_dsp_mix_s16 applied in that order produces
+static void expected_mix(const int16_t in[SLOTS][AudioMixer::MAX_FRAME_SAMPLES], size_t self, size_t n,
+                         int16_t *out) {
+  memset(out, 0, n * sizeof(int16_t));
+  for (size_t other = 0; other < SLOTS; other++) {
+    if (other != self) {
+      audio_dsp_mix_s16_ref(out, in[other], n);
+    }
+  }
+}
+
+static void test_mix_minus() {
+  auto mixer = std::make_unique<AudioMixer>();
+  const size_t n = 320;
+  CHECK(mixer->set_frame_samples(n));
+  int16_t scratch[AudioMixer::MAX_FRAME_SAMPLES];
+  for (size_t s = 1; s < SLOTS; s++) {
+    mixer->read(s, scratch, n);  // Remote legs start listening before audio flows
+  }
+
+  static int16_t in[SLOTS][AudioMixer::MAX_FRAME_SAMPLES];
+  for (int round = 0; round < 50; round++) {
+    // Loud enough that two or three voices clip
+    for (size_t s = 0; s < SLOTS; s++) {
+      fill_random(in[s], n, round % 2 ? 30000 : 8000);
+      mixer->write(s, in[s], n);
+    }
+    for (size_t s = 0; s < SLOTS; s++) {
+      int16_t got[AudioMixer::MAX_FRAME_SAMPLES];
+      int16_t want[AudioMixer::MAX_FRAME_SAMPLES];
+      CHECK(mixer->read(s, got, n) == n);
+      expected_mix(in, s, n, want);
+      CHECK(memcmp(got, want, n * sizeof(int16_t)) == 0);
+    }
+  }
+  CHECK(mixer->overruns() == 0);
+}
+
+static void test_frame_sizing() {
+  auto mixer = std::make_unique<AudioMixer>();
+  int16_t frame[AudioMixer::MAX_FRAME_SAMPLES];
+  fill_random(frame, 480, 1000);
+
+  // Before the first decoded frame the mic has nowhere to go and the
+  // speaker plays silence
+  mixer->write(AudioMixer::LOCAL_SLOT, frame, 160);
+  CHECK(mixer->frame_samples() == 0);
+  int16_t out[AudioMixer::MAX_FRAME_SAMPLES];
+  CHECK(mixer->read(AudioMixer::LOCAL_SLOT, out, 160) == 160);
+  CHECK(mixer->underruns() == 0);
+
+  // 10 ms at 48 kHz from the decoder sets the period
+  mixer->write(1, frame, 480);
+  CHECK(mixer->frame_samples() == 480);
+  CHECK(mixer->read(AudioMixer::LOCAL_SLOT, out, 480) == 480);
+  CHECK(memcmp(out, frame, 480 * sizeof(int16_t)) == 0);
+
+  mixer->reset();
+  CHECK(mixer->frame_samples() == 0);
+  CHECK(!mixer->set_frame_samples(0));
+  CHECK(!mixer->set_frame_samples(AudioMixer::MAX_FRAME_SAMPLES + 1));
+}
+
+static void test_speaker_clock() {
+  // The decoder delivers 320-sample frames while I2S pulls 256 at a time;
+  // the speaker must hear the remote stream unbroken and in order
+  auto mixer = std::make_unique<AudioMixer>();
+  const size_t n = 320, chunk = 256, total = 40 * n;
+  static int16_t stream[40 * 320];
+  for (size_t i = 0; i < total; i++) {
+    stream[i] = (int16_t) (i * 7);
+  }
+  size_t written = 0, played = 0;
+  while (played + chunk <= total - n) {
+    while (written < played + chunk + n && written < total) {
+      mixer->write(1, stream + written, n);
+      written += n;
+    }
+    int16_t out[256];
+    mixer->read(AudioMixer::LOCAL_SLOT, out, chunk);
+    CHECK(memcmp(out, stream + played, chunk * sizeof(int16_t)) == 0);
+    played += chunk;
+  }
+  CHECK(mixer->underruns() == 0);
+  CHECK(mixer->overruns() == 0);
+
+  // With no remote audio the speaker still runs, on silence
+  mixer->release(1);
+  int16_t out[256];
+  mixer->read(AudioMixer::LOCAL_SLOT, out, chunk);
+  mixer->read(AudioMixer::LOCAL_SLOT, out, chunk);
+  bool silent = true;
+  for (size_t i = 0; i < chunk; i++) {
+    silent &= out[i] == 0;
+  }
+  CHECK(silent);
+}
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_participants() {
+  const size_t n = 320;  // 20 ms at 16 kHz
+  const int iterations = 20000;
+  static int16_t frames[SLOTS][AudioMixer::MAX_FRAME_SAMPLES];
+  for (size_t s = 0; s < SLOTS; s++) {
+    fill_random(frames[s], n, 12000);
+  }
+
+  printf("mixer (%s kernels), %u-sample frames, all %u slots listening\n", audio_dsp_backend(), (unsigned) n,
+         (unsigned) SLOTS);
+  double prev = 0;
+  for (size_t active = 1; active <= SLOTS; active++) {
+    auto mixer = std::make_unique<AudioMixer>();
+    mixer->set_frame_samples(n);
+    int16_t out[AudioMixer::MAX_FRAME_SAMPLES];
+    for (size_t s = 0; s < SLOTS; s++) {
+      mixer->read(s, out, n);
+    }
+    double start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+      for (size_t s = 0; s < active; s++) {
+        mixer->write(s, frames[s], n);
+      }
+      for (size_t s = 0; s < SLOTS; s++) {
+        mixer->read(s, out, n);
+      }
+    }
+    double per_frame = (now_ns() - start) / iterations;
+    CHECK(mixer->mix_count() >= (uint32_t) iterations);
+    CHECK(mixer->overruns() == 0);
+    printf("  %u active: %8.0f ns/frame incl. FIFOs, %8u ns/mix", (unsigned) active, per_frame,
+           (unsigned) mixer->avg_mix_cycles());
+    if (active > 1) {
+      printf(", +%.0f ns for this participant", per_frame - prev);
+    }
+    printf("\n");
+    prev = per_frame;
+  }
+}
+
+int main() {
+  srand(1);
+  test_mix_minus();
+  test_frame_sizing();
+  test_speaker_clock();
+  bench_participants();
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("mixer: all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * RFC 2198 redundancy through the jitter buffer under simulated loss:
+ * residual loss against bandwidth overhead for each redundancy depth, on
+ * random and on bursty (Gilbert-Elliott) channels. The receive side is
+ * wired the way the component wires it, and every frame played out must
+ * be the one that was sent.
+ */
+
+#include "jitter_buffer.h"
+#include "rtp_red.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace esphome::intercom;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+static constexpr uint8_t PAYLOAD_TYPE = 96;
+static constexpr size_t FRAME_BYTES = 160;  // 20 ms of a compressed codec
+static constexpr uint32_t FRAME_SAMPLES = 320;
+static constexpr int FRAMES = 50000;
+
+// Two-state loss model: in the bad state every packet is lost. Mean loss
+// is p / (p + r), mean burst length 1 / r.
+struct Channel {
+  float p;  // good -> bad
+  float r;  // bad -> good
+  bool bad = false;
+  uint32_t state = 0x9E3779B9;
+
+  float uniform() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) / 16777216.0f;
+  }
+  bool lose() {
+    bad = bad ? uniform() >= r : uniform() < p;
+    return bad;
+  }
+};
+
+struct Result {
+  float channel_loss;
+  float residual_loss;
+  float overhead;
+  uint32_t recovered;
+};
+
+// The frame names its sequence number in its first two bytes
+static void make_frame(uint16_t seq, uint8_t *frame) {
+  frame[0] = seq >> 8;
+  frame[1] = seq & 0xFF;
+  for (size_t i = 2; i < FRAME_BYTES; i++) {
+    frame[i] = (uint8_t) (seq * 31 + i);
+  }
+}
+
+static Result run(Channel channel, uint8_t depth) {
+  static RedEncoder encoder;
+  static JitterBuffer buffer;
+  encoder.reset();
+  buffer.reset();
+  uint8_t frame[FRAME_BYTES];
+  uint8_t payload[1200];
+  uint32_t dropped = 0;
+  bool frames_ok = true;
+  int32_t last_played = -1;
+
+  for (int i = 0; i < FRAMES; i++) {
+    uint16_t seq = (uint16_t) (1000 + i);
+    make_frame(seq, frame);
+    size_t len = encoder.encode(PAYLOAD_TYPE, frame, FRAME_BYTES, (uint32_t) i * FRAME_SAMPLES, depth, payload,
+                                sizeof(payload));
+    bool red = len > 0;
+    if (!red) {
+      memcpy(payload, frame, FRAME_BYTES);
+      len = FRAME_BYTES;
+    }
+    // Keep the first packet so the buffer has a start
+    if (i > 0 && channel.lose()) {
+      dropped++;
+      continue;
+    }
+
+    if (red) {
+      RedBlock blocks[RED_MAX_DEPTH + 1];
+      size_t count = rtp_red_parse(payload, len, (uint32_t) i * FRAME_SAMPLES, blocks, RED_MAX_DEPTH + 1);
+      CHECK(count == (size_t) encoder.last_depth() + 1);
+      buffer.set_hold(count > 0 ? count - 1 : 0);
+      for (size_t b = 0; b < count; b++) {
+        if (blocks[b].payload_type == PAYLOAD_TYPE) {
+          buffer.put(seq - blocks[b].distance, blocks[b].data, blocks[b].len, blocks[b].distance > 0);
+        }
+      }
+    } else {
+      buffer.set_hold(0);
+      buffer.put(seq, payload, len, false);
+    }
+
+    uint8_t *out;
+    size_t out_len;
+    while (buffer.pop(&out, &out_len)) {
+      if (out_len > 0) {
+        // Intact, and in order: a burst longer than the buffer skips
+        // ahead, but nothing may come out twice or backwards
+        uint16_t got = (uint16_t) ((out[0] << 8) | out[1]);
+        uint8_t want[FRAME_BYTES];
+        make_frame(got, want);
+        frames_ok &= out_len == FRAME_BYTES && memcmp(out, want, FRAME_BYTES) == 0 && (int32_t) got > last_played;
+        last_played = got;
+      }
+    }
+  }
+  CHECK(frames_ok);
+
+  const JitterBufferStats &stats = buffer.stats();
+  Result result;
+  result.channel_loss = (float) dropped / (FRAMES - 1);
+  result.residual_loss = (float) stats.lost / (stats.played + stats.lost);
+  result.overhead = encoder.primary_bytes() ? (float) encoder.redundant_bytes() / encoder.primary_bytes() : 0.0f;
+  result.recovered = stats.recovered;
+  return result;
+}
+
+static void sweep(const char *name, Channel channel, float max_residual[RED_MAX_DEPTH + 1]) {
+  printf("%s\n  depth  overhead  channel loss  residual loss  recovered\n", name);
+  float previous = 1.0f;
+  for (uint8_t depth = 0; depth <= RED_MAX_DEPTH; depth++) {
+    Result r = run(channel, depth);
+    printf("  %5u  %7.0f%%  %11.2f%%  %12.3f%%  %9u\n", depth, 100.0f * r.overhead, 100.0f * r.channel_loss,
+           100.0f * r.residual_loss, (unsigned) r.recovered);
+    // Each redundant copy costs one frame's worth of audio
+    CHECK(r.overhead > depth - 0.01f && r.overhead < depth + 0.01f);
+    CHECK(r.residual_loss <= max_residual[depth]);
+    CHECK(depth == 0 || r.residual_loss <= previous);
+    if (depth == 0) {
+      CHECK(r.recovered == 0);
+      CHECK(r.residual_loss > 0.9f * r.channel_loss && r.residual_loss < 1.1f * r.channel_loss);
+    }
+    previous = r.residual_loss;
+  }
+}
+
+int main() {
+  // Random loss: a frame is gone only if it and its depth successors are,
+  // so depth d leaves about p^(d+1)
+  float random3[] = {0.035f, 0.002f, 0.0002f, 0.0001f};
+  sweep("3% random loss", Channel{0.03f, 0.97f}, random3);
+  float random8[] = {0.09f, 0.01f, 0.001f, 0.0003f};
+  sweep("8% random loss", Channel{0.08f, 0.92f}, random8);
+  // Bursts averaging 2.5 packets at about 5% loss, the outdoor station's
+  // profile: depth 1 helps little, depth 3 covers most bursts
+  float bursty[] = {0.06f, 0.045f, 0.03f, 0.015f};
+  sweep("5% loss in bursts of 2.5", Channel{0.02f, 0.4f}, bursty);
+
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("rtp_red: all checks passed\n");
+  return 0;
+}
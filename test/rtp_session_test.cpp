@@ -0,0 +1,247 @@
+/*
+ * RTP session against RFC 3550 reference computations: extended sequence
+ * numbers and loss (A.1, A.3), interarrival jitter (A.8, in floating
+ * point), RTT from LSR/DLSR (6.4.1), the report interval (6.2) and RTCP
+ * demultiplexing (RFC 5761)
+ */
+
+#include "rtp_session.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace esphome::intercom;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+static constexpr uint32_t CLOCK_RATE = 16000;
+static constexpr uint32_t FRAME = 320;  // 20 ms
+static constexpr uint64_t FRAME_US = 20000;
+
+static uint32_t be32(const uint8_t *p) {
+  return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+struct ReportBlock {
+  uint32_t ssrc;
+  uint8_t fraction;
+  int32_t cumulative;
+  uint32_t extended_max;
+  uint32_t jitter;
+  uint32_t lsr;
+  uint32_t dlsr;
+};
+
+// First report block of an SR or RR at the head of a compound packet
+static bool first_block(const uint8_t *rtcp, size_t len, ReportBlock *block) {
+  if (len < 8 || (rtcp[0] & 0x1F) == 0) {
+    return false;
+  }
+  const uint8_t *b = rtcp + (rtcp[1] == 200 ? 28 : 8);
+  block->ssrc = be32(b);
+  block->fraction = b[4];
+  block->cumulative = (int32_t) ((be32(b + 4) & 0xFFFFFF) << 8) >> 8;
+  block->extended_max = be32(b + 8);
+  block->jitter = be32(b + 12);
+  block->lsr = be32(b + 16);
+  block->dlsr = be32(b + 20);
+  return true;
+}
+
+static void test_helpers() {
+  // 1.5 s is 1 second and half of 2^32 in NTP fraction
+  CHECK(rtp_ntp_from_us(1500000) == ((1ull << 32) | 0x80000000ull));
+  CHECK(rtp_ntp_from_us(0) == 0);
+
+  uint8_t rtp[RTP_HEADER_SIZE];
+  RtpHeader header{96, true, 0xBEEF, 0x01020304, 0xCAFEBABE};
+  CHECK(rtp_write_header(rtp, header) == RTP_HEADER_SIZE);
+  RtpHeader parsed;
+  size_t offset = 0, payload = 0;
+  CHECK(rtp_parse_header(rtp, sizeof(rtp), &parsed, &offset, &payload));
+  CHECK(parsed.seq == 0xBEEF && parsed.timestamp == 0x01020304 && parsed.ssrc == 0xCAFEBABE);
+  CHECK(parsed.marker && parsed.payload_type == 96 && offset == RTP_HEADER_SIZE && payload == 0);
+
+  // Payload type 96 sits outside 192-223 with the marker bit set; SR (200) inside
+  CHECK(!rtp_is_rtcp(rtp, sizeof(rtp)));
+  uint8_t sr[8] = {0x80, 200, 0, 1, 0, 0, 0, 0};
+  CHECK(rtp_is_rtcp(sr, sizeof(sr)));
+}
+
+static void test_report_interval() {
+  // First report after half the 5 s minimum, randomized over [0.5, 1.5]
+  // and divided by e - 3/2
+  for (uint32_t ssrc = 1; ssrc < 200; ssrc++) {
+    RtpSession session;
+    session.begin(ssrc * 7919, 0, CLOCK_RATE, "t", 1000000);
+    const double lo = 2500.0 * 0.5 / 1.218, hi = 2500.0 * 1.5 / 1.218;
+    CHECK(!session.rtcp_due(1000000 + (uint64_t) (lo * 1000) - 1000));
+    CHECK(session.rtcp_due(1000000 + (uint64_t) (hi * 1000) + 1000));
+  }
+}
+
+// Sender A streams to receiver B over a path that drops, duplicates and
+// delays packets; B's report block must match the appendix A figures
+// computed here independently
+static void test_loss_and_jitter() {
+  RtpSession a, b;
+  a.begin(0x11111111, 0, CLOCK_RATE, "a", 0);
+  b.begin(0x22222222, 0, CLOCK_RATE, "b", 0);
+  // Start the sequence close to the wrap so the cycle count is exercised
+  uint8_t packet[RTP_HEADER_SIZE + 4] = {};
+
+  srand(7);
+  uint32_t first_seq = 0;
+  bool validated = false;
+  uint32_t received = 0, lost = 0, highest_ext = 0;
+  double jitter = 0.0;  // A.8 reference, in timestamp units
+  bool have_transit = false;
+  double prev_transit = 0.0;
+
+  const int packets = 3000;
+  uint16_t wrap_seq = 0;
+  for (int i = 0; i < packets; i++) {
+    uint64_t send_us = (uint64_t) i * FRAME_US;
+    a.write_header(packet, FRAME, 4, send_us);
+    // Rewrite the sequence so the stream crosses 65535 -> 0 mid-test
+    uint16_t seq = (uint16_t) (65000 + i);
+    packet[2] = seq >> 8;
+    packet[3] = seq & 0xFF;
+    if (i == 0) {
+      wrap_seq = seq;
+    }
+    uint32_t ts = be32(packet + 4);
+
+    // 3% loss after the source is validated, and 0-9 ms of delay
+    bool drop = i > 10 && rand() % 100 < 3;
+    if (drop) {
+      lost++;
+      continue;
+    }
+    uint64_t arrive_us = send_us + 30000 + (uint64_t) (rand() % 10) * 1000;
+    size_t offset, len;
+    bool accepted = b.on_rtp(packet, sizeof(packet), arrive_us, &offset, &len);
+    if (i == 0) {
+      CHECK(!accepted);  // Probation: the first packet only starts validation
+      continue;
+    }
+    CHECK(accepted);
+    if (!validated) {
+      validated = true;
+      first_seq = (uint32_t) (wrap_seq + 1);
+    }
+    received++;
+    highest_ext = (uint32_t) 65000 + (uint32_t) i;  // Extended: 65000 + i crosses into cycle 1
+
+    // A.8 in floating point: arrival in timestamp units, J += (|D| - J) / 16
+    double arrival = (double) (uint32_t) (arrive_us * CLOCK_RATE / 1000000);
+    double transit = arrival - (double) ts;
+    if (have_transit) {
+      double d = std::fabs(transit - prev_transit);
+      jitter += (d - jitter) / 16.0;
+    }
+    prev_transit = transit;
+    have_transit = true;
+  }
+
+  uint8_t rtcp[RTCP_MAX_PACKET_SIZE];
+  size_t rtcp_len = b.build_rtcp(rtcp, sizeof(rtcp), (uint64_t) packets * FRAME_US + 50000);
+  ReportBlock block;
+  CHECK(first_block(rtcp, rtcp_len, &block));
+  uint32_t expected = highest_ext - first_seq + 1;
+  CHECK(block.ssrc == a.ssrc());
+  CHECK(block.extended_max == highest_ext);
+  CHECK(block.extended_max >> 16 == 1);  // One wrap
+  CHECK(block.cumulative == (int32_t) (expected - received));
+  CHECK(block.cumulative == (int32_t) lost);
+  CHECK(block.fraction == (uint8_t) (((expected - received) << 8) / expected));
+  // Integer A.8 keeps 4 fractional bits; allow a unit either side
+  CHECK(std::fabs((double) block.jitter - jitter) <= 1.0);
+  CHECK(b.stats().cumulative_lost == (int32_t) lost);
+  printf("loss %u/%u, fraction %u/256, jitter %u (reference %.2f) timestamp units\n", (unsigned) block.cumulative,
+         (unsigned) expected, block.fraction, (unsigned) block.jitter, jitter);
+
+  // Next interval: 100 packets without loss, two of them duplicated. The
+  // fraction covers the interval only, and goes no lower than zero.
+  for (int i = packets; i < packets + 100; i++) {
+    uint64_t send_us = (uint64_t) i * FRAME_US;
+    a.write_header(packet, FRAME, 4, send_us);
+    uint16_t seq = (uint16_t) (65000 + i);
+    packet[2] = seq >> 8;
+    packet[3] = seq & 0xFF;
+    size_t offset, len;
+    b.on_rtp(packet, sizeof(packet), send_us + 30000, &offset, &len);
+    if (i % 50 == 0) {
+      b.on_rtp(packet, sizeof(packet), send_us + 31000, &offset, &len);
+    }
+  }
+  rtcp_len = b.build_rtcp(rtcp, sizeof(rtcp), (uint64_t) (packets + 100) * FRAME_US + 50000);
+  CHECK(first_block(rtcp, rtcp_len, &block));
+  CHECK(block.fraction == 0);
+  CHECK(block.cumulative == (int32_t) lost - 2);  // Duplicates count as received (A.3)
+}
+
+// A sends an SR, B holds it for a while and answers with a report block
+// carrying LSR/DLSR; A's RTT must be the two one-way delays
+static void test_rtt() {
+  RtpSession a, b;
+  a.begin(0xAAAA0001, 0, CLOCK_RATE, "a", 1000000);
+  b.begin(0xBBBB0002, 0, CLOCK_RATE, "b", 1000000);
+  uint8_t packet[RTP_HEADER_SIZE + 4] = {};
+  uint8_t rtcp[RTCP_MAX_PACKET_SIZE];
+
+  const uint64_t one_way_us[] = {12000, 45000, 150000};
+  uint64_t now = 2000000;
+  for (uint64_t delay : one_way_us) {
+    // A -> B media, so B validates A and A sends an SR
+    for (int i = 0; i < 5; i++) {
+      a.write_header(packet, FRAME, 4, now);
+      size_t offset, len;
+      b.on_rtp(packet, sizeof(packet), now + delay, &offset, &len);
+      now += FRAME_US;
+    }
+    size_t sr_len = a.build_rtcp(rtcp, sizeof(rtcp), now);
+    CHECK(rtcp[1] == 200);  // SR: A sent media since its last report
+    b.on_rtcp(rtcp, sr_len, now + delay);
+
+    // B answers 0.7 s later with an RR (it sent no media)
+    uint64_t hold = 700000;
+    size_t rr_len = b.build_rtcp(rtcp, sizeof(rtcp), now + delay + hold);
+    CHECK(rtcp[1] == 201);
+    ReportBlock block;
+    CHECK(first_block(rtcp, rr_len, &block));
+    CHECK(block.lsr == (uint32_t) (rtp_ntp_from_us(now) >> 16));
+    CHECK(std::llabs((long long) block.dlsr - (long long) (hold * 65536 / 1000000)) <= 1);
+
+    CHECK(a.on_rtcp(rtcp, rr_len, now + delay + hold + delay));
+    CHECK(a.stats().rtt_valid);
+    double want_ms = 2.0 * delay / 1000.0;
+    // LSR and DLSR are in 1/65536 s; two truncations allow ~0.05 ms
+    CHECK(std::fabs(a.stats().rtt_ms - want_ms) < 0.05);
+    printf("one-way %.0f ms: RTT %.3f ms\n", delay / 1000.0, a.stats().rtt_ms);
+    now += 1000000;
+  }
+}
+
+int main() {
+  test_helpers();
+  test_report_interval();
+  test_loss_and_jitter();
+  test_rtt();
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("rtp_session: all checks passed\n");
+  return 0;
+}
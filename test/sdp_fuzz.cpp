@@ -0,0 +1,238 @@
+/*
+ * SDP fuzz harness. LLVMFuzzerTestOneInput parses any input, negotiates
+ * against our codecs and, when that succeeds, writes the answer and
+ * parses it back. Every SdpString must point inside the text it came
+ * from, counts must stay within their arrays, and our own answer must
+ * negotiate to the same codec.
+ *
+ * Built with clang and -DSDP_FUZZ_LIBFUZZER -fsanitize=fuzzer it runs
+ * under libFuzzer. Otherwise main() below mutates a seed corpus for a
+ * fixed number of rounds, which is what CTest runs (under ASan/UBSan when
+ * the compiler has them).
+ */
+
+#include "sdp.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace esphome::intercom;
+
+static const SdpCodecCap CAPS[] = {
+    {"L16", 16000, 1, 256, 96},
+    {"PCMU", 8000, 1, 64, 0},
+    {"opus", 48000, 2, 32, 111},
+};
+static constexpr size_t CAP_COUNT = sizeof(CAPS) / sizeof(CAPS[0]);
+
+static void fail(const char *what) {
+  fprintf(stderr, "sdp_fuzz: %s\n", what);
+  abort();
+}
+
+static void check_in(const SdpString &s, const char *base, size_t len, const char *what) {
+  if (s.len == 0) {
+    return;
+  }
+  if (s.data < base || s.data + s.len > base + len) {
+    fail(what);
+  }
+}
+
+static void check_description(const SdpDescription &d, const char *text, size_t len) {
+  if (d.codec_count > SdpDescription::MAX_CODECS || d.candidate_count > SdpDescription::MAX_CANDIDATES ||
+      d.crypto_count > SdpDescription::MAX_CRYPTO) {
+    fail("count past its array");
+  }
+  check_in(d.proto, text, len, "proto outside the text");
+  check_in(d.address, text, len, "address outside the text");
+  check_in(d.ice_ufrag, text, len, "ice-ufrag outside the text");
+  check_in(d.ice_pwd, text, len, "ice-pwd outside the text");
+  for (size_t i = 0; i < d.codec_count; i++) {
+    // Static payload types name themselves from a string literal
+    if (d.codecs[i].payload_type >= 96) {
+      check_in(d.codecs[i].name, text, len, "codec name outside the text");
+    }
+    check_in(d.codecs[i].fmtp, text, len, "fmtp outside the text");
+  }
+  for (size_t i = 0; i < d.candidate_count; i++) {
+    check_in(d.candidates[i].address, text, len, "candidate address outside the text");
+    check_in(d.candidates[i].type, text, len, "candidate type outside the text");
+  }
+  for (size_t i = 0; i < d.crypto_count; i++) {
+    check_in(d.crypto[i].suite, text, len, "crypto suite outside the text");
+    check_in(d.crypto[i].key, text, len, "crypto key outside the text");
+  }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  // Exactly sized copy, so a read past the end is a heap overflow
+  std::vector<char> text(data, data + size);
+  const char *p = text.empty() ? "" : text.data();
+
+  SdpCandidate candidate;
+  if (sdp_parse_candidate(p, size, &candidate)) {
+    check_in(candidate.address, p, size, "trickled candidate address outside the text");
+  }
+
+  SdpDescription remote;
+  if (!sdp_parse(p, size, &remote)) {
+    return 0;
+  }
+  check_description(remote, p, size);
+
+  SdpNegotiation negotiation;
+  if (!sdp_negotiate(remote, CAPS, CAP_COUNT, &negotiation)) {
+    return 0;
+  }
+  if (negotiation.codec < CAPS || negotiation.codec >= CAPS + CAP_COUNT) {
+    fail("negotiated codec is not one of ours");
+  }
+  if (memchr(negotiation.remote_address, '\0', sizeof(negotiation.remote_address)) == nullptr) {
+    fail("remote address not terminated");
+  }
+
+  // Our answer must be valid SDP that negotiates to the same codec
+  SdpLocal local{};
+  local.session_id = 1;
+  local.version = 1;
+  local.address = "192.168.1.10";
+  local.port = 5004;
+  local.answer = &negotiation;
+  local.ptime = 20;
+  char answer[1024];
+  size_t answer_len = sdp_write(local, answer, sizeof(answer));
+  if (answer_len == 0) {
+    fail("answer did not fit");
+  }
+  SdpDescription echoed;
+  SdpNegotiation again;
+  if (!sdp_parse(answer, answer_len, &echoed) || !sdp_negotiate(echoed, CAPS, CAP_COUNT, &again)) {
+    fail("our answer does not negotiate");
+  }
+  if (again.codec != negotiation.codec || again.payload_type != negotiation.payload_type) {
+    fail("our answer negotiates to a different codec");
+  }
+  return 0;
+}
+
+#ifndef SDP_FUZZ_LIBFUZZER
+
+static const char *const SEEDS[] = {
+    "v=0\r\no=- 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+    "m=audio 5004 RTP/AVP 96 0 97\r\na=rtpmap:96 L16/16000\r\na=rtpmap:97 red/16000\r\n"
+    "a=fmtp:97 96/96\r\na=ptime:20\r\na=rtcp-mux\r\na=sendrecv\r\n",
+
+    "v=0\no=- 2 2 IN IP4 0.0.0.0\ns=-\nt=0 0\nm=audio 9 UDP/TLS/RTP/SAVPF 111 0\nc=IN IP4 0.0.0.0\n"
+    "a=rtpmap:111 opus/48000/2\na=fmtp:111 minptime=10;useinbandfec=1\na=ice-ufrag:abcd\n"
+    "a=ice-pwd:0123456789abcdefghijkl\na=ice-lite\n"
+    "a=candidate:1 1 UDP 2130706431 192.168.1.20 50000 typ host\n"
+    "a=candidate:2 1 UDP 1694498815 203.0.113.7 50001 typ srflx raddr 192.168.1.20 rport 50000\n",
+
+    "v=0\r\no=- 3 3 IN IP4 10.0.0.3\r\ns=-\r\nc=IN IP4 10.0.0.3\r\nt=0 0\r\n"
+    "m=audio 7078 RTP/SAVP 0\r\na=crypto:1 AES_CM_128_HMAC_SHA1_80 "
+    "inline:WVNfX19zZW1jdGwgKCkgewkyMjA7fQp9CnVubGVz|2^20|1:32\r\na=sendonly\r\n",
+
+    "a=candidate:842163049 1 udp 1677729535 198.51.100.4 61234 typ srflx",
+};
+
+// Cheap, deterministic mutations in the spirit of libFuzzer's
+static void mutate(std::vector<uint8_t> &buf, uint32_t &rng) {
+  auto next = [&rng]() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+  };
+  static const char *const TOKENS[] = {"\r\n", "\n", "a=", "m=audio ", "c=IN IP4 ", ":", "/", " ", "rtpmap:",
+                                       "fmtp:", "candidate:", "crypto:", "inline:", "|", "65536", "4294967296",
+                                       "255", "-1", "0.0.0.0", "::1", "red/", "typ host"};
+  int edits = 1 + next() % 4;
+  for (int e = 0; e < edits; e++) {
+    size_t pos = buf.empty() ? 0 : next() % (buf.size() + 1);
+    switch (next() % 6) {
+      case 0:  // Flip a byte
+        if (!buf.empty()) {
+          buf[pos % buf.size()] ^= (uint8_t) (1u << (next() % 8));
+        }
+        break;
+      case 1:  // Random byte
+        if (!buf.empty()) {
+          buf[pos % buf.size()] = (uint8_t) next();
+        }
+        break;
+      case 2:  // Erase a run
+        if (!buf.empty()) {
+          size_t at = pos % buf.size();
+          size_t n = 1 + next() % 16;
+          buf.erase(buf.begin() + at, buf.begin() + std::min(buf.size(), at + n));
+        }
+        break;
+      case 3: {  // Insert a token
+        const char *t = TOKENS[next() % (sizeof(TOKENS) / sizeof(TOKENS[0]))];
+        buf.insert(buf.begin() + pos, t, t + strlen(t));
+        break;
+      }
+      case 4:  // Truncate
+        buf.resize(pos);
+        break;
+      default: {  // Duplicate a run, e.g. a whole line
+        if (!buf.empty()) {
+          size_t at = pos % buf.size();
+          size_t n = std::min(buf.size() - at, (size_t) (1 + next() % 64));
+          std::vector<uint8_t> run(buf.begin() + at, buf.begin() + at + n);
+          buf.insert(buf.begin() + (next() % (buf.size() + 1)), run.begin(), run.end());
+        }
+        break;
+      }
+    }
+  }
+  if (buf.size() > 4096) {
+    buf.resize(4096);
+  }
+}
+
+int main(int argc, char **argv) {
+  long rounds = argc > 1 ? strtol(argv[1], nullptr, 10) : 200000;
+  const size_t seed_count = sizeof(SEEDS) / sizeof(SEEDS[0]);
+
+  // The seeds themselves must go all the way through
+  for (size_t s = 0; s < seed_count; s++) {
+    LLVMFuzzerTestOneInput((const uint8_t *) SEEDS[s], strlen(SEEDS[s]));
+  }
+  SdpDescription d;
+  if (!sdp_parse(SEEDS[0], strlen(SEEDS[0]), &d) || d.codec_count != 3 || !d.rtcp_mux) {
+    fail("seed 0 does not parse as expected");
+  }
+
+  // Inputs that still parse go back into the corpus, so mutations build
+  // on SDP rather than wearing the seeds down to noise
+  static constexpr size_t CORPUS_MAX = 256;
+  std::vector<std::vector<uint8_t>> corpus;
+  for (size_t s = 0; s < seed_count; s++) {
+    corpus.emplace_back(SEEDS[s], SEEDS[s] + strlen(SEEDS[s]));
+  }
+  uint32_t rng = 0x12345678;
+  long parsed = 0;
+  for (long r = 0; r < rounds; r++) {
+    rng = rng * 1664525u + 1013904223u;
+    std::vector<uint8_t> buf = corpus[(rng >> 8) % corpus.size()];
+    mutate(buf, rng);
+    LLVMFuzzerTestOneInput(buf.data(), buf.size());
+    if (sdp_parse((const char *) buf.data(), buf.size(), &d)) {
+      parsed++;
+      if (corpus.size() < CORPUS_MAX) {
+        corpus.push_back(buf);
+      } else {
+        corpus[seed_count + (rng >> 4) % (CORPUS_MAX - seed_count)] = buf;
+      }
+    }
+  }
+  printf("sdp_fuzz: %ld inputs (%ld parsed as SDP), no faults\n", rounds, parsed);
+  return 0;
+}
+
+#endif  // SDP_FUZZ_LIBFUZZER
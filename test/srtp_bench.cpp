@@ -0,0 +1,197 @@
+/*
+ * SRTP on the host: session keys against the RFC 3711 B.3 derivation
+ * vectors, round trips, tamper and replay rejection, and packets per
+ * second per cipher suite for protect and unprotect
+ */
+
+#include "rtp_session.h"
+#include "srtp.h"
+
+#include "mbedtls/aes.h"
+#include "mbedtls/md.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace esphome::intercom;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+static size_t from_hex(const char *hex, uint8_t *out) {
+  size_t n = 0;
+  for (; hex[0] && hex[1]; hex += 2) {
+    unsigned byte;
+    sscanf(hex, "%2x", &byte);
+    out[n++] = (uint8_t) byte;
+  }
+  return n;
+}
+
+// RFC 3711 B.3
+static const char *const MASTER_KEY = "E1F97A0D3E018BE0D64FA32C06DE4139";
+static const char *const MASTER_SALT = "0EC675AD498AFEEBB6960B3AABE6";
+static const char *const CIPHER_KEY = "C61E7A93744F39EE10734AFE3FF7A087";
+static const char *const CIPHER_SALT = "30CBBC08863D8C85D49DB34A9AE1";
+static const char *const AUTH_KEY = "CEBE321F6FF7716B6FD4AB49AF256A156D38BAA4";
+
+static size_t make_packet(uint8_t *packet, uint16_t seq, uint32_t ssrc, size_t payload_len) {
+  RtpHeader header{96, false, seq, seq * 320u, ssrc};
+  rtp_write_header(packet, header);
+  for (size_t i = 0; i < payload_len; i++) {
+    packet[RTP_HEADER_SIZE + i] = (uint8_t) (seq + i);
+  }
+  return RTP_HEADER_SIZE + payload_len;
+}
+
+static void test_key_derivation() {
+  uint8_t master[SRTP_MASTER_SIZE];
+  from_hex(MASTER_KEY, master);
+  from_hex(MASTER_SALT, master + SRTP_KEY_SIZE);
+  SrtpContext tx;
+  tx.begin(SrtpSuite::AES_CM_128_HMAC_SHA1_80, master);
+
+  // A zero payload at SSRC 0, index 0 encrypts to the raw keystream:
+  // AES-CTR under the B.3 cipher key from IV = cipher salt || 0000
+  uint8_t packet[RTP_HEADER_SIZE + 48 + SRTP_MAX_TAG];
+  size_t len = make_packet(packet, 0, 0, 48);
+  memset(packet + RTP_HEADER_SIZE, 0, 48);
+  uint8_t header[RTP_HEADER_SIZE];
+  memcpy(header, packet, RTP_HEADER_SIZE);
+  CHECK(tx.protect(packet, len, sizeof(packet)) == len + 10);
+
+  uint8_t key[SRTP_KEY_SIZE], iv[16] = {0}, stream[48] = {0}, block[16];
+  from_hex(CIPHER_KEY, key);
+  from_hex(CIPHER_SALT, iv);
+  mbedtls_aes_context aes;
+  mbedtls_aes_init(&aes);
+  mbedtls_aes_setkey_enc(&aes, key, 128);
+  size_t offset = 0;
+  mbedtls_aes_crypt_ctr(&aes, sizeof(stream), &offset, iv, block, stream, stream);
+  mbedtls_aes_free(&aes);
+  CHECK(memcmp(packet + RTP_HEADER_SIZE, stream, sizeof(stream)) == 0);
+
+  // Tag: HMAC-SHA1 under the B.3 auth key over header, payload and ROC
+  uint8_t auth_key[20], roc[4] = {0}, mac[20];
+  from_hex(AUTH_KEY, auth_key);
+  mbedtls_md_context_t md;
+  mbedtls_md_init(&md);
+  mbedtls_md_setup(&md, mbedtls_md_info_from_type(MBEDTLS_MD_SHA1), 1);
+  mbedtls_md_hmac_starts(&md, auth_key, sizeof(auth_key));
+  mbedtls_md_hmac_update(&md, header, RTP_HEADER_SIZE);
+  mbedtls_md_hmac_update(&md, packet + RTP_HEADER_SIZE, 48);
+  mbedtls_md_hmac_update(&md, roc, sizeof(roc));
+  mbedtls_md_hmac_finish(&md, mac);
+  mbedtls_md_free(&md);
+  CHECK(memcmp(packet + len, mac, 10) == 0);
+}
+
+static void test_round_trip(SrtpSuite suite) {
+  uint8_t master[SRTP_MASTER_SIZE];
+  for (size_t i = 0; i < sizeof(master); i++) {
+    master[i] = (uint8_t) (i * 7 + 1);
+  }
+  SrtpContext tx, rx;
+  tx.begin(suite, master);
+  rx.begin(suite, master);
+  size_t tag = suite == SrtpSuite::AES_CM_128_HMAC_SHA1_32 ? 4 : 10;
+  CHECK(tx.tag_size() == tag);
+
+  // Across a sequence number rollover
+  uint8_t packet[RTP_HEADER_SIZE + 640 + SRTP_MAX_TAG], plain[sizeof(packet)], replay[sizeof(packet)];
+  for (uint32_t i = 0; i < 200; i++) {
+    uint16_t seq = (uint16_t) (65436 + i);
+    size_t len = make_packet(packet, seq, 0x1234, 640);
+    memcpy(plain, packet, len);
+    size_t sent = tx.protect(packet, len, sizeof(packet));
+    CHECK(sent == len + tag);
+    CHECK(memcmp(packet + RTP_HEADER_SIZE, plain + RTP_HEADER_SIZE, 640) != 0);
+    memcpy(replay, packet, sent);
+    CHECK(rx.unprotect(packet, sent) == len);
+    CHECK(memcmp(packet, plain, len) == 0);
+    if (i % 50 == 0) {
+      CHECK(rx.unprotect(replay, sent) == 0);  // Same packet again
+    }
+  }
+  CHECK(rx.stats().replays == 4);
+
+  // One flipped bit anywhere fails authentication
+  size_t len = make_packet(packet, 200, 0x1234, 640);
+  size_t sent = tx.protect(packet, len, sizeof(packet));
+  packet[RTP_HEADER_SIZE + 100] ^= 0x01;
+  CHECK(rx.unprotect(packet, sent) == 0);
+  CHECK(rx.stats().auth_failures == 1);
+
+  // SRTCP round trip
+  uint8_t rtcp[RTCP_MAX_PACKET_SIZE + SRTCP_TRAILER];
+  RtpSession session;
+  session.begin(0x1234, 96, 16000, "bench", 0);
+  size_t rtcp_len = session.build_rtcp(rtcp, sizeof(rtcp), 1000);
+  uint8_t rtcp_plain[sizeof(rtcp)];
+  memcpy(rtcp_plain, rtcp, rtcp_len);
+  size_t protected_len = tx.protect_rtcp(rtcp, rtcp_len, sizeof(rtcp));
+  CHECK(protected_len == rtcp_len + SRTCP_TRAILER);
+  CHECK(rx.unprotect_rtcp(rtcp, protected_len) == rtcp_len);
+  CHECK(memcmp(rtcp, rtcp_plain, rtcp_len) == 0);
+}
+
+static void bench(SrtpSuite suite, size_t payload_len) {
+  uint8_t master[SRTP_MASTER_SIZE] = {1, 2, 3};
+  SrtpContext tx, rx;
+  tx.begin(suite, master);
+  rx.begin(suite, master);
+  uint8_t packet[RTP_HEADER_SIZE + 1280 + SRTP_MAX_TAG];
+  const int packets = 100000;
+
+  using clock = std::chrono::steady_clock;
+  double protect_s = 0.0, unprotect_s = 0.0;
+  for (int i = 0; i < packets; i++) {
+    size_t len = make_packet(packet, (uint16_t) i, 0xBEEF, payload_len);
+    auto t0 = clock::now();
+    size_t sent = tx.protect(packet, len, sizeof(packet));
+    auto t1 = clock::now();
+    size_t got = rx.unprotect(packet, sent);
+    auto t2 = clock::now();
+    protect_s += std::chrono::duration<double>(t1 - t0).count();
+    unprotect_s += std::chrono::duration<double>(t2 - t1).count();
+    if (got != len) {
+      CHECK(got == len);
+      return;
+    }
+  }
+  double protect_pps = packets / protect_s, unprotect_pps = packets / unprotect_s;
+  // A call needs 50 packets/s each way
+  printf("  %-24s %4u-byte payload: protect %8.0f packets/s, unprotect %8.0f packets/s (%.0fx a call)\n",
+         srtp_suite_name(suite), (unsigned) payload_len, protect_pps, unprotect_pps,
+         (protect_pps < unprotect_pps ? protect_pps : unprotect_pps) / 50.0);
+}
+
+int main() {
+  test_key_derivation();
+  test_round_trip(SrtpSuite::AES_CM_128_HMAC_SHA1_80);
+  test_round_trip(SrtpSuite::AES_CM_128_HMAC_SHA1_32);
+
+  printf("SRTP on the host (software AES/SHA-1 from mbedtls)\n");
+  const SrtpSuite suites[] = {SrtpSuite::AES_CM_128_HMAC_SHA1_80, SrtpSuite::AES_CM_128_HMAC_SHA1_32};
+  const size_t payloads[] = {160, 640, 1280};  // 20 ms of G.711, L16 16 kHz, L16 32 kHz
+  for (SrtpSuite suite : suites) {
+    for (size_t payload : payloads) {
+      bench(suite, payload);
+    }
+  }
+
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("srtp: all checks passed\n");
+  return 0;
+}
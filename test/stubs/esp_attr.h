@@ -0,0 +1,9 @@
+/*
+ * Host stand-in for ESP-IDF's esp_attr.h: there is one kind of memory on
+ * the host, so the placement attributes are empty
+ */
+
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
@@ -0,0 +1,16 @@
+/*
+ * Host stand-in for ESP-IDF's esp_cpu.h: the cycle counter reads the
+ * monotonic clock in nanoseconds, so host "cycles" are nanoseconds
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+static inline uint32_t esp_cpu_get_cycle_count(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+}
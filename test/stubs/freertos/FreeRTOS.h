@@ -0,0 +1,23 @@
+/*
+ * Host stand-in for FreeRTOS.h: tasks are threads and a critical section
+ * is a mutex. There are no interrupts.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+
+typedef pthread_mutex_t portMUX_TYPE;
+typedef void *TaskHandle_t;
+
+#define portMUX_INITIALIZER_UNLOCKED PTHREAD_MUTEX_INITIALIZER
+#define portENTER_CRITICAL(mux) pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL(mux) pthread_mutex_unlock(mux)
+#define portENTER_CRITICAL_SAFE(mux) pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL_SAFE(mux) pthread_mutex_unlock(mux)
+
+static inline bool xPortInIsrContext(void)
+{
+    return false;
+}
@@ -0,0 +1,12 @@
+/*
+ * Host stand-in for FreeRTOS task.h: the current task is the current thread
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+static inline TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return (TaskHandle_t)pthread_self();
+}
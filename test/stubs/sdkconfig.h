@@ -0,0 +1,6 @@
+/*
+ * Host stand-in for the generated sdkconfig.h. Options a test needs are
+ * passed as compile definitions by its target instead.
+ */
+
+#pragma once
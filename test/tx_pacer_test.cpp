@@ -0,0 +1,266 @@
+/*
+ * Transmit pacer: capture that hands packets over in bursts goes out one
+ * packet time apart, timer lateness is all the pacing jitter left, and
+ * the interarrival jitter a receiver would measure (RFC 3550 A.8) drops
+ * accordingly. Capture running fast or slow against the timer keeps a
+ * bounded queue. Also the refusals, a producer and a consumer thread
+ * handing over packets in order, and send_batch() over loopback.
+ */
+
+#include "tx_pacer.h"
+#include "udp_socket.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace esphome::intercom;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+static constexpr uint32_t PACKET_US = 20000;
+static constexpr uint32_t HOLD_US = 10000;  // As the component
+static constexpr size_t BACKLOG = 4;
+static constexpr uint32_t IDLE_US = 5000;
+static constexpr uint32_t LOOPBACK = 0x7F000001;
+
+struct Departure {
+  uint32_t seq;
+  uint64_t pushed_us;
+  uint64_t sent_us;
+};
+
+struct SimResult {
+  PacerStats stats;
+  size_t max_depth;
+  std::vector<Departure> departures;
+};
+
+// Capture delivers `burst` packets back to back every burst * 20 ms of its
+// own clock, which runs capture_ppm off the timer's. The pace timer fires
+// when due, up to max_late_us late, as an esp_timer task callback would.
+static SimResult simulate(size_t burst, float capture_ppm, uint32_t max_late_us, uint32_t seconds) {
+  static TxPacer pacer;
+  pacer.begin(HOLD_US, BACKLOG);
+  SimResult result{};
+  srand(5);
+  const double block_us = burst * PACKET_US / (1.0 + capture_ppm * 1e-6);
+  const uint64_t end_us = (uint64_t) seconds * 1000000;
+  uint8_t packet[172];
+  uint32_t seq = 0;
+  uint64_t block = 1;
+  uint64_t next_capture = (uint64_t) block_us;
+  uint64_t next_timer = IDLE_US;
+  while (next_capture < end_us || next_timer < end_us) {
+    if (next_capture <= next_timer) {
+      uint64_t now = next_capture;
+      for (size_t i = 0; i < burst; i++, seq++) {
+        memcpy(packet, &seq, sizeof(seq));
+        CHECK(pacer.push(LOOPBACK, 5004, PACKET_US, now, packet, sizeof(packet)));
+      }
+      result.max_depth = pacer.depth() > result.max_depth ? pacer.depth() : result.max_depth;
+      next_capture = (uint64_t) (++block * block_us);
+    } else {
+      uint64_t now = next_timer;
+      UdpDatagram batch[TxPacer::SLOTS];
+      size_t count = pacer.due(now, batch, TxPacer::SLOTS);
+      for (size_t i = 0; i < count; i++) {
+        uint32_t sent_seq;
+        memcpy(&sent_seq, batch[i].data, sizeof(sent_seq));
+        result.departures.push_back(Departure{sent_seq, 0, now});
+      }
+      pacer.release(count);
+      uint64_t next = pacer.next_due_us();
+      uint64_t late = max_late_us ? (uint64_t) (rand() % max_late_us) : 0;
+      next_timer = (next == 0 ? now + IDLE_US : (next > now ? next : now)) + late;
+    }
+  }
+  // Capture time of each packet, for the unpaced comparison
+  for (Departure &d : result.departures) {
+    d.pushed_us = (uint64_t) ((d.seq / burst + 1) * block_us);
+  }
+  result.stats = pacer.stats();
+  return result;
+}
+
+// RFC 3550 A.8 interarrival jitter in microseconds, for packets arriving at
+// the given times over a path of constant delay
+static double interarrival_jitter(const std::vector<Departure> &departures, bool paced) {
+  double jitter = 0.0, prev_transit = 0.0;
+  for (size_t i = 0; i < departures.size(); i++) {
+    double arrival = (double) (paced ? departures[i].sent_us : departures[i].pushed_us);
+    double transit = arrival - (double) departures[i].seq * PACKET_US;
+    if (i > 0) {
+      jitter += (std::fabs(transit - prev_transit) - jitter) / 16.0;
+    }
+    prev_transit = transit;
+  }
+  return jitter;
+}
+
+static void test_bursty_capture() {
+  // 64 ms DMA blocks: three packets at once, then nothing for 60 ms
+  const uint32_t max_late_us = 300;
+  SimResult r = simulate(3, 0.0f, max_late_us, 60);
+  double unpaced = interarrival_jitter(r.departures, false);
+  double paced = interarrival_jitter(r.departures, true);
+  printf("bursts of 3: capture jitter %.2f ms, pacing jitter %.2f ms (max %.2f ms); receiver jitter %.2f ms unpaced, "
+         "%.2f ms paced\n",
+         r.stats.capture_jitter_us / 1000.0, r.stats.jitter_us / 1000.0, r.stats.max_jitter_us / 1000.0,
+         unpaced / 1000.0, paced / 1000.0);
+  CHECK(r.stats.capture_jitter_us > 10000);
+  // What is left is the timer's lateness, a departure either side
+  CHECK(r.stats.jitter_us < max_late_us);
+  CHECK(r.stats.max_jitter_us < 2 * max_late_us);
+  CHECK(paced < unpaced / 20.0);
+  CHECK(r.stats.dropped == 0 && r.stats.batched == 0 && r.stats.underruns == 0);
+  CHECK(r.max_depth <= 3);
+  // Every packet went out once, in order, one packet time apart
+  CHECK(r.departures.size() >= 2990);
+  bool ordered = true, spaced = true;
+  for (size_t i = 1; i < r.departures.size(); i++) {
+    ordered &= r.departures[i].seq == r.departures[i - 1].seq + 1;
+    uint64_t gap = r.departures[i].sent_us - r.departures[i - 1].sent_us;
+    spaced &= gap + 2 * max_late_us > PACKET_US && gap < PACKET_US + 2 * max_late_us;
+  }
+  CHECK(ordered);
+  CHECK(spaced);
+}
+
+static void test_clock_offsets() {
+  // Capture one packet at a time, its clock off the timer's, for five
+  // minutes. Slow capture runs the queue dry now and then; fast capture
+  // builds it up until the backlog is cut by a batch. Either way the
+  // queue stays short.
+  const float offsets[] = {-500.0f, 500.0f, 1000.0f};
+  for (float ppm : offsets) {
+    SimResult r = simulate(1, ppm, 300, 300);
+    printf("capture %+5.0f ppm: %u sent, %u batched, %u underruns, queue up to %u, pacing jitter %.2f ms\n", ppm,
+           (unsigned) r.stats.sent, (unsigned) r.stats.batched, (unsigned) r.stats.underruns, (unsigned) r.max_depth,
+           r.stats.jitter_us / 1000.0);
+    // Packets the two clocks drift apart over the run; each is made up
+    // for by an underrun or two, or taken back by a batch
+    float drift = std::fabs(ppm) * 1e-6f * 300 * 1000000 / PACKET_US;
+    CHECK(r.stats.dropped == 0);
+    CHECK(r.max_depth <= BACKLOG + 2);
+    CHECK(r.stats.underruns <= 2 * drift + 2);
+    CHECK(r.stats.batched <= drift + 2);
+    CHECK(ppm < 0 || r.stats.underruns == 0);
+    CHECK(ppm > 0 || r.stats.batched == 0);
+    CHECK(r.stats.sent >= 14990);
+  }
+}
+
+static void test_refusals() {
+  static TxPacer pacer;
+  pacer.begin(HOLD_US, BACKLOG);
+  static uint8_t big[TxPacer::MAX_PACKET + 1];
+  CHECK(!pacer.push(LOOPBACK, 5004, PACKET_US, 1000, big, TxPacer::MAX_PACKET - 10, big, 8, big, 3));
+  CHECK(pacer.stats().oversized == 1);
+  CHECK(pacer.push(LOOPBACK, 5004, PACKET_US, 1000, big, TxPacer::MAX_PACKET - 10, big, 8, big, 2));
+  for (size_t i = 1; i < TxPacer::SLOTS; i++) {
+    CHECK(pacer.push(LOOPBACK, 5004, PACKET_US, 1000, big, 100));
+  }
+  CHECK(!pacer.push(LOOPBACK, 5004, PACKET_US, 1000, big, 100));
+  CHECK(pacer.stats().dropped == 1);
+  CHECK(pacer.depth() == TxPacer::SLOTS);
+  // Nothing leaves before the hold, then the backlog goes as one batch
+  UdpDatagram batch[TxPacer::SLOTS];
+  CHECK(pacer.due(1000 + HOLD_US - 1, batch, TxPacer::SLOTS) == 0);
+  CHECK(pacer.due(1000 + HOLD_US, batch, TxPacer::SLOTS) == TxPacer::SLOTS - BACKLOG);
+  CHECK(batch[0].len == TxPacer::MAX_PACKET);
+}
+
+// One thread pushes, another takes; every packet arrives once and in order
+static void test_threads() {
+  static TxPacer pacer;
+  pacer.begin(0, TxPacer::SLOTS);
+  const uint32_t packets = 500000;
+  std::thread producer([] {
+    uint8_t packet[64] = {};
+    for (uint32_t seq = 0; seq < packets;) {
+      memcpy(packet, &seq, sizeof(seq));
+      if (pacer.push(LOOPBACK, 5004, 0, 1, packet, sizeof(packet))) {
+        seq++;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+  uint32_t expected = 0;
+  bool ordered = true;
+  uint64_t now = 1;
+  while (expected < packets) {
+    UdpDatagram batch[TxPacer::SLOTS];
+    size_t count = pacer.due(now++, batch, TxPacer::SLOTS);
+    for (size_t i = 0; i < count; i++) {
+      uint32_t seq;
+      memcpy(&seq, batch[i].data, sizeof(seq));
+      ordered &= seq == expected++;
+    }
+    pacer.release(count);
+    if (count == 0) {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  CHECK(ordered);
+  CHECK(pacer.stats().sent == packets);
+  CHECK(pacer.depth() == 0);
+}
+
+// A batch goes out in one call (sendmmsg() on Linux) and arrives in order
+static void test_send_batch() {
+  UdpSocket socket;
+  uint16_t port = 0;
+  for (uint16_t p = 47104; p < 47120 && port == 0; p++) {
+    if (socket.open(p, 100)) {
+      port = p;
+    }
+  }
+  CHECK(port != 0);
+  if (port == 0) {
+    return;
+  }
+  uint8_t payloads[5][32];
+  UdpDatagram batch[5];
+  for (size_t i = 0; i < 5; i++) {
+    memset(payloads[i], (int) i, sizeof(payloads[i]));
+    batch[i] = UdpDatagram{LOOPBACK, port, payloads[i], sizeof(payloads[i]) - i};
+  }
+  CHECK(socket.send_batch(batch, 5) == 5);
+  for (size_t i = 0; i < 5; i++) {
+    uint8_t buf[64];
+    uint32_t ip;
+    uint16_t from;
+    int len = socket.receive(buf, sizeof(buf), &ip, &from);
+    CHECK(len == (int) (sizeof(payloads[i]) - i));
+    CHECK(len > 0 && buf[0] == i);
+    CHECK(ip == LOOPBACK && from == port);
+  }
+}
+
+int main() {
+  test_bursty_capture();
+  test_clock_offsets();
+  test_refusals();
+  test_threads();
+  test_send_batch();
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("tx_pacer: all checks passed\n");
+  return 0;
+}
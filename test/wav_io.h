@@ -0,0 +1,112 @@
+/*
+ * Minimal 16-bit PCM WAV reading and writing for the host harnesses. Any
+ * channel count; the reader takes WAVE_FORMAT_PCM and WAVE_FORMAT_EXTENSIBLE
+ * and skips chunks it does not know.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint32_t sample_rate;
+    uint16_t channels;
+    size_t frames;
+    int16_t *samples;  // Interleaved, frames * channels; free() when done
+} wav_t;
+
+static inline void wav_put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void wav_put32(uint8_t *p, uint32_t v)
+{
+    wav_put16(p, (uint16_t)v);
+    wav_put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static inline uint32_t wav_get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline int wav_write(const char *path, const int16_t *samples, size_t frames, uint16_t channels,
+                            uint32_t sample_rate)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+    uint32_t data_bytes = (uint32_t)(frames * channels * sizeof(int16_t));
+    uint8_t header[44];
+    memcpy(header, "RIFF", 4);
+    wav_put32(header + 4, 36 + data_bytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    wav_put32(header + 16, 16);
+    wav_put16(header + 20, 1);  // PCM
+    wav_put16(header + 22, channels);
+    wav_put32(header + 24, sample_rate);
+    wav_put32(header + 28, sample_rate * channels * 2);
+    wav_put16(header + 32, (uint16_t)(channels * 2));
+    wav_put16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    wav_put32(header + 40, data_bytes);
+    // Samples are little endian in the file, as on every host this runs on
+    int ok = fwrite(header, sizeof(header), 1, f) == 1 &&
+             fwrite(samples, sizeof(int16_t), frames * channels, f) == frames * channels;
+    return (fclose(f) == 0 && ok) ? 0 : -1;
+}
+
+static inline int wav_read(const char *path, wav_t *wav)
+{
+    memset(wav, 0, sizeof(*wav));
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+    uint8_t riff[12];
+    if (fread(riff, sizeof(riff), 1, f) != 1 || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) {
+        fclose(f);
+        return -1;
+    }
+    int have_fmt = 0;
+    uint8_t chunk[8];
+    while (fread(chunk, sizeof(chunk), 1, f) == 1) {
+        uint32_t size = wav_get32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            uint8_t fmt[16];
+            if (fread(fmt, sizeof(fmt), 1, f) != 1) {
+                break;
+            }
+            uint16_t tag = (uint16_t)(fmt[0] | (fmt[1] << 8));
+            uint16_t bits = (uint16_t)(fmt[14] | (fmt[15] << 8));
+            if ((tag != 1 && tag != 0xFFFE) || bits != 16) {
+                break;
+            }
+            wav->channels = (uint16_t)(fmt[2] | (fmt[3] << 8));
+            wav->sample_rate = wav_get32(fmt + 4);
+            have_fmt = wav->channels > 0;
+            fseek(f, (long)(size - 16 + (size & 1)), SEEK_CUR);
+        } else if (memcmp(chunk, "data", 4) == 0 && have_fmt) {
+            wav->frames = size / (wav->channels * sizeof(int16_t));
+            wav->samples = (int16_t *)malloc(wav->frames * wav->channels * sizeof(int16_t));
+            if (!wav->samples ||
+                fread(wav->samples, sizeof(int16_t), wav->frames * wav->channels, f) != wav->frames * wav->channels) {
+                free(wav->samples);
+                wav->samples = NULL;
+                break;
+            }
+            fclose(f);
+            return 0;
+        } else {
+            fseek(f, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+    fclose(f);
+    return -1;
+}
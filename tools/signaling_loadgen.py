@@ -0,0 +1,547 @@
+#!/usr/bin/env python3
+"""
+Signaling Load Generator
+
+Emulates a building full of intercom panels against a signaling server so we
+can find its breaking point before a rollout. Each virtual intercom speaks the
+same protocol as main/signaling_client.c and the ESPHome component:
+
+  join (roomId, clientId, sessionId) -> joined -> ready
+  caller re-joins the callee's room  -> ready (room has 2 peers)
+  offer -> answer -> trickle candidates
+  leave -> re-join own room (always-on mode)
+
+Only the Python standard library is used, so the tool runs on any Linux box.
+
+Usage:
+  python3 tools/signaling_loadgen.py --url ws://127.0.0.1:1880/endpoint/webrtc \
+      --clients 1000 --call-rate 20 --duration 120
+"""
+
+import argparse
+import asyncio
+import base64
+import json
+import os
+import random
+import struct
+import sys
+import time
+from urllib.parse import urlparse
+
+# ============================================================================
+# Minimal WebSocket client (RFC 6455, text frames only)
+# ============================================================================
+
+OP_CONT = 0x0
+OP_TEXT = 0x1
+OP_CLOSE = 0x8
+OP_PING = 0x9
+OP_PONG = 0xA
+
+
+class WebSocketClosed(Exception):
+    pass
+
+
+class WebSocket:
+    def __init__(self, reader, writer):
+        self.reader = reader
+        self.writer = writer
+        self.closed = False
+
+    @classmethod
+    async def connect(cls, url, timeout):
+        u = urlparse(url)
+        if u.scheme != "ws":
+            raise ValueError("only ws:// URLs are supported")
+        host = u.hostname
+        port = u.port or 80
+        path = u.path or "/"
+        if u.query:
+            path += "?" + u.query
+
+        reader, writer = await asyncio.wait_for(
+            asyncio.open_connection(host, port), timeout)
+        key = base64.b64encode(os.urandom(16)).decode()
+        request = (
+            f"GET {path} HTTP/1.1\r\n"
+            f"Host: {host}:{port}\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            f"Sec-WebSocket-Key: {key}\r\n"
+            "Sec-WebSocket-Version: 13\r\n\r\n"
+        )
+        writer.write(request.encode())
+        await writer.drain()
+
+        status = await asyncio.wait_for(reader.readline(), timeout)
+        if b" 101 " not in status:
+            writer.close()
+            raise ConnectionError(f"handshake failed: {status.decode().strip()}")
+        while True:
+            line = await asyncio.wait_for(reader.readline(), timeout)
+            if line in (b"\r\n", b""):
+                break
+        return cls(reader, writer)
+
+    async def _send_frame(self, opcode, payload):
+        header = bytearray([0x80 | opcode])
+        length = len(payload)
+        if length < 126:
+            header.append(0x80 | length)
+        elif length < 65536:
+            header.append(0x80 | 126)
+            header += struct.pack("!H", length)
+        else:
+            header.append(0x80 | 127)
+            header += struct.pack("!Q", length)
+        mask = os.urandom(4)
+        header += mask
+        masked = bytes(b ^ mask[i & 3] for i, b in enumerate(payload))
+        self.writer.write(bytes(header) + masked)
+        await self.writer.drain()
+
+    async def send_text(self, text):
+        if self.closed:
+            raise WebSocketClosed()
+        await self._send_frame(OP_TEXT, text.encode())
+
+    async def recv_text(self):
+        message = bytearray()
+        while True:
+            head = await self.reader.readexactly(2)
+            fin = head[0] & 0x80
+            opcode = head[0] & 0x0F
+            length = head[1] & 0x7F
+            if length == 126:
+                length = struct.unpack("!H", await self.reader.readexactly(2))[0]
+            elif length == 127:
+                length = struct.unpack("!Q", await self.reader.readexactly(8))[0]
+            if head[1] & 0x80:
+                mask = await self.reader.readexactly(4)
+                data = bytes(b ^ mask[i & 3] for i, b in
+                             enumerate(await self.reader.readexactly(length)))
+            else:
+                data = await self.reader.readexactly(length)
+
+            if opcode == OP_PING:
+                await self._send_frame(OP_PONG, data)
+                continue
+            if opcode == OP_CLOSE:
+                self.closed = True
+                raise WebSocketClosed()
+            if opcode in (OP_TEXT, OP_CONT):
+                message += data
+                if fin:
+                    return message.decode(errors="replace")
+
+    async def close(self):
+        if not self.closed:
+            self.closed = True
+            try:
+                await self._send_frame(OP_CLOSE, struct.pack("!H", 1000))
+            except (ConnectionError, OSError):
+                pass
+        self.writer.close()
+
+
+# ============================================================================
+# Statistics
+# ============================================================================
+
+def percentile(sorted_samples, pct):
+    if not sorted_samples:
+        return float("nan")
+    k = (len(sorted_samples) - 1) * pct / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(sorted_samples) - 1)
+    return sorted_samples[lo] + (sorted_samples[hi] - sorted_samples[lo]) * (k - lo)
+
+
+class Stats:
+    METRICS = ("join_rtt", "offer_relay", "answer_relay", "candidate_relay", "call_setup")
+
+    def __init__(self):
+        self.samples = {m: [] for m in self.METRICS}
+        self.counters = {
+            "connected": 0,
+            "connect_failed": 0,
+            "disconnected": 0,
+            "calls_attempted": 0,
+            "calls_established": 0,
+            "calls_failed": 0,
+            "calls_skipped": 0,
+            "room_full": 0,
+            "server_errors": 0,
+            "msgs_sent": 0,
+            "msgs_received": 0,
+        }
+        self.active_calls = 0
+
+    def add(self, metric, seconds):
+        self.samples[metric].append(seconds * 1000.0)
+
+    def summary(self):
+        out = {"counters": dict(self.counters), "latency_ms": {}}
+        for metric, values in self.samples.items():
+            s = sorted(values)
+            out["latency_ms"][metric] = {
+                "count": len(s),
+                "p50": percentile(s, 50),
+                "p90": percentile(s, 90),
+                "p99": percentile(s, 99),
+                "max": s[-1] if s else float("nan"),
+            }
+        return out
+
+
+# ============================================================================
+# Virtual intercom
+# ============================================================================
+
+class VirtualIntercom:
+    def __init__(self, index, args, stats, registry):
+        self.client_id = f"{args.client_prefix}{index:05d}"
+        self.session_id = ""
+        self.room_id = self.client_id
+        self.args = args
+        self.stats = stats
+        self.registry = registry  # shared send timestamps for relay latency
+        self.ws = None
+        self.busy = False
+        self.connected = False
+        self.waiters = {}
+        self.join_sent_at = 0.0
+
+    def _new_session_id(self):
+        # Same shape as generate_session_id_(): random word + uptime millis
+        millis = int(time.monotonic() * 1000) & 0xFFFFFFFF
+        self.session_id = f"{random.getrandbits(32):08X}{millis:08X}"
+
+    async def send(self, obj):
+        await self.ws.send_text(json.dumps(obj, separators=(",", ":")))
+        self.stats.counters["msgs_sent"] += 1
+
+    async def send_join(self):
+        self.join_sent_at = time.perf_counter()
+        await self.send({"type": "join", "roomId": self.room_id,
+                         "clientId": self.client_id, "sessionId": self.session_id})
+
+    def _expect(self, msg_type):
+        fut = asyncio.get_running_loop().create_future()
+        self.waiters[msg_type] = fut
+        return fut
+
+    def _resolve(self, msg_type, value):
+        fut = self.waiters.pop(msg_type, None)
+        if fut and not fut.done():
+            fut.set_result(value)
+
+    def _fail_waiters(self, exc):
+        for fut in self.waiters.values():
+            if not fut.done():
+                fut.set_exception(exc)
+        self.waiters.clear()
+
+    async def run(self):
+        try:
+            self.ws = await WebSocket.connect(self.args.url, self.args.timeout)
+        except (OSError, asyncio.TimeoutError, ConnectionError, ValueError):
+            self.stats.counters["connect_failed"] += 1
+            return
+        self.connected = True
+        self.stats.counters["connected"] += 1
+
+        # Always-on mode: join our own room so we can receive calls
+        self._new_session_id()
+        self.room_id = self.client_id
+        await self.send_join()
+
+        try:
+            while True:
+                text = await self.ws.recv_text()
+                now = time.perf_counter()
+                self.stats.counters["msgs_received"] += 1
+                try:
+                    msg = json.loads(text)
+                except ValueError:
+                    continue
+                await self.handle_message(msg, now)
+        except (WebSocketClosed, asyncio.IncompleteReadError, ConnectionError, OSError):
+            pass
+        finally:
+            self.connected = False
+            self.stats.counters["disconnected"] += 1
+            self._fail_waiters(WebSocketClosed())
+
+    async def handle_message(self, msg, now):
+        msg_type = msg.get("type", "")
+
+        if msg_type == "joined":
+            self.stats.add("join_rtt", now - self.join_sent_at)
+            await self.send({"type": "ready", "roomId": self.room_id})
+            self._resolve("joined", msg)
+
+        elif msg_type == "ready":
+            self._resolve("ready", msg)
+
+        elif msg_type == "offer":
+            self._record_relay("offer_relay", msg.get("sdp", ""), now)
+            self.busy = True
+            if self.args.answer_delay > 0:
+                await asyncio.sleep(self.args.answer_delay / 1000.0)
+            await self.send({"type": "answer", "sdp": self._make_sdp("answer")})
+            await self.trickle_candidates()
+
+        elif msg_type == "answer":
+            self._record_relay("answer_relay", msg.get("sdp", ""), now)
+            self._resolve("answer", msg)
+
+        elif msg_type == "candidate":
+            self._record_relay("candidate_relay", msg.get("candidate", ""), now)
+
+        elif msg_type == "leave":
+            # Mirror end_call() on the callee: leave, then return to own room
+            if self.busy and self.room_id == self.client_id:
+                self.busy = False
+                await self.send({"type": "leave"})
+                self._new_session_id()
+                await self.send_join()
+
+        elif msg_type == "error":
+            if msg.get("message") == "room_full":
+                self.stats.counters["room_full"] += 1
+            else:
+                self.stats.counters["server_errors"] += 1
+            self._fail_waiters(RuntimeError(msg.get("message", "error")))
+
+        elif msg_type == "replaced":
+            self.stats.counters["server_errors"] += 1
+
+    def _tag(self):
+        tag = self.registry["next"]
+        self.registry["next"] += 1
+        self.registry["sent"][tag] = time.perf_counter()
+        return tag
+
+    def _record_relay(self, metric, text, now):
+        # Tags are embedded as "lg<N>" so relay latency is measured on one clock
+        start = text.find("lg")
+        if start < 0:
+            return
+        end = start + 2
+        while end < len(text) and text[end].isdigit():
+            end += 1
+        sent = self.registry["sent"].pop(int(text[start + 2:end] or -1), None)
+        if sent is not None:
+            self.stats.add(metric, now - sent)
+
+    def _make_sdp(self, kind):
+        # Realistically sized SDP so the server sees representative payloads
+        tag = self._tag()
+        lines = [
+            "v=0",
+            f"o=- lg{tag} 2 IN IP4 127.0.0.1",
+            f"s={kind}",
+            "t=0 0",
+            "a=group:BUNDLE 0",
+            "m=audio 9 UDP/TLS/RTP/SAVPF 111 0 8",
+            "c=IN IP4 0.0.0.0",
+            f"a=ice-ufrag:{random.getrandbits(32):08x}",
+            f"a=ice-pwd:{random.getrandbits(128):032x}",
+            "a=fingerprint:sha-256 " + ":".join(f"{b:02X}" for b in os.urandom(32)),
+            "a=setup:actpass" if kind == "offer" else "a=setup:active",
+            "a=mid:0",
+            "a=sendrecv",
+            "a=rtcp-mux",
+            "a=rtpmap:111 opus/48000/2",
+            "a=fmtp:111 minptime=10;useinbandfec=1",
+            "a=rtpmap:0 PCMU/8000",
+            "a=rtpmap:8 PCMA/8000",
+        ]
+        lines += ["a=x-pad:" + "0" * 64] * self.args.sdp_padding
+        return "\r\n".join(lines) + "\r\n"
+
+    async def trickle_candidates(self):
+        for i in range(self.args.candidates):
+            tag = self._tag()
+            port = 50000 + random.randrange(10000)
+            await self.send({
+                "type": "candidate",
+                "candidate": f"candidate:lg{tag} 1 udp {2122260223 - i} "
+                             f"192.168.{i % 256}.{random.randrange(1, 255)} {port} typ host",
+            })
+
+    async def place_call(self, callee):
+        """Caller side of start_call(): join callee room, wait ready, offer."""
+        self.busy = True
+        callee.busy = True
+        self.stats.counters["calls_attempted"] += 1
+        self.stats.active_calls += 1
+        t0 = time.perf_counter()
+        try:
+            self.room_id = callee.client_id
+            self._new_session_id()
+            ready = self._expect("ready")
+            await self.send_join()
+            await asyncio.wait_for(ready, self.args.timeout)
+
+            answer = self._expect("answer")
+            await self.send({"type": "offer", "sdp": self._make_sdp("offer"),
+                             "clientId": self.client_id})
+            await self.trickle_candidates()
+            await asyncio.wait_for(answer, self.args.timeout)
+
+            self.stats.add("call_setup", time.perf_counter() - t0)
+            self.stats.counters["calls_established"] += 1
+            await asyncio.sleep(random.expovariate(1.0 / self.args.call_hold))
+        except (asyncio.TimeoutError, RuntimeError, WebSocketClosed):
+            self.stats.counters["calls_failed"] += 1
+        finally:
+            self.waiters.pop("ready", None)
+            self.waiters.pop("answer", None)
+            self.stats.active_calls -= 1
+            if self.connected:
+                try:
+                    # end_call(): leave, then return to own room
+                    await self.send({"type": "leave"})
+                    self.room_id = self.client_id
+                    self._new_session_id()
+                    await self.send_join()
+                except (WebSocketClosed, ConnectionError, OSError):
+                    pass
+            self.busy = False
+            if callee.room_id == callee.client_id:
+                callee.busy = False
+
+
+# ============================================================================
+# Load driver
+# ============================================================================
+
+async def connect_all(intercoms, args):
+    tasks = []
+    interval = 1.0 / args.connect_rate if args.connect_rate > 0 else 0.0
+    for vi in intercoms:
+        tasks.append(asyncio.create_task(vi.run()))
+        if interval:
+            await asyncio.sleep(interval)
+    return tasks
+
+
+async def drive_calls(intercoms, args, stats, deadline):
+    calls = set()
+    while time.monotonic() < deadline:
+        # Poisson arrivals at the configured call rate
+        await asyncio.sleep(random.expovariate(args.call_rate))
+        idle = [vi for vi in intercoms if vi.connected and not vi.busy]
+        if len(idle) < 2:
+            stats.counters["calls_skipped"] += 1
+            continue
+        caller, callee = random.sample(idle, 2)
+        task = asyncio.create_task(caller.place_call(callee))
+        calls.add(task)
+        task.add_done_callback(calls.discard)
+    if calls:
+        await asyncio.wait(calls, timeout=args.timeout + args.call_hold * 4)
+
+
+async def report_progress(stats, interval, start):
+    last_sent = last_recv = 0
+    while True:
+        await asyncio.sleep(interval)
+        c = stats.counters
+        sent_rate = (c["msgs_sent"] - last_sent) / interval
+        recv_rate = (c["msgs_received"] - last_recv) / interval
+        last_sent, last_recv = c["msgs_sent"], c["msgs_received"]
+        setup = sorted(stats.samples["call_setup"][-500:])
+        print(f"[{time.monotonic() - start:7.1f}s] clients={c['connected'] - c['disconnected']} "
+              f"active_calls={stats.active_calls} established={c['calls_established']} "
+              f"failed={c['calls_failed']} tx={sent_rate:.0f}/s rx={recv_rate:.0f}/s "
+              f"setup_p50={percentile(setup, 50):.1f}ms setup_p99={percentile(setup, 99):.1f}ms",
+              flush=True)
+
+
+def print_summary(summary, elapsed):
+    c = summary["counters"]
+    print("\n========================================")
+    print("Signaling Load Test Summary")
+    print("========================================")
+    print(f"Duration:            {elapsed:.1f}s")
+    for key, value in c.items():
+        print(f"{key + ':':<21}{value}")
+    print(f"{'msgs/s (tx/rx):':<21}{c['msgs_sent'] / elapsed:.0f} / {c['msgs_received'] / elapsed:.0f}")
+    print("\nLatency (ms)          count      p50      p90      p99      max")
+    for metric, v in summary["latency_ms"].items():
+        print(f"  {metric:<18}{v['count']:>8} {v['p50']:>8.2f} {v['p90']:>8.2f} "
+              f"{v['p99']:>8.2f} {v['max']:>8.2f}")
+
+
+async def main_async(args):
+    stats = Stats()
+    registry = {"next": 0, "sent": {}}
+    intercoms = [VirtualIntercom(i, args, stats, registry) for i in range(args.clients)]
+
+    start = time.monotonic()
+    reporter = asyncio.create_task(report_progress(stats, args.report_interval, start))
+    client_tasks = await connect_all(intercoms, args)
+    await asyncio.sleep(args.settle)
+
+    await drive_calls(intercoms, args, stats, time.monotonic() + args.duration)
+    elapsed = time.monotonic() - start
+
+    reporter.cancel()
+    for vi in intercoms:
+        if vi.ws:
+            await vi.ws.close()
+    await asyncio.gather(*client_tasks, return_exceptions=True)
+
+    summary = stats.summary()
+    summary["elapsed_s"] = elapsed
+    summary["config"] = vars(args)
+    print_summary(summary, elapsed)
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(summary, f, indent=2)
+        print(f"\nWrote {args.json}")
+
+    return 0 if stats.counters["calls_failed"] == 0 else 1
+
+
+def parse_args(argv):
+    p = argparse.ArgumentParser(description="Emulate many intercom panels against a signaling server")
+    p.add_argument("--url", default="ws://127.0.0.1:1880/endpoint/webrtc",
+                   help="Signaling server WebSocket URL")
+    p.add_argument("--clients", type=int, default=200, help="Number of virtual intercoms")
+    p.add_argument("--connect-rate", type=float, default=200.0,
+                   help="New WebSocket connections per second during ramp-up (0 = all at once)")
+    p.add_argument("--call-rate", type=float, default=5.0, help="Mean call arrivals per second")
+    p.add_argument("--call-hold", type=float, default=5.0, help="Mean call duration in seconds")
+    p.add_argument("--duration", type=float, default=60.0, help="Call-generation phase length in seconds")
+    p.add_argument("--settle", type=float, default=2.0, help="Seconds to wait after ramp-up")
+    p.add_argument("--candidates", type=int, default=4, help="ICE candidates trickled per side")
+    p.add_argument("--sdp-padding", type=int, default=0,
+                   help="Extra 64-byte attribute lines per SDP to emulate larger offers")
+    p.add_argument("--answer-delay", type=float, default=0.0,
+                   help="Emulated answer generation time on the callee in milliseconds")
+    p.add_argument("--timeout", type=float, default=10.0, help="Per-step timeout in seconds")
+    p.add_argument("--client-prefix", default="loadgen-", help="clientId prefix for virtual intercoms")
+    p.add_argument("--report-interval", type=float, default=5.0, help="Progress report period in seconds")
+    p.add_argument("--json", help="Write the summary as JSON to this path")
+    args = p.parse_args(argv)
+    if args.call_rate <= 0:
+        p.error("--call-rate must be positive")
+    return args
+
+
+def main(argv=None):
+    args = parse_args(argv)
+    try:
+        return asyncio.run(main_async(args))
+    except KeyboardInterrupt:
+        return 130
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""
+Local STUN Server
+
+Minimal RFC 5389 Binding responder for testing the intercom's ICE setup on a
+bench network without reaching a public STUN server. It answers on the same
+port coturn uses (3478), so a panel configured with
+
+  ice_servers:
+    - url: stun:<this-host>:3478
+
+works unchanged against this script or a real coturn instance. For TURN
+(relay) testing run coturn itself, e.g.:
+
+  turnserver -n --listening-port 3478 --lt-cred-mech \
+      --user intercom:intercom --realm intercom.local --no-tls --no-dtls
+
+Usage:
+  python3 tools/stun_server.py [--port 3478] [--delay-ms 0] [--drop 0.0]
+"""
+
+import argparse
+import asyncio
+import binascii
+import random
+import socket
+import struct
+import sys
+
+MAGIC_COOKIE = 0x2112A442
+
+BINDING_REQUEST = 0x0001
+BINDING_SUCCESS = 0x0101
+
+ATTR_MAPPED_ADDRESS = 0x0001
+ATTR_ERROR_CODE = 0x0009
+ATTR_XOR_MAPPED_ADDRESS = 0x0020
+ATTR_SOFTWARE = 0x8022
+ATTR_FINGERPRINT = 0x8028
+
+SOFTWARE = b"esp32-intercom test STUN"
+
+
+def attribute(attr_type, value):
+    padding = (4 - len(value) % 4) % 4
+    return struct.pack("!HH", attr_type, len(value)) + value + b"\x00" * padding
+
+
+def address_value(family_ip, port, xor_transaction=None):
+    host, ip_bytes, family = family_ip
+    if xor_transaction is None:
+        return struct.pack("!BBH", 0, family, port) + ip_bytes
+    xport = port ^ (MAGIC_COOKIE >> 16)
+    key = struct.pack("!I", MAGIC_COOKIE) + xor_transaction
+    xip = bytes(b ^ key[i] for i, b in enumerate(ip_bytes))
+    return struct.pack("!BBH", 0, family, xport) + xip
+
+
+def build_message(msg_type, transaction_id, attributes):
+    body = b"".join(attributes)
+    # Length must include the FINGERPRINT attribute when computing its CRC
+    header = struct.pack("!HHI", msg_type, len(body) + 8, MAGIC_COOKIE) + transaction_id
+    crc = (binascii.crc32(header + body) ^ 0x5354554E) & 0xFFFFFFFF
+    return header + body + attribute(ATTR_FINGERPRINT, struct.pack("!I", crc))
+
+
+class StunProtocol(asyncio.DatagramProtocol):
+    def __init__(self, args):
+        self.args = args
+        self.transport = None
+        self.requests = 0
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def datagram_received(self, data, addr):
+        if len(data) < 20:
+            return
+        msg_type, length, cookie = struct.unpack("!HHI", data[:8])
+        transaction_id = data[8:20]
+        # Top two bits are zero for STUN; anything else is RTP/DTLS noise
+        if cookie != MAGIC_COOKIE or msg_type & 0xC000 or length + 20 > len(data):
+            return
+        if self.args.drop and random.random() < self.args.drop:
+            return
+
+        self.requests += 1
+        if msg_type != BINDING_REQUEST:
+            # TURN methods (Allocate, Refresh, ...) are coturn's job
+            reply = build_message(
+                (msg_type & 0x3EEF) | 0x0110, transaction_id,
+                [attribute(ATTR_ERROR_CODE, struct.pack("!HBB", 0, 4, 0) + b"Bad Request"),
+                 attribute(ATTR_SOFTWARE, SOFTWARE)])
+        else:
+            host, port = addr[0], addr[1]
+            if ":" in host:
+                family_ip = (host, socket.inet_pton(socket.AF_INET6, host), 0x02)
+            else:
+                family_ip = (host, socket.inet_aton(host), 0x01)
+            reply = build_message(BINDING_SUCCESS, transaction_id, [
+                attribute(ATTR_XOR_MAPPED_ADDRESS, address_value(family_ip, port, transaction_id)),
+                attribute(ATTR_MAPPED_ADDRESS, address_value(family_ip, port)),
+                attribute(ATTR_SOFTWARE, SOFTWARE),
+            ])
+            if self.args.verbose:
+                print(f"Binding request from {host}:{port}", flush=True)
+
+        if self.args.delay_ms > 0:
+            # Emulate a WAN round trip to exercise host-vs-srflx prioritisation
+            asyncio.get_running_loop().call_later(
+                self.args.delay_ms / 1000.0, self.transport.sendto, reply, addr)
+        else:
+            self.transport.sendto(reply, addr)
+
+
+async def main_async(args):
+    loop = asyncio.get_running_loop()
+    transport, protocol = await loop.create_datagram_endpoint(
+        lambda: StunProtocol(args), local_addr=(args.bind, args.port))
+    print(f"STUN server listening on {args.bind}:{args.port}", flush=True)
+    try:
+        await asyncio.Event().wait()
+    finally:
+        transport.close()
+        print(f"Served {protocol.requests} requests")
+
+
+def main(argv=None):
+    p = argparse.ArgumentParser(description="Minimal STUN Binding server for ICE testing")
+    p.add_argument("--bind", default="0.0.0.0", help="Address to listen on")
+    p.add_argument("--port", type=int, default=3478, help="UDP port (coturn default 3478)")
+    p.add_argument("--delay-ms", type=float, default=0.0, help="Added response delay in milliseconds")
+    p.add_argument("--drop", type=float, default=0.0, help="Probability of dropping a request")
+    p.add_argument("-v", "--verbose", action="store_true", help="Log every binding request")
+    args = p.parse_args(argv)
+    try:
+        asyncio.run(main_async(args))
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,261 @@
+#!/usr/bin/env python3
+"""
+Telemetry Decoder
+
+Decodes the binary call quality frames built by telemetry.cpp. Panels send
+them as UDP datagrams straight to a collector (set_telemetry_collector) or as
+WebSocket binary messages to the signaling server, whose Node-RED flow
+forwards them to 127.0.0.1:5599. Either way they end up here.
+
+Frames are self-describing: the schema (metric names, types, units, scales
+and histogram buckets) is repeated every few frames, and frames from a panel
+whose schema has not been seen yet are counted and skipped.
+
+Only the Python standard library is used, so the tool runs on any Linux box.
+
+Usage:
+  python3 tools/telemetry_decode.py [--bind 0.0.0.0] [--port 5599]
+  python3 tools/telemetry_decode.py --csv metrics.csv --record frames.bin
+  python3 tools/telemetry_decode.py --file frames.bin
+"""
+
+import argparse
+import csv
+import socket
+import struct
+import sys
+import time
+
+MAGIC = b"ITM"
+VERSION = 1
+FLAG_SCHEMA = 0x01
+
+COUNTER = 1
+GAUGE = 2
+HISTOGRAM = 3
+
+
+class DecodeError(Exception):
+    pass
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def take(self, n):
+        if self.pos + n > len(self.data):
+            raise DecodeError("truncated frame")
+        chunk = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return chunk
+
+    def u8(self):
+        return self.take(1)[0]
+
+    def unpack(self, fmt):
+        return struct.unpack(fmt, self.take(struct.calcsize(fmt)))
+
+    def varint(self):
+        value = 0
+        shift = 0
+        while True:
+            byte = self.u8()
+            value |= (byte & 0x7F) << shift
+            if not byte & 0x80:
+                return value
+            shift += 7
+            if shift > 28:
+                raise DecodeError("varint too long")
+
+    def string(self):
+        return self.take(self.u8()).decode("utf-8", "replace")
+
+
+def zigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def scaled(value, scale):
+    """Apply a metric's decimal places; unscaled values stay integers."""
+    return value / (10 ** scale) if scale else value
+
+
+def parse_schema(r):
+    name = r.string()
+    metrics = []
+    for _ in range(r.u8()):
+        mtype, scale = r.u8(), r.u8()
+        metric = {"type": mtype, "scale": scale, "name": r.string(), "unit": r.string()}
+        if mtype == HISTOGRAM:
+            metric["bounds"] = [scaled(r.varint(), scale) for _ in range(r.u8())]
+        elif mtype not in (COUNTER, GAUGE):
+            raise DecodeError(f"unknown metric type {mtype}")
+        metrics.append(metric)
+    return {"name": name, "metrics": metrics}
+
+
+def decode_frame(data, schemas):
+    """Return (device name, seq, [(uptime_ms, {metric: value})]) or None if the schema is unknown."""
+    r = Reader(data)
+    if r.take(3) != MAGIC:
+        raise DecodeError("bad magic")
+    version = r.u8()
+    if version != VERSION:
+        raise DecodeError(f"unsupported version {version}")
+    flags = r.u8()
+    seq, device_id, start_ms = r.unpack("<HII")
+    if flags & FLAG_SCHEMA:
+        schemas[device_id] = parse_schema(r)
+    schema = schemas.get(device_id)
+    if schema is None:
+        return None
+
+    snapshots = []
+    for _ in range(r.u8()):
+        uptime = start_ms + r.varint()
+        values = {}
+        for m in schema["metrics"]:
+            if m["type"] == COUNTER:
+                values[m["name"]] = scaled(r.varint(), m["scale"])
+            elif m["type"] == GAUGE:
+                values[m["name"]] = scaled(zigzag(r.varint()), m["scale"])
+            else:
+                values[m["name"]] = [r.varint() for _ in range(len(m["bounds"]) + 1)]
+        snapshots.append((uptime, values))
+    return schema, seq, snapshots
+
+
+def percentile(bounds, counts, q):
+    """Upper bound of the bucket holding the q-quantile; '>' the last bound for the open bucket."""
+    total = sum(counts)
+    if total == 0:
+        return None
+    rank = q * total
+    seen = 0
+    for i, count in enumerate(counts):
+        seen += count
+        if seen >= rank:
+            return bounds[i] if i < len(bounds) else f">{bounds[-1]}"
+    return None
+
+
+def format_value(metric, value):
+    unit = metric["unit"]
+    if metric["type"] == HISTOGRAM:
+        n = sum(value)
+        if n == 0:
+            return "-"
+        p50 = percentile(metric["bounds"], value, 0.5)
+        p95 = percentile(metric["bounds"], value, 0.95)
+        return f"n={n} p50<={p50}{unit} p95<={p95}{unit}"
+    if metric["scale"]:
+        return f"{value:.{metric['scale']}f}{unit}"
+    return f"{value:g}{unit}" if isinstance(value, float) else f"{value}{unit}"
+
+
+class Decoder:
+    def __init__(self, args):
+        self.args = args
+        self.schemas = {}
+        self.last_seq = {}
+        self.frames = 0
+        self.no_schema = 0
+        self.errors = 0
+        self.lost = 0
+        self.csv = None
+        if args.csv:
+            self.csv_file = open(args.csv, "w", newline="")
+            self.csv = csv.writer(self.csv_file)
+            self.csv.writerow(["time", "device", "uptime_ms", "metric", "value", "unit"])
+        self.record = open(args.record, "ab") if args.record else None
+
+    def feed(self, data, source=""):
+        if self.record:
+            self.record.write(struct.pack("<H", len(data)) + data)
+        try:
+            result = decode_frame(data, self.schemas)
+        except DecodeError as e:
+            self.errors += 1
+            print(f"{source}: {e}", file=sys.stderr)
+            return
+        if result is None:
+            self.no_schema += 1
+            return
+        schema, seq, snapshots = result
+        self.frames += 1
+
+        device = schema["name"]
+        last = self.last_seq.get(device)
+        if last is not None and seq != (last + 1) & 0xFFFF:
+            self.lost += (seq - last - 1) & 0xFFFF
+        self.last_seq[device] = seq
+
+        now = time.strftime("%Y-%m-%d %H:%M:%S")
+        for uptime, values in snapshots:
+            if self.csv:
+                for m in schema["metrics"]:
+                    value = values[m["name"]]
+                    if m["type"] == HISTOGRAM:
+                        value = " ".join(str(c) for c in value)
+                    self.csv.writerow([now, device, uptime, m["name"], value, m["unit"]])
+            if not self.args.quiet:
+                fields = "  ".join(f"{m['name']}={format_value(m, values[m['name']])}"
+                                   for m in schema["metrics"])
+                print(f"{now} {device} +{uptime / 1000:.1f}s  {fields}", flush=True)
+
+    def close(self):
+        if self.csv:
+            self.csv_file.close()
+        if self.record:
+            self.record.close()
+        print(f"{self.frames} frames decoded, {self.lost} lost, {self.no_schema} waiting for schema, "
+              f"{self.errors} malformed", file=sys.stderr)
+
+
+def read_recording(path, decoder):
+    with open(path, "rb") as f:
+        while True:
+            header = f.read(2)
+            if len(header) < 2:
+                break
+            (length,) = struct.unpack("<H", header)
+            decoder.feed(f.read(length), path)
+
+
+def listen(args, decoder):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind((args.bind, args.port))
+    print(f"Listening for telemetry on {args.bind}:{args.port}", file=sys.stderr, flush=True)
+    while True:
+        data, addr = sock.recvfrom(65535)
+        decoder.feed(data, f"{addr[0]}:{addr[1]}")
+
+
+def main(argv=None):
+    p = argparse.ArgumentParser(description="Decode intercom binary telemetry")
+    p.add_argument("--bind", default="0.0.0.0", help="Address to listen on")
+    p.add_argument("--port", type=int, default=5599, help="UDP port to listen on")
+    p.add_argument("--file", help="Decode a recording made with --record instead of listening")
+    p.add_argument("--record", help="Append raw frames to this file")
+    p.add_argument("--csv", help="Write one row per metric per snapshot to this file")
+    p.add_argument("-q", "--quiet", action="store_true", help="Do not print snapshots")
+    args = p.parse_args(argv)
+
+    decoder = Decoder(args)
+    try:
+        if args.file:
+            read_recording(args.file, decoder)
+        else:
+            listen(args, decoder)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        decoder.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,128 @@
+#include "tx_pacer.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace intercom {
+
+static uint32_t deviation_us(uint64_t gap_us, uint32_t expected_us) {
+  return gap_us > expected_us ? (uint32_t) (gap_us - expected_us) : (uint32_t) (expected_us - gap_us);
+}
+
+void TxPacer::begin(uint32_t hold_us, size_t backlog) {
+  head_.store(0, std::memory_order_relaxed);
+  tail_.store(0, std::memory_order_relaxed);
+  hold_us_ = hold_us;
+  backlog_ = backlog < SLOTS ? backlog : SLOTS;
+  idle_ = true;
+  restarted_ = true;
+  next_due_us_ = 0;
+  last_sent_us_ = 0;
+  last_duration_us_ = 0;
+  last_pushed_us_ = 0;
+  last_push_duration_us_ = 0;
+  stats_ = PacerStats{};
+}
+
+bool TxPacer::push(uint32_t ip, uint16_t port, uint32_t duration_us, uint64_t now_us, const uint8_t *data,
+                   size_t len, const uint8_t *more, size_t more_len, const uint8_t *tail, size_t tail_len) {
+  if (last_pushed_us_ != 0) {
+    smooth_(&stats_.capture_jitter_us, deviation_us(now_us - last_pushed_us_, last_push_duration_us_));
+  }
+  last_pushed_us_ = now_us;
+  last_push_duration_us_ = duration_us;
+
+  uint32_t t = tail_.load(std::memory_order_relaxed);
+  if (len + more_len + tail_len > MAX_PACKET) {
+    stats_.oversized++;
+    return false;
+  }
+  if (t - head_.load(std::memory_order_acquire) >= SLOTS) {
+    stats_.dropped++;
+    return false;
+  }
+  Slot &slot = slots_[t % SLOTS];
+  memcpy(slot.data, data, len);
+  if (more_len > 0) {
+    memcpy(slot.data + len, more, more_len);
+  }
+  if (tail_len > 0) {
+    memcpy(slot.data + len + more_len, tail, tail_len);
+  }
+  slot.datagram = UdpDatagram{ip, port, slot.data, len + more_len + tail_len};
+  slot.duration_us = duration_us;
+  slot.pushed_us = now_us;
+  tail_.store(t + 1, std::memory_order_release);
+  return true;
+}
+
+size_t TxPacer::due(uint64_t now_us, UdpDatagram *out, size_t max) {
+  uint32_t h = head_.load(std::memory_order_relaxed);
+  size_t depth = tail_.load(std::memory_order_acquire) - h;
+  if (depth == 0) {
+    if (!idle_ && now_us >= next_due_us_) {
+      idle_ = true;
+      restarted_ = true;
+      stats_.underruns++;
+    }
+    return 0;
+  }
+  if (idle_) {
+    idle_ = false;
+    next_due_us_ = slots_[h % SLOTS].pushed_us + hold_us_;
+  }
+  if (now_us < next_due_us_ || max == 0) {
+    return 0;
+  }
+
+  size_t count = depth > backlog_ + 1 ? depth - backlog_ : 1;
+  if (count > max) {
+    count = max;
+  }
+  for (size_t i = 0; i < count; i++) {
+    out[i] = slots_[(h + i) % SLOTS].datagram;
+  }
+  // Packets batched onto this departure take no time of their own: that
+  // is the delay they cut
+  uint32_t duration = slots_[h % SLOTS].duration_us;
+
+  if (restarted_) {
+    restarted_ = false;
+    stats_.last_deviation_us = -1;
+  } else {
+    uint32_t deviation = deviation_us(now_us - last_sent_us_, last_duration_us_);
+    smooth_(&stats_.jitter_us, deviation);
+    if (deviation > stats_.max_jitter_us) {
+      stats_.max_jitter_us = deviation;
+    }
+    stats_.last_deviation_us = (int32_t) deviation;
+  }
+  last_sent_us_ = now_us;
+  last_duration_us_ = duration;
+  stats_.sent += count;
+  stats_.batched += count - 1;
+
+  next_due_us_ += duration;
+  if (next_due_us_ <= now_us) {
+    next_due_us_ = now_us + duration;
+  }
+  return count;
+}
+
+void TxPacer::release(size_t count) {
+  head_.store(head_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+}
+
+uint64_t TxPacer::next_due_us() const {
+  if (!idle_) {
+    return next_due_us_;
+  }
+  uint32_t h = head_.load(std::memory_order_relaxed);
+  if (tail_.load(std::memory_order_acquire) == h) {
+    return 0;
+  }
+  return slots_[h % SLOTS].pushed_us + hold_us_;
+}
+
+}  // namespace intercom
+}  // namespace esphome
@@ -0,0 +1,104 @@
+/*
+ * Transmit Pacer
+ * Spaces outgoing RTP packets by their duration, whatever the size of the
+ * blocks capture hands them over in. A capture task push()es each packet
+ * as it is built; a timer calls due() and sends what it returns, one
+ * packet per packet time, so the receiver sees them arrive as evenly as
+ * they were recorded.
+ *
+ * The first packet after an idle spell leaves hold_us after it was pushed,
+ * which absorbs the capture task's own scheduling jitter. When more than
+ * `backlog` packets are waiting (the capture clock runs fast, or the timer
+ * was held up), the excess goes out at once as a batch rather than growing
+ * the delay. A late timer does not cause a burst: the schedule restarts
+ * from now instead of catching up.
+ *
+ * Pacing jitter is the deviation of each gap between departures from the
+ * duration of the packet before it, smoothed like RFC 3550 interarrival
+ * jitter; the same measure over push() times shows how bursty capture is.
+ *
+ * One producer and one consumer, which may be different tasks: the slots
+ * are handed over through two atomic indexes, with no lock. Plain C++
+ * with the time passed in, so the same code runs on the host.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "udp_socket.h"
+
+namespace esphome {
+namespace intercom {
+
+struct PacerStats {
+  uint32_t sent{0};
+  uint32_t batched{0};    // Sent straight after another to cut the backlog
+  uint32_t dropped{0};    // Pushed while every slot was full
+  uint32_t oversized{0};  // Pushed larger than MAX_PACKET
+  uint32_t underruns{0};  // Nothing was ready when a packet was due
+  uint32_t jitter_us{0};
+  uint32_t max_jitter_us{0};  // Largest single deviation
+  uint32_t capture_jitter_us{0};
+  int32_t last_deviation_us{-1};  // Of the latest departure; -1 after a restart
+};
+
+class TxPacer {
+ public:
+  static constexpr size_t SLOTS = 8;
+  static constexpr size_t MAX_PACKET = 1472;  // UDP payload in a 1500-byte MTU
+
+  // Forgets queued packets and statistics. Call while neither side runs.
+  void begin(uint32_t hold_us, size_t backlog);
+
+  // Producer. Queues one datagram made of up to three pieces, lasting
+  // duration_us; false if it is over MAX_PACKET or every slot is taken.
+  bool push(uint32_t ip, uint16_t port, uint32_t duration_us, uint64_t now_us, const uint8_t *data, size_t len,
+            const uint8_t *more = nullptr, size_t more_len = 0, const uint8_t *tail = nullptr, size_t tail_len = 0);
+
+  // Consumer. Fills out with up to max datagrams to send now and returns
+  // how many; they stay valid until release().
+  size_t due(uint64_t now_us, UdpDatagram *out, size_t max);
+  void release(size_t count);
+  // When due() next has something, or 0 while idle with nothing queued
+  uint64_t next_due_us() const;
+
+  size_t depth() const { return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire); }
+  // Each side writes its own fields; other tasks read them for reporting
+  const PacerStats &stats() const { return stats_; }
+
+ protected:
+  struct Slot {
+    UdpDatagram datagram;
+    uint32_t duration_us;
+    uint64_t pushed_us;
+    uint8_t data[MAX_PACKET];
+  };
+
+  static void smooth_(uint32_t *jitter, uint32_t deviation) {
+    *jitter += ((int32_t) deviation - (int32_t) *jitter) / 16;
+  }
+
+  Slot slots_[SLOTS];
+  std::atomic<uint32_t> head_{0};  // Next slot due(); only the consumer moves it
+  std::atomic<uint32_t> tail_{0};  // Next slot push(); only the producer moves it
+  uint32_t hold_us_{0};
+  size_t backlog_{SLOTS};
+
+  // Consumer
+  bool idle_{true};
+  bool restarted_{true};  // No departure since the last idle spell to measure from
+  uint64_t next_due_us_{0};
+  uint64_t last_sent_us_{0};
+  uint32_t last_duration_us_{0};
+  // Producer
+  uint64_t last_pushed_us_{0};
+  uint32_t last_push_duration_us_{0};
+
+  PacerStats stats_;
+};
+
+}  // namespace intercom
+}  // namespace esphome
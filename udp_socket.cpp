@@ -0,0 +1,148 @@
+#include "udp_socket.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace esphome {
+namespace intercom {
+
+bool set_socket_dscp(int fd, uint8_t dscp) {
+  if (fd < 0) {
+    return false;
+  }
+  // The code point is the upper six bits of the old TOS byte
+  int tos = (dscp & 0x3F) << 2;
+  return setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) == 0;
+}
+
+bool UdpSocket::open(uint16_t port, uint32_t receive_timeout_ms) {
+  close();
+  fd_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (fd_ < 0) {
+    return false;
+  }
+
+  int reuse = 1;
+  setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  struct timeval timeout;
+  timeout.tv_sec = receive_timeout_ms / 1000;
+  timeout.tv_usec = (receive_timeout_ms % 1000) * 1000;
+  setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd_, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void UdpSocket::close() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool UdpSocket::send(uint32_t ip, uint16_t port, const uint8_t *data, size_t len, const uint8_t *more,
+                     size_t more_len, const uint8_t *tail, size_t tail_len) {
+  if (fd_ < 0) {
+    return false;
+  }
+  struct sockaddr_in to;
+  memset(&to, 0, sizeof(to));
+  to.sin_family = AF_INET;
+  to.sin_port = htons(port);
+  to.sin_addr.s_addr = htonl(ip);
+
+  struct iovec iov[3];
+  int count = 0;
+  iov[count].iov_base = const_cast<uint8_t *>(data);
+  iov[count++].iov_len = len;
+  if (more_len > 0) {
+    iov[count].iov_base = const_cast<uint8_t *>(more);
+    iov[count++].iov_len = more_len;
+  }
+  if (tail_len > 0) {
+    iov[count].iov_base = const_cast<uint8_t *>(tail);
+    iov[count++].iov_len = tail_len;
+  }
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name = &to;
+  msg.msg_namelen = sizeof(to);
+  msg.msg_iov = iov;
+  msg.msg_iovlen = count;
+  return sendmsg(fd_, &msg, 0) == (ssize_t) (len + more_len + tail_len);
+}
+
+size_t UdpSocket::send_batch(const UdpDatagram *datagrams, size_t count) {
+  if (fd_ < 0) {
+    return 0;
+  }
+#ifdef __linux__
+  static constexpr size_t BATCH = 16;
+  size_t sent = 0;
+  while (sent < count) {
+    struct sockaddr_in to[BATCH];
+    struct iovec iov[BATCH];
+    struct mmsghdr msgs[BATCH];
+    size_t n = count - sent < BATCH ? count - sent : BATCH;
+    memset(msgs, 0, sizeof(msgs));
+    for (size_t i = 0; i < n; i++) {
+      const UdpDatagram &d = datagrams[sent + i];
+      memset(&to[i], 0, sizeof(to[i]));
+      to[i].sin_family = AF_INET;
+      to[i].sin_port = htons(d.port);
+      to[i].sin_addr.s_addr = htonl(d.ip);
+      iov[i].iov_base = const_cast<uint8_t *>(d.data);
+      iov[i].iov_len = d.len;
+      msgs[i].msg_hdr.msg_name = &to[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(to[i]);
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int done = sendmmsg(fd_, msgs, n, 0);
+    if (done <= 0) {
+      break;
+    }
+    sent += done;
+  }
+  return sent;
+#else
+  size_t sent = 0;
+  while (sent < count && send(datagrams[sent].ip, datagrams[sent].port, datagrams[sent].data, datagrams[sent].len)) {
+    sent++;
+  }
+  return sent;
+#endif
+}
+
+int UdpSocket::receive(uint8_t *buf, size_t cap, uint32_t *ip, uint16_t *port) {
+  if (fd_ < 0) {
+    return -1;
+  }
+  struct sockaddr_in from;
+  socklen_t from_len = sizeof(from);
+  ssize_t len = recvfrom(fd_, buf, cap, 0, (struct sockaddr *) &from, &from_len);
+  if (len < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+  }
+  *ip = ntohl(from.sin_addr.s_addr);
+  *port = ntohs(from.sin_port);
+  return (int) len;
+}
+
+}  // namespace intercom
+}  // namespace esphome
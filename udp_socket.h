@@ -0,0 +1,79 @@
+/*
+ * UDP Socket
+ * The audio socket of the raw RTP path, on the BSD socket API that lwIP
+ * provides.
+ *
+ * Unlike WiFiUDP, which keeps one peer address for both the packet being
+ * built and the one last received, sends and receives share no state here,
+ * so a capture task can send while a render task waits in receive(). The
+ * wait is bounded by the timeout given to open(). A datagram is gathered
+ * from up to three pieces (header, payload, SRTP tag) without copying them
+ * together first.
+ *
+ * Several ready datagrams go out in one sendmmsg() call where the platform
+ * has it (Linux); lwIP has no such call and sends them one by one.
+ *
+ * set_dscp() marks what the socket sends with a DiffServ code point. The
+ * ESP32 Wi-Fi driver queues by it (WMM): without a mark audio waits in
+ * the best-effort queue behind every other frame. Drivers that take the
+ * 802.11 priority from the top three bits of the code point put EF in
+ * AC_VI; CS6 is the one that lands in AC_VO there.
+ *
+ * Addresses are host-order IPv4 as in ice_lite.h. Only needs the socket
+ * API, so the same code runs on the host.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace intercom {
+
+// DiffServ code points (RFC 4594)
+static constexpr uint8_t DSCP_BEST_EFFORT = 0;
+static constexpr uint8_t DSCP_AF41 = 34;  // Interactive video, and signaling that should keep up with it
+static constexpr uint8_t DSCP_EF = 46;    // Telephony
+static constexpr uint8_t DSCP_CS6 = 48;
+
+// Marks any IPv4 socket, such as a TCP one owned by another library
+bool set_socket_dscp(int fd, uint8_t dscp);
+
+struct UdpDatagram {
+  uint32_t ip;
+  uint16_t port;
+  const uint8_t *data;
+  size_t len;
+};
+
+class UdpSocket {
+ public:
+  UdpSocket() = default;
+  ~UdpSocket() { close(); }
+  UdpSocket(const UdpSocket &) = delete;
+  UdpSocket &operator=(const UdpSocket &) = delete;
+
+  // Binds to port on every interface; receive() waits at most
+  // receive_timeout_ms
+  bool open(uint16_t port, uint32_t receive_timeout_ms);
+  void close();
+  bool is_open() const { return fd_ >= 0; }
+  // Applies to every datagram sent from here on
+  bool set_dscp(uint8_t dscp) { return set_socket_dscp(fd_, dscp); }
+
+  // One datagram made of data, then more and tail when given
+  bool send(uint32_t ip, uint16_t port, const uint8_t *data, size_t len, const uint8_t *more = nullptr,
+            size_t more_len = 0, const uint8_t *tail = nullptr, size_t tail_len = 0);
+  // Returns how many of the datagrams went out, in order
+  size_t send_batch(const UdpDatagram *datagrams, size_t count);
+  // Waits for one datagram and the address it came from. Returns its length
+  // (cut to cap), 0 on timeout, or -1 on error.
+  int receive(uint8_t *buf, size_t cap, uint32_t *ip, uint16_t *port);
+
+ protected:
+  int fd_{-1};
+};
+
+}  // namespace intercom
+}  // namespace esphome